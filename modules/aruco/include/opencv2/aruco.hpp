@@ -120,6 +120,13 @@ namespace aruco {
  *   than 128 or not) (default 5.0)
  * - errorCorrectionRate error correction rate respect to the maximun error correction capability
  *   for each dictionary. (default 0.6).
+ * - adaptiveThreshIntegral: threshold the image with all the window sizes using one integral image
+ *   instead of a box filter for each window size. The thresholded images are the same (default
+ *   false).
+ * - adaptiveThreshPyrLevel: if adaptiveThreshIntegral is set, the local means of the adaptive
+ *   thresholding are computed in the image downscaled 2^adaptiveThreshPyrLevel times, with the
+ *   window sizes scaled accordingly, and compared with the pixels of the original image. It is an
+ *   approximation which reduces the cost for high resolution images (default 0).
  */
 struct CV_EXPORTS DetectorParameters {
 
@@ -145,6 +152,8 @@ struct CV_EXPORTS DetectorParameters {
     double maxErroneousBitsInBorderRate;
     double minOtsuStdDev;
     double errorCorrectionRate;
+    bool adaptiveThreshIntegral;
+    int adaptiveThreshPyrLevel;
 };
 
 
@@ -177,6 +186,79 @@ CV_EXPORTS void detectMarkers(InputArray image, Dictionary dictionary, OutputArr
 
 
 
+/**
+ * @brief Marker detector which keeps its intermediate buffers between the calls
+ *
+ * The detector gives the same results as detectMarkers(), but the grey images, thresholded images
+ * and candidate arrays allocated by the previous calls are reused, so processing of a video stream
+ * doesn't reallocate them for each frame. detectBatch() processes several frames at once (e.g.
+ * the frames of synchronized cameras): the candidates search for all the frames and all the
+ * thresholding window sizes, and the identification of the candidates of all the frames are each
+ * scheduled in one parallel loop, which balances the load better than a sequence of detectMarkers()
+ * calls. Copies of the detector share the buffers, so they must not be used concurrently.
+ *
+ * For video streams the detector can work in tracking mode (trackingInterval > 1): the image is
+ * only thresholded and searched for candidates in the regions around the positions of the markers
+ * predicted from the previous frames. A full-frame detection is done each trackingInterval-th
+ * frame, when any tracked marker is lost and while no marker is tracked, so new markers are found
+ * with a delay of at most trackingInterval frames. In tracking mode the rejected candidates are
+ * only the ones inside the searched regions. In detectBatch(), the i-th image of each call is
+ * considered the next frame of the i-th stream.
+ */
+class CV_EXPORTS MarkerDetector {
+
+    public:
+    /**
+     * @param dictionary indicates the type of markers that will be searched
+     * @param parameters marker detection parameters
+     */
+    MarkerDetector(const Dictionary &dictionary,
+                   const DetectorParameters &parameters = DetectorParameters());
+
+    /**
+     * @brief Detects markers in the image, see detectMarkers()
+     */
+    void detect(InputArray image, OutputArrayOfArrays corners, OutputArray ids,
+                OutputArrayOfArrays rejectedImgPoints = noArray());
+
+    /**
+     * @brief Detects markers in several images
+     *
+     * @param images vector of input images
+     * @param corners corners of the markers detected in each image, i.e. corners[i] contains the
+     * corners of markers detected in images[i] in the format of detectMarkers()
+     * @param ids identifiers of the markers detected in each image
+     */
+    void detectBatch(InputArrayOfArrays images,
+                     std::vector< std::vector< std::vector< Point2f > > > &corners,
+                     std::vector< std::vector< int > > &ids);
+
+    // the dictionary of the searched markers
+    Dictionary dictionary;
+
+    // marker detection parameters
+    DetectorParameters parameters;
+
+    // number of frames between the full-frame detections in tracking mode, 0 or 1 disables the
+    // tracking (default 0)
+    int trackingInterval;
+
+    // margin around the predicted marker positions searched in tracking mode, relative to the
+    // marker size (default 0.5)
+    float trackingMarginRate;
+
+    /**
+     * @brief Forces a full-frame detection in the next frame of all streams, e.g. after a cut
+     */
+    void resetTracking();
+
+    private:
+    struct Impl;
+    Ptr< Impl > impl;
+};
+
+
+
 /**
  * @brief Pose estimation for single markers
  *
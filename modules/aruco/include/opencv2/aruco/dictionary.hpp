@@ -75,6 +75,11 @@ class CV_EXPORTS Dictionary {
     /**
      * @brief Given a matrix of bits. Returns whether if marker is identified or not.
      * It returns by reference the correct id (if any) and the correct rotation
+     *
+     * The codes are searched in a multi-index hash table built by the constructor, so the cost
+     * doesn't grow linearly with the number of markers. The content of bytesList must not be
+     * modified in place after the construction. If another bytesList is assigned, markers are
+     * added or maxCorrectionRate is greater than 1, the dictionary is searched linearly.
      */
     bool identify(const Mat &onlyBits, int &idx, int &rotation, double maxCorrectionRate) const;
 
@@ -101,6 +106,10 @@ class CV_EXPORTS Dictionary {
       * @brief Transform list of bytes to matrix of bits
       */
     static Mat getBitsFromByteList(const Mat &byteList, int markerSize);
+
+    private:
+    struct Index;
+    Ptr< Index > index; // hashed codes of bytesList for identify()
 };
 
 
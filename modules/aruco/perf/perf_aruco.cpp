@@ -0,0 +1,213 @@
+/*
+By downloading, copying, installing or using the software you agree to this
+license. If you do not agree to this license, do not download, install,
+copy or use the software.
+
+                          License Agreement
+               For Open Source Computer Vision Library
+                       (3-clause BSD License)
+
+Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+Third party copyrights are property of their respective owners.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  * Neither the names of the copyright holders nor the names of the contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+This software is provided by the copyright holders and contributors "as is" and
+any express or implied warranties, including, but not limited to, the implied
+warranties of merchantability and fitness for a particular purpose are
+disclaimed. In no event shall copyright holders or contributors be liable for
+any direct, indirect, incidental, special, exemplary, or consequential damages
+(including, but not limited to, procurement of substitute goods or services;
+loss of use, data, or profits; or business interruption) however caused
+and on any theory of liability, whether in contract, strict liability,
+or tort (including negligence or otherwise) arising in any way out of
+the use of this software, even if advised of the possibility of such damage.
+*/
+
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace perf;
+using std::tr1::tuple;
+using std::tr1::get;
+
+/**
+ * @brief Frames of synchronized cameras looking at the same board from different positions
+ */
+static void _createCameraFrames(const aruco::Dictionary &dictionary, int nFrames,
+                                vector< Mat > &frames) {
+
+    aruco::GridBoard board = aruco::GridBoard::create(5, 4, 0.04f, 0.01f, dictionary);
+    Mat boardImage;
+    board.draw(Size(500, 400), boardImage, 10, 1);
+
+    RNG rng(0);
+    frames.resize(nFrames);
+    for(int i = 0; i < nFrames; i++) {
+        // random perspective view of the board in VGA frame
+        vector< Point2f > src(4), dst(4);
+        src[0] = Point2f(0, 0);
+        src[1] = Point2f((float)boardImage.cols, 0);
+        src[2] = Point2f((float)boardImage.cols, (float)boardImage.rows);
+        src[3] = Point2f(0, (float)boardImage.rows);
+        for(int c = 0; c < 4; c++)
+            dst[c] = src[c] * 0.9f + Point2f(40.f + rng.uniform(-25.f, 25.f),
+                                             30.f + rng.uniform(-25.f, 25.f));
+
+        warpPerspective(boardImage, frames[i], getPerspectiveTransform(src, dst), Size(640, 480),
+                        INTER_LINEAR, BORDER_CONSTANT, Scalar::all(255));
+    }
+}
+
+typedef tuple< int, bool > ArucoBatchParams; // number of cameras, batched detector
+typedef TestBaseWithParam< ArucoBatchParams > ArucoBatchPerfTest;
+
+PERF_TEST_P(ArucoBatchPerfTest, detect, testing::Combine(testing::Values(1, 4, 16),
+                                                         testing::Bool())) {
+
+    int nFrames = get< 0 >(GetParam());
+    bool batched = get< 1 >(GetParam());
+
+    aruco::Dictionary dictionary = aruco::getPredefinedDictionary(aruco::DICT_6X6_250);
+    vector< Mat > frames;
+    _createCameraFrames(dictionary, nFrames, frames);
+
+    aruco::MarkerDetector detector(dictionary);
+    vector< vector< vector< Point2f > > > corners(nFrames);
+    vector< vector< int > > ids(nFrames);
+
+    TEST_CYCLE() {
+        if(batched)
+            detector.detectBatch(frames, corners, ids);
+        else
+            for(int i = 0; i < nFrames; i++)
+                aruco::detectMarkers(frames[i], dictionary, corners[i], ids[i]);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+
+typedef tuple< Size, bool > ArucoTrackingParams; // frame size, tracking mode
+typedef TestBaseWithParam< ArucoTrackingParams > ArucoTrackingPerfTest;
+
+PERF_TEST_P(ArucoTrackingPerfTest, detect,
+            testing::Combine(testing::Values(Size(640, 480), Size(1920, 1080), Size(3840, 2160)),
+                             testing::Bool())) {
+
+    Size frameSize = get< 0 >(GetParam());
+    bool tracking = get< 1 >(GetParam());
+
+    // video of a few markers moving across the frame
+    aruco::Dictionary dictionary = aruco::getPredefinedDictionary(aruco::DICT_6X6_250);
+    const int nFrames = 20, nMarkers = 4;
+    int markerSide = frameSize.height / 8;
+    vector< Mat > frames(nFrames);
+    for(int f = 0; f < nFrames; f++) {
+        frames[f] = Mat(frameSize, CV_8UC1, Scalar::all(255));
+        for(int m = 0; m < nMarkers; m++) {
+            Mat marker;
+            aruco::drawMarker(dictionary, m, markerSide, marker);
+            Point pos(markerSide * (2 * m + 1) + f * markerSide / 20,
+                      markerSide + f * markerSide / 40);
+            marker.copyTo(frames[f](Rect(pos, Size(markerSide, markerSide))));
+        }
+    }
+
+    aruco::MarkerDetector detector(dictionary);
+    detector.trackingInterval = tracking ? 10 : 0;
+    vector< vector< Point2f > > corners;
+    vector< int > ids;
+
+    TEST_CYCLE() {
+        detector.resetTracking();
+        for(int f = 0; f < nFrames; f++)
+            detector.detect(frames[f], corners, ids);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+
+typedef tuple< int, bool > ArucoIdentifyParams; // predefined dictionary, hashed search
+typedef TestBaseWithParam< ArucoIdentifyParams > ArucoIdentifyPerfTest;
+
+PERF_TEST_P(ArucoIdentifyPerfTest, identify,
+            testing::Combine(testing::Values((int)aruco::DICT_4X4_50, (int)aruco::DICT_5X5_250,
+                                             (int)aruco::DICT_6X6_1000, (int)aruco::DICT_7X7_1000,
+                                             (int)aruco::DICT_ARUCO_ORIGINAL),
+                             testing::Bool())) {
+
+    aruco::PREDEFINED_DICTIONARY_NAME name =
+        aruco::PREDEFINED_DICTIONARY_NAME(get< 0 >(GetParam()));
+    bool hashed = get< 1 >(GetParam());
+
+    aruco::Dictionary dictionary = aruco::getPredefinedDictionary(name);
+    // a dictionary with a new bytesList isn't indexed and is searched linearly
+    if(!hashed) dictionary.bytesList = dictionary.bytesList.clone();
+
+    // markers with some wrong bits and random codes, i.e. mostly rejected candidates
+    RNG rng(0);
+    vector< Mat > candidates(200);
+    for(size_t i = 0; i < candidates.size(); i++) {
+        Mat &bits = candidates[i];
+        if(i % 2 == 0) {
+            int id = rng.uniform(0, dictionary.bytesList.rows);
+            bits = aruco::Dictionary::getBitsFromByteList(dictionary.bytesList.rowRange(id, id + 1),
+                                                          dictionary.markerSize);
+            bits.at< uchar >(rng.uniform(0, bits.rows), rng.uniform(0, bits.cols)) ^= 1;
+        } else {
+            bits.create(dictionary.markerSize, dictionary.markerSize, CV_8UC1);
+            rng.fill(bits, RNG::UNIFORM, 0, 2);
+        }
+    }
+
+    int idx, rotation;
+    TEST_CYCLE() {
+        for(size_t i = 0; i < candidates.size(); i++)
+            dictionary.identify(candidates[i], idx, rotation, 0.6);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+
+// threshold modes: 0 adaptive threshold per window size, 1 integral image, 2 downscaled integral
+typedef tuple< Size, int > ArucoThresholdParams;
+typedef TestBaseWithParam< ArucoThresholdParams > ArucoThresholdPerfTest;
+
+PERF_TEST_P(ArucoThresholdPerfTest, detectMarkers,
+            testing::Combine(testing::Values(Size(640, 480), Size(1920, 1080), Size(3840, 2160)),
+                             testing::Values(0, 1, 2))) {
+
+    Size frameSize = get< 0 >(GetParam());
+    int mode = get< 1 >(GetParam());
+
+    aruco::Dictionary dictionary = aruco::getPredefinedDictionary(aruco::DICT_6X6_250);
+    aruco::GridBoard board = aruco::GridBoard::create(5, 4, 0.04f, 0.01f, dictionary);
+    Mat image;
+    board.draw(frameSize, image, frameSize.height / 10, 1);
+
+    aruco::DetectorParameters params;
+    params.adaptiveThreshIntegral = mode > 0;
+    params.adaptiveThreshPyrLevel = mode > 1 ? 1 : 0;
+    vector< vector< Point2f > > corners;
+    vector< int > ids;
+
+    TEST_CYCLE() aruco::detectMarkers(image, dictionary, corners, ids, params);
+
+    SANITY_CHECK_NOTHING();
+}
@@ -40,6 +40,7 @@ the use of this software, even if advised of the possibility of such damage.
 #include "opencv2/aruco.hpp"
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
+#include "opencv2/core/hal/intrin.hpp"
 
 
 namespace cv {
@@ -73,7 +74,9 @@ DetectorParameters::DetectorParameters()
       perspectiveRemoveIgnoredMarginPerCell(0.13),
       maxErroneousBitsInBorderRate(0.35),
       minOtsuStdDev(5.0),
-      errorCorrectionRate(0.6) {}
+      errorCorrectionRate(0.6),
+      adaptiveThreshIntegral(false),
+      adaptiveThreshPyrLevel(0) {}
 
 
 /**
@@ -103,41 +106,195 @@ static void _threshold(InputArray _in, OutputArray _out, int winSize, double con
 
 
 /**
-  * @brief Given a tresholded image, find the contours, calculate their polygonal approximation
-  * and take those that accomplish some conditions
+  * @brief Integral image of a region of the grey image with a border of the given width. The
+  * region is processed as an isolated image, its edge pixels are replicated into the border as
+  * adaptiveThreshold() does for the region. The region is downscaled 2^level times before the
+  * integration. Sums are computed modulo 2^32, so differences of sums are exact for any image size.
   */
-static void _findMarkerContours(InputArray _in, vector< vector< Point2f > > &candidates,
-                                vector< vector< Point > > &contoursOut, double minPerimeterRate,
-                                double maxPerimeterRate, double accuracyRate,
-                                double minCornerDistanceRate, int minDistanceToBorder) {
+static void _regionIntegral(const Mat &grey, const Rect &region, int level, int border,
+                            Mat &padded, Mat &scaled, Mat &integral) {
+
+    int s = 1 << level;
+    copyMakeBorder(grey(region), padded, border * s, border * s, border * s, border * s,
+                   BORDER_REPLICATE | BORDER_ISOLATED);
+    if(level > 0)
+        resize(padded, scaled, Size((padded.cols + s - 1) / s, (padded.rows + s - 1) / s), 0, 0,
+               INTER_AREA);
+    else
+        scaled = padded;
+
+    integral.create(scaled.rows + 1, scaled.cols + 1, CV_32SC1);
+    memset(integral.ptr(0), 0, integral.cols * sizeof(unsigned));
+    for(int y = 0; y < scaled.rows; y++) {
+        const uchar *src = scaled.ptr(y);
+        const unsigned *prev = integral.ptr< unsigned >(y);
+        unsigned *curr = integral.ptr< unsigned >(y + 1);
+        unsigned rowSum = 0;
+        curr[0] = 0;
+        for(int x = 0; x < scaled.cols; x++) {
+            rowSum += src[x];
+            curr[x + 1] = prev[x + 1] + rowSum;
+        }
+    }
+}
+
+
+/**
+  * ParallelLoopBody class for the thresholding of the rows of a region with all the window sizes
+  * from the integral image. The result is the same as the one of _threshold(): a pixel is set if
+  * p + floor(constant) <= round(mean), which for the odd window area a is 2 * sum >=
+  * (2 * (p + floor(constant)) - 1) * a, since the mean is never half-integer.
+  */
+class IntegralThresholdParallel : public ParallelLoopBody {
+    public:
+    IntegralThresholdParallel(const Mat *_grey, const Rect &_region, const Mat *_integral,
+                              int _level, int _border, const vector< int > *_radius, int _delta,
+                              vector< Mat > *_thresh)
+        : grey(_grey), region(_region), integral(_integral), level(_level), border(_border),
+          radius(_radius), delta(_delta), thresh(_thresh) {}
+
+    void operator()(const Range &range) const {
+        // window sums of the (downscaled) columns of the region in the current row
+        int nSums = ((region.width - 1) >> level) + 1;
+        vector< int > sumsBuf(nSums);
+        int *sums = &sumsBuf[0];
+
+        for(int y = range.start; y < range.end; y++) {
+            int yl = (y >> level) + border;
+            const uchar *src = grey->ptr(region.y + y) + region.x;
+
+            for(size_t k = 0; k < radius->size(); k++) {
+                int r = (*radius)[k];
+                int area = (2 * r + 1) * (2 * r + 1);
+                const unsigned *top = integral->ptr< unsigned >(yl - r) + border - r;
+                const unsigned *bottom = integral->ptr< unsigned >(yl + r + 1) + border - r;
+                const int w = 2 * r + 1;
+                uchar *dst = (*thresh)[k].ptr(y);
+
+                int x = 0;
+#if CV_SIMD128
+                for(; x <= nSums - 4; x += 4) {
+                    v_uint32x4 sum = v_load(bottom + x + w) - v_load(bottom + x) -
+                                     v_load(top + x + w) + v_load(top + x);
+                    v_store(sums + x, v_reinterpret_as_s32(sum));
+                }
+#endif
+                for(; x < nSums; x++)
+                    sums[x] = (int)(bottom[x + w] - bottom[x] - top[x + w] + top[x]);
+
+                x = 0;
+                if(level == 0) {
+#if CV_SIMD128
+                    v_int32x4 vdelta = v_setall_s32(2 * delta - 1), varea = v_setall_s32(area);
+                    v_int32x4 vmin = v_setall_s32(-1), vmax = v_setall_s32(511);
+                    for(; x <= region.width - 16; x += 16) {
+                        v_int32x4 mask[4];
+                        for(int j = 0; j < 4; j++) {
+                            // 2 * (p + delta) - 1 clamped to [-1, 511], out of [0, 255] means
+                            v_int32x4 v = v_reinterpret_as_s32(v_load_expand_q(src + x + 4 * j));
+                            v = v_min(v_max(v + v + vdelta, vmin), vmax);
+                            v_int32x4 sum = v_load(sums + x + 4 * j);
+                            mask[j] = (sum + sum) >= v * varea;
+                        }
+                        v_store((schar *)dst + x, v_pack(v_pack(mask[0], mask[1]),
+                                                         v_pack(mask[2], mask[3])));
+                    }
+#endif
+                    for(; x < region.width; x++) {
+                        int v = min(max(2 * (src[x] + delta) - 1, -1), 511);
+                        dst[x] = 2 * sums[x] >= v * area ? 255 : 0;
+                    }
+                } else {
+                    for(; x < region.width; x++) {
+                        int v = min(max(2 * (src[x] + delta) - 1, -1), 511);
+                        dst[x] = 2 * sums[x >> level] >= v * area ? 255 : 0;
+                    }
+                }
+            }
+        }
+    }
+
+    private:
+    IntegralThresholdParallel &operator=(const IntegralThresholdParallel &);
+
+    const Mat *grey;
+    Rect region;
+    const Mat *integral;
+    int level, border;
+    const vector< int > *radius;
+    int delta;
+    vector< Mat > *thresh;
+};
+
+
+/**
+  * @brief Threshold a region of the image with all the window sizes of the parameters, using one
+  * integral image instead of a box filter per window size. With params.adaptiveThreshPyrLevel > 0
+  * the local means are computed in the downscaled image, which is an approximation.
+  */
+static void _integralThreshold(const Mat &grey, const Rect &region,
+                               const DetectorParameters &params, int nScales,
+                               vector< Mat > &thresh, Mat &padded, Mat &scaled, Mat &integral) {
+
+    int level = params.adaptiveThreshPyrLevel;
+    CV_Assert(level >= 0 && level < 8);
+    CV_Assert(params.adaptiveThreshWinSizeMax < 2048); // products of the comparison in 32 bits
+
+    // window radius of each scale in the downscaled image, even window sizes are made odd as in
+    // _threshold()
+    vector< int > radius(nScales);
+    int border = 0;
+    for(int k = 0; k < nScales; k++) {
+        int winSize = params.adaptiveThreshWinSizeMin + k * params.adaptiveThreshWinSizeStep;
+        radius[k] = (winSize / 2) >> level;
+        border = max(border, radius[k]);
+    }
+
+    _regionIntegral(grey, region, level, border, padded, scaled, integral);
+
+    thresh.resize(nScales);
+    for(int k = 0; k < nScales; k++)
+        thresh[k].create(region.size(), CV_8UC1);
+
+    parallel_for_(Range(0, region.height),
+                  IntegralThresholdParallel(&grey, region, &integral, level, border, &radius,
+                                            cvFloor(params.adaptiveThreshConstant), &thresh));
+}
+
+
+/**
+  * @brief Given the contours of a tresholded image, calculate their polygonal approximation
+  * and take those that accomplish some conditions. The contours are found in the region of the
+  * image, the border distance is checked against the region borders.
+  */
+static void _filterMarkerContours(const vector< vector< Point > > &contours, Size imageSize,
+                                  const Rect &region, vector< vector< Point2f > > &candidates,
+                                  vector< vector< Point > > &contoursOut, double minPerimeterRate,
+                                  double maxPerimeterRate, double accuracyRate,
+                                  double minCornerDistanceRate, int minDistanceToBorder) {
 
     CV_Assert(minPerimeterRate > 0 && maxPerimeterRate > 0 && accuracyRate > 0 &&
               minCornerDistanceRate >= 0 && minDistanceToBorder >= 0);
 
     // calculate maximum and minimum sizes in pixels
     unsigned int minPerimeterPixels =
-        (unsigned int)(minPerimeterRate * max(_in.getMat().cols, _in.getMat().rows));
+        (unsigned int)(minPerimeterRate * max(imageSize.width, imageSize.height));
     unsigned int maxPerimeterPixels =
-        (unsigned int)(maxPerimeterRate * max(_in.getMat().cols, _in.getMat().rows));
+        (unsigned int)(maxPerimeterRate * max(imageSize.width, imageSize.height));
 
-    Mat contoursImg;
-    _in.getMat().copyTo(contoursImg);
-    vector< vector< Point > > contours;
-    findContours(contoursImg, contours, RETR_LIST, CHAIN_APPROX_NONE);
-    // now filter list of contours
+    vector< Point > approxCurve;
     for(unsigned int i = 0; i < contours.size(); i++) {
         // check perimeter
         if(contours[i].size() < minPerimeterPixels || contours[i].size() > maxPerimeterPixels)
             continue;
 
         // check is square and is convex
-        vector< Point > approxCurve;
         approxPolyDP(contours[i], approxCurve, double(contours[i].size()) * accuracyRate, true);
         if(approxCurve.size() != 4 || !isContourConvex(approxCurve)) continue;
 
         // check min distance between corners
         double minDistSq =
-            max(contoursImg.cols, contoursImg.rows) * max(contoursImg.cols, contoursImg.rows);
+            max(imageSize.width, imageSize.height) * max(imageSize.width, imageSize.height);
         for(int j = 0; j < 4; j++) {
             double d = (double)(approxCurve[j].x - approxCurve[(j + 1) % 4].x) *
                            (double)(approxCurve[j].x - approxCurve[(j + 1) % 4].x) +
@@ -151,9 +308,10 @@ static void _findMarkerContours(InputArray _in, vector< vector< Point2f > > &can
         // check if it is too near to the image border
         bool tooNearBorder = false;
         for(int j = 0; j < 4; j++) {
-            if(approxCurve[j].x < minDistanceToBorder || approxCurve[j].y < minDistanceToBorder ||
-               approxCurve[j].x > contoursImg.cols - 1 - minDistanceToBorder ||
-               approxCurve[j].y > contoursImg.rows - 1 - minDistanceToBorder)
+            if(approxCurve[j].x < region.x + minDistanceToBorder ||
+               approxCurve[j].y < region.y + minDistanceToBorder ||
+               approxCurve[j].x > region.x + region.width - 1 - minDistanceToBorder ||
+               approxCurve[j].y > region.y + region.height - 1 - minDistanceToBorder)
                 tooNearBorder = true;
         }
         if(tooNearBorder) continue;
@@ -170,6 +328,26 @@ static void _findMarkerContours(InputArray _in, vector< vector< Point2f > > &can
 }
 
 
+/**
+  * @brief Given a tresholded image, find the contours, calculate their polygonal approximation
+  * and take those that accomplish some conditions
+  */
+static void _findMarkerContours(InputArray _in, vector< vector< Point2f > > &candidates,
+                                vector< vector< Point > > &contoursOut, double minPerimeterRate,
+                                double maxPerimeterRate, double accuracyRate,
+                                double minCornerDistanceRate, int minDistanceToBorder) {
+
+    Mat contoursImg;
+    _in.getMat().copyTo(contoursImg);
+    vector< vector< Point > > contours;
+    findContours(contoursImg, contours, RETR_LIST, CHAIN_APPROX_NONE);
+    // now filter list of contours
+    _filterMarkerContours(contours, contoursImg.size(), Rect(Point(), contoursImg.size()),
+                          candidates, contoursOut, minPerimeterRate, maxPerimeterRate,
+                          accuracyRate, minCornerDistanceRate, minDistanceToBorder);
+}
+
+
 /**
   * @brief Assure order of candidate corners is clockwise direction
   */
@@ -261,15 +439,17 @@ static void _filterTooCloseCandidates(const vector< vector< Point2f > > &candida
 /**
   * ParallelLoopBody class for the parallelization of the basic candidate detections using
   * different threhold window sizes. Called from function _detectInitialCandidates()
+  * If the thresholded images are given, they are used instead of thresholding the grey image.
   */
 class DetectInitialCandidatesParallel : public ParallelLoopBody {
     public:
     DetectInitialCandidatesParallel(const Mat *_grey,
                                     vector< vector< vector< Point2f > > > *_candidatesArrays,
                                     vector< vector< vector< Point > > > *_contoursArrays,
-                                    DetectorParameters *_params)
+                                    DetectorParameters *_params,
+                                    const vector< Mat > *_thresholds = 0)
         : grey(_grey), candidatesArrays(_candidatesArrays), contoursArrays(_contoursArrays),
-          params(_params) {}
+          params(_params), thresholds(_thresholds) {}
 
     void operator()(const Range &range) const {
         const int begin = range.start;
@@ -280,7 +460,10 @@ class DetectInitialCandidatesParallel : public ParallelLoopBody {
                 params->adaptiveThreshWinSizeMin + i * params->adaptiveThreshWinSizeStep;
             // threshold
             Mat thresh;
-            _threshold(*grey, thresh, currScale, params->adaptiveThreshConstant);
+            if(thresholds)
+                thresh = (*thresholds)[i];
+            else
+                _threshold(*grey, thresh, currScale, params->adaptiveThreshConstant);
 
             // detect rectangles
             _findMarkerContours(thresh, (*candidatesArrays)[i], (*contoursArrays)[i],
@@ -297,23 +480,33 @@ class DetectInitialCandidatesParallel : public ParallelLoopBody {
     vector< vector< vector< Point2f > > > *candidatesArrays;
     vector< vector< vector< Point > > > *contoursArrays;
     DetectorParameters *params;
+    const vector< Mat > *thresholds;
 };
 
 
 /**
- * @brief Initial steps on finding square candidates
+ * @brief Number of window sizes (scales) to apply adaptive thresholding
  */
-static void _detectInitialCandidates(const Mat &grey, vector< vector< Point2f > > &candidates,
-                                     vector< vector< Point > > &contours,
-                                     DetectorParameters params) {
+static int _getThresholdScales(const DetectorParameters &params) {
 
     CV_Assert(params.adaptiveThreshWinSizeMin >= 3 && params.adaptiveThreshWinSizeMax >= 3);
     CV_Assert(params.adaptiveThreshWinSizeMax >= params.adaptiveThreshWinSizeMin);
     CV_Assert(params.adaptiveThreshWinSizeStep > 0);
 
+    return (params.adaptiveThreshWinSizeMax - params.adaptiveThreshWinSizeMin) /
+               params.adaptiveThreshWinSizeStep + 1;
+}
+
+
+/**
+ * @brief Initial steps on finding square candidates
+ */
+static void _detectInitialCandidates(const Mat &grey, vector< vector< Point2f > > &candidates,
+                                     vector< vector< Point > > &contours,
+                                     DetectorParameters params) {
+
     // number of window sizes (scales) to apply adaptive thresholding
-    int nScales = (params.adaptiveThreshWinSizeMax - params.adaptiveThreshWinSizeMin) /
-                      params.adaptiveThreshWinSizeStep + 1;
+    int nScales = _getThresholdScales(params);
 
     vector< vector< vector< Point2f > > > candidatesArrays(nScales);
     vector< vector< vector< Point > > > contoursArrays(nScales);
@@ -331,9 +524,19 @@ static void _detectInitialCandidates(const Mat &grey, vector< vector< Point2f >
     //                        params.minCornerDistance, params.minDistanceToBorder);
     //}
 
+    // all the window sizes can be thresholded at once from an integral image
+    vector< Mat > thresholds;
+    if(params.adaptiveThreshIntegral) {
+        Mat padded, scaled, integral;
+        _integralThreshold(grey, Rect(Point(), grey.size()), params, nScales, thresholds, padded,
+                           scaled, integral);
+    }
+
     // this is the parallel call for the previous commented loop (result is equivalent)
-    parallel_for_(Range(0, nScales), DetectInitialCandidatesParallel(&grey, &candidatesArrays,
-                                                                     &contoursArrays, &params));
+    parallel_for_(Range(0, nScales),
+                  DetectInitialCandidatesParallel(&grey, &candidatesArrays, &contoursArrays,
+                                                  &params,
+                                                  params.adaptiveThreshIntegral ? &thresholds : 0));
 
     // join candidates
     for(int i = 0; i < nScales; i++) {
@@ -815,6 +1018,581 @@ void detectMarkers(InputArray _image, Dictionary dictionary, OutputArrayOfArrays
 
 
 
+/**
+  * @brief Intermediate data of one frame processed by MarkerDetector, kept between the calls
+  */
+struct MarkerDetectorFrame {
+    MarkerDetectorFrame() : framesToDetection(0) {}
+
+    Mat grey, greyBuf;
+    // regions searched for the candidates and the range of their items in MarkerDetector::Impl
+    vector< Rect > regions;
+    Range scalesRange;
+    // candidates of all thresholding scales and the ones remaining after the filtering
+    vector< vector< Point2f > > joinedCandidates, candidates;
+    vector< vector< Point > > joinedContours, contours;
+    vector< int > candidateIds;
+    vector< char > validCandidates;
+    vector< vector< Point2f > > corners, rejected;
+    vector< int > ids;
+
+    // tracking state: markers of the previous frame, their motion and the number of frames
+    // which can still be processed in tracking mode before the next full-frame detection
+    vector< vector< Point2f > > trackedCorners;
+    vector< int > trackedIds;
+    vector< Point2f > trackedShifts;
+    Size trackedSize;
+    int framesToDetection;
+};
+
+
+/**
+  * @brief Buffers of the candidates search in one region of a frame with one thresholding window
+  * size
+  */
+struct MarkerDetectorScale {
+    int frame;
+    Rect region;
+    int winSize;
+    Mat thresh;
+    vector< vector< Point > > allContours, contours;
+    vector< vector< Point2f > > candidates;
+    // buffers of the integral thresholding, used by the first scale item of each region
+    Mat padded, scaled, integral;
+};
+
+
+struct MarkerDetector::Impl {
+    vector< MarkerDetectorFrame > frames;
+    vector< MarkerDetectorScale > scales; // (frame, region, window size) of the candidates search
+    vector< Vec2i > candidatesIdx;        // (frame, candidate) of all the candidates of the batch
+    vector< Vec2i > markersIdx;           // (frame, marker) of all the markers of the batch
+    vector< int > regionsIdx;             // first item in scales of each region of the batch
+
+    void detect(InputArrayOfArrays images, const Dictionary &dictionary,
+                const DetectorParameters &params, int trackingInterval, float trackingMarginRate,
+                bool needRejected);
+};
+
+
+/**
+  * ParallelLoopBody class for the conversion of the batch frames to grey
+  */
+class ConvertFramesParallel : public ParallelLoopBody {
+    public:
+    ConvertFramesParallel(InputArrayOfArrays _images, vector< MarkerDetectorFrame > *_frames)
+        : images(_images), frames(_frames) {}
+
+    void operator()(const Range &range) const {
+        for(int i = range.start; i < range.end; i++) {
+            Mat image = images.getMat(i);
+            CV_Assert(image.total() != 0);
+            MarkerDetectorFrame &frame = (*frames)[i];
+
+            // grey images are used directly, the buffer isn't bound to the user data
+            if(image.type() == CV_8UC1)
+                frame.grey = image;
+            else {
+                _convertToGrey(image, frame.greyBuf);
+                frame.grey = frame.greyBuf;
+            }
+        }
+    }
+
+    private:
+    ConvertFramesParallel &operator=(const ConvertFramesParallel &); // to quiet MSVC
+
+    InputArrayOfArrays images;
+    vector< MarkerDetectorFrame > *frames;
+};
+
+
+/**
+  * @brief Regions around the positions of the tracked markers predicted from their last motion.
+  * Overlapping regions are merged, so no pixel is thresholded twice with the same window size.
+  */
+static void _predictTrackedRegions(const MarkerDetectorFrame &frame,
+                                   const DetectorParameters &params, float marginRate,
+                                   vector< Rect > &regions) {
+
+    Rect imageRect(Point(), frame.grey.size());
+    regions.clear();
+    vector< Point2f > predicted(4);
+    for(unsigned int i = 0; i < frame.trackedCorners.size(); i++) {
+        for(int c = 0; c < 4; c++)
+            predicted[c] = frame.trackedCorners[i][c] + frame.trackedShifts[i];
+        Rect r = boundingRect(predicted);
+
+        // the margin is at least the largest thresholding window, so the threshold around the
+        // marker is the same as in the full frame
+        int margin = max(cvRound(marginRate * max(r.width, r.height)),
+                         params.adaptiveThreshWinSizeMax);
+        r = Rect(r.x - margin, r.y - margin, r.width + 2 * margin, r.height + 2 * margin);
+        r &= imageRect;
+        if(r.area() > 0) regions.push_back(r);
+    }
+
+    bool merged = true;
+    while(merged) {
+        merged = false;
+        for(unsigned int i = 0; i < regions.size() && !merged; i++) {
+            for(unsigned int j = i + 1; j < regions.size(); j++) {
+                if((regions[i] & regions[j]).area() > 0) {
+                    regions[i] |= regions[j];
+                    regions.erase(regions.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+
+/**
+  * @brief Match the detected markers with the tracked ones to get their motion and decide when the
+  * next full-frame detection is done
+  */
+static void _updateTracking(MarkerDetectorFrame &frame, bool fullDetection, int trackingInterval) {
+
+    vector< char > found(frame.trackedIds.size(), 0);
+    vector< Point2f > shifts(frame.ids.size(), Point2f(0, 0));
+    for(unsigned int m = 0; m < frame.ids.size(); m++) {
+        Point2f center = (frame.corners[m][0] + frame.corners[m][1] + frame.corners[m][2] +
+                          frame.corners[m][3]) * 0.25f;
+
+        // nearest tracked marker with the same id
+        int best = -1;
+        double bestDist = 0;
+        for(unsigned int t = 0; t < frame.trackedIds.size(); t++) {
+            if(found[t] || frame.trackedIds[t] != frame.ids[m]) continue;
+            const vector< Point2f > &tc = frame.trackedCorners[t];
+            Point2f trackedCenter = (tc[0] + tc[1] + tc[2] + tc[3]) * 0.25f;
+            double dist = norm(center - trackedCenter);
+            if(best == -1 || dist < bestDist) {
+                best = (int)t;
+                bestDist = dist;
+                shifts[m] = center - trackedCenter;
+            }
+        }
+        if(best != -1) found[best] = 1;
+    }
+
+    // a lost marker can only be found again by the full-frame detection
+    bool lost = false;
+    for(unsigned int t = 0; t < found.size(); t++)
+        if(!found[t]) lost = true;
+
+    if(fullDetection)
+        frame.framesToDetection = trackingInterval - 1;
+    else if(lost)
+        frame.framesToDetection = 0;
+    else
+        frame.framesToDetection--;
+
+    frame.trackedCorners = frame.corners;
+    frame.trackedIds = frame.ids;
+    frame.trackedShifts = shifts;
+    frame.trackedSize = frame.grey.size();
+}
+
+
+/**
+  * ParallelLoopBody class for the candidates search in all the regions of all the frames of the
+  * batch with all the thresholding window sizes
+  */
+class DetectCandidatesBatchParallel : public ParallelLoopBody {
+    public:
+    DetectCandidatesBatchParallel(vector< MarkerDetectorFrame > *_frames,
+                                  vector< MarkerDetectorScale > *_scales,
+                                  const DetectorParameters *_params)
+        : frames(_frames), scales(_scales), params(_params) {}
+
+    void operator()(const Range &range) const {
+        for(int i = range.start; i < range.end; i++) {
+            MarkerDetectorScale &scale = (*scales)[i];
+            const Mat &grey = (*frames)[scale.frame].grey;
+
+            // threshold, unless all the scales of the region were thresholded from the integral
+            if(!params->adaptiveThreshIntegral)
+                _threshold(grey(scale.region), scale.thresh, scale.winSize,
+                           params->adaptiveThreshConstant);
+
+            // detect rectangles, thresholded image isn't needed anymore and can be modified
+            findContours(scale.thresh, scale.allContours, RETR_LIST, CHAIN_APPROX_NONE,
+                         scale.region.tl());
+            scale.candidates.clear();
+            scale.contours.clear();
+            _filterMarkerContours(scale.allContours, grey.size(), scale.region, scale.candidates,
+                                  scale.contours, params->minMarkerPerimeterRate,
+                                  params->maxMarkerPerimeterRate,
+                                  params->polygonalApproxAccuracyRate,
+                                  params->minCornerDistanceRate, params->minDistanceToBorder);
+        }
+    }
+
+    private:
+    DetectCandidatesBatchParallel &operator=(const DetectCandidatesBatchParallel &);
+
+    vector< MarkerDetectorFrame > *frames;
+    vector< MarkerDetectorScale > *scales;
+    const DetectorParameters *params;
+};
+
+
+/**
+  * ParallelLoopBody class for the integral thresholding of all the regions of the batch, each one
+  * with all the window sizes
+  */
+class IntegralThresholdBatchParallel : public ParallelLoopBody {
+    public:
+    IntegralThresholdBatchParallel(vector< MarkerDetectorFrame > *_frames,
+                                   vector< MarkerDetectorScale > *_scales,
+                                   const vector< int > *_regionsIdx, int _nScales,
+                                   const DetectorParameters *_params)
+        : frames(_frames), scales(_scales), regionsIdx(_regionsIdx), nScales(_nScales),
+          params(_params) {}
+
+    void operator()(const Range &range) const {
+        vector< Mat > thresh(nScales);
+        for(int i = range.start; i < range.end; i++) {
+            int first = (*regionsIdx)[i];
+            MarkerDetectorScale &scale = (*scales)[first];
+
+            // the buffers of the previous calls are reused by create()
+            for(int k = 0; k < nScales; k++)
+                thresh[k] = (*scales)[first + k].thresh;
+            _integralThreshold((*frames)[scale.frame].grey, scale.region, *params, nScales, thresh,
+                               scale.padded, scale.scaled, scale.integral);
+            for(int k = 0; k < nScales; k++)
+                (*scales)[first + k].thresh = thresh[k];
+        }
+    }
+
+    private:
+    IntegralThresholdBatchParallel &operator=(const IntegralThresholdBatchParallel &);
+
+    vector< MarkerDetectorFrame > *frames;
+    vector< MarkerDetectorScale > *scales;
+    const vector< int > *regionsIdx;
+    int nScales;
+    const DetectorParameters *params;
+};
+
+
+/**
+  * ParallelLoopBody class for joining the candidates of all the scales of each frame
+  */
+class JoinCandidatesParallel : public ParallelLoopBody {
+    public:
+    JoinCandidatesParallel(vector< MarkerDetectorFrame > *_frames,
+                           vector< MarkerDetectorScale > *_scales,
+                           const DetectorParameters *_params)
+        : frames(_frames), scales(_scales), params(_params) {}
+
+    void operator()(const Range &range) const {
+        for(int i = range.start; i < range.end; i++) {
+            MarkerDetectorFrame &frame = (*frames)[i];
+            frame.joinedCandidates.clear();
+            frame.joinedContours.clear();
+            for(int s = frame.scalesRange.start; s < frame.scalesRange.end; s++) {
+                const MarkerDetectorScale &scale = (*scales)[s];
+                frame.joinedCandidates.insert(frame.joinedCandidates.end(),
+                                              scale.candidates.begin(), scale.candidates.end());
+                frame.joinedContours.insert(frame.joinedContours.end(), scale.contours.begin(),
+                                            scale.contours.end());
+            }
+
+            _reorderCandidatesCorners(frame.joinedCandidates);
+            _filterTooCloseCandidates(frame.joinedCandidates, frame.candidates,
+                                      frame.joinedContours, frame.contours,
+                                      params->minMarkerDistanceRate);
+
+            frame.candidateIds.assign(frame.candidates.size(), -1);
+            frame.validCandidates.assign(frame.candidates.size(), 0);
+        }
+    }
+
+    private:
+    JoinCandidatesParallel &operator=(const JoinCandidatesParallel &);
+
+    vector< MarkerDetectorFrame > *frames;
+    vector< MarkerDetectorScale > *scales;
+    const DetectorParameters *params;
+};
+
+
+/**
+  * ParallelLoopBody class for the identification of the candidates of all the frames of the batch
+  */
+class IdentifyCandidatesBatchParallel : public ParallelLoopBody {
+    public:
+    IdentifyCandidatesBatchParallel(vector< MarkerDetectorFrame > *_frames,
+                                    const vector< Vec2i > *_candidatesIdx,
+                                    const Dictionary *_dictionary,
+                                    const DetectorParameters *_params)
+        : frames(_frames), candidatesIdx(_candidatesIdx), dictionary(_dictionary),
+          params(_params) {}
+
+    void operator()(const Range &range) const {
+        for(int i = range.start; i < range.end; i++) {
+            MarkerDetectorFrame &frame = (*frames)[(*candidatesIdx)[i][0]];
+            int c = (*candidatesIdx)[i][1];
+            int currId;
+            if(_identifyOneCandidate(*dictionary, frame.grey, frame.candidates[c], currId,
+                                     *params)) {
+                frame.validCandidates[c] = 1;
+                frame.candidateIds[c] = currId;
+            }
+        }
+    }
+
+    private:
+    IdentifyCandidatesBatchParallel &operator=(const IdentifyCandidatesBatchParallel &);
+
+    vector< MarkerDetectorFrame > *frames;
+    const vector< Vec2i > *candidatesIdx;
+    const Dictionary *dictionary;
+    const DetectorParameters *params;
+};
+
+
+/**
+  * ParallelLoopBody class for the selection of the identified markers of each frame
+  */
+class FilterMarkersParallel : public ParallelLoopBody {
+    public:
+    FilterMarkersParallel(vector< MarkerDetectorFrame > *_frames, bool _needRejected)
+        : frames(_frames), needRejected(_needRejected) {}
+
+    void operator()(const Range &range) const {
+        for(int i = range.start; i < range.end; i++) {
+            MarkerDetectorFrame &frame = (*frames)[i];
+            frame.corners.clear();
+            frame.ids.clear();
+            frame.rejected.clear();
+            for(size_t c = 0; c < frame.candidates.size(); c++) {
+                if(frame.validCandidates[c] == 1) {
+                    frame.corners.push_back(frame.candidates[c]);
+                    frame.ids.push_back(frame.candidateIds[c]);
+                } else if(needRejected) {
+                    frame.rejected.push_back(frame.candidates[c]);
+                }
+            }
+
+            _filterDetectedMarkers(frame.corners, frame.ids, frame.corners, frame.ids);
+        }
+    }
+
+    private:
+    FilterMarkersParallel &operator=(const FilterMarkersParallel &);
+
+    vector< MarkerDetectorFrame > *frames;
+    bool needRejected;
+};
+
+
+/**
+  * ParallelLoopBody class for the corner subpixel refinement of the markers of all the frames
+  */
+class MarkerSubpixelBatchParallel : public ParallelLoopBody {
+    public:
+    MarkerSubpixelBatchParallel(vector< MarkerDetectorFrame > *_frames,
+                                const vector< Vec2i > *_markersIdx,
+                                const DetectorParameters *_params)
+        : frames(_frames), markersIdx(_markersIdx), params(_params) {}
+
+    void operator()(const Range &range) const {
+        for(int i = range.start; i < range.end; i++) {
+            MarkerDetectorFrame &frame = (*frames)[(*markersIdx)[i][0]];
+            cornerSubPix(frame.grey, frame.corners[(*markersIdx)[i][1]],
+                         Size(params->cornerRefinementWinSize, params->cornerRefinementWinSize),
+                         Size(-1, -1), TermCriteria(TermCriteria::MAX_ITER | TermCriteria::EPS,
+                                                    params->cornerRefinementMaxIterations,
+                                                    params->cornerRefinementMinAccuracy));
+        }
+    }
+
+    private:
+    MarkerSubpixelBatchParallel &operator=(const MarkerSubpixelBatchParallel &);
+
+    vector< MarkerDetectorFrame > *frames;
+    const vector< Vec2i > *markersIdx;
+    const DetectorParameters *params;
+};
+
+
+/**
+  * @brief Same steps as detectMarkers(), but each step is done for all the frames in one
+  * parallel loop. In tracking mode the candidates are only searched around the markers of the
+  * previous frame, except each trackingInterval-th frame and when a marker is lost.
+  */
+void MarkerDetector::Impl::detect(InputArrayOfArrays images, const Dictionary &dictionary,
+                                  const DetectorParameters &params, int trackingInterval,
+                                  float trackingMarginRate, bool needRejected) {
+
+    int nFrames = (int)images.total();
+    int nScales = _getThresholdScales(params);
+    bool tracking = trackingInterval > 1;
+    CV_Assert(trackingMarginRate >= 0);
+
+    // buffers are only added, so they are reused by the following calls
+    if((int)frames.size() < nFrames) frames.resize(nFrames);
+
+    /// STEP 1: Detect marker candidates
+    parallel_for_(Range(0, nFrames), ConvertFramesParallel(images, &frames));
+
+    // regions of the candidates search
+    vector< char > fullDetection(nFrames, 1);
+    int nItems = 0;
+    for(int i = 0; i < nFrames; i++) {
+        MarkerDetectorFrame &frame = frames[i];
+        if(tracking && frame.framesToDetection > 0 && !frame.trackedIds.empty() &&
+           frame.trackedSize == frame.grey.size()) {
+            fullDetection[i] = 0;
+            _predictTrackedRegions(frame, params, trackingMarginRate, frame.regions);
+        } else {
+            frame.regions.assign(1, Rect(Point(), frame.grey.size()));
+        }
+
+        frame.scalesRange = Range(nItems, nItems + (int)frame.regions.size() * nScales);
+        nItems = frame.scalesRange.end;
+    }
+
+    if((int)scales.size() < nItems) scales.resize(nItems);
+    regionsIdx.clear();
+    for(int i = 0; i < nFrames; i++) {
+        const MarkerDetectorFrame &frame = frames[i];
+        int s = frame.scalesRange.start;
+        for(unsigned int r = 0; r < frame.regions.size(); r++) {
+            regionsIdx.push_back(s);
+            for(int k = 0; k < nScales; k++, s++) {
+                scales[s].frame = i;
+                scales[s].region = frame.regions[r];
+                scales[s].winSize =
+                    params.adaptiveThreshWinSizeMin + k * params.adaptiveThreshWinSizeStep;
+            }
+        }
+    }
+
+    if(params.adaptiveThreshIntegral)
+        parallel_for_(Range(0, (int)regionsIdx.size()),
+                      IntegralThresholdBatchParallel(&frames, &scales, &regionsIdx, nScales,
+                                                     &params));
+    parallel_for_(Range(0, nItems), DetectCandidatesBatchParallel(&frames, &scales, &params));
+    parallel_for_(Range(0, nFrames), JoinCandidatesParallel(&frames, &scales, &params));
+
+    /// STEP 2: Check candidate codification (identify markers)
+    candidatesIdx.clear();
+    for(int i = 0; i < nFrames; i++)
+        for(int c = 0; c < (int)frames[i].candidates.size(); c++)
+            candidatesIdx.push_back(Vec2i(i, c));
+
+    parallel_for_(Range(0, (int)candidatesIdx.size()),
+                  IdentifyCandidatesBatchParallel(&frames, &candidatesIdx, &dictionary, &params));
+
+    /// STEP 3: Filter detected markers;
+    parallel_for_(Range(0, nFrames), FilterMarkersParallel(&frames, needRejected));
+
+    /// STEP 4: Corner refinement
+    if(params.doCornerRefinement) {
+        CV_Assert(params.cornerRefinementWinSize > 0 && params.cornerRefinementMaxIterations > 0 &&
+                  params.cornerRefinementMinAccuracy > 0);
+
+        markersIdx.clear();
+        for(int i = 0; i < nFrames; i++)
+            for(int m = 0; m < (int)frames[i].corners.size(); m++)
+                markersIdx.push_back(Vec2i(i, m));
+
+        parallel_for_(Range(0, (int)markersIdx.size()),
+                      MarkerSubpixelBatchParallel(&frames, &markersIdx, &params));
+    }
+
+    if(tracking) {
+        for(int i = 0; i < nFrames; i++)
+            _updateTracking(frames[i], fullDetection[i] != 0, trackingInterval);
+    }
+}
+
+
+/**
+  * @brief Copy the corners of markers to the output array in the format of detectMarkers()
+  */
+static void _copyCorners(const vector< vector< Point2f > > &corners, OutputArrayOfArrays _out) {
+
+    _out.create((int)corners.size(), 1, CV_32FC2);
+    for(unsigned int i = 0; i < corners.size(); i++) {
+        _out.create(4, 1, CV_32FC2, i, true);
+        Mat m = _out.getMat(i);
+        Mat(corners[i]).copyTo(m);
+    }
+}
+
+
+/**
+  */
+MarkerDetector::MarkerDetector(const Dictionary &_dictionary,
+                               const DetectorParameters &_parameters)
+    : dictionary(_dictionary), parameters(_parameters), trackingInterval(0),
+      trackingMarginRate(0.5f), impl(new Impl) {}
+
+
+/**
+  */
+void MarkerDetector::detect(InputArray _image, OutputArrayOfArrays _corners, OutputArray _ids,
+                            OutputArrayOfArrays _rejectedImgPoints) {
+
+    CV_Assert(_image.getMat().total() != 0);
+
+    vector< Mat > images(1, _image.getMat());
+    impl->detect(images, dictionary, parameters, trackingInterval, trackingMarginRate,
+                 _rejectedImgPoints.needed());
+
+    const MarkerDetectorFrame &frame = impl->frames[0];
+    _copyCorners(frame.corners, _corners);
+
+    _ids.create((int)frame.ids.size(), 1, CV_32SC1);
+    for(unsigned int i = 0; i < frame.ids.size(); i++)
+        _ids.getMat().ptr< int >(0)[i] = frame.ids[i];
+
+    if(_rejectedImgPoints.needed()) _copyCorners(frame.rejected, _rejectedImgPoints);
+}
+
+
+/**
+  */
+void MarkerDetector::detectBatch(InputArrayOfArrays images,
+                                 vector< vector< vector< Point2f > > > &corners,
+                                 vector< vector< int > > &ids) {
+
+    int nFrames = (int)images.total();
+    corners.resize(nFrames);
+    ids.resize(nFrames);
+    if(nFrames == 0) return;
+
+    impl->detect(images, dictionary, parameters, trackingInterval, trackingMarginRate, false);
+
+    for(int i = 0; i < nFrames; i++) {
+        corners[i] = impl->frames[i].corners;
+        ids[i] = impl->frames[i].ids;
+    }
+}
+
+
+/**
+  */
+void MarkerDetector::resetTracking() {
+
+    for(unsigned int i = 0; i < impl->frames.size(); i++) {
+        impl->frames[i].trackedCorners.clear();
+        impl->frames[i].trackedIds.clear();
+        impl->frames[i].trackedShifts.clear();
+        impl->frames[i].framesToDetection = 0;
+    }
+}
+
+
+
 /**
   * ParallelLoopBody class for the parallelization of the single markers pose estimation
   * Called from function estimatePoseSingleMarkers()
@@ -42,18 +42,122 @@ the use of this software, even if advised of the possibility of such damage.
 #include <opencv2/imgproc.hpp>
 #include "predefined_dictionaries.hpp"
 #include "opencv2/core/hal/hal.hpp"
+#include <algorithm>
 
 namespace cv {
 namespace aruco {
 
 using namespace std;
 
+
+/**
+  * @brief Multi-index hash of the codes of a dictionary in the four rotations.
+  * The codes are split in maxCorrectionBits + 1 substrings. If the distance of two codes is not
+  * greater than t, at least one of any t + 1 substrings is identical in both codes, so the markers
+  * at distance t are found among the ones sharing one of the first t + 1 substrings with the
+  * candidate. Each substring table is a list of (substring, code index) sorted by the substring.
+  * See M. Norouzi, A. Punjani and D. J. Fleet. 2012. "Fast search in Hamming space with
+  * multi-index hashing". CVPR 2012, 3108-3115.
+  */
+struct Dictionary::Index {
+    Mat bytesList; // indexed data, shared with the dictionary
+    int markerSize;
+    int maxCorrectionBits;
+
+    vector< uint64 > codes; // code of marker m in rotation r is codes[4 * m + r]
+    vector< int > substringShift;
+    vector< uint64 > substringMask;
+    vector< vector< uint64 > > keys;
+    vector< vector< int > > entries;
+
+    bool create(const Mat &_bytesList, int _markerSize, int _maxCorrectionBits);
+};
+
+
+/**
+  * @brief Code of nbits bits stored in a byte list as an integer. The bits of the last byte are
+  * the lowest ones, see getByteListFromBits().
+  */
+static inline uint64 _packCode(const uchar *bytes, int nbits) {
+    uint64 code = 0;
+    for(; nbits > 0; nbits -= 8, bytes++) {
+        int n = min(nbits, 8);
+        code = (code << n) | *bytes;
+    }
+    return code;
+}
+
+
+static inline int _popcount(uint64 x) {
+    x = x - ((x >> 1) & CV_BIG_UINT(0x5555555555555555));
+    x = (x & CV_BIG_UINT(0x3333333333333333)) + ((x >> 2) & CV_BIG_UINT(0x3333333333333333));
+    x = (x + (x >> 4)) & CV_BIG_UINT(0x0f0f0f0f0f0f0f0f);
+    return (int)((x * CV_BIG_UINT(0x0101010101010101)) >> 56);
+}
+
+
+/**
+  * @brief Build the multi-index hash of the dictionary codes, returns false if the codes don't
+  * fit in 64 bits
+  */
+bool Dictionary::Index::create(const Mat &_bytesList, int _markerSize, int _maxCorrectionBits) {
+
+    int nbits = _markerSize * _markerSize;
+    int nbytes = (nbits + 7) / 8;
+    if(_bytesList.empty() || nbits <= 0 || nbits > 64 || _maxCorrectionBits < 0 ||
+       _bytesList.type() != CV_8UC4 || _bytesList.cols != nbytes)
+        return false;
+
+    bytesList = _bytesList;
+    markerSize = _markerSize;
+    maxCorrectionBits = _maxCorrectionBits;
+
+    int nCodes = 4 * bytesList.rows;
+    codes.resize(nCodes);
+    for(int m = 0; m < bytesList.rows; m++)
+        for(int r = 0; r < 4; r++)
+            codes[4 * m + r] = _packCode(bytesList.ptr(m) + r * nbytes, nbits);
+
+    // substrings of nearly the same length
+    int nSubstrings = min(maxCorrectionBits + 1, nbits);
+    substringShift.resize(nSubstrings);
+    substringMask.resize(nSubstrings);
+    keys.resize(nSubstrings);
+    entries.resize(nSubstrings);
+
+    vector< pair< uint64, int > > table(nCodes);
+    int shift = 0;
+    for(int s = 0; s < nSubstrings; s++) {
+        int length = nbits / nSubstrings + (s < nbits % nSubstrings ? 1 : 0);
+        uint64 mask = length == 64 ? ~(uint64)0 : (((uint64)1 << length) - 1);
+        substringShift[s] = shift;
+        substringMask[s] = mask;
+        shift += length;
+
+        for(int i = 0; i < nCodes; i++)
+            table[i] = make_pair((codes[i] >> substringShift[s]) & mask, i);
+        sort(table.begin(), table.end());
+
+        keys[s].resize(nCodes);
+        entries[s].resize(nCodes);
+        for(int i = 0; i < nCodes; i++) {
+            keys[s][i] = table[i].first;
+            entries[s][i] = table[i].second;
+        }
+    }
+    return true;
+}
+
+
 /**
   */
 Dictionary::Dictionary(const Mat &_bytesList, int _markerSize, int _maxcorr) {
     markerSize = _markerSize;
     maxCorrectionBits = _maxcorr;
     bytesList = _bytesList;
+
+    Ptr< Index > _index = makePtr< Index >();
+    if(_index->create(bytesList, markerSize, maxCorrectionBits)) index = _index;
 }
 
 
@@ -72,6 +176,41 @@ bool Dictionary::identify(const Mat &onlyBits, int &idx, int &rotation,
 
     idx = -1; // by default, not found
 
+    // the index is only used if it still corresponds to the dictionary codes
+    if(index && index->bytesList.data == bytesList.data &&
+       index->bytesList.rows == bytesList.rows && index->markerSize == markerSize &&
+       maxCorrectionRecalculed >= 0 && maxCorrectionRecalculed < (int)index->keys.size()) {
+
+        uint64 candidate = _packCode(candidateBytes.ptr(), markerSize * markerSize);
+
+        // the first marker in the dictionary order at the allowed distance, as the linear search
+        int best = bytesList.rows;
+        for(int s = 0; s <= maxCorrectionRecalculed; s++) {
+            const vector< uint64 > &keys = index->keys[s];
+            uint64 key = (candidate >> index->substringShift[s]) & index->substringMask[s];
+            size_t first = lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+            for(size_t i = first; i < keys.size() && keys[i] == key; i++) {
+                int code = index->entries[s][i];
+                if(code / 4 < best &&
+                   _popcount(index->codes[code] ^ candidate) <= maxCorrectionRecalculed)
+                    best = code / 4;
+            }
+        }
+
+        if(best < bytesList.rows) {
+            int currentMinDistance = markerSize * markerSize + 1;
+            for(int r = 0; r < 4; r++) {
+                int currentHamming = _popcount(index->codes[4 * best + r] ^ candidate);
+                if(currentHamming < currentMinDistance) {
+                    currentMinDistance = currentHamming;
+                    rotation = r;
+                }
+            }
+            idx = best;
+        }
+        return idx != -1;
+    }
+
     // search closest marker in dict
     for(int m = 0; m < bytesList.rows; m++) {
         int currentMinDistance = markerSize * markerSize + 1;
@@ -424,7 +563,8 @@ Dictionary generateCustomDictionary(int nMarkers, int markerSize,
     // update the maximum number of correction bits for the generated dictionary
     out.maxCorrectionBits = (tau - 1) / 2;
 
-    return out;
+    // construct it again to index the final codes
+    return Dictionary(out.bytesList, out.markerSize, out.maxCorrectionBits);
 }
 }
 }
@@ -40,6 +40,7 @@ the use of this software, even if advised of the possibility of such damage.
 #include "test_precomp.hpp"
 #include <opencv2/aruco.hpp>
 #include <string>
+#include <algorithm>
 
 using namespace std;
 using namespace cv;
@@ -130,6 +131,312 @@ void CV_ArucoDetectionSimple::run(int) {
 }
 
 
+/**
+ * @brief Draw 2D synthetic markers and check that MarkerDetector gives the same results as
+ * detectMarkers, both for single images and for batches
+ */
+class CV_ArucoMarkerDetector : public cvtest::BaseTest {
+    public:
+    CV_ArucoMarkerDetector();
+
+    protected:
+    void run(int);
+};
+
+
+CV_ArucoMarkerDetector::CV_ArucoMarkerDetector() {}
+
+
+void CV_ArucoMarkerDetector::run(int) {
+
+    aruco::Dictionary dictionary = aruco::getPredefinedDictionary(aruco::DICT_6X6_250);
+    aruco::DetectorParameters params;
+    params.doCornerRefinement = true;
+
+    // 8 frames with different sizes and number of markers
+    vector< Mat > images;
+    for(int i = 0; i < 8; i++) {
+        const int markerSidePixels = 60 + 10 * i;
+        int nMarkers = 1 + i % 3;
+        Mat img(markerSidePixels * 2, markerSidePixels * (2 * nMarkers + 1), CV_8UC1,
+                Scalar::all(255));
+        for(int m = 0; m < nMarkers; m++) {
+            Mat marker;
+            aruco::drawMarker(dictionary, i * 3 + m, markerSidePixels, marker);
+            marker.copyTo(img(Rect(markerSidePixels * (2 * m + 1), markerSidePixels / 2,
+                                   markerSidePixels, markerSidePixels)));
+        }
+        GaussianBlur(img, img, Size(3, 3), 0);
+        if(i % 2 == 1) cvtColor(img, img, COLOR_GRAY2BGR);
+        images.push_back(img);
+    }
+
+    aruco::MarkerDetector detector(dictionary, params);
+    vector< vector< vector< Point2f > > > batchCorners;
+    vector< vector< int > > batchIds;
+
+    // the second pass reuses the buffers of the first one
+    for(int pass = 0; pass < 2; pass++) {
+        detector.detectBatch(images, batchCorners, batchIds);
+        if(batchCorners.size() != images.size() || batchIds.size() != images.size()) {
+            ts->printf(cvtest::TS::LOG, "Incorrect number of frames in the batch output");
+            ts->set_failed_test_info(cvtest::TS::FAIL_BAD_ARG_CHECK);
+            return;
+        }
+
+        for(size_t i = 0; i < images.size(); i++) {
+            vector< vector< Point2f > > refCorners, corners, refRejected, rejected;
+            vector< int > refIds, ids;
+            aruco::detectMarkers(images[i], dictionary, refCorners, refIds, params, refRejected);
+            detector.detect(images[i], corners, ids, rejected);
+
+            if(refIds.size() != (size_t)(1 + i % 3) || ids != refIds || batchIds[i] != refIds ||
+               rejected.size() != refRejected.size()) {
+                ts->printf(cvtest::TS::LOG, "Detected markers differ from detectMarkers");
+                ts->set_failed_test_info(cvtest::TS::FAIL_MISMATCH);
+                return;
+            }
+
+            for(size_t m = 0; m < refIds.size(); m++) {
+                for(int c = 0; c < 4; c++) {
+                    if(norm(refCorners[m][c] - corners[m][c]) > 1e-5 ||
+                       norm(refCorners[m][c] - batchCorners[i][m][c]) > 1e-5) {
+                        ts->printf(cvtest::TS::LOG, "Marker corners differ from detectMarkers");
+                        ts->set_failed_test_info(cvtest::TS::FAIL_BAD_ACCURACY);
+                        return;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/**
+ * @brief Check the tracking mode of MarkerDetector in a synthetic video with moving markers
+ */
+class CV_ArucoMarkerTracking : public cvtest::BaseTest {
+    public:
+    CV_ArucoMarkerTracking();
+
+    protected:
+    void run(int);
+};
+
+
+CV_ArucoMarkerTracking::CV_ArucoMarkerTracking() {}
+
+
+void CV_ArucoMarkerTracking::run(int) {
+
+    aruco::Dictionary dictionary = aruco::getPredefinedDictionary(aruco::DICT_6X6_250);
+    aruco::DetectorParameters params;
+    params.doCornerRefinement = true;
+
+    aruco::MarkerDetector detector(dictionary, params);
+    detector.trackingInterval = 5;
+
+    const int nFrames = 30, newMarkerFrame = 12, markerSidePixels = 80;
+    int firstFoundFrame = -1;
+    for(int f = 0; f < nFrames; f++) {
+        // three markers moving in different directions, a fourth one appears later
+        Mat img(480, 640, CV_8UC1, Scalar::all(255));
+        int nMarkers = f < newMarkerFrame ? 3 : 4;
+        for(int m = 0; m < nMarkers; m++) {
+            Mat marker;
+            aruco::drawMarker(dictionary, 10 + m, markerSidePixels, marker);
+            Point pos(40 + 150 * m + (m % 2 == 0 ? 3 * f : f), 60 + 100 * (m % 2) + 4 * f);
+            marker.copyTo(img(Rect(pos, Size(markerSidePixels, markerSidePixels))));
+        }
+        GaussianBlur(img, img, Size(3, 3), 0);
+
+        vector< vector< Point2f > > refCorners, corners;
+        vector< int > refIds, ids;
+        aruco::detectMarkers(img, dictionary, refCorners, refIds, params);
+        detector.detect(img, corners, ids);
+
+        if(refIds.size() != (size_t)nMarkers) {
+            ts->printf(cvtest::TS::LOG, "Incorrect number of detected markers");
+            ts->set_failed_test_info(cvtest::TS::FAIL_MISMATCH);
+            return;
+        }
+
+        // all the tracked markers are found, the new one at the latest by the next full detection
+        bool newFound = false;
+        for(size_t m = 0; m < ids.size(); m++) {
+            size_t r = find(refIds.begin(), refIds.end(), ids[m]) - refIds.begin();
+            if(r == refIds.size()) {
+                ts->printf(cvtest::TS::LOG, "Unexpected marker in tracking mode");
+                ts->set_failed_test_info(cvtest::TS::FAIL_MISMATCH);
+                return;
+            }
+            for(int c = 0; c < 4; c++) {
+                if(norm(refCorners[r][c] - corners[m][c]) > 0.1) {
+                    ts->printf(cvtest::TS::LOG, "Tracked marker corners differ from detectMarkers");
+                    ts->set_failed_test_info(cvtest::TS::FAIL_BAD_ACCURACY);
+                    return;
+                }
+            }
+            if(ids[m] == 13) newFound = true;
+        }
+        if(newFound && firstFoundFrame == -1) firstFoundFrame = f;
+
+        bool allOldFound = ids.size() >= 3 && (newFound || ids.size() == 3);
+        if(!allOldFound || (f >= newMarkerFrame + detector.trackingInterval && !newFound)) {
+            ts->printf(cvtest::TS::LOG, "Markers lost in tracking mode");
+            ts->set_failed_test_info(cvtest::TS::FAIL_MISMATCH);
+            return;
+        }
+    }
+
+    if(firstFoundFrame < newMarkerFrame) {
+        ts->printf(cvtest::TS::LOG, "New marker not detected in tracking mode");
+        ts->set_failed_test_info(cvtest::TS::FAIL_MISMATCH);
+        return;
+    }
+}
+
+
+/**
+ * @brief Check the detection with the integral image thresholding against the adaptive
+ * thresholding of each window size
+ */
+class CV_ArucoIntegralThreshold : public cvtest::BaseTest {
+    public:
+    CV_ArucoIntegralThreshold();
+
+    protected:
+    void run(int);
+};
+
+
+CV_ArucoIntegralThreshold::CV_ArucoIntegralThreshold() {}
+
+
+void CV_ArucoIntegralThreshold::run(int) {
+
+    aruco::Dictionary dictionary = aruco::getPredefinedDictionary(aruco::DICT_6X6_250);
+    RNG rng(0);
+
+    for(int i = 0; i < 6; i++) {
+        // markers of different sizes on a noisy gradient background
+        Mat img(480, 640, CV_8UC1);
+        for(int y = 0; y < img.rows; y++)
+            for(int x = 0; x < img.cols; x++)
+                img.at< uchar >(y, x) = saturate_cast< uchar >(150 + x / 8 + rng.uniform(-10, 10));
+        int nMarkers = 1 + i % 3;
+        for(int m = 0; m < nMarkers; m++) {
+            Mat marker;
+            int side = 60 + 20 * m + 10 * i;
+            aruco::drawMarker(dictionary, 20 * i + m, side, marker);
+            marker.copyTo(img(Rect(20 + 200 * m, 40 + 30 * i, side, side)));
+        }
+        GaussianBlur(img, img, Size(3, 3), 0);
+
+        aruco::DetectorParameters params;
+        params.adaptiveThreshWinSizeStep = 4 + i % 2; // even and odd window sizes
+        vector< vector< Point2f > > refCorners;
+        vector< int > refIds;
+        aruco::detectMarkers(img, dictionary, refCorners, refIds, params);
+
+        // the thresholded images are the same, the downscaled means are an approximation
+        for(int level = 0; level < 2; level++) {
+            aruco::DetectorParameters integralParams = params;
+            integralParams.adaptiveThreshIntegral = true;
+            integralParams.adaptiveThreshPyrLevel = level;
+
+            vector< vector< Point2f > > corners, batchCorners;
+            vector< int > ids, batchIds;
+            aruco::detectMarkers(img, dictionary, corners, ids, integralParams);
+            aruco::MarkerDetector detector(dictionary, integralParams);
+            detector.detect(img, batchCorners, batchIds);
+
+            if(refIds.size() != (size_t)nMarkers || ids.size() != refIds.size() ||
+               batchIds != ids || (level == 0 && ids != refIds)) {
+                ts->printf(cvtest::TS::LOG, "Detected markers differ with integral thresholding");
+                ts->set_failed_test_info(cvtest::TS::FAIL_MISMATCH);
+                return;
+            }
+
+            double maxError = level == 0 ? 1e-5 : 1.5;
+            for(size_t m = 0; m < ids.size(); m++) {
+                size_t r = find(refIds.begin(), refIds.end(), ids[m]) - refIds.begin();
+                if(r == refIds.size()) {
+                    ts->printf(cvtest::TS::LOG, "Unexpected marker with integral thresholding");
+                    ts->set_failed_test_info(cvtest::TS::FAIL_MISMATCH);
+                    return;
+                }
+                for(int c = 0; c < 4; c++) {
+                    if(norm(refCorners[r][c] - corners[m][c]) > maxError ||
+                       norm(corners[m][c] - batchCorners[m][c]) > 1e-5) {
+                        ts->printf(cvtest::TS::LOG, "Marker corners differ with integral "
+                                                    "thresholding");
+                        ts->set_failed_test_info(cvtest::TS::FAIL_BAD_ACCURACY);
+                        return;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/**
+ * @brief Check the hashed search of Dictionary::identify() against the linear search
+ */
+class CV_ArucoDictionaryIdentify : public cvtest::BaseTest {
+    public:
+    CV_ArucoDictionaryIdentify();
+
+    protected:
+    void run(int);
+};
+
+
+CV_ArucoDictionaryIdentify::CV_ArucoDictionaryIdentify() {}
+
+
+void CV_ArucoDictionaryIdentify::run(int) {
+
+    const aruco::PREDEFINED_DICTIONARY_NAME names[] = { aruco::DICT_4X4_50, aruco::DICT_5X5_1000,
+                                                        aruco::DICT_6X6_250, aruco::DICT_7X7_1000,
+                                                        aruco::DICT_ARUCO_ORIGINAL };
+    RNG rng(0);
+    for(int d = 0; d < 5; d++) {
+        aruco::Dictionary dictionary = aruco::getPredefinedDictionary(names[d]);
+
+        // a dictionary with a new bytesList isn't indexed and is searched linearly
+        aruco::Dictionary linearDictionary = dictionary;
+        linearDictionary.bytesList = dictionary.bytesList.clone();
+
+        for(int i = 0; i < 200; i++) {
+            // rotated marker with some wrong bits
+            int id = rng.uniform(0, dictionary.bytesList.rows);
+            Mat bits = aruco::Dictionary::getBitsFromByteList(
+                dictionary.bytesList.rowRange(id, id + 1), dictionary.markerSize);
+            int nErrors = rng.uniform(0, dictionary.maxCorrectionBits + 3);
+            for(int e = 0; e < nErrors; e++)
+                bits.at< uchar >(rng.uniform(0, bits.rows), rng.uniform(0, bits.cols)) ^= 1;
+            for(int r = rng.uniform(0, 4); r > 0; r--) {
+                transpose(bits, bits);
+                flip(bits, bits, 1);
+            }
+
+            for(double rate = 0; rate <= 1; rate += 0.25) {
+                int refIdx, refRotation = -1, idx, rotation = -1;
+                bool refFound = linearDictionary.identify(bits, refIdx, refRotation, rate);
+                bool found = dictionary.identify(bits, idx, rotation, rate);
+                if(found != refFound || idx != refIdx || rotation != refRotation) {
+                    ts->printf(cvtest::TS::LOG, "Identified marker differs from linear search");
+                    ts->set_failed_test_info(cvtest::TS::FAIL_MISMATCH);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+
 static double deg2rad(double deg) { return deg * CV_PI / 180.; }
 
 /**
@@ -504,3 +811,23 @@ TEST(CV_ArucoBitCorrection, algorithmic) {
     CV_ArucoBitCorrection test;
     test.safe_run();
 }
+
+TEST(CV_ArucoMarkerDetector, algorithmic) {
+    CV_ArucoMarkerDetector test;
+    test.safe_run();
+}
+
+TEST(CV_ArucoMarkerTracking, algorithmic) {
+    CV_ArucoMarkerTracking test;
+    test.safe_run();
+}
+
+TEST(CV_ArucoIntegralThreshold, algorithmic) {
+    CV_ArucoIntegralThreshold test;
+    test.safe_run();
+}
+
+TEST(CV_ArucoDictionaryIdentify, algorithmic) {
+    CV_ArucoDictionaryIdentify test;
+    test.safe_run();
+}
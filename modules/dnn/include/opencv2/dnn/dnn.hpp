@@ -112,6 +112,13 @@ namespace dnn //! This namespace is used for dnn module functionlaity.
          */
         virtual int outputNameToIndex(String outputName);
 
+        /** @brief Estimates number of floating point operations performed by forward().
+         *  @param[in] input  the input blobs.
+         *  @param[in] output allocated output blobs.
+         *  @returns zero by default, i. e. the estimation isn't provided by the layer.
+         */
+        virtual int64 getFLOPS(const std::vector<Blob*> &input, const std::vector<Blob> &output) const;
+
         String name; //!< Name of the layer instance, can be used for logging or other internal purposes.
         String type; //!< Type name which was used for creating layer by layer factory.
 
@@ -120,6 +127,22 @@ namespace dnn //! This namespace is used for dnn module functionlaity.
         virtual ~Layer();
     };
 
+    /** @brief Profiling information about the layer, collected during the last forward pass.
+     *  @see Net::getProfile()
+     */
+    struct CV_EXPORTS LayerProfile
+    {
+        int id;                 //!< Identifier of the layer in the net.
+        String name;            //!< Name of the layer.
+        String type;            //!< Type name of the layer.
+        double time;            //!< Wall time of the layer forward() in milliseconds.
+        double start;           //!< Start of the layer forward() relative to the start of the forward pass in milliseconds.
+        int thread;             //!< Index of the worker which computed the layer, nonzero only for parallel forward pass.
+        int64 flops;            //!< Estimated number of floating point operations, see Layer::getFLOPS().
+        size_t memory;          //!< Size in bytes of the output blobs, excluding ones computed inplace over the inputs.
+        std::vector<BlobShape> outputShapes; //!< Shapes of the output blobs.
+    };
+
     /** @brief This class allows to create and manipulate comprehensive artificial neural networks.
      *
      * Neural network is presented as directed acyclic graph (DAG), where vertices are Layer instances,
@@ -199,21 +222,117 @@ namespace dnn //! This namespace is used for dnn module functionlaity.
         /** @overload */
         void forward(const std::vector<LayerId> &startLayers, const std::vector<LayerId> &toLayers);
 
-        //TODO:
         /** @brief Optimized forward.
-         *  @warning Not implemented yet.
-         *  @details Makes forward only those layers which weren't changed after previous forward().
+         *  @details Makes forward only those layers which were changed after previous forward(),
+         *  i. e. layers whose params were updated by setParam() or whose inputs were updated by setBlob(),
+         *  and all layers depending on them. Outputs of other layers are reused.
          */
         void forwardOpt(LayerId toLayer);
         /** @overload */
         void forwardOpt(const std::vector<LayerId> &toLayers);
 
+        /** @brief Enables or disables reusing of memory between blobs of intermediate layers.
+         *
+         * If enabled, blobs whose lifetimes don't overlap during the forward pass are placed into the same memory buffers,
+         * Split layers share data of their input and inputs of Concat layers are computed directly inside its output.
+         * Blobs of the network inputs and outputs (i. e. outputs of layers which aren't connected to other layers) are never reused.
+         * @note If memory reuse is enabled then getBlob() of intermediate layers can return data overwritten by the subsequent layers,
+         * and forwardOpt() computes all required layers because their outputs can't be preserved between passes.
+         * Disabled by default.
+         */
+        void setMemoryReuse(bool enable);
+
+        /** @brief Computes memory consumption of the network blobs.
+         *  @param[out] blobsMemory   size in bytes of all layers blobs if each of them is stored in its own memory.
+         *  @param[out] plannedMemory size in bytes of all layers blobs if memory reuse is enabled, i. e. planned peak memory.
+         *  @details The network is allocated by this call, so shapes of its inputs must be set.
+         *  @see setMemoryReuse()
+         */
+        void getMemoryConsumption(size_t &blobsMemory, size_t &plannedMemory);
+
+        /** @brief Enables or disables fusion of layers.
+         *
+         * If enabled, elementwise activation layers (ReLU, TanH, Sigmoid, etc.) which follow convolution or fully connected layers
+         * are applied by these layers to their outputs while they are still in cache, instead of the separate pass over the whole blob.
+         * @note If fusion is enabled then getBlob() of the fused convolution or fully connected layer returns the activated data.
+         * Enabled by default.
+         */
+        void setLayerFusion(bool enable);
+
+        /** @brief Enables or disables concurrent computation of independent layers by forward().
+         *
+         * If enabled, layers whose inputs are ready (e.g. branches of Inception modules) are computed by several threads.
+         * Threads which computed a layer take the layers which became ready after it, and new threads are started
+         * when the running ones find nothing to compute, so no thread waits for others.
+         * The option is ignored if memory reuse is enabled or only one thread is available, see cv::setNumThreads().
+         * Disabled by default.
+         */
+        void setParallelForward(bool enable);
+
+        /** @brief Returns time spent by each layer during the last forward pass.
+         *  @param[out] timings time in milliseconds of each layer, i. e. timings[id] is the time of the layer with identifier @p id.
+         *  Layers which weren't computed by the last pass and missing identifiers have zero time.
+         *  @returns wall time in milliseconds of the last call of forward() or forwardOpt().
+         */
+        double getPerfProfile(std::vector<double> &timings);
+
+        /** @brief Returns profiling information about layers computed by the last forward pass.
+         *  @param[out] profile information about each computed layer in order of their identifiers.
+         *  @see getPerfProfile(), writeProfile()
+         */
+        void getProfile(std::vector<LayerProfile> &profile);
+
+        enum ProfileFormat
+        {
+            PROFILE_JSON,           //!< Array of objects with fields of LayerProfile.
+            PROFILE_CHROME_TRACE    //!< Trace event format, which can be viewed by chrome://tracing.
+        };
+
+        /** @brief Writes profiling information about the last forward pass to the file.
+         *  @param filename path to the output file.
+         *  @param format   format of the file, one of #ProfileFormat values.
+         *  @see getProfile()
+         */
+        void writeProfile(const String &filename, int format = PROFILE_JSON);
+
+        enum Precision
+        {
+            PRECISION_FP32, //!< Single precision floating point weights.
+            PRECISION_FP16, //!< Half precision floating point weights, computations are done in single precision.
+            PRECISION_INT8  //!< 8-bit integer weights and inputs, computations are done with 32-bit integer accumulators.
+        };
+
+        /** @brief Converts weights of convolution and fully connected layers to the reduced precision (post-training quantization).
+         *  @param precision   one of #Precision values, the conversion can't be reverted.
+         *  @param inputName   descriptor of the net input blob which is set to @p calibration blobs.
+         *  @param calibration representative inputs of the net. For PRECISION_INT8 the net is computed for each of them
+         *  and maximal absolute values of layers inputs give the quantization steps of these inputs.
+         *  If it's empty, the steps are computed for each input during the forward pass.
+         *
+         * Int8 weights are quantized symmetrically with the separate step for each output channel.
+         * Original weights are released, so the memory consumed by them is reduced 2x for fp16 and 4x for int8.
+         * Then the first parameter of these layers (see getParam()) is [outputs x inputs] matrix of the quantized weights,
+         * which contains CV_16U half precision numbers for fp16 or CV_8S values for int8.
+         */
+        void quantize(int precision, const String &inputName = String(), const std::vector<Blob> &calibration = std::vector<Blob>());
+
+        /** @brief Creates the execution context of the net, i. e. the net which can be computed concurrently with this one.
+         *
+         * The context has the same layers, connections and options, and shares learned parameters of the layers (Layer::blobs),
+         * including the weights converted by quantize() and transformed by the fast convolution algorithms during previous forward passes.
+         * The context owns the layer instances with their internal buffers and the blobs of intermediate layers,
+         * so each worker thread can call forward() of its own context while the weights are stored once.
+         * @note Inputs of the context must be set by setBlob(). Parameters changed by setParam() after the call
+         * aren't propagated to the context.
+         */
+        Net createContext();
+
         /** @brief Sets the new value for the layer output blob
          *  @param outputName descriptor of the updating layer output blob.
          *  @param blob new blob.
          *  @see connect(String, String) to know format of the descriptor.
-         *  @note If updating blob is not empty then @p blob must have the same shape,
-         *  because network reshaping is not implemented yet.
+         *  @note If updating blob is not empty and has the same shape, then its data is updated inplace.
+         *  Otherwise the network will be reallocated during the next forward pass.
          */
         void setBlob(String outputName, const Blob &blob);
         /** @brief Returns the layer output blob.
@@ -258,9 +377,11 @@ namespace dnn //! This namespace is used for dnn module functionlaity.
     /** @brief Creates the importer of <a href="http://caffe.berkeleyvision.org">Caffe</a> framework network.
      *  @param prototxt   path to the .prototxt file with text description of the network architecture.
      *  @param caffeModel path to the .caffemodel file with learned network.
+     *  @param mapModel   if true then the .caffemodel file is mapped into memory and the learned blobs reference
+     *                    the mapped data instead of being copied to the heap. The mapping is kept while any of blobs is alive.
      *  @returns Pointer to the created importer, NULL in failure cases.
      */
-    CV_EXPORTS Ptr<Importer> createCaffeImporter(const String &prototxt, const String &caffeModel = String());
+    CV_EXPORTS Ptr<Importer> createCaffeImporter(const String &prototxt, const String &caffeModel = String(), bool mapModel = false);
 
     /** @brief Creates the importer of <a href="http://torch.ch">Torch7</a> framework network.
      *  @param filename path to the file, dumped from Torch by using torch.save() function.
@@ -0,0 +1,127 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "perf_precomp.hpp"
+#include <fstream>
+#include <sstream>
+
+namespace cvtest
+{
+
+using namespace perf;
+using namespace testing;
+using namespace cv;
+using namespace cv::dnn;
+
+#if defined(ENABLE_CAFFE_MODEL_TESTS)
+
+//reads the specified field of /proc/self/status in kB, returns -1 if it isn't available
+static int64 readProcStatus(const std::string &field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, field.size(), field) == 0 && line.size() > field.size() && line[field.size()] == ':')
+        {
+            std::istringstream value(line.substr(field.size() + 1));
+            int64 kb = -1;
+            value >> kb;
+            return kb;
+        }
+    }
+    return -1;
+}
+
+//resets peak resident set size of the process (supported since Linux 4.0)
+static bool resetPeakRSS()
+{
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    return clearRefs.good();
+}
+
+static void importCaffeNet(Net &net, const String &prototxt, const String &caffemodel, bool mapModel)
+{
+    Ptr<Importer> importer = createCaffeImporter(prototxt, caffemodel, mapModel);
+    CV_Assert(importer != NULL);
+    importer->populateNet(net);
+}
+
+typedef TestBaseWithParam< tuple<std::string, bool> > CaffeImporterPerfTest; //model, mapModel
+
+PERF_TEST_P( CaffeImporterPerfTest, import, Combine(
+#if defined(ENABLE_CAFFE_ALEXNET_TEST)
+             Values(std::string("bvlc_googlenet"), std::string("bvlc_alexnet")),
+#else
+             Values(std::string("bvlc_googlenet")),
+#endif
+             Bool()) )
+{
+    String prefix = "dnn/" + get<0>(GetParam());
+    String prototxt = getDataPath(prefix + ".prototxt");
+    String caffemodel = getDataPath(prefix + ".caffemodel");
+    bool mapModel = get<1>(GetParam());
+
+    //peak memory of the single import, the mapped weights are counted only after they are touched
+    int64 rssBefore = readProcStatus("VmRSS");
+    if (rssBefore >= 0 && resetPeakRSS())
+    {
+        Net net;
+        importCaffeNet(net, prototxt, caffemodel, mapModel);
+
+        int64 peak = readProcStatus("VmHWM");
+        RecordProperty("peak_rss_increase_kb", (int)(peak - rssBefore));
+        RecordProperty("rss_increase_kb", (int)(readProcStatus("VmRSS") - rssBefore));
+    }
+
+    TEST_CYCLE()
+    {
+        Net net;
+        importCaffeNet(net, prototxt, caffemodel, mapModel);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+#endif
+
+}
@@ -0,0 +1,163 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "perf_precomp.hpp"
+
+namespace cvtest
+{
+
+using std::tr1::tuple;
+using std::tr1::get;
+using namespace perf;
+using namespace testing;
+using namespace cv;
+using namespace cv::dnn;
+
+struct ConvShape
+{
+    const char *name;
+    int inpCn, size, outCn, kernel, stride, pad, group;
+};
+
+//shapes of convolution layers of AlexNet and GoogLeNet
+static const ConvShape convShapes[] =
+{
+    {"alexnet_conv1",            3, 227,  96, 11, 4, 0, 1},
+    {"alexnet_conv2",           96,  27, 256,  5, 1, 2, 2},
+    {"alexnet_conv3",          256,  13, 384,  3, 1, 1, 1},
+    {"alexnet_conv4",          384,  13, 384,  3, 1, 1, 2},
+    {"googlenet_conv1",          3, 224,  64,  7, 2, 3, 1},
+    {"googlenet_conv2_reduce",  64,  56,  64,  1, 1, 0, 1},
+    {"googlenet_conv2",         64,  56, 192,  3, 1, 1, 1},
+    {"googlenet_3a_1x1",       192,  28,  64,  1, 1, 0, 1},
+    {"googlenet_3a_5x5",        16,  28,  32,  5, 1, 2, 1},
+    {"googlenet_4a_3x3",        96,  14, 208,  3, 1, 1, 1},
+};
+
+static const int CONV_SHAPES_NUM = (int)(sizeof(convShapes) / sizeof(convShapes[0]));
+
+//shapes of 3x3 convolution layers of VGG-16 and layers with large kernels
+static const ConvShape fastConvShapes[] =
+{
+    {"vgg16_conv1_2",           64, 224,  64,  3, 1, 1, 1},
+    {"vgg16_conv2_2",          128, 112, 128,  3, 1, 1, 1},
+    {"vgg16_conv3_3",          256,  56, 256,  3, 1, 1, 1},
+    {"vgg16_conv4_3",          512,  28, 512,  3, 1, 1, 1},
+    {"vgg16_conv5_3",          512,  14, 512,  3, 1, 1, 1},
+    {"large_kernel_11x11",      16,  64,  16, 11, 1, 5, 1},
+    {"large_kernel_15x15",       8,  64,   8, 15, 1, 7, 1},
+};
+
+static const int FAST_CONV_SHAPES_NUM = (int)(sizeof(fastConvShapes) / sizeof(fastConvShapes[0]));
+
+static Ptr<Layer> createConvolution(const ConvShape &shape, const String &algorithm, int batch, RNG &rng,
+                                    Blob &input, std::vector<Blob> &outputs)
+{
+    LayerParams params;
+    params.name = shape.name;
+    params.set("num_output", shape.outCn);
+    params.set("kernel_size", shape.kernel);
+    params.set("stride", shape.stride);
+    params.set("pad", shape.pad);
+    params.set("group", shape.group);
+    params.set("conv_algorithm", algorithm);
+
+    Blob weights(BlobShape(shape.outCn, shape.inpCn / shape.group, shape.kernel, shape.kernel));
+    Blob bias(BlobShape(1, shape.outCn, 1, 1));
+    rng.fill(weights.matRef(), RNG::UNIFORM, -1, 1);
+    rng.fill(bias.matRef(), RNG::UNIFORM, -1, 1);
+    params.blobs.push_back(weights);
+    params.blobs.push_back(bias);
+
+    Ptr<Layer> layer = LayerFactory::createLayerInstance("Convolution", params);
+    CV_Assert(layer != NULL);
+
+    input.create(BlobShape(batch, shape.inpCn, shape.size, shape.size));
+    rng.fill(input.matRef(), RNG::UNIFORM, -1, 1);
+
+    std::vector<Blob*> inputs(1, &input);
+    layer->allocate(inputs, outputs);
+    return layer;
+}
+
+typedef tuple<int, int> ConvParams; //index of the shape, batch size
+typedef TestBaseWithParam<ConvParams> ConvolutionPerfTest;
+
+PERF_TEST_P( ConvolutionPerfTest, perf, Combine(::testing::Range(0, CONV_SHAPES_NUM), Values(1, 8)) )
+{
+    RNG rng(0);
+    Blob input;
+    std::vector<Blob> outputs;
+    Ptr<Layer> layer = createConvolution(convShapes[get<0>(GetParam())], "auto", get<1>(GetParam()), rng, input, outputs);
+    std::vector<Blob*> inputs(1, &input);
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    TEST_CYCLE()
+    {
+        layer->forward(inputs, outputs);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+typedef tuple<int, std::string> FastConvParams; //index of the shape, algorithm
+typedef TestBaseWithParam<FastConvParams> FastConvolutionPerfTest;
+
+PERF_TEST_P( FastConvolutionPerfTest, perf, Combine(::testing::Range(0, FAST_CONV_SHAPES_NUM),
+                                                    Values(std::string("im2col"), std::string("winograd"),
+                                                           std::string("fft"), std::string("auto"))) )
+{
+    RNG rng(0);
+    Blob input;
+    std::vector<Blob> outputs;
+    Ptr<Layer> layer = createConvolution(fastConvShapes[get<0>(GetParam())], get<1>(GetParam()), 1, rng, input, outputs);
+    std::vector<Blob*> inputs(1, &input);
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    TEST_CYCLE()
+    {
+        layer->forward(inputs, outputs);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+}
@@ -0,0 +1,156 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "perf_precomp.hpp"
+#include <cstdlib>
+
+namespace cvtest
+{
+
+using namespace perf;
+using namespace testing;
+using namespace cv;
+using namespace cv::dnn;
+
+//writes profile of the last forward pass if OPENCV_DNN_PROFILE_DIR environment variable is set
+static void writeNetProfile(Net &net, const String &name)
+{
+    const char *dir = getenv("OPENCV_DNN_PROFILE_DIR");
+    if (!dir)
+        return;
+
+    String prefix = String(dir) + "/" + name;
+    net.writeProfile(prefix + ".json", Net::PROFILE_JSON);
+    net.writeProfile(prefix + ".trace.json", Net::PROFILE_CHROME_TRACE);
+}
+
+static void importCaffeNet(Net &net, const String &prototxt, const String &caffemodel)
+{
+    Ptr<Importer> importer = createCaffeImporter(prototxt, caffemodel);
+    CV_Assert(importer != NULL);
+    importer->populateNet(net);
+}
+
+#if defined(ENABLE_CAFFE_MODEL_TESTS)
+
+typedef TestBaseWithParam<bool> GoogLeNetPerfTest; //parallel forward
+
+PERF_TEST_P( GoogLeNetPerfTest, forward, Bool() )
+{
+    Net net;
+    importCaffeNet(net, getDataPath("dnn/bvlc_googlenet.prototxt"), getDataPath("dnn/bvlc_googlenet.caffemodel"));
+    net.setParallelForward(GetParam());
+
+    Blob input(BlobShape(1, 3, 224, 224));
+    RNG rng(0);
+    rng.fill(input.matRef(), RNG::UNIFORM, 0, 255);
+    net.setBlob(".data", input);
+    net.forward(); //allocation
+
+    TEST_CYCLE()
+    {
+        net.forward();
+    }
+
+    writeNetProfile(net, (GetParam()) ? "googlenet_parallel" : "googlenet");
+    SANITY_CHECK_NOTHING();
+}
+
+#if defined(ENABLE_CAFFE_ALEXNET_TEST)
+
+PERF_TEST( AlexNetPerfTest, forward )
+{
+    Net net;
+    importCaffeNet(net, getDataPath("dnn/bvlc_alexnet.prototxt"), getDataPath("dnn/bvlc_alexnet.caffemodel"));
+
+    Blob input(BlobShape(1, 3, 227, 227));
+    RNG rng(0);
+    rng.fill(input.matRef(), RNG::UNIFORM, 0, 255);
+    net.setBlob(".data", input);
+    net.forward();
+
+    TEST_CYCLE()
+    {
+        net.forward();
+    }
+
+    writeNetProfile(net, "alexnet");
+    SANITY_CHECK_NOTHING();
+}
+
+#endif
+#endif
+
+#if defined(ENABLE_TORCH_IMPORTER) && ENABLE_TORCH_IMPORTER
+#if defined(ENABLE_TORCH_TESTS) && ENABLE_TORCH_TESTS
+
+typedef TestBaseWithParam<std::string> TorchNetPerfTest;
+
+PERF_TEST_P( TorchNetPerfTest, forward, Values(std::string("net_conv"), std::string("net_pool_max"), std::string("net_pool_ave"),
+                                               std::string("net_reshape"), std::string("net_linear_2d"),
+                                               std::string("net_parallel"), std::string("net_concat")) )
+{
+    String prefix = "dnn/torch/" + GetParam();
+
+    Net net;
+    {
+        Ptr<Importer> importer = createTorchImporter(getDataPath(prefix + "_net.txt"), false);
+        ASSERT_TRUE(importer != NULL);
+        importer->populateNet(net);
+    }
+
+    Blob input = readTorchBlob(getDataPath(prefix + "_input.txt"), false);
+    net.setBlob(".0", input);
+    net.forward();
+
+    TEST_CYCLE()
+    {
+        net.forward();
+    }
+
+    writeNetProfile(net, GetParam());
+    SANITY_CHECK_NOTHING();
+}
+
+#endif
+#endif
+
+}
@@ -0,0 +1,151 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "perf_precomp.hpp"
+
+namespace cvtest
+{
+
+using std::tr1::tuple;
+using std::tr1::get;
+using namespace perf;
+using namespace testing;
+using namespace cv;
+using namespace cv::dnn;
+
+CV_ENUM(Precision, Net::PRECISION_FP32, Net::PRECISION_FP16, Net::PRECISION_INT8)
+
+//creates the net from the single layer
+static void createNet(Net &net, const String &type, LayerParams &params, const Blob &input, int precision)
+{
+    net.setNetInputs(std::vector<String>(1, "data"));
+    net.addLayer("layer", type, params);
+    net.connect(".data", "layer");
+    net.setBlob(".data", input);
+    net.quantize(precision, ".data", std::vector<Blob>(1, input));
+    net.forward(); //allocation
+}
+
+struct QuantConvShape
+{
+    const char *name;
+    int inpCn, size, outCn, kernel, stride, pad;
+};
+
+static const QuantConvShape quantConvShapes[] =
+{
+    {"alexnet_conv3",     256, 13, 384, 3, 1, 1},
+    {"googlenet_conv2",    64, 56, 192, 3, 1, 1},
+    {"googlenet_3a_1x1",  192, 28,  64, 1, 1, 0},
+    {"vgg16_conv4_3",     512, 28, 512, 3, 1, 1},
+};
+
+typedef tuple<int, Precision> QuantConvParams; //index of the shape, precision
+typedef TestBaseWithParam<QuantConvParams> QuantizedConvolutionPerfTest;
+
+PERF_TEST_P( QuantizedConvolutionPerfTest, perf, Combine(::testing::Range(0, (int)(sizeof(quantConvShapes) / sizeof(quantConvShapes[0]))),
+                                                         Precision::all()) )
+{
+    const QuantConvShape &shape = quantConvShapes[get<0>(GetParam())];
+    RNG rng(0);
+
+    LayerParams params;
+    params.set("num_output", shape.outCn);
+    params.set("kernel_size", shape.kernel);
+    params.set("stride", shape.stride);
+    params.set("pad", shape.pad);
+    params.set("conv_algorithm", String("im2col"));
+
+    Blob weights(BlobShape(shape.outCn, shape.inpCn, shape.kernel, shape.kernel)), bias(BlobShape(1, shape.outCn, 1, 1));
+    rng.fill(weights.matRef(), RNG::UNIFORM, -1, 1);
+    rng.fill(bias.matRef(), RNG::UNIFORM, -1, 1);
+    params.blobs.push_back(weights);
+    params.blobs.push_back(bias);
+
+    Blob input(BlobShape(1, shape.inpCn, shape.size, shape.size));
+    rng.fill(input.matRef(), RNG::UNIFORM, -1, 1);
+
+    Net net;
+    createNet(net, "Convolution", params, input, get<1>(GetParam()));
+
+    TEST_CYCLE()
+    {
+        net.forward();
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+typedef tuple<tuple<int, int>, int, Precision> QuantFCParams; //(inputs, outputs), batch size, precision
+typedef TestBaseWithParam<QuantFCParams> QuantizedFullyConnectedPerfTest;
+
+PERF_TEST_P( QuantizedFullyConnectedPerfTest, perf, Combine(Values(tuple<int, int>(9216, 4096), tuple<int, int>(4096, 4096),
+                                                                   tuple<int, int>(4096, 1000)),
+                                                            Values(1, 8), Precision::all()) )
+{
+    int inputs = get<0>(get<0>(GetParam())), outputs = get<1>(get<0>(GetParam()));
+    int batch = get<1>(GetParam());
+    RNG rng(0);
+
+    LayerParams params;
+    params.set("num_output", outputs);
+
+    Blob weights(BlobShape(Vec2i(outputs, inputs))), bias(BlobShape(Vec2i(1, outputs)));
+    rng.fill(weights.matRef(), RNG::UNIFORM, -1, 1);
+    rng.fill(bias.matRef(), RNG::UNIFORM, -1, 1);
+    params.blobs.push_back(weights);
+    params.blobs.push_back(bias);
+
+    Blob input(BlobShape(Vec2i(batch, inputs)));
+    rng.fill(input.matRef(), RNG::UNIFORM, -1, 1);
+
+    Net net;
+    createNet(net, "InnerProduct", params, input, get<2>(GetParam()));
+
+    TEST_CYCLE()
+    {
+        net.forward();
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+}
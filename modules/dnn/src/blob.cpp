@@ -160,6 +160,14 @@ namespace dnn
         this->create(shape, type);
     }
 
+    void Blob::fill(InputArray in)
+    {
+        CV_Assert(in.isMat());
+        Mat mat = in.getMat();
+        CV_Assert(mat.type() == CV_32F || mat.type() == CV_64F);
+        m = mat;
+    }
+
     void Blob::fill(const BlobShape &shape, int type, void *data, bool deepCopy)
     {
         CV_Assert(type == CV_32F || type == CV_64F);
@@ -53,6 +53,7 @@ using namespace cv::dnn;
 #include <google/protobuf/text_format.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include "caffe_io.hpp"
+#include "caffe_mapped_model.hpp"
 
 using ::google::protobuf::RepeatedField;
 using ::google::protobuf::RepeatedPtrField;
@@ -68,14 +69,32 @@ namespace
         caffe::NetParameter net;
         caffe::NetParameter netBinary;
 
+        //used instead of netBinary if the model was mapped into memory
+        Ptr<MappedFile> mappedModel;
+        std::vector<MappedLayerProto> mappedLayers;
+
     public:
 
-        CaffeImporter(const char *pototxt, const char *caffeModel)
+        CaffeImporter(const char *pototxt, const char *caffeModel, bool mapModel)
         {
             ReadNetParamsFromTextFileOrDie(pototxt, &net);
 
             if (caffeModel && caffeModel[0])
-                ReadNetParamsFromBinaryFileOrDie(caffeModel, &netBinary);
+            {
+                if (mapModel)
+                {
+                    mappedModel = Ptr<MappedFile>(new MappedFile(caffeModel));
+                    if (!readMappedCaffeModel(*mappedModel, mappedLayers))
+                    {
+                        //legacy models have to be upgraded by the protobuf-based reader
+                        mappedModel.release();
+                        mappedLayers.clear();
+                    }
+                }
+
+                if (mappedModel.empty())
+                    ReadNetParamsFromBinaryFileOrDie(caffeModel, &netBinary);
+            }
         }
 
         void addParam(const Message &msg, const FieldDescriptor *field, cv::dnn::LayerParams &params)
@@ -219,10 +238,31 @@ namespace
                 dstData[i] = pbBlob.data(i);
         }
 
+        void extractMappedLayerParams(const std::string &name, LayerParams& layerParams)
+        {
+            for (size_t li = 0; li < mappedLayers.size(); li++)
+            {
+                const MappedLayerProto &mappedLayer = mappedLayers[li];
+                if (mappedLayer.name != name)
+                    continue;
+
+                layerParams.blobs.resize(mappedLayer.blobs.size());
+                for (size_t bi = 0; bi < mappedLayer.blobs.size(); bi++)
+                    layerParams.blobs[bi].fill(mappedBlobData(mappedModel, mappedLayer.blobs[bi]));
+                return;
+            }
+        }
+
         void extractBinaryLayerParms(const caffe::LayerParameter& layer, LayerParams& layerParams)
         {
             const std::string &name = layer.name();
 
+            if (!mappedModel.empty())
+            {
+                extractMappedLayerParams(name, layerParams);
+                return;
+            }
+
             int li;
             for (li = 0; li != netBinary.layer_size(); li++)
             {
@@ -339,14 +379,14 @@ namespace
 
 }
 
-Ptr<Importer> cv::dnn::createCaffeImporter(const String &prototxt, const String &caffeModel)
+Ptr<Importer> cv::dnn::createCaffeImporter(const String &prototxt, const String &caffeModel, bool mapModel)
 {
-    return Ptr<Importer>(new CaffeImporter(prototxt.c_str(), caffeModel.c_str()));
+    return Ptr<Importer>(new CaffeImporter(prototxt.c_str(), caffeModel.c_str(), mapModel));
 }
 
 #else //HAVE_PROTOBUF
 
-Ptr<Importer> cv::dnn::createCaffeImporter(const String&, const String&)
+Ptr<Importer> cv::dnn::createCaffeImporter(const String&, const String&, bool)
 {
     CV_Error(cv::Error::StsNotImplemented, "libprotobuf required to import data from Caffe models");
     return Ptr<Importer>();
@@ -0,0 +1,471 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "precomp.hpp"
+
+#if HAVE_PROTOBUF
+#include "caffe_mapped_model.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//platforms where unaligned float loads are allowed and cheap
+#if defined(__i386__) || defined(_M_IX86) || defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__)
+#define MAPPED_MODEL_UNALIGNED_ACCESS 1
+#else
+#define MAPPED_MODEL_UNALIGNED_ACCESS 0
+#endif
+
+namespace cv {
+namespace dnn {
+
+MappedFile::MappedFile(const String &filename) : ptr(NULL), len(0)
+{
+#ifdef _WIN32
+    mapping = NULL;
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        CV_Error(Error::StsError, "Can't open \"" + filename + "\"");
+
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+    {
+        len = (size_t)fileSize.QuadPart;
+        mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (mapping)
+            ptr = (uchar*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    }
+    CloseHandle(file);
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        CV_Error(Error::StsError, "Can't open \"" + filename + "\"");
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        len = (size_t)st.st_size;
+        void *addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+            ptr = (uchar*)addr;
+    }
+    close(fd);
+#endif
+
+    if (!ptr)
+    {
+#ifdef _WIN32
+        if (mapping)
+            CloseHandle(mapping);
+#endif
+        CV_Error(Error::StsError, "Can't map \"" + filename + "\" into memory");
+    }
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    UnmapViewOfFile(ptr);
+    CloseHandle(mapping);
+#else
+    munmap(ptr, len);
+#endif
+}
+
+namespace
+{
+    //Minimal reader of the protobuf wire format, which allows to locate the fields without copying them
+    struct WireStream
+    {
+        enum { VARINT = 0, FIXED64 = 1, LENGTH_DELIMITED = 2, FIXED32 = 5 };
+
+        const uchar *ptr, *end;
+
+        WireStream(const uchar *_ptr, const uchar *_end) : ptr(_ptr), end(_end) {}
+
+        bool empty() const { return ptr >= end; }
+
+        uint64 readVarint()
+        {
+            uint64 val = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                if (ptr >= end)
+                    break;
+                uchar byte = *ptr++;
+                val |= (uint64)(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                    return val;
+            }
+            CV_Error(Error::StsParseError, "Failed to parse NetParameter: invalid varint");
+            return 0;
+        }
+
+        void readTag(int &field, int &wireType)
+        {
+            uint64 tag = readVarint();
+            field = (int)(tag >> 3);
+            wireType = (int)(tag & 7);
+        }
+
+        const uchar *advance(size_t size)
+        {
+            if (size > (size_t)(end - ptr))
+                CV_Error(Error::StsParseError, "Failed to parse NetParameter: unexpected end of data");
+            const uchar *begin = ptr;
+            ptr += size;
+            return begin;
+        }
+
+        WireStream readMessage()
+        {
+            size_t size = (size_t)readVarint();
+            const uchar *begin = advance(size);
+            return WireStream(begin, ptr);
+        }
+
+        void skip(int wireType)
+        {
+            switch (wireType)
+            {
+            case VARINT:
+                readVarint();
+                break;
+            case FIXED64:
+                advance(8);
+                break;
+            case LENGTH_DELIMITED:
+                advance((size_t)readVarint());
+                break;
+            case FIXED32:
+                advance(4);
+                break;
+            default:
+                CV_Error(Error::StsParseError, "Failed to parse NetParameter: unsupported wire type");
+            }
+        }
+    };
+
+    //NetParameter message
+    enum { NET_LAYERS_V1 = 2, NET_LAYER = 100 };
+    //LayerParameter and V1LayerParameter messages
+    enum { LAYER_NAME = 1, LAYER_BLOBS = 7, LAYER_V1_V0_LAYER = 1, LAYER_V1_NAME = 4, LAYER_V1_BLOBS = 6 };
+    //BlobProto and BlobShape messages
+    enum { BLOB_NUM = 1, BLOB_WIDTH = 4, BLOB_DATA = 5, BLOB_SHAPE = 7, BLOB_DOUBLE_DATA = 8, SHAPE_DIM = 1 };
+
+    inline float readFloatLE(const uchar *ptr)
+    {
+        Cv32suf v;
+        v.u = (unsigned)ptr[0] | ((unsigned)ptr[1] << 8) | ((unsigned)ptr[2] << 16) | ((unsigned)ptr[3] << 24);
+        return v.f;
+    }
+
+    inline double readDoubleLE(const uchar *ptr)
+    {
+        Cv64suf v;
+        v.u = 0;
+        for (int i = 7; i >= 0; i--)
+            v.u = (v.u << 8) | ptr[i];
+        return v.f;
+    }
+
+    inline bool isLittleEndian()
+    {
+        const int one = 1;
+        return *(const uchar*)&one == 1;
+    }
+
+    void moveToBuffer(MappedBlobProto &blob)
+    {
+        if (!blob.data)
+            return;
+        blob.buffer.resize(blob.count);
+        for (size_t i = 0; i < blob.count; i++)
+            blob.buffer[i] = readFloatLE(blob.data + i * sizeof(float));
+        blob.data = NULL;
+    }
+
+    void readShape(WireStream msg, std::vector<int> &shape)
+    {
+        while (!msg.empty())
+        {
+            int field, wireType;
+            msg.readTag(field, wireType);
+
+            if (field == SHAPE_DIM && wireType == WireStream::LENGTH_DELIMITED)
+            {
+                WireStream packed = msg.readMessage();
+                while (!packed.empty())
+                    shape.push_back((int)packed.readVarint());
+            }
+            else if (field == SHAPE_DIM && wireType == WireStream::VARINT)
+            {
+                shape.push_back((int)msg.readVarint());
+            }
+            else
+            {
+                msg.skip(wireType);
+            }
+        }
+    }
+
+    void readBlob(WireStream msg, MappedBlobProto &blob)
+    {
+        int legacyShape[4] = {0, 0, 0, 0};
+        bool hasLegacyShape = false, hasShape = false;
+
+        while (!msg.empty())
+        {
+            int field, wireType;
+            msg.readTag(field, wireType);
+
+            if (field >= BLOB_NUM && field <= BLOB_WIDTH && wireType == WireStream::VARINT)
+            {
+                legacyShape[field - BLOB_NUM] = (int)msg.readVarint();
+                hasLegacyShape = true;
+            }
+            else if (field == BLOB_DATA && wireType == WireStream::LENGTH_DELIMITED)
+            {
+                size_t size = (size_t)msg.readVarint();
+                if (size % sizeof(float) != 0)
+                    CV_Error(Error::StsParseError, "Failed to parse NetParameter: invalid size of packed blob data");
+
+                const uchar *data = msg.advance(size);
+                if (!blob.data && blob.buffer.empty())
+                {
+                    blob.data = data;
+                    blob.count = size / sizeof(float);
+                }
+                else
+                {
+                    moveToBuffer(blob);
+                    for (size_t i = 0; i < size; i += sizeof(float))
+                        blob.buffer.push_back(readFloatLE(data + i));
+                }
+            }
+            else if (field == BLOB_DATA && wireType == WireStream::FIXED32)
+            {
+                moveToBuffer(blob);
+                blob.buffer.push_back(readFloatLE(msg.advance(sizeof(float))));
+            }
+            else if (field == BLOB_DOUBLE_DATA && wireType == WireStream::LENGTH_DELIMITED)
+            {
+                size_t size = (size_t)msg.readVarint();
+                if (size % sizeof(double) != 0)
+                    CV_Error(Error::StsParseError, "Failed to parse NetParameter: invalid size of packed blob data");
+
+                //blobs are stored in single precision, so the values can't be referenced in place
+                const uchar *data = msg.advance(size);
+                moveToBuffer(blob);
+                for (size_t i = 0; i < size; i += sizeof(double))
+                    blob.buffer.push_back((float)readDoubleLE(data + i));
+            }
+            else if (field == BLOB_DOUBLE_DATA && wireType == WireStream::FIXED64)
+            {
+                moveToBuffer(blob);
+                blob.buffer.push_back((float)readDoubleLE(msg.advance(sizeof(double))));
+            }
+            else if (field == BLOB_SHAPE && wireType == WireStream::LENGTH_DELIMITED)
+            {
+                blob.shape.clear();
+                readShape(msg.readMessage(), blob.shape);
+                hasShape = true;
+            }
+            else
+            {
+                msg.skip(wireType);
+            }
+        }
+
+        if (!blob.data)
+            blob.count = blob.buffer.size();
+
+        if (hasLegacyShape)
+            blob.shape.assign(legacyShape, legacyShape + 4);
+        else if (!hasShape)
+            CV_Error(Error::StsError, "Unknown shape of input blob");
+    }
+
+    bool readLayer(WireStream msg, bool isV1, MappedLayerProto &layer)
+    {
+        int nameField = isV1 ? LAYER_V1_NAME : LAYER_NAME;
+        int blobsField = isV1 ? LAYER_V1_BLOBS : LAYER_BLOBS;
+
+        while (!msg.empty())
+        {
+            int field, wireType;
+            msg.readTag(field, wireType);
+
+            if (isV1 && field == LAYER_V1_V0_LAYER)
+            {
+                return false;
+            }
+            else if (field == nameField && wireType == WireStream::LENGTH_DELIMITED)
+            {
+                WireStream name = msg.readMessage();
+                layer.name.assign((const char*)name.ptr, (const char*)name.end);
+            }
+            else if (field == blobsField && wireType == WireStream::LENGTH_DELIMITED)
+            {
+                layer.blobs.push_back(MappedBlobProto());
+                readBlob(msg.readMessage(), layer.blobs.back());
+            }
+            else
+            {
+                msg.skip(wireType);
+            }
+        }
+        return true;
+    }
+
+    class MappedFileAllocator : public MatAllocator
+    {
+    public:
+        UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, int flags, UMatUsageFlags usageFlags) const
+        {
+            return Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        }
+
+        bool allocate(UMatData* u, int accessFlags, UMatUsageFlags usageFlags) const
+        {
+            return Mat::getStdAllocator()->allocate(u, accessFlags, usageFlags);
+        }
+
+        void deallocate(UMatData* u) const
+        {
+            if (!u)
+                return;
+
+            CV_Assert(u->urefcount == 0 && u->refcount == 0);
+            delete (Ptr<MappedFile>*)u->userdata;
+            delete u;
+        }
+    };
+
+    MatAllocator *getMappedFileAllocator()
+    {
+        static MappedFileAllocator allocator;
+        return &allocator;
+    }
+}
+
+bool readMappedCaffeModel(const MappedFile &file, std::vector<MappedLayerProto> &layers)
+{
+    layers.clear();
+
+    WireStream net(file.data(), file.data() + file.size());
+    while (!net.empty())
+    {
+        int field, wireType;
+        net.readTag(field, wireType);
+
+        if ((field == NET_LAYER || field == NET_LAYERS_V1) && wireType == WireStream::LENGTH_DELIMITED)
+        {
+            MappedLayerProto layer;
+            if (!readLayer(net.readMessage(), field == NET_LAYERS_V1, layer))
+                return false;
+
+            if (!layer.blobs.empty())
+                layers.push_back(layer);
+        }
+        else
+        {
+            net.skip(wireType);
+        }
+    }
+
+    return true;
+}
+
+Mat mappedBlobData(const Ptr<MappedFile> &file, const MappedBlobProto &blob)
+{
+    int dims = (int)blob.shape.size();
+    const int *sizes = (dims) ? &blob.shape[0] : NULL;
+
+    bool canReference = blob.data && isLittleEndian() &&
+                        (MAPPED_MODEL_UNALIGNED_ACCESS || (size_t)blob.data % sizeof(float) == 0);
+
+    if (!canReference)
+    {
+        Mat m(dims, sizes, CV_32F);
+        CV_Assert(blob.count == m.total());
+
+        float *dst = m.ptr<float>();
+        if (blob.data)
+        {
+            for (size_t i = 0; i < blob.count; i++)
+                dst[i] = readFloatLE(blob.data + i * sizeof(float));
+        }
+        else if (blob.count)
+        {
+            memcpy(dst, &blob.buffer[0], blob.count * sizeof(float));
+        }
+        return m;
+    }
+
+    Mat m(dims, sizes, CV_32F, (void*)blob.data);
+    CV_Assert(blob.count == m.total());
+
+    //attach the reference counter which holds the mapping
+    UMatData *u = new UMatData(getMappedFileAllocator());
+    u->data = u->origdata = m.data;
+    u->size = m.total() * m.elemSize();
+    u->flags |= UMatData::USER_ALLOCATED;
+    u->userdata = new Ptr<MappedFile>(file);
+    u->refcount = 1;
+    m.u = u;
+
+    return m;
+}
+
+}
+}
+#endif
@@ -0,0 +1,104 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#ifndef __OPENCV_DNN_CAFFE_MAPPED_MODEL_HPP__
+#define __OPENCV_DNN_CAFFE_MAPPED_MODEL_HPP__
+#if HAVE_PROTOBUF
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+namespace cv {
+namespace dnn {
+
+//File mapped into the address space of the process.
+//Pages are mapped copy-on-write, so data referenced by blobs may be safely modified in place.
+class MappedFile
+{
+public:
+    MappedFile(const String &filename);
+    ~MappedFile();
+
+    const uchar *data() const { return ptr; }
+    size_t size() const { return len; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile &operator=(const MappedFile&);
+
+    uchar *ptr;
+    size_t len;
+#ifdef _WIN32
+    void *mapping;
+#endif
+};
+
+//Location of learned weights of the single BlobProto message.
+struct MappedBlobProto
+{
+    MappedBlobProto() : data(NULL), count(0) {}
+
+    std::vector<int> shape;
+    const uchar *data;          //!< packed little-endian floats inside the mapped file
+    size_t count;
+    std::vector<float> buffer;  //!< used instead of @p data if the values aren't packed into the single chunk
+};
+
+struct MappedLayerProto
+{
+    std::string name;
+    std::vector<MappedBlobProto> blobs;
+};
+
+//Walks through the NetParameter message stored in the mapped .caffemodel and collects the blobs of
+//the layers without copying them. Returns false if the model uses legacy V0 layers, which can be
+//read only by ReadNetParamsFromBinaryFileOrDie() because they require the upgrade.
+bool readMappedCaffeModel(const MappedFile &file, std::vector<MappedLayerProto> &layers);
+
+//Returns the header referencing the blob data. The header keeps @p file mapped while it is alive.
+//The data is copied if the platform can't access it in place (e.g. because of the alignment).
+Mat mappedBlobData(const Ptr<MappedFile> &file, const MappedBlobProto &blob);
+
+}
+}
+#endif
+#endif
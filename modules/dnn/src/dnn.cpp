@@ -40,10 +40,16 @@
 //M*/
 
 #include "precomp.hpp"
+#include "layers/concat_layer.hpp"
+#include "layers/split_layer.hpp"
+#include "layers/layers_common.hpp"
+#include "layers/quantization.hpp"
 #include <set>
+#include <deque>
 #include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <fstream>
 
 using namespace cv;
 using namespace cv::dnn;
@@ -87,9 +93,9 @@ struct LayerPin
 
 struct LayerData
 {
-    LayerData() {}
+    LayerData() : flag(0), dirty(true), skip(false), forwardTime(0), forwardStart(-1), thread(0) {}
     LayerData(int _id, const String &_name, const String &_type, LayerParams &_params)
-        : id(_id), name(_name), type(_type), params(_params)
+        : id(_id), name(_name), type(_type), params(_params), flag(0), dirty(true), skip(false), forwardTime(0), forwardStart(-1), thread(0)
     {
         //add logging info
         params.name = name;
@@ -103,6 +109,7 @@ struct LayerData
 
     std::vector<LayerPin> inputBlobsId;
     std::set<int> inputLayersId;
+    std::set<int> outputLayersId;
     std::set<int> requiredOutputs;
 
     Ptr<Layer> layerInstance;
@@ -110,6 +117,16 @@ struct LayerData
     std::vector<Blob*> inputBlobs;
 
     int flag;
+    //outputs must be recomputed, i. e. the layer or its inputs were changed after the last forward
+    bool dirty;
+    //layer is fused into the preceding one, so its forward isn't called
+    bool skip;
+    //duration of the last forward call in milliseconds
+    double forwardTime;
+    //start of the last forward call relative to the start of the forward pass in milliseconds, -1 if it wasn't called
+    double forwardStart;
+    //index of the worker which computed the layer during the parallel forward pass
+    int thread;
 
     Ptr<Layer> getLayerInstance()
     {
@@ -126,6 +143,139 @@ struct LayerData
     }
 };
 
+static void forwardLayerInstance(LayerData &ld, int64 passStart, int thread = 0)
+{
+    int64 t = getTickCount();
+    if (!ld.skip)
+        ld.layerInstance->forward(ld.inputBlobs, ld.outputBlobs);
+
+    double freq = getTickFrequency() / 1000.;
+    ld.forwardTime = (getTickCount() - t) / freq;
+    ld.forwardStart = (t - passStart) / freq;
+    ld.thread = thread;
+}
+
+//dependencies between layers for the parallel forward pass, layers are indexed by positions in the forward order
+struct LayersSchedule
+{
+    std::vector<LayerData*> layers;
+    std::vector<int> depsNum;               //number of layers which must be computed before the layer
+    std::vector<std::vector<int> > next;    //layers which depend on the layer
+};
+
+//Runs layers whose dependencies are computed. Each worker takes ready layers from the shared queue
+//and appends the layers which become ready after it. A worker never waits for other workers, it returns
+//when the queue is empty and Net::Impl::forwardParallel() starts the workers again for the layers which
+//became ready later. The layers call parallel_for_ themselves, and a thread blocked in such an inner loop
+//may execute an outer worker (e.g. TBB steals the tasks), which must not wait for the layer below it.
+class ParallelForwardInvoker : public ParallelLoopBody
+{
+public:
+    struct State
+    {
+        Mutex mutex;
+        std::deque<int> ready;
+        std::vector<int> pending;
+        int remaining;
+        bool failed;
+        cv::Exception error;
+    };
+
+    ParallelForwardInvoker(const LayersSchedule &_schedule, State &_state, int64 _passStart)
+        : schedule(_schedule), state(&_state), passStart(_passStart)
+    {
+        state->pending = schedule.depsNum;
+        state->remaining = (int)schedule.layers.size();
+        state->failed = false;
+        state->ready.clear();
+
+        for (size_t i = 0; i < schedule.layers.size(); i++)
+        {
+            if (schedule.depsNum[i] == 0)
+                state->ready.push_back((int)i);
+        }
+    }
+
+    void operator()(const Range &range) const
+    {
+        for (int worker = range.start; worker < range.end; worker++)
+            work(worker);
+    }
+
+private:
+    void work(int worker) const
+    {
+        for (;;)
+        {
+            int idx;
+            {
+                AutoLock lock(state->mutex);
+                if (state->failed || state->ready.empty())
+                    return;
+
+                idx = state->ready.front();
+                state->ready.pop_front();
+            }
+
+            try
+            {
+                forwardLayerInstance(*schedule.layers[idx], passStart, worker);
+            }
+            catch (const cv::Exception &e)
+            {
+                AutoLock lock(state->mutex);
+                state->failed = true;
+                state->error = e;
+                return;
+            }
+            catch (...)
+            {
+                AutoLock lock(state->mutex);
+                state->failed = true;
+                state->error = cv::Exception(Error::StsError, "Unknown exception in layer \"" + schedule.layers[idx]->name + "\"",
+                                             CV_Func, __FILE__, __LINE__);
+                return;
+            }
+
+            AutoLock lock(state->mutex);
+            const std::vector<int> &next = schedule.next[idx];
+            for (size_t i = 0; i < next.size(); i++)
+            {
+                if (--state->pending[next[i]] == 0)
+                    state->ready.push_back(next[i]);
+            }
+            state->remaining--;
+        }
+    }
+
+    const LayersSchedule &schedule;
+    State *state;
+    int64 passStart;
+};
+
+//memory region shared by one or several blobs (e.g. by inplace layers outputs)
+struct BlobStorage
+{
+    BlobStorage(const uchar *_datastart = NULL)
+        : datastart(_datastart), size(0), producedAt(INT_MAX), writtenAt(-1), releasedAt(-1),
+          pinned(false), parent(-1), offset(0), buffer(-1) {}
+
+    const uchar *datastart;
+    size_t size;
+
+    //positions of layers in the forward order
+    int producedAt; //the first layer which writes into the storage
+    int writtenAt;  //the last layer which writes into the storage
+    int releasedAt; //the last layer which reads or writes the storage
+
+    bool pinned;    //storage must not be reused, e.g. it contains net inputs or outputs
+    int parent;     //index of the storage which contains this storage, -1 if it's a root storage
+    size_t offset;  //offset inside the parent storage in bytes
+    int buffer;     //index of the memory pool buffer assigned to the root storage
+
+    std::vector<LayerPin> blobs;
+};
+
 //fake layer containing network input blobs
 struct NetInputLayer : public Layer
 {
@@ -143,6 +293,11 @@ struct NetInputLayer : public Layer
         outNames.assign(names.begin(), names.end());
     }
 
+    const std::vector<String> &getNames() const
+    {
+        return outNames;
+    }
+
 private:
     std::vector<String> outNames;
 };
@@ -161,6 +316,14 @@ struct Net::Impl
 
         lastLayerId = 1;
         netWasAllocated = false;
+
+        memoryReuse = false;
+        blobsPlanned = false;
+        fusion = true;
+        parallelForward = false;
+        forwardTime = 0;
+        forwardStartTick = 0;
+        blobsMemory = plannedMemory = 0;
     }
 
     Ptr<NetInputLayer> netInputLayer;
@@ -174,12 +337,29 @@ struct Net::Impl
 
     bool netWasAllocated;
 
+    std::vector<int> layersOrder;
+
+    bool memoryReuse, blobsPlanned;
+    std::vector<Mat> memoryPool;
+    size_t blobsMemory, plannedMemory;
+
+    bool fusion;
+
+    bool parallelForward;
+    LayersSchedule schedule;
+    double forwardTime; //duration of the last forward pass in milliseconds
+    int64 forwardStartTick;
+
     void setUpNet()
     {
         if (!netWasAllocated)
         {
             allocateLayers();
             computeNetOutputLayers();
+            fuseLayers();
+            computeLayersOrder();
+            planMemory();
+            computeSchedule();
 
             netWasAllocated = true;
         }
@@ -345,9 +525,12 @@ struct Net::Impl
         for (size_t i = 0; i < ld.inputBlobsId.size(); i++)
             ld.inputLayersId.insert(ld.inputBlobsId[i].lid);
 
-        //allocate parents
+        //allocate parents and register itself as their consumer
         for (set<int>::iterator i = ld.inputLayersId.begin(); i != ld.inputLayersId.end(); i++)
+        {
             allocateLayer(*i);
+            layers[*i].outputLayersId.insert(lid);
+        }
 
         //bind inputs
         ld.inputBlobs.resize(ld.inputBlobsId.size());
@@ -364,6 +547,7 @@ struct Net::Impl
         ld.getLayerInstance()->allocate(ld.inputBlobs, ld.outputBlobs);
 
         ld.flag = 1;
+        ld.dirty = true;
     }
 
     void allocateLayers()
@@ -372,6 +556,18 @@ struct Net::Impl
         for (it = layers.begin(); it != layers.end(); it++)
             it->second.flag = 0;
 
+        //blobs which point to the memory pool must be created again
+        if (blobsPlanned)
+        {
+            for (it = layers.begin(); it != layers.end(); it++)
+            {
+                if (it->first != 0)
+                    it->second.outputBlobs.clear();
+            }
+            memoryPool.clear();
+            blobsPlanned = false;
+        }
+
         for (it = layers.begin(); it != layers.end(); it++)
         {
             int lid = it->first;
@@ -379,7 +575,404 @@ struct Net::Impl
         }
     }
 
-    void forwardLayer(LayerData &ld, bool clearFlags = true)
+    //Fuses elementwise activation layers into the preceding convolution and fully connected layers,
+    //which apply the activation to their output tiles. The activation layer computes its output inplace,
+    //so it shares data with the fused layer output and it is only skipped during the forward pass.
+    void fuseLayers()
+    {
+        MapIdToLayerData::iterator it;
+        for (it = layers.begin(); it != layers.end(); it++)
+        {
+            LayerData &ld = it->second;
+            ld.skip = false;
+
+            Ptr<ActivationFusible> fusible = ld.layerInstance.dynamicCast<ActivationFusible>();
+            if (fusible)
+                fusible->setActivation(Ptr<ActivationFunction>());
+        }
+
+        if (!fusion)
+            return;
+
+        for (it = layers.begin(); it != layers.end(); it++)
+        {
+            LayerData &ld = it->second;
+
+            Ptr<ActivationFusible> fusible = ld.layerInstance.dynamicCast<ActivationFusible>();
+            if (!fusible || ld.outputBlobs.size() != 1 || ld.outputLayersId.size() != 1)
+                continue;
+
+            LayerData &next = layers[*ld.outputLayersId.begin()];
+            Ptr<ActivationFunction> activ = next.layerInstance.dynamicCast<ActivationFunction>();
+            if (!activ || next.skip || next.inputBlobs.size() != 1 || next.outputBlobs.size() != 1)
+                continue;
+
+            //activation must be computed inplace over the fused layer output
+            if (next.outputBlobs[0].matRefConst().data != ld.outputBlobs[0].matRefConst().data)
+                continue;
+
+            if (fusible->setActivation(activ))
+            {
+                next.skip = true;
+                ld.dirty = next.dirty = true;
+            }
+        }
+    }
+
+    void addLayerToOrder(LayerData &ld)
+    {
+        if (ld.flag)
+            return;
+        ld.flag = 1;
+
+        for (set<int>::iterator i = ld.inputLayersId.begin(); i != ld.inputLayersId.end(); i++)
+            addLayerToOrder(layers[*i]);
+
+        layersOrder.push_back(ld.id);
+    }
+
+    //sorts layers in order of forward pass, i. e. each layer follows all its parents
+    void computeLayersOrder()
+    {
+        MapIdToLayerData::iterator it;
+        for (it = layers.begin(); it != layers.end(); it++)
+            it->second.flag = 0;
+
+        layersOrder.clear();
+        for (it = layers.begin(); it != layers.end(); it++)
+            addLayerToOrder(it->second);
+    }
+
+    //Builds dependencies for the parallel forward pass. Besides the connections, a layer which rewrites its input inplace
+    //is ordered with other consumers of this input in the same way as in the sequential forward order.
+    void computeSchedule()
+    {
+        std::map<int, int> position;
+        for (size_t i = 0; i < layersOrder.size(); i++)
+            position[layersOrder[i]] = (int)i;
+
+        std::vector<std::set<int> > deps(layersOrder.size());
+        for (size_t i = 0; i < layersOrder.size(); i++)
+        {
+            LayerData &ld = layers[layersOrder[i]];
+
+            for (set<int>::iterator it = ld.inputLayersId.begin(); it != ld.inputLayersId.end(); it++)
+                deps[i].insert(position[*it]);
+
+            for (size_t j = 0; j < ld.inputBlobsId.size(); j++)
+            {
+                const uchar *inpData = ld.inputBlobs[j]->matRefConst().data;
+                bool inplace = false;
+                for (size_t k = 0; k < ld.outputBlobs.size() && !inplace; k++)
+                    inplace = inpData && ld.outputBlobs[k].matRefConst().data == inpData;
+                if (!inplace)
+                    continue;
+
+                LayerData &parent = layers[ld.inputBlobsId[j].lid];
+                for (set<int>::iterator it = parent.outputLayersId.begin(); it != parent.outputLayersId.end(); it++)
+                {
+                    int pos = position[*it];
+                    if (pos == (int)i || !readsPin(layers[*it], ld.inputBlobsId[j]))
+                        continue;
+
+                    if (pos < (int)i)
+                        deps[i].insert(pos);
+                    else
+                        deps[pos].insert((int)i);
+                }
+            }
+        }
+
+        schedule.layers.resize(layersOrder.size());
+        schedule.depsNum.resize(layersOrder.size());
+        schedule.next.assign(layersOrder.size(), std::vector<int>());
+        for (size_t i = 0; i < layersOrder.size(); i++)
+        {
+            schedule.layers[i] = &layers[layersOrder[i]];
+            schedule.depsNum[i] = (int)deps[i].size();
+            for (set<int>::iterator it = deps[i].begin(); it != deps[i].end(); it++)
+                schedule.next[*it].push_back((int)i);
+        }
+    }
+
+    static bool readsPin(const LayerData &ld, const LayerPin &pin)
+    {
+        for (size_t i = 0; i < ld.inputBlobsId.size(); i++)
+        {
+            if (ld.inputBlobsId[i].equal(pin))
+                return true;
+        }
+        return false;
+    }
+
+    static int findStorage(const Mat &m, std::map<const uchar*, int> &storagesIdx, std::vector<BlobStorage> &storages)
+    {
+        if (!m.data)
+            return -1;
+
+        std::map<const uchar*, int>::iterator it = storagesIdx.find(m.datastart);
+        if (it != storagesIdx.end())
+            return it->second;
+
+        storagesIdx.insert(make_pair(m.datastart, (int)storages.size()));
+        storages.push_back(BlobStorage(m.datastart));
+        return (int)storages.size() - 1;
+    }
+
+    static int findRootStorage(int sid, const std::vector<BlobStorage> &storages, size_t &offset)
+    {
+        offset = 0;
+        while (storages[sid].parent >= 0)
+        {
+            offset += storages[sid].offset;
+            sid = storages[sid].parent;
+        }
+        return sid;
+    }
+
+    //outputs of Split layer can use data of its input, if nobody changes it inplace
+    void shareSplitOutputs(LayerData &ld, int pos, std::map<const uchar*, int> &storagesIdx, std::vector<BlobStorage> &storages)
+    {
+        if (ld.inputBlobs.size() != 1)
+            return;
+
+        const Mat &inpMat = ld.inputBlobs[0]->matRefConst();
+        int inpSid = findStorage(inpMat, storagesIdx, storages);
+        if (inpSid < 0)
+            return;
+
+        size_t rootOffset;
+        int rootSid = findRootStorage(inpSid, storages, rootOffset);
+        if (storages[inpSid].writtenAt >= pos || storages[rootSid].writtenAt >= pos)
+            return;
+
+        for (size_t i = 0; i < ld.outputBlobs.size(); i++)
+        {
+            int sid = findStorage(ld.outputBlobs[i].matRefConst(), storagesIdx, storages);
+            if (sid < 0 || sid == inpSid || sid == rootSid)
+                continue;
+
+            BlobStorage &st = storages[sid];
+            if (st.pinned || st.parent >= 0 || st.producedAt != pos || st.writtenAt != pos)
+                continue;
+
+            st.parent = rootSid;
+            st.offset = rootOffset + (inpMat.data - inpMat.datastart);
+            storages[rootSid].releasedAt = std::max(storages[rootSid].releasedAt, st.releasedAt);
+        }
+    }
+
+    //inputs of Concat layer can be computed directly inside its output, if they are not used after it
+    void shareConcatInputs(LayerData &ld, int pos, int axis, std::map<const uchar*, int> &storagesIdx, std::vector<BlobStorage> &storages)
+    {
+        if (ld.outputBlobs.size() != 1)
+            return;
+
+        const Mat &outMat = ld.outputBlobs[0].matRefConst();
+        int outSid = findStorage(outMat, storagesIdx, storages);
+        if (outSid < 0 || storages[outSid].parent >= 0 || outMat.data != outMat.datastart || !outMat.isContinuous())
+            return;
+
+        //the part of each input inside the output must be continuous
+        for (int i = 0; i < axis; i++)
+        {
+            if (outMat.size[i] != 1)
+                return;
+        }
+
+        size_t offset = 0;
+        for (size_t i = 0; i < ld.inputBlobs.size(); i++)
+        {
+            const Mat &inpMat = ld.inputBlobs[i]->matRefConst();
+            size_t inpSize = inpMat.total() * inpMat.elemSize();
+            int sid = findStorage(inpMat, storagesIdx, storages);
+
+            if (sid >= 0 && sid != outSid && inpMat.type() == outMat.type() && inpMat.isContinuous() && inpMat.data == inpMat.datastart)
+            {
+                BlobStorage &st = storages[sid];
+                if (!st.pinned && st.parent < 0 && st.releasedAt == pos && st.size == inpSize)
+                {
+                    st.parent = outSid;
+                    st.offset = offset;
+                    storages[outSid].producedAt = std::min(storages[outSid].producedAt, st.producedAt);
+                }
+            }
+
+            offset += inpSize;
+        }
+    }
+
+    //assigns shared memory buffers to the blobs with non-overlapping lifetimes
+    void planMemory()
+    {
+        std::vector<BlobStorage> storages;
+        std::map<const uchar*, int> storagesIdx;
+
+        //compute lifetimes of the storages
+        for (int pos = 0; pos < (int)layersOrder.size(); pos++)
+        {
+            LayerData &ld = layers[layersOrder[pos]];
+
+            for (size_t i = 0; i < ld.inputBlobs.size(); i++)
+            {
+                int sid = findStorage(ld.inputBlobs[i]->matRefConst(), storagesIdx, storages);
+                if (sid >= 0)
+                    storages[sid].releasedAt = std::max(storages[sid].releasedAt, pos);
+            }
+
+            for (size_t i = 0; i < ld.outputBlobs.size(); i++)
+            {
+                const Mat &m = ld.outputBlobs[i].matRefConst();
+                int sid = findStorage(m, storagesIdx, storages);
+                if (sid < 0)
+                    continue;
+
+                BlobStorage &st = storages[sid];
+                st.size = std::max(st.size, (size_t)(m.data - m.datastart) + m.total() * m.elemSize());
+                st.producedAt = std::min(st.producedAt, pos);
+                st.writtenAt = std::max(st.writtenAt, pos);
+                st.releasedAt = std::max(st.releasedAt, pos);
+                st.pinned |= (ld.id == 0 || ld.requiredOutputs.empty() || m.u == NULL);
+                st.blobs.push_back(LayerPin(ld.id, (int)i));
+            }
+        }
+
+        blobsMemory = 0;
+        for (size_t i = 0; i < storages.size(); i++)
+            blobsMemory += storages[i].size;
+
+        //eliminate copies inside Split and Concat layers
+        for (int pos = 0; pos < (int)layersOrder.size(); pos++)
+        {
+            LayerData &ld = layers[layersOrder[pos]];
+            Layer *layer = ld.layerInstance.get();
+
+            if (dynamic_cast<SplitLayer*>(layer))
+                shareSplitOutputs(ld, pos, storagesIdx, storages);
+            else if (ConcatLayer *concat = dynamic_cast<ConcatLayer*>(layer))
+                shareConcatInputs(ld, pos, concat->getAxis(), storagesIdx, storages);
+        }
+
+        //greedily assign buffers to root storages in order of their production
+        std::vector<std::pair<int, int> > roots;
+        for (size_t i = 0; i < storages.size(); i++)
+        {
+            if (storages[i].parent < 0 && !storages[i].pinned)
+                roots.push_back(make_pair(storages[i].producedAt, (int)i));
+        }
+        std::sort(roots.begin(), roots.end());
+
+        std::vector<size_t> bufSizes;
+        std::vector<int> bufReleasedAt;
+        for (size_t i = 0; i < roots.size(); i++)
+        {
+            BlobStorage &st = storages[roots[i].second];
+
+            //prefer the smallest of sufficient free buffers, otherwise grow the largest free one
+            int bestBuf = -1;
+            for (int b = 0; b < (int)bufSizes.size(); b++)
+            {
+                if (bufReleasedAt[b] >= st.producedAt)
+                    continue;
+
+                if (bestBuf < 0)
+                {
+                    bestBuf = b;
+                    continue;
+                }
+
+                bool fits = bufSizes[b] >= st.size, bestFits = bufSizes[bestBuf] >= st.size;
+                if ((fits && (!bestFits || bufSizes[b] < bufSizes[bestBuf])) || (!fits && !bestFits && bufSizes[b] > bufSizes[bestBuf]))
+                    bestBuf = b;
+            }
+
+            if (bestBuf < 0)
+            {
+                bestBuf = (int)bufSizes.size();
+                bufSizes.push_back(0);
+                bufReleasedAt.push_back(-1);
+            }
+
+            bufSizes[bestBuf] = std::max(bufSizes[bestBuf], st.size);
+            bufReleasedAt[bestBuf] = st.releasedAt;
+            st.buffer = bestBuf;
+        }
+
+        plannedMemory = 0;
+        for (size_t i = 0; i < bufSizes.size(); i++)
+            plannedMemory += bufSizes[i];
+        for (size_t i = 0; i < storages.size(); i++)
+        {
+            if (storages[i].parent < 0 && storages[i].pinned)
+                plannedMemory += storages[i].size;
+        }
+
+        if (!memoryReuse)
+            return;
+
+        //rebind blobs to the planned memory
+        memoryPool.resize(bufSizes.size());
+        for (size_t i = 0; i < bufSizes.size(); i++)
+            memoryPool[i].create(1, (int)bufSizes[i], CV_8U);
+
+        for (size_t i = 0; i < storages.size(); i++)
+        {
+            const BlobStorage &st = storages[i];
+            if (st.parent < 0 && st.pinned)
+                continue;
+
+            size_t offset;
+            const BlobStorage &root = storages[findRootStorage((int)i, storages, offset)];
+            uchar *base = (root.pinned ? const_cast<uchar*>(root.datastart) : memoryPool[root.buffer].data) + offset;
+
+            for (size_t j = 0; j < st.blobs.size(); j++)
+            {
+                Blob &blob = layers[st.blobs[j].lid].outputBlobs[st.blobs[j].oid];
+                const Mat &m = blob.matRefConst();
+                Mat planned(m.dims, m.size.p, m.type(), base + (m.data - m.datastart), m.step.p);
+                blob.matRef() = planned;
+            }
+        }
+
+        blobsPlanned = true;
+    }
+
+    //marks the layer and all layers which depend on it as requiring recomputation
+    void invalidateLayer(LayerData &ld)
+    {
+        //dirty layer always has dirty consumers, so the subgraph was already processed
+        if (ld.dirty)
+            return;
+
+        ld.dirty = true;
+        invalidateConsumers(ld);
+    }
+
+    void invalidateConsumers(LayerData &ld)
+    {
+        for (set<int>::iterator i = ld.outputLayersId.begin(); i != ld.outputLayersId.end(); i++)
+            invalidateLayer(layers[*i]);
+    }
+
+    //marks only the layers which read the given output (and all layers which depend on them) as requiring recomputation
+    void invalidatePinConsumers(const LayerPin &pin)
+    {
+        LayerData &ld = layers[pin.lid];
+        for (set<int>::iterator i = ld.outputLayersId.begin(); i != ld.outputLayersId.end(); i++)
+        {
+            LayerData &consumer = layers[*i];
+            for (size_t j = 0; j < consumer.inputBlobsId.size(); j++)
+            {
+                if (consumer.inputBlobsId[j].equal(pin))
+                {
+                    invalidateLayer(consumer);
+                    break;
+                }
+            }
+        }
+    }
+
+    void forwardLayer(LayerData &ld, bool clearFlags = true, bool onlyDirty = false)
     {
         if (clearFlags)
         {
@@ -392,16 +985,26 @@ struct Net::Impl
         if (ld.flag)
             return;
 
+        //outputs are actual, and outputs of all parents are actual too
+        if (onlyDirty && !ld.dirty)
+        {
+            ld.flag = 1;
+            return;
+        }
+
         //forward parents
         for (set<int>::iterator i = ld.inputLayersId.begin(); i != ld.inputLayersId.end(); i++)
         {
-            forwardLayer(layers[*i], false);
+            forwardLayer(layers[*i], false, onlyDirty);
         }
 
         //forward itself
-        ld.layerInstance->forward(ld.inputBlobs, ld.outputBlobs);
+        forwardLayerInstance(ld, forwardStartTick);
 
         ld.flag = 1;
+        ld.dirty = false;
+        //consumers might be computed inplace over the rewritten outputs
+        invalidateConsumers(ld);
     }
 
     void forwardAll()
@@ -410,9 +1013,147 @@ struct Net::Impl
         for (it = layers.begin(); it != layers.end(); it++)
             it->second.flag = 0;
 
+        //layers share memory buffers in the assumption of the sequential order
+        if (parallelForward && !memoryReuse && getNumThreads() > 1)
+        {
+            forwardParallel();
+            return;
+        }
+
         for (it = layers.begin(); it != layers.end(); it++)
             forwardLayer(it->second, false);
     }
+
+    //computes the net in the forward order and updates maximal absolute values of the quantizable layers inputs
+    void calibrate(std::map<int, double> &maxAbs)
+    {
+        int64 passStart = getTickCount();
+
+        for (size_t i = 0; i < layersOrder.size(); i++)
+        {
+            LayerData &ld = layers[layersOrder[i]];
+
+            if (ld.layerInstance.dynamicCast<Quantizable>())
+            {
+                double &val = maxAbs[ld.id];
+                for (size_t j = 0; j < ld.inputBlobs.size(); j++)
+                    val = std::max(val, norm(ld.inputBlobs[j]->matRefConst(), NORM_INF));
+            }
+
+            forwardLayerInstance(ld, passStart);
+            ld.dirty = true;
+        }
+    }
+
+    void quantizeLayers(int precision, const std::map<int, double> &maxAbs)
+    {
+        MapIdToLayerData::iterator it;
+        for (it = layers.begin(); it != layers.end(); it++)
+        {
+            LayerData &ld = it->second;
+            Ptr<Quantizable> layer = ld.getLayerInstance().dynamicCast<Quantizable>();
+            if (!layer)
+                continue;
+
+            std::map<int, double>::const_iterator scaleIt = maxAbs.find(ld.id);
+            float inputScale = (scaleIt != maxAbs.end()) ? int8Scale(scaleIt->second) : 0.f;
+
+            //parameters keep references to the original weights
+            if (layer->quantize(precision, inputScale) && precision != Net::PRECISION_FP32 && !ld.params.blobs.empty())
+                ld.params.blobs[0] = Blob();
+        }
+
+        netWasAllocated = false;
+    }
+
+    void beginForward()
+    {
+        MapIdToLayerData::iterator it;
+        for (it = layers.begin(); it != layers.end(); it++)
+        {
+            it->second.forwardTime = 0;
+            it->second.forwardStart = -1;
+        }
+        forwardStartTick = getTickCount();
+    }
+
+    void endForward()
+    {
+        forwardTime = (getTickCount() - forwardStartTick) * 1000. / getTickFrequency();
+    }
+
+    static size_t allocatedMemory(const LayerData &ld)
+    {
+        size_t memory = 0;
+        for (size_t i = 0; i < ld.outputBlobs.size(); i++)
+        {
+            const Mat &m = ld.outputBlobs[i].matRefConst();
+            bool inplace = false;
+            for (size_t j = 0; j < ld.inputBlobs.size() && !inplace; j++)
+                inplace = m.data == ld.inputBlobs[j]->matRefConst().data;
+
+            if (!inplace)
+                memory += m.total() * m.elemSize();
+        }
+        return memory;
+    }
+
+    void getProfile(std::vector<LayerProfile> &profile)
+    {
+        profile.clear();
+
+        MapIdToLayerData::iterator it;
+        for (it = layers.begin(); it != layers.end(); it++)
+        {
+            LayerData &ld = it->second;
+            if (ld.id == 0 || ld.forwardStart < 0)
+                continue;
+
+            LayerProfile lp;
+            lp.id = ld.id;
+            lp.name = ld.name;
+            lp.type = ld.type;
+            lp.time = ld.forwardTime;
+            lp.start = ld.forwardStart;
+            lp.thread = ld.thread;
+            lp.flops = (ld.skip) ? 0 : ld.layerInstance->getFLOPS(ld.inputBlobs, ld.outputBlobs);
+            lp.memory = allocatedMemory(ld);
+            for (size_t i = 0; i < ld.outputBlobs.size(); i++)
+                lp.outputShapes.push_back(ld.outputBlobs[i].shape());
+
+            profile.push_back(lp);
+        }
+    }
+
+    void forwardParallel()
+    {
+        ParallelForwardInvoker::State state;
+        ParallelForwardInvoker invoker(schedule, state, forwardStartTick);
+
+        //the workers aren't running between the rounds, so the state is accessed without the lock
+        while (!state.failed && state.remaining > 0)
+        {
+            //there is a worker for each ready layer, so the inner loops of the layers aren't starved by idle workers;
+            //a single ready layer is computed by this thread with all the threads available to its inner loops
+            int workers = std::min(getNumThreads(), (int)state.ready.size());
+            CV_Assert(workers > 0);
+            if (workers == 1)
+                invoker(Range(0, 1));
+            else
+                parallel_for_(Range(0, workers), invoker, workers);
+        }
+
+        if (state.failed)
+            throw state.error;
+
+        //all layers are computed, so there is no need to invalidate consumers
+        MapIdToLayerData::iterator it;
+        for (it = layers.begin(); it != layers.end(); it++)
+        {
+            it->second.flag = 1;
+            it->second.dirty = false;
+        }
+    }
 };
 
 Net::Net() : impl(new Net::Impl)
@@ -472,13 +1213,217 @@ void Net::connect(String _outPin, String _inPin)
 void Net::forward()
 {
     impl->setUpNet();
+    impl->beginForward();
     impl->forwardAll();
+    impl->endForward();
 }
 
 void Net::forward(LayerId toLayer)
 {
     impl->setUpNet();
+    impl->beginForward();
     impl->forwardLayer(impl->getLayerData(toLayer));
+    impl->endForward();
+}
+
+void Net::forwardOpt(LayerId toLayer)
+{
+    impl->setUpNet();
+    impl->beginForward();
+    //outputs of unchanged layers might be overwritten if memory is reused
+    impl->forwardLayer(impl->getLayerData(toLayer), true, !impl->memoryReuse);
+    impl->endForward();
+}
+
+void Net::forwardOpt(const std::vector<LayerId> &toLayers)
+{
+    impl->setUpNet();
+    impl->beginForward();
+
+    Impl::MapIdToLayerData::iterator it;
+    for (it = impl->layers.begin(); it != impl->layers.end(); it++)
+        it->second.flag = 0;
+
+    for (size_t i = 0; i < toLayers.size(); i++)
+        impl->forwardLayer(impl->getLayerData(toLayers[i]), false, !impl->memoryReuse);
+    impl->endForward();
+}
+
+void Net::setMemoryReuse(bool enable)
+{
+    if (impl->memoryReuse != enable)
+    {
+        impl->memoryReuse = enable;
+        impl->netWasAllocated = false;
+    }
+}
+
+void Net::setParallelForward(bool enable)
+{
+    impl->parallelForward = enable;
+}
+
+double Net::getPerfProfile(std::vector<double> &timings)
+{
+    timings.assign(impl->lastLayerId + 1, 0.);
+
+    Impl::MapIdToLayerData::iterator it;
+    for (it = impl->layers.begin(); it != impl->layers.end(); it++)
+        timings[it->first] = it->second.forwardTime;
+
+    return impl->forwardTime;
+}
+
+void Net::getProfile(std::vector<LayerProfile> &profile)
+{
+    impl->getProfile(profile);
+}
+
+static String jsonString(const String &str)
+{
+    std::string res = "\"";
+    for (size_t i = 0; i < str.size(); i++)
+    {
+        char c = str[i];
+        if (c == '"' || c == '\\')
+            res += '\\';
+        res += c;
+    }
+    return res + "\"";
+}
+
+static std::string jsonShapes(const std::vector<BlobShape> &shapes)
+{
+    std::ostringstream ss;
+    ss << "[";
+    for (size_t i = 0; i < shapes.size(); i++)
+    {
+        ss << ((i) ? ", [" : "[");
+        for (int j = 0; j < shapes[i].dims(); j++)
+            ss << ((j) ? ", " : "") << shapes[i][j];
+        ss << "]";
+    }
+    ss << "]";
+    return ss.str();
+}
+
+void Net::writeProfile(const String &filename, int format)
+{
+    CV_Assert(format == PROFILE_JSON || format == PROFILE_CHROME_TRACE);
+
+    std::vector<LayerProfile> profile;
+    impl->getProfile(profile);
+
+    std::ofstream fs(filename.c_str());
+    if (!fs.is_open())
+        CV_Error(Error::StsError, "Can't open file \"" + filename + "\"");
+    fs.precision(6);
+    fs << std::fixed;
+
+    if (format == PROFILE_JSON)
+    {
+        fs << "{\n  \"time\": " << impl->forwardTime << ",\n  \"layers\": [";
+        for (size_t i = 0; i < profile.size(); i++)
+        {
+            const LayerProfile &lp = profile[i];
+            fs << ((i) ? ",\n" : "\n")
+               << "    {\"id\": " << lp.id << ", \"name\": " << jsonString(lp.name) << ", \"type\": " << jsonString(lp.type)
+               << ", \"time\": " << lp.time << ", \"start\": " << lp.start << ", \"thread\": " << lp.thread
+               << ", \"flops\": " << lp.flops << ", \"memory\": " << lp.memory
+               << ", \"output_shapes\": " << jsonShapes(lp.outputShapes) << "}";
+        }
+        fs << "\n  ]\n}\n";
+    }
+    else
+    {
+        //timestamps of trace events are in microseconds
+        fs << "{\"traceEvents\": [";
+        for (size_t i = 0; i < profile.size(); i++)
+        {
+            const LayerProfile &lp = profile[i];
+            fs << ((i) ? ",\n" : "\n")
+               << "  {\"name\": " << jsonString(lp.name) << ", \"cat\": " << jsonString(lp.type) << ", \"ph\": \"X\""
+               << ", \"ts\": " << lp.start * 1000 << ", \"dur\": " << lp.time * 1000 << ", \"pid\": 0, \"tid\": " << lp.thread
+               << ", \"args\": {\"flops\": " << lp.flops << ", \"memory\": " << lp.memory
+               << ", \"output_shapes\": " << jsonString(jsonShapes(lp.outputShapes)) << "}}";
+        }
+        fs << "\n], \"displayTimeUnit\": \"ms\"}\n";
+    }
+}
+
+void Net::quantize(int precision, const String &inputName, const std::vector<Blob> &calibration)
+{
+    CV_Assert(precision == PRECISION_FP32 || precision == PRECISION_FP16 || precision == PRECISION_INT8);
+
+    std::map<int, double> maxAbs;
+    if (precision == PRECISION_INT8)
+    {
+        for (size_t i = 0; i < calibration.size(); i++)
+        {
+            setBlob(inputName, calibration[i]);
+            impl->setUpNet();
+            impl->calibrate(maxAbs);
+        }
+    }
+
+    impl->quantizeLayers(precision, maxAbs);
+}
+
+Net Net::createContext()
+{
+    Net context;
+    Impl &dst = *context.impl;
+
+    dst.netInputLayer->setNames(impl->netInputLayer->getNames());
+    dst.layers[0].requiredOutputs = impl->layers[0].requiredOutputs;
+
+    Impl::MapIdToLayerData::iterator it;
+    for (it = impl->layers.begin(); it != impl->layers.end(); it++)
+    {
+        LayerData &ld = it->second;
+        if (ld.id == 0)
+            continue;
+
+        //current parameters of the layer, they could be changed by setParam() or quantize()
+        Ptr<Layer> layer = ld.getLayerInstance();
+        LayerParams params = ld.params;
+        params.blobs = layer->blobs;
+
+        LayerData &copy = dst.layers.insert(std::make_pair(ld.id, LayerData(ld.id, ld.name, ld.type, params))).first->second;
+        copy.inputBlobsId = ld.inputBlobsId;
+        copy.requiredOutputs = ld.requiredOutputs;
+
+        //instances are created here, so worker threads don't access the layers factory
+        Ptr<WeightsSharing> sharing = layer.dynamicCast<WeightsSharing>();
+        if (sharing)
+            copy.layerInstance = sharing->createShared();
+        else
+            copy.getLayerInstance();
+    }
+
+    dst.layerNameToId = impl->layerNameToId;
+    dst.lastLayerId = impl->lastLayerId;
+    dst.memoryReuse = impl->memoryReuse;
+    dst.fusion = impl->fusion;
+    dst.parallelForward = impl->parallelForward;
+
+    return context;
+}
+
+void Net::setLayerFusion(bool enable)
+{
+    if (impl->fusion != enable)
+    {
+        impl->fusion = enable;
+        impl->netWasAllocated = false;
+    }
+}
+
+void Net::getMemoryConsumption(size_t &blobsMemory, size_t &plannedMemory)
+{
+    impl->setUpNet();
+    blobsMemory = impl->blobsMemory;
+    plannedMemory = impl->plannedMemory;
 }
 
 void Net::setNetInputs(const std::vector<String> &inputBlobNames)
@@ -494,7 +1439,21 @@ void Net::setBlob(String outputName, const Blob &blob)
 
     LayerData &ld = impl->layers[pin.lid];
     ld.outputBlobs.resize( std::max(pin.oid+1, (int)ld.requiredOutputs.size()) );
-    ld.outputBlobs[pin.oid] = blob;
+
+    Blob &outBlob = ld.outputBlobs[pin.oid];
+    if (impl->netWasAllocated && outBlob.equalShape(blob) && outBlob.type() == blob.type())
+    {
+        //consumers may share data of the allocated blob, so update it inplace
+        if (outBlob.matRefConst().data != blob.matRefConst().data)
+            blob.matRefConst().copyTo(outBlob.matRef());
+    }
+    else
+    {
+        outBlob = blob;
+        impl->netWasAllocated = false;
+    }
+
+    impl->invalidatePinConsumers(pin);
 }
 
 Blob Net::getBlob(String outputName)
@@ -521,6 +1480,17 @@ Blob Net::getParam(LayerId layer, int numParam)
     return layerBlobs[numParam];
 }
 
+void Net::setParam(LayerId layer, int numParam, const Blob &blob)
+{
+    LayerData &ld = impl->getLayerData(layer);
+
+    std::vector<Blob> &layerBlobs = ld.getLayerInstance()->blobs;
+    CV_Assert(numParam < (int)layerBlobs.size());
+    layerBlobs[numParam] = blob;
+
+    impl->invalidateLayer(ld);
+}
+
 int Net::getLayerId(const String &layer)
 {
     return impl->getLayerId(layer);
@@ -553,6 +1523,11 @@ int Layer::outputNameToIndex(String)
     return -1;
 }
 
+int64 Layer::getFLOPS(const std::vector<Blob*>&, const std::vector<Blob>&) const
+{
+    return 0;
+}
+
 Layer::~Layer() {}
 
 //////////////////////////////////////////////////////////////////////////
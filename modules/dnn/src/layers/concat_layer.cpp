@@ -92,7 +92,9 @@ namespace dnn
             ranges[axis] = Range(sizeStart, sizeEnd);
 
             Mat outSubMat = outMat(&ranges[0]);
-            inputs[i]->matRef().copyTo(outSubMat);
+            //input could be already computed inside the output (see memory planning in Net)
+            if (inputs[i]->matRefConst().data != outSubMat.data)
+                inputs[i]->matRef().copyTo(outSubMat);
 
             sizeStart = sizeEnd;
         }
@@ -55,6 +55,8 @@ namespace dnn
         ConcatLayer(LayerParams& params);
         void allocate(const std::vector<Blob*> &inputs, std::vector<Blob> &outputs);
         void forward(std::vector<Blob*> &inputs, std::vector<Blob> &outputs);
+
+        int getAxis() const { return axis; }
     };
 }
 }
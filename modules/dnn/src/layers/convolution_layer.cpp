@@ -64,6 +64,8 @@ namespace dnn
 
         const Blob &wgtBlob = blobs[0];
         CV_Assert(wgtBlob.dims() == 4 && wgtBlob.cols() == kerW && wgtBlob.rows() == kerH);
+        wgtShape = wgtBlob.shape();
+        inputScale = 0;
 
         if (bias)
         {
@@ -73,23 +75,60 @@ namespace dnn
 
         //TBD
         useOpenCL = params.has("use_opencl");
+
+        String algo = params.get<String>("conv_algorithm", "auto").toLowerCase();
+        if (algo == "auto")
+            requestedAlgorithm = CONV_AUTO;
+        else if (algo == "im2col")
+            requestedAlgorithm = CONV_IM2COL;
+        else if (algo == "winograd")
+            requestedAlgorithm = CONV_WINOGRAD;
+        else if (algo == "winograd_2x2")
+            requestedAlgorithm = CONV_WINOGRAD_2X2;
+        else if (algo == "winograd_4x4")
+            requestedAlgorithm = CONV_WINOGRAD_4X4;
+        else if (algo == "fft")
+            requestedAlgorithm = CONV_FFT;
+        else
+            CV_Error(Error::StsBadArg, "Unknown convolution algorithm \"" + algo + "\"");
+        algorithm = CONV_IM2COL;
     }
 
+    //size limit of the batched columns matrix, at least one image is always processed
+    static const size_t MAX_COL_BATCH_BYTES = (size_t)1 << 26;
+
+    //minimal channels per group for which the Winograd transforms pay off in auto mode
+    static const int WINOGRAD_MIN_CHANNELS = 16;
+    //minimal output size for which F(4x4,3x3) is used instead of F(2x2,3x3)
+    static const int WINOGRAD_4X4_MIN_SIZE = 16;
+    //minimal kernel size for which FFT is used in auto mode
+    static const int FFT_MIN_KERNEL = 9;
+
+    //Accuracy limits of auto mode. The transforms of F(4x4,3x3) amplify the rounding errors more than
+    //those of F(2x2,3x3), and the error of FFT grows with the transform size, so beyond these limits
+    //the more exact algorithm is chosen.
+    static const int WINOGRAD_4X4_MAX_CHANNELS = 256;
+    static const int FFT_MAX_SIZE = 256;
+    //maximal error of the fast algorithm chosen in auto mode relative to the maximal absolute output,
+    //the layer falls back to im2col if it's exceeded for the real weights
+    static const double AUTO_MAX_RELATIVE_ERROR = 1e-4;
+
     void ConvolutionLayer::allocate(const std::vector<Blob*> &inputs, std::vector<Blob> &outputs)
     {
         CV_Assert(inputs.size() > 0);
 
         const Blob &inpBlob = *inputs[0];
-        CV_Assert(inpBlob.dims() == 4 && inpBlob.type() == CV_32F);
+        CV_Assert(inpBlob.dims() == 4 && (inpBlob.type() == CV_32F || inpBlob.type() == CV_64F));
         computeInpOutShape(inpBlob);
 
         CV_Assert(inpCn % group == 0 && outCn % group == 0);
-        CV_Assert(blobs[0].num() == outCn && blobs[0].channels() == inpCn / group);
+        CV_Assert(wgtShape[0] == outCn && wgtShape[1] == inpCn / group);
 
         outGroupCn = outCn / group;
         inpGroupCn = inpCn / group;
         ksize = inpGroupCn * kerH * kerW;
 
+        int maxNum = 1;
         outputs.resize(inputs.size());
         for (size_t i = 0; i < inputs.size(); i++)
         {
@@ -97,14 +136,120 @@ namespace dnn
             CV_Assert(inputs[i]->dims() == 4 && inputs[i]->channels() == inpBlob.channels());
             CV_Assert(inputs[i]->rows() == inpBlob.rows() && inputs[i]->cols() == inpBlob.cols());
 
-            outputs[i].create(BlobShape(inputs[i]->num(), topCn, topH, topW));
+            outputs[i].create(BlobShape(inputs[i]->num(), topCn, topH, topW), inpBlob.type());
+            maxNum = std::max(maxNum, inputs[i]->num());
         }
 
-        if (!is1x1())
-            colMat.create(ksize, outH * outW, inpBlob.type());
+        allocateBuffers(inpBlob.type(), maxNum);
+    }
 
-        if (bias)
-            biasOnesMat = Mat::ones(1, topH * topW, inpBlob.type());
+    //Chooses the algorithm for the current shape. The requested algorithm is used if it is applicable,
+    //otherwise the layer falls back to im2col.
+    int ConvolutionLayer::selectAlgorithm() const
+    {
+        //reduced precision weights are supported only by im2col
+        if (!qWeights.empty())
+            return CONV_IM2COL;
+
+        bool unitStride = strideH == 1 && strideW == 1;
+        //larger kernels would need larger transforms, which lose too much precision
+        bool canWinograd = unitStride && kerH == 3 && kerW == 3 && !useOpenCL;
+        bool canFFT = unitStride && !useOpenCL;
+        int winogradTile = (std::min(outH, outW) >= WINOGRAD_4X4_MIN_SIZE) ? CONV_WINOGRAD_4X4 : CONV_WINOGRAD_2X2;
+
+        switch (requestedAlgorithm)
+        {
+        case CONV_AUTO:
+            if (canWinograd && inpGroupCn >= WINOGRAD_MIN_CHANNELS && outGroupCn >= WINOGRAD_MIN_CHANNELS)
+                return (inpGroupCn > WINOGRAD_4X4_MAX_CHANNELS) ? CONV_WINOGRAD_2X2 : winogradTile;
+            if (canFFT && kerH >= FFT_MIN_KERNEL && kerW >= FFT_MIN_KERNEL &&
+                inpH + 2 * padH <= FFT_MAX_SIZE && inpW + 2 * padW <= FFT_MAX_SIZE)
+                return CONV_FFT;
+            return CONV_IM2COL;
+        case CONV_WINOGRAD:
+            return (canWinograd) ? winogradTile : CONV_IM2COL;
+        case CONV_WINOGRAD_2X2:
+        case CONV_WINOGRAD_4X4:
+            return (canWinograd) ? requestedAlgorithm : CONV_IM2COL;
+        case CONV_FFT:
+            return (canFFT) ? CONV_FFT : CONV_IM2COL;
+        default:
+            return CONV_IM2COL;
+        }
+    }
+
+    void ConvolutionLayer::allocateBuffers(int type, int maxNum)
+    {
+        //double precision is computed image by image by forwardDouble()
+        if (type == CV_64F)
+        {
+            algorithm = CONV_IM2COL;
+            colBatchMat.release();
+            colInt8.release();
+            if (!isDirect1x1())
+                colMat.create(ksize, outH * outW, type);
+            return;
+        }
+
+        algorithm = selectAlgorithm();
+        if (requestedAlgorithm == CONV_AUTO && algorithm != CONV_IM2COL && !checkAlgorithmAccuracy())
+            algorithm = CONV_IM2COL;
+
+        if (qWeights.precision == Net::PRECISION_INT8)
+            colInt8.create(outH * outW, ksize, CV_8S);
+        else
+            colInt8.release();
+
+        if (algorithm != CONV_IM2COL || isDirect1x1())
+        {
+            colBatchMat.release();
+            return;
+        }
+
+        size_t imColBytes = (size_t)group * ksize * outH * outW * CV_ELEM_SIZE(type);
+        colBatchNum = (int)std::max((size_t)1, std::min((size_t)maxNum, MAX_COL_BATCH_BYTES / imColBytes));
+        colBatchMat.create(colBatchNum * group * ksize, outH * outW, type);
+    }
+
+    //Computes the probe image by the selected fast algorithm and by im2col in double precision.
+    //The result is cached for the input size, since it depends only on the size and the weights.
+    bool ConvolutionLayer::checkAlgorithmAccuracy()
+    {
+        int keyData[] = {inpH, inpW, algorithm};
+        std::vector<int> key(keyData, keyData + 3);
+        std::map<std::vector<int>, bool>::const_iterator it = algorithmAccuracy.find(key);
+        if (it != algorithmAccuracy.end())
+            return it->second;
+
+        Blob probe(BlobShape(1, inpCn, inpH, inpW)), out(BlobShape(1, outCn, outH, outW));
+        RNG rng(0);
+        rng.fill(probe.matRef(), RNG::UNIFORM, -1, 1);
+
+        const float *biasPtr = (bias) ? blobs[1].ptrf() : NULL;
+        if (algorithm == CONV_FFT)
+        {
+            fft.init(blobs[0], inpH, inpW, padH, padW);
+            fft.run(probe, out, biasPtr, padH, padW, group);
+        }
+        else
+        {
+            winograd.init((algorithm == CONV_WINOGRAD_2X2) ? 2 : 4, blobs[0], group);
+            winograd.run(probe.ptrf(), 1, inpCn, inpH, inpW, out.ptrf(), outCn, outH, outW, biasPtr, padH, padW, group);
+        }
+
+        Blob probe64(probe.shape(), CV_64F), ref(out.shape(), CV_64F);
+        probe.matRefConst().convertTo(probe64.matRef(), CV_64F);
+        colMat.create(ksize, outH * outW, CV_64F);
+        forwardDouble(probe64, ref, false);
+        colMat.release();
+
+        Mat out64;
+        out.matRefConst().convertTo(out64, CV_64F);
+        double maxAbs = norm(ref.matRefConst(), NORM_INF);
+        bool accurate = norm(out64, ref.matRefConst(), NORM_INF) <= AUTO_MAX_RELATIVE_ERROR * maxAbs;
+
+        algorithmAccuracy[key] = accurate;
+        return accurate;
     }
 
     inline bool ConvolutionLayer::is1x1() const
@@ -112,66 +257,452 @@ namespace dnn
         return (kerH == 1 && kerW == 1);
     }
 
-    void ConvolutionLayer::forward(std::vector<Blob*> &inputs, std::vector<Blob> &outputs)
+    inline bool ConvolutionLayer::isDirect1x1() const
     {
-        Blob &wgtBlob = blobs[0];
+        return is1x1() && strideH == 1 && strideW == 1 && padH == 0 && padW == 0;
+    }
 
-        for (size_t ii = 0; ii < outputs.size(); ii++)
+    //Multiplies weights by columns matrices of several images, adds bias and applies the fused activation.
+    //Output is split on tiles of (image, group, output channels block, output pixels block),
+    //each tile is accumulated over blocks of the columns rows to keep the used columns in cache.
+    class ConvolutionInvoker : public ParallelLoopBody
+    {
+    public:
+        enum { BLOCK_OUT_CN = 32, BLOCK_PIXELS = 128, BLOCK_KSIZE = 128 };
+
+        const float *wgt, *bias, *col;
+        float *out;
+        ActivationFunction *activ;
+        const QuantizedMatrix *qwgt; //fp16 weights converted by blocks of rows if wgt is NULL
+        size_t colImStep, colGroupStep, outImStep;
+        int imCount, group, outGroupCn, ksize, outSize;
+        int cnTiles, pixelTiles;
+
+        ConvolutionInvoker(const float *_wgt, const float *_bias, const float *_col, size_t _colImStep, size_t _colGroupStep,
+                           float *_out, size_t _outImStep, int _imCount, int _group, int _outGroupCn, int _ksize, int _outSize,
+                           ActivationFunction *_activ = NULL, const QuantizedMatrix *_qwgt = NULL)
+            : wgt(_wgt), bias(_bias), col(_col), out(_out), activ(_activ), qwgt(_qwgt),
+              colImStep(_colImStep), colGroupStep(_colGroupStep), outImStep(_outImStep),
+              imCount(_imCount), group(_group), outGroupCn(_outGroupCn), ksize(_ksize), outSize(_outSize)
         {
-            Blob &inpBlob = *inputs[ii];
-            Blob &outBlob = outputs[ii];
+            cnTiles = (outGroupCn + BLOCK_OUT_CN - 1) / BLOCK_OUT_CN;
+            pixelTiles = (outSize + BLOCK_PIXELS - 1) / BLOCK_PIXELS;
+        }
+
+        int totalTiles() const
+        {
+            return imCount * group * cnTiles * pixelTiles;
+        }
 
-            for (int n = 0; n < inpBlob.num(); n++)
+        void operator()(const Range &range) const
+        {
+            AutoBuffer<float> wgtBuf((qwgt) ? (size_t)BLOCK_OUT_CN * ksize : 1);
+
+            for (int tile = range.start; tile < range.end; tile++)
             {
-                for (int g = 0; g < group; g++)
+                int pt = tile % pixelTiles;
+                int ct = (tile / pixelTiles) % cnTiles;
+                int g = (tile / (pixelTiles * cnTiles)) % group;
+                int n = tile / (pixelTiles * cnTiles * group);
+
+                int p0 = pt * BLOCK_PIXELS, p1 = std::min(outSize, p0 + BLOCK_PIXELS);
+                int c0 = ct * BLOCK_OUT_CN, c1 = std::min(outGroupCn, c0 + BLOCK_OUT_CN);
+
+                const float *colBase = col + n * colImStep + g * colGroupStep;
+                const float *tileWgt;
+                if (qwgt)
+                {
+                    qwgt->getRows(g * outGroupCn + c0, g * outGroupCn + c1, wgtBuf);
+                    tileWgt = wgtBuf;
+                }
+                else
                 {
-                    im2col(inpBlob, n, g);
+                    tileWgt = wgt + ((size_t)g * outGroupCn + c0) * ksize;
+                }
+                float *outBase = out + n * outImStep + (size_t)g * outGroupCn * outSize;
 
-                    Mat kerMat(outGroupCn, ksize, wgtBlob.type(), wgtBlob.ptr(g*outGroupCn));
-                    Mat dstMat(outGroupCn, outH*outW, outBlob.type(), outBlob.ptr(n, g*outGroupCn));
+                for (int c = c0; c < c1; c++)
+                {
+                    float *outRow = outBase + (size_t)c * outSize;
+                    float b = (bias) ? bias[g * outGroupCn + c] : 0.f;
+                    for (int p = p0; p < p1; p++)
+                        outRow[p] = b;
+                }
 
-                    cv::gemm(kerMat, colMat, 1, noArray(), 0, dstMat);
+                for (int k0 = 0; k0 < ksize; k0 += BLOCK_KSIZE)
+                {
+                    int k1 = std::min(ksize, k0 + BLOCK_KSIZE);
+                    int c = c0;
 
-                    if (bias)
+                    for (; c + 3 < c1; c += 4)
                     {
-                        float *biasPtr = blobs[1].ptrf() + g*outGroupCn;
-                        Mat biasMat(outGroupCn, 1, CV_32F, biasPtr);
-                        cv::gemm(biasMat, biasOnesMat, 1, dstMat, 1, dstMat);
+                        float *r0 = outBase + (size_t)c * outSize, *r1 = r0 + outSize, *r2 = r1 + outSize, *r3 = r2 + outSize;
+                        const float *w0 = tileWgt + (size_t)(c - c0) * ksize, *w1 = w0 + ksize, *w2 = w1 + ksize, *w3 = w2 + ksize;
+
+                        for (int k = k0; k < k1; k++)
+                        {
+                            const float *colRow = colBase + (size_t)k * outSize;
+                            float a0 = w0[k], a1 = w1[k], a2 = w2[k], a3 = w3[k];
+                            for (int p = p0; p < p1; p++)
+                            {
+                                float v = colRow[p];
+                                r0[p] += a0 * v;
+                                r1[p] += a1 * v;
+                                r2[p] += a2 * v;
+                                r3[p] += a3 * v;
+                            }
+                        }
                     }
+
+                    for (; c < c1; c++)
+                    {
+                        float *r0 = outBase + (size_t)c * outSize;
+                        const float *w0 = tileWgt + (size_t)(c - c0) * ksize;
+
+                        for (int k = k0; k < k1; k++)
+                        {
+                            const float *colRow = colBase + (size_t)k * outSize;
+                            float a0 = w0[k];
+                            for (int p = p0; p < p1; p++)
+                                r0[p] += a0 * colRow[p];
+                        }
+                    }
+                }
+
+                if (activ)
+                {
+                    for (int c = c0; c < c1; c++)
+                        activ->apply(outBase + (size_t)c * outSize + p0, p1 - p0);
+                }
+            }
+        }
+    };
+
+    //Computes output pixels of one image group by int8 weights and transposed int8 columns.
+    class ConvolutionInt8Invoker : public ParallelLoopBody
+    {
+    public:
+        enum { BLOCK_PIXELS = 64 };
+
+        const QuantizedMatrix *wgt;
+        const schar *colT;
+        const float *bias;
+        float *out;
+        ActivationFunction *activ;
+        int wgtRow0, outGroupCn, ksize, outSize;
+        float inputScale;
+
+        int totalBlocks() const
+        {
+            return (outSize + BLOCK_PIXELS - 1) / BLOCK_PIXELS;
+        }
+
+        void operator()(const Range &range) const
+        {
+            for (int block = range.start; block < range.end; block++)
+            {
+                int p0 = block * BLOCK_PIXELS, p1 = std::min(outSize, p0 + BLOCK_PIXELS);
+
+                for (int c = 0; c < outGroupCn; c++)
+                {
+                    const schar *w = wgt->int8Row(wgtRow0 + c);
+                    float scale = wgt->scales[wgtRow0 + c] * inputScale;
+                    float b = (bias) ? bias[wgtRow0 + c] : 0.f;
+                    float *outRow = out + (size_t)c * outSize;
+
+                    for (int p = p0; p < p1; p++)
+                        outRow[p] = dotInt8(w, colT + (size_t)p * ksize, ksize) * scale + b;
+
+                    if (activ)
+                        activ->apply(outRow + p0, p1 - p0);
                 }
             }
         }
+    };
+
+    void ConvolutionLayer::forwardInt8(Blob &inpBlob, Blob &outBlob)
+    {
+        const float *biasPtr = (bias) ? blobs[1].ptrf() : NULL;
+        int outSize = outH * outW;
+
+        for (int n = 0; n < inpBlob.num(); n++)
+        {
+            float scale = inputScale;
+            if (scale <= 0)
+                scale = int8Scale(norm(Mat(1, inpCn * inpH * inpW, CV_32F, inpBlob.ptrf(n)), NORM_INF));
+
+            const float *colPtr;
+            size_t colGroupStep;
+            if (isDirect1x1())
+            {
+                colPtr = inpBlob.ptrf(n);
+                colGroupStep = (size_t)inpGroupCn * outSize;
+            }
+            else
+            {
+                im2colBatch(inpBlob, n, 1);
+                colPtr = colBatchMat.ptr<float>();
+                colGroupStep = (size_t)ksize * outSize;
+            }
+
+            for (int g = 0; g < group; g++)
+            {
+                quantizeInt8Transposed(colPtr + g * colGroupStep, outSize, ksize, outSize, scale, colInt8.ptr<schar>(), ksize);
+
+                ConvolutionInt8Invoker invoker;
+                invoker.wgt = &qWeights;
+                invoker.colT = colInt8.ptr<schar>();
+                invoker.bias = biasPtr;
+                invoker.out = outBlob.ptrf(n, g * outGroupCn);
+                invoker.activ = activ;
+                invoker.wgtRow0 = g * outGroupCn;
+                invoker.outGroupCn = outGroupCn;
+                invoker.ksize = ksize;
+                invoker.outSize = outSize;
+                invoker.inputScale = scale;
+                parallel_for_(Range(0, invoker.totalBlocks()), invoker);
+            }
+        }
     }
 
-    void ConvolutionLayer::im2col(Blob &inpBlob, int imNum, int cnGroup)
+    //Generic path of double precision inputs: im2col and gemm for each image and group.
+    //The blocked, Winograd, FFT and quantized paths work with floats only.
+    void ConvolutionLayer::forwardDouble(Blob &inpBlob, Blob &outBlob, bool applyActivation)
     {
-        uchar *srcPtr = inpBlob.ptr(imNum, cnGroup*inpGroupCn);
+        if (!qWeights.empty())
+            CV_Error(Error::StsNotImplemented, "Convolution with reduced precision weights requires CV_32F inputs");
+
+        int outSize = outH * outW;
+        Mat wgtMat, biasMat;
+        Mat(outCn, ksize, blobs[0].type(), blobs[0].ptr()).convertTo(wgtMat, CV_64F);
+        if (bias)
+            Mat(1, outCn, blobs[1].type(), blobs[1].ptr()).convertTo(biasMat, CV_64F);
+
+        for (int n = 0; n < inpBlob.num(); n++)
+        {
+            for (int g = 0; g < group; g++)
+            {
+                Mat col;
+                if (isDirect1x1())
+                {
+                    col = Mat(ksize, outSize, CV_64F, inpBlob.ptr(n, g*inpGroupCn));
+                }
+                else
+                {
+                    col = colMat;
+                    im2col(inpBlob, n, g, col);
+                }
 
-        if (is1x1())
+                Mat dstMat(outGroupCn, outSize, CV_64F, outBlob.ptr(n, g*outGroupCn));
+                cv::gemm(wgtMat.rowRange(g*outGroupCn, (g+1)*outGroupCn), col, 1, noArray(), 0, dstMat);
+
+                for (int c = 0; c < outGroupCn; c++)
+                {
+                    Mat dstRow = dstMat.row(c);
+                    if (bias)
+                        dstRow += Scalar::all(biasMat.at<double>(g*outGroupCn + c));
+                    if (activ && applyActivation)
+                        activ->apply(dstRow.ptr<double>(), outSize);
+                }
+            }
+        }
+    }
+
+    void ConvolutionLayer::forward(std::vector<Blob*> &inputs, std::vector<Blob> &outputs)
+    {
+        const float *biasPtr = (bias) ? blobs[1].ptrf() : NULL;
+        int outSize = outH * outW;
+
+        if (inputs[0]->type() == CV_64F)
+        {
+            for (size_t ii = 0; ii < outputs.size(); ii++)
+                forwardDouble(*inputs[ii], outputs[ii]);
+            return;
+        }
+
+        if (qWeights.precision == Net::PRECISION_INT8)
+        {
+            for (size_t ii = 0; ii < outputs.size(); ii++)
+                forwardInt8(*inputs[ii], outputs[ii]);
+            return;
+        }
+
+        Blob &wgtBlob = blobs[0];
+        const float *wgtPtr = (qWeights.empty()) ? wgtBlob.ptrf() : NULL;
+
+        if (algorithm == CONV_WINOGRAD_2X2 || algorithm == CONV_WINOGRAD_4X4)
+        {
+            winograd.init((algorithm == CONV_WINOGRAD_2X2) ? 2 : 4, wgtBlob, group);
+            for (size_t ii = 0; ii < outputs.size(); ii++)
+            {
+                winograd.run(inputs[ii]->ptrf(), inputs[ii]->num(), inpCn, inpH, inpW,
+                             outputs[ii].ptrf(), outCn, outH, outW, biasPtr, padH, padW, group, activ);
+            }
+            return;
+        }
+
+        if (algorithm == CONV_FFT)
+        {
+            fft.init(wgtBlob, inpH, inpW, padH, padW);
+            for (size_t ii = 0; ii < outputs.size(); ii++)
+                fft.run(*inputs[ii], outputs[ii], biasPtr, padH, padW, group, activ);
+            return;
+        }
+
+        for (size_t ii = 0; ii < outputs.size(); ii++)
+        {
+            Blob &inpBlob = *inputs[ii];
+            Blob &outBlob = outputs[ii];
+            int num = inpBlob.num();
+            int batchNum = (isDirect1x1()) ? num : colBatchNum;
+
+            for (int n0 = 0; n0 < num; n0 += batchNum)
+            {
+                int imCount = std::min(batchNum, num - n0);
+                const float *colPtr;
+                size_t colImStep, colGroupStep;
+
+                if (isDirect1x1())
+                {
+                    colPtr = inpBlob.ptrf(n0);
+                    colImStep = (size_t)inpCn * outSize;
+                    colGroupStep = (size_t)inpGroupCn * outSize;
+                }
+                else
+                {
+                    im2colBatch(inpBlob, n0, imCount);
+                    colPtr = colBatchMat.ptr<float>();
+                    colImStep = (size_t)group * ksize * outSize;
+                    colGroupStep = (size_t)ksize * outSize;
+                }
+
+                ConvolutionInvoker invoker(wgtPtr, biasPtr, colPtr, colImStep, colGroupStep,
+                                           outBlob.ptrf(n0), (size_t)outCn * outSize,
+                                           imCount, group, outGroupCn, ksize, outSize, activ,
+                                           (qWeights.empty()) ? NULL : &qWeights);
+                parallel_for_(Range(0, invoker.totalTiles()), invoker);
+            }
+        }
+    }
+
+    //also valid for deconvolution, which multiplies the transposed weights by its input
+    int64 ConvolutionLayer::getFLOPS(const std::vector<Blob*> &inputs, const std::vector<Blob>&) const
+    {
+        int64 flops = 0;
+        for (size_t i = 0; i < inputs.size(); i++)
+            flops += (int64)inputs[i]->num() * outCn * outH * outW * (2 * ksize + (bias ? 1 : 0));
+        return flops;
+    }
+
+    bool ConvolutionLayer::quantize(int precision, float _inputScale)
+    {
+        if (precision == Net::PRECISION_FP32)
+            return qWeights.empty();
+        if (!qWeights.empty())
+            return qWeights.precision == precision;
+
+        const Blob &wgtBlob = blobs[0];
+        qWeights.create(Mat(wgtShape[0], (int)(wgtBlob.total() / wgtShape[0]), CV_32F, (void*)wgtBlob.ptrf()), precision);
+        inputScale = _inputScale;
+
+        //original weights aren't needed anymore, the parameter refers to the quantized ones
+        blobs[0].matRef() = qWeights.data;
+        return true;
+    }
+
+    bool ConvolutionLayer::setActivation(const Ptr<ActivationFunction> &_activ)
+    {
+        activ = _activ;
+        return true;
+    }
+
+    //buffers of the forward pass, which can't be shared by the instances computed concurrently
+    void ConvolutionLayer::releaseBuffers()
+    {
+        colMat.release();
+        biasOnesMat.release();
+        colBatchMat.release();
+        colInt8.release();
+        activ.release();
+    }
+
+    Ptr<Layer> ConvolutionLayer::createShared() const
+    {
+        //weights, quantized weights and transformed weights of Winograd and FFT algorithms are shared by copies
+        Ptr<ConvolutionLayer> layer(new ConvolutionLayer(*this));
+        layer->releaseBuffers();
+        return layer;
+    }
+
+    class Im2ColInvoker : public ParallelLoopBody
+    {
+    public:
+        const float *inp;
+        float *col;
+        size_t inpGroupStep, colGroupStep;
+        int channels, height, width, kerH, kerW, padH, padW, strideH, strideW;
+
+        Im2ColInvoker(const float *_inp, size_t _inpGroupStep, float *_col, size_t _colGroupStep, int _channels, int _height, int _width,
+                      int _kerH, int _kerW, int _padH, int _padW, int _strideH, int _strideW)
+            : inp(_inp), col(_col), inpGroupStep(_inpGroupStep), colGroupStep(_colGroupStep),
+              channels(_channels), height(_height), width(_width), kerH(_kerH), kerW(_kerW),
+              padH(_padH), padW(_padW), strideH(_strideH), strideW(_strideW) {}
+
+        void operator()(const Range &range) const
+        {
+            for (int i = range.start; i < range.end; i++)
+                im2col_cpu(inp + i * inpGroupStep, channels, height, width, kerH, kerW, padH, padW, strideH, strideW, col + i * colGroupStep);
+        }
+    };
+
+    //fills colBatchMat by columns of each group of images [imStart; imStart + imCount)
+    void ConvolutionLayer::im2colBatch(Blob &inpBlob, int imStart, int imCount)
+    {
+        size_t colGroupStep = (size_t)ksize * outH * outW;
+
+#ifdef HAVE_OPENCL
+        if (useOpenCL && ocl::useOpenCL())
         {
-            colMat = Mat(ksize, inpBlob.rows()*inpBlob.cols(), inpBlob.type(), srcPtr);
+            for (int n = 0; n < imCount; n++)
+            {
+                for (int g = 0; g < group; g++)
+                {
+                    Mat dstMat(ksize, outH * outW, colBatchMat.type(), colBatchMat.ptr<float>() + (n * group + g) * colGroupStep);
+                    im2col(inpBlob, imStart + n, g, dstMat);
+                }
+            }
             return;
         }
+#endif // HAVE_OPENCL
+
+        Im2ColInvoker invoker(inpBlob.ptrf(imStart), (size_t)inpGroupCn * inpH * inpW, colBatchMat.ptr<float>(), colGroupStep,
+                              inpGroupCn, inpH, inpW, kerH, kerW, padH, padW, strideH, strideW);
+        parallel_for_(Range(0, imCount * group), invoker);
+    }
+
+    void ConvolutionLayer::im2col(Blob &inpBlob, int imNum, int cnGroup, Mat &dstMat)
+    {
+        uchar *srcPtr = inpBlob.ptr(imNum, cnGroup*inpGroupCn);
 
 #ifdef HAVE_OPENCL
-        if (useOpenCL && ocl::useOpenCL() && inpBlob.type() == CV_32F && !is1x1())
+        if (useOpenCL && ocl::useOpenCL() && inpBlob.type() == CV_32F)
         {
             std::vector<Range> ranges(4, Range::all());
             ranges[0] = Range(imNum, imNum+1);
             ranges[1] = Range(cnGroup*inpGroupCn, (cnGroup + 1)*inpGroupCn);
 
             UMat src = inpBlob.matRef()(&ranges[0]).getUMat(ACCESS_READ);
-            UMat dst(colMat.size(), colMat.type());
+            UMat dst(dstMat.size(), dstMat.type());
             im2col_ocl(src, inpGroupCn, inpH, inpW, kerH, kerW, padH, padW, strideH, strideW, dst);
-            dst.copyTo(colMat);
+            dst.copyTo(dstMat);
             return;
         }
 #endif // HAVE_OPENCL
 
         if (inpBlob.type() == CV_32F)
-            im2col_cpu((float *)srcPtr, inpGroupCn, inpH, inpW, kerH, kerW, padH, padW, strideH, strideW, (float *)colMat.ptr());
+            im2col_cpu((float *)srcPtr, inpGroupCn, inpH, inpW, kerH, kerW, padH, padW, strideH, strideW, (float *)dstMat.ptr());
         if (inpBlob.type() == CV_64F)
-            im2col_cpu((double*)srcPtr, inpGroupCn, inpH, inpW, kerH, kerW, padH, padW, strideH, strideW, (double*)colMat.ptr());
+            im2col_cpu((double*)srcPtr, inpGroupCn, inpH, inpW, kerH, kerW, padH, padW, strideH, strideW, (double*)dstMat.ptr());
     }
 
     void ConvolutionLayer::computeInpOutShape(const Blob &inpBlob)
@@ -190,6 +721,18 @@ namespace dnn
     DeConvolutionLayer::DeConvolutionLayer(LayerParams &params)
         : ConvolutionLayer(params) {}
 
+    void DeConvolutionLayer::allocateBuffers(int type, int)
+    {
+        //the bias is added by a float gemm
+        CV_Assert(type == CV_32F);
+
+        if (!is1x1())
+            colMat.create(ksize, outH * outW, type);
+
+        if (bias)
+            biasOnesMat = Mat::ones(1, topH * topW, type);
+    }
+
     void DeConvolutionLayer::computeInpOutShape(const Blob &inpBlob)
     {
         outH = inpBlob.rows();
@@ -238,6 +781,23 @@ namespace dnn
         }
     }
 
+    bool DeConvolutionLayer::quantize(int precision, float)
+    {
+        return precision == Net::PRECISION_FP32;
+    }
+
+    bool DeConvolutionLayer::setActivation(const Ptr<ActivationFunction> &_activ)
+    {
+        return !_activ;
+    }
+
+    Ptr<Layer> DeConvolutionLayer::createShared() const
+    {
+        Ptr<DeConvolutionLayer> layer(new DeConvolutionLayer(*this));
+        layer->releaseBuffers();
+        return layer;
+    }
+
     void DeConvolutionLayer::col2im(Mat &dstMat)
     {
         if (is1x1()) return;
@@ -42,13 +42,15 @@
 #ifndef __OPENCV_DNN_LAYERS_CONVOLUTION_LAYER_HPP__
 #define __OPENCV_DNN_LAYERS_CONVOLUTION_LAYER_HPP__
 #include "../precomp.hpp"
+#include "layers_common.hpp"
+#include "fast_convolution.hpp"
+#include "quantization.hpp"
 
 namespace cv
 {
 namespace dnn
 {
-    //TODO: simultaneously convolution and bias addition for cache optimization
-    class ConvolutionLayer : public Layer
+    class ConvolutionLayer : public Layer, public ActivationFusible, public Quantizable, public WeightsSharing
     {
     protected:
         bool bias;
@@ -62,30 +64,71 @@ namespace dnn
         int topH, topW, topCn; //switched between inp/out on deconv/conv
         int inpGroupCn, outGroupCn;
         int ksize;
+        BlobShape wgtShape;
 
         bool useOpenCL;
         Mat colMat, biasOnesMat;
 
+        Mat colBatchMat;    //columns of several images for all groups
+        int colBatchNum;    //number of images processed by one batched multiplication
+
+        enum ConvAlgorithm
+        {
+            CONV_AUTO,
+            CONV_IM2COL,
+            CONV_WINOGRAD,      //F(2x2,3x3) or F(4x4,3x3) selected by the output size
+            CONV_WINOGRAD_2X2,
+            CONV_WINOGRAD_4X4,
+            CONV_FFT
+        };
+        int requestedAlgorithm; //specified by "conv_algorithm" parameter
+        int algorithm;          //selected for the current input shape
+        std::map<std::vector<int>, bool> algorithmAccuracy; //results of checkAlgorithmAccuracy() for (inpH, inpW, algorithm)
+        WinogradConvolution winograd;
+        FFTConvolution fft;
+
+        Ptr<ActivationFunction> activ; //fused activation applied to the outputs
+
+        QuantizedMatrix qWeights;   //weights with the reduced precision, replace blobs[0] if not empty
+        float inputScale;           //quantization step of the inputs for int8 weights, zero if it's computed for each image
+        Mat colInt8;                //transposed int8 columns of one image group
+
         inline bool is1x1() const;
+        inline bool isDirect1x1() const; //input can be used as columns matrix
         virtual void computeInpOutShape(const Blob &inpBlob);
-        void im2col(Blob &inpBlob, int imNum, int cnGroup);
+        int selectAlgorithm() const;
+        bool checkAlgorithmAccuracy();
+        virtual void allocateBuffers(int type, int maxNum);
+        void im2col(Blob &inpBlob, int imNum, int cnGroup, Mat &dstMat);
+        void im2colBatch(Blob &inpBlob, int imStart, int imCount);
+        void forwardInt8(Blob &inpBlob, Blob &outBlob);
+        void forwardDouble(Blob &inpBlob, Blob &outBlob, bool applyActivation = true);
+        void releaseBuffers();
 
     public:
         ConvolutionLayer() {}
         ConvolutionLayer(LayerParams &params);
         void allocate(const std::vector<Blob*> &inputs, std::vector<Blob> &outputs);
         void forward(std::vector<Blob*> &inputs, std::vector<Blob> &outputs);
+        bool setActivation(const Ptr<ActivationFunction> &activ);
+        bool quantize(int precision, float inputScale);
+        Ptr<Layer> createShared() const;
+        int64 getFLOPS(const std::vector<Blob*> &inputs, const std::vector<Blob> &outputs) const;
     };
 
     class DeConvolutionLayer : public ConvolutionLayer
     {
     protected:
         void computeInpOutShape(const Blob &inpBlob);
+        void allocateBuffers(int type, int maxNum);
         void col2im(Mat &dstMat);
 
     public:
         DeConvolutionLayer(LayerParams &params);
         void forward(std::vector<Blob*> &inputs, std::vector<Blob> &outputs);
+        bool setActivation(const Ptr<ActivationFunction> &activ);
+        bool quantize(int precision, float inputScale);
+        Ptr<Layer> createShared() const;
     };
 }
 }
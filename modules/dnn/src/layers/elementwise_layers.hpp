@@ -56,7 +56,7 @@ using std::tanh;
 using std::pow;
 
     template<typename Func>
-    class ElementWiseLayer : public Layer
+    class ElementWiseLayer : public Layer, public ActivationFunction
     {
         Func func;
     public:
@@ -96,6 +96,26 @@ using std::pow;
                 }
             }
         }
+
+        int64 getFLOPS(const std::vector<Blob*>&, const std::vector<Blob> &outputs) const
+        {
+            int64 flops = 0;
+            for (size_t i = 0; i < outputs.size(); i++)
+                flops += (int64)outputs[i].total();
+            return flops;
+        }
+
+        void apply(float *data, size_t size)
+        {
+            for (size_t j = 0; j < size; j++)
+                data[j] = func(data[j]);
+        }
+
+        void apply(double *data, size_t size)
+        {
+            for (size_t j = 0; j < size; j++)
+                data[j] = func(data[j]);
+        }
     };
 
 
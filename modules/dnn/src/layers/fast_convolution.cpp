@@ -0,0 +1,440 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "../precomp.hpp"
+#include "fast_convolution.hpp"
+
+namespace cv
+{
+namespace dnn
+{
+
+//transformation matrices of Winograd F(2x2, 3x3) and F(4x4, 3x3) algorithms
+static const float winogradBT2[] =
+{
+    1,  0, -1,  0,
+    0,  1,  1,  0,
+    0, -1,  1,  0,
+    0,  1,  0, -1
+};
+
+static const float winogradG2[] =
+{
+    1.f,  0.f, 0.f,
+    .5f,  .5f, .5f,
+    .5f, -.5f, .5f,
+    0.f,  0.f, 1.f
+};
+
+static const float winogradAT2[] =
+{
+    1, 1,  1,  0,
+    0, 1, -1, -1
+};
+
+static const float winogradBT4[] =
+{
+    4,  0, -5,  0, 1, 0,
+    0, -4, -4,  1, 1, 0,
+    0,  4, -4, -1, 1, 0,
+    0, -2, -1,  2, 1, 0,
+    0,  2, -1, -2, 1, 0,
+    0,  4,  0, -5, 0, 1
+};
+
+static const float winogradG4[] =
+{
+     1.f/4,       0.f,      0.f,
+    -1.f/6,  -1.f/6,  -1.f/6,
+    -1.f/6,   1.f/6,  -1.f/6,
+     1.f/24,  1.f/12,  1.f/6,
+     1.f/24, -1.f/12,  1.f/6,
+     0.f,       0.f,      1.f
+};
+
+static const float winogradAT4[] =
+{
+    1, 1,  1, 1,  1, 0,
+    0, 1, -1, 2, -2, 0,
+    0, 1,  1, 4,  4, 0,
+    0, 1, -1, 8, -8, 1
+};
+
+enum { WINOGRAD_MAX_ALPHA = 6 };
+
+//Y[p x p] = L[p x q] * X[q x q] * L^T
+static inline void transform2D(const float *L, int p, int q, const float *X, float *Y)
+{
+    float tmp[WINOGRAD_MAX_ALPHA * WINOGRAD_MAX_ALPHA];
+
+    for (int i = 0; i < p; i++)
+    {
+        for (int j = 0; j < q; j++)
+        {
+            float s = 0;
+            for (int k = 0; k < q; k++)
+                s += L[i*q + k] * X[k*q + j];
+            tmp[i*q + j] = s;
+        }
+    }
+
+    for (int i = 0; i < p; i++)
+    {
+        for (int j = 0; j < p; j++)
+        {
+            float s = 0;
+            for (int k = 0; k < q; k++)
+                s += tmp[i*q + k] * L[j*q + k];
+            Y[i*p + j] = s;
+        }
+    }
+}
+
+void WinogradConvolution::init(int tileSize, const Blob &weights, int group)
+{
+    CV_Assert(tileSize == 2 || tileSize == 4);
+    CV_Assert(weights.dims() == 4 && weights.rows() == 3 && weights.cols() == 3 && weights.type() == CV_32F);
+
+    const uchar *data = weights.matRefConst().data;
+    if (m == tileSize && weightsData == data)
+        return;
+
+    m = tileSize;
+    alpha = m + 2;
+    weightsData = data;
+
+    const float *G = (m == 2) ? winogradG2 : winogradG4;
+    int outCn = weights.num(), inpGroupCn = weights.channels();
+    int outGroupCn = outCn / group, area = alpha * alpha;
+    const float *wgt = (const float*)data;
+
+    //new buffer is allocated because the previous one may be shared with copies
+    trWeights = Mat(1, area * outCn * inpGroupCn, CV_32F);
+    float *trw = trWeights.ptr<float>();
+    float U[WINOGRAD_MAX_ALPHA * WINOGRAD_MAX_ALPHA];
+
+    for (int oc = 0; oc < outCn; oc++)
+    {
+        int g = oc / outGroupCn, ocg = oc % outGroupCn;
+
+        for (int ic = 0; ic < inpGroupCn; ic++)
+        {
+            transform2D(G, alpha, 3, wgt + ((size_t)oc * inpGroupCn + ic) * 9, U);
+
+            for (int xi = 0; xi < area; xi++)
+                trw[(((size_t)g * area + xi) * outGroupCn + ocg) * inpGroupCn + ic] = U[xi];
+        }
+    }
+}
+
+//Processes blocks of tiles, each block belongs to one image and one group.
+class WinogradInvoker : public ParallelLoopBody
+{
+public:
+    enum { BLOCK_TILES = 16 };
+
+    const float *inp, *trWeights, *bias;
+    float *out;
+    const float *BT, *AT;
+    ActivationFunction *activ;
+    int m, alpha;
+    int inpGroupCn, inpH, inpW, outGroupCn, outH, outW, padH, padW, group;
+    int tilesW, tilesNum, blocksNum;
+
+    int totalBlocks(int num) const
+    {
+        return num * group * blocksNum;
+    }
+
+    void operator()(const Range &range) const
+    {
+        int area = alpha * alpha;
+        AutoBuffer<float> buf((size_t)area * (inpGroupCn + outGroupCn) * BLOCK_TILES);
+        float *V = buf, *M = V + (size_t)area * inpGroupCn * BLOCK_TILES;
+        float d[WINOGRAD_MAX_ALPHA * WINOGRAD_MAX_ALPHA], tr[WINOGRAD_MAX_ALPHA * WINOGRAD_MAX_ALPHA];
+
+        for (int item = range.start; item < range.end; item++)
+        {
+            int block = item % blocksNum;
+            int g = (item / blocksNum) % group;
+            int n = item / (blocksNum * group);
+
+            int t0 = block * BLOCK_TILES, tn = std::min(tilesNum - t0, (int)BLOCK_TILES);
+            const float *inpBase = inp + ((size_t)n * group + g) * inpGroupCn * inpH * inpW;
+            float *outBase = out + ((size_t)n * group + g) * outGroupCn * outH * outW;
+            const float *U = trWeights + (size_t)g * area * outGroupCn * inpGroupCn;
+
+            //V[xi][ic][t] = BT * d * B
+            for (int t = 0; t < tn; t++)
+            {
+                int y0 = ((t0 + t) / tilesW) * m - padH, x0 = ((t0 + t) % tilesW) * m - padW;
+
+                for (int ic = 0; ic < inpGroupCn; ic++)
+                {
+                    const float *plane = inpBase + (size_t)ic * inpH * inpW;
+                    for (int i = 0; i < alpha; i++)
+                    {
+                        int y = y0 + i;
+                        for (int j = 0; j < alpha; j++)
+                        {
+                            int x = x0 + j;
+                            d[i*alpha + j] = (y >= 0 && y < inpH && x >= 0 && x < inpW) ? plane[y*inpW + x] : 0.f;
+                        }
+                    }
+
+                    transform2D(BT, alpha, alpha, d, tr);
+                    for (int xi = 0; xi < area; xi++)
+                        V[((size_t)xi * inpGroupCn + ic) * BLOCK_TILES + t] = tr[xi];
+                }
+            }
+
+            //M[xi] = U[xi] * V[xi]
+            for (int xi = 0; xi < area; xi++)
+            {
+                const float *Uxi = U + (size_t)xi * outGroupCn * inpGroupCn;
+                const float *Vxi = V + (size_t)xi * inpGroupCn * BLOCK_TILES;
+                float *Mxi = M + (size_t)xi * outGroupCn * BLOCK_TILES;
+
+                for (int oc = 0; oc < outGroupCn; oc++)
+                {
+                    float *mrow = Mxi + (size_t)oc * BLOCK_TILES;
+                    const float *urow = Uxi + (size_t)oc * inpGroupCn;
+
+                    for (int t = 0; t < tn; t++)
+                        mrow[t] = 0.f;
+
+                    for (int ic = 0; ic < inpGroupCn; ic++)
+                    {
+                        float u = urow[ic];
+                        const float *vrow = Vxi + (size_t)ic * BLOCK_TILES;
+                        for (int t = 0; t < tn; t++)
+                            mrow[t] += u * vrow[t];
+                    }
+                }
+            }
+
+            //Y = AT * M * A + bias
+            for (int oc = 0; oc < outGroupCn; oc++)
+            {
+                float b = (bias) ? bias[g * outGroupCn + oc] : 0.f;
+                float *plane = outBase + (size_t)oc * outH * outW;
+
+                for (int t = 0; t < tn; t++)
+                {
+                    for (int xi = 0; xi < area; xi++)
+                        d[xi] = M[((size_t)xi * outGroupCn + oc) * BLOCK_TILES + t];
+
+                    transform2D(AT, m, alpha, d, tr);
+                    for (int xi = 0; xi < m*m; xi++)
+                        tr[xi] += b;
+                    if (activ)
+                        activ->apply(tr, m*m);
+
+                    int y0 = ((t0 + t) / tilesW) * m, x0 = ((t0 + t) % tilesW) * m;
+                    int ym = std::min(m, outH - y0), xm = std::min(m, outW - x0);
+                    for (int i = 0; i < ym; i++)
+                    {
+                        for (int j = 0; j < xm; j++)
+                            plane[(y0 + i)*outW + x0 + j] = tr[i*m + j];
+                    }
+                }
+            }
+        }
+    }
+};
+
+void WinogradConvolution::run(const float *inp, int num, int inpCn, int inpH, int inpW,
+                              float *out, int outCn, int outH, int outW,
+                              const float *bias, int padH, int padW, int group, ActivationFunction *activ) const
+{
+    CV_Assert(m == 2 || m == 4);
+    CV_Assert(outH == inpH + 2 * padH - 2 && outW == inpW + 2 * padW - 2);
+
+    WinogradInvoker invoker;
+    invoker.inp = inp;
+    invoker.trWeights = trWeights.ptr<float>();
+    invoker.bias = bias;
+    invoker.out = out;
+    invoker.BT = (m == 2) ? winogradBT2 : winogradBT4;
+    invoker.AT = (m == 2) ? winogradAT2 : winogradAT4;
+    invoker.activ = activ;
+    invoker.m = m;
+    invoker.alpha = alpha;
+    invoker.inpGroupCn = inpCn / group;
+    invoker.inpH = inpH;
+    invoker.inpW = inpW;
+    invoker.outGroupCn = outCn / group;
+    invoker.outH = outH;
+    invoker.outW = outW;
+    invoker.padH = padH;
+    invoker.padW = padW;
+    invoker.group = group;
+    invoker.tilesW = (outW + m - 1) / m;
+    invoker.tilesNum = invoker.tilesW * ((outH + m - 1) / m);
+    invoker.blocksNum = (invoker.tilesNum + WinogradInvoker::BLOCK_TILES - 1) / WinogradInvoker::BLOCK_TILES;
+
+    parallel_for_(Range(0, invoker.totalBlocks(num)), invoker);
+}
+
+void FFTConvolution::init(const Blob &weights, int inpH, int inpW, int padH, int padW)
+{
+    CV_Assert(weights.dims() == 4 && weights.type() == CV_32F);
+
+    const uchar *data = weights.matRefConst().data;
+    Size padded(inpW + 2 * padW, inpH + 2 * padH);
+    if (weightsData == data && paddedSize == padded)
+        return;
+
+    weightsData = data;
+    paddedSize = padded;
+    dftSize = Size(getOptimalDFTSize(padded.width), getOptimalDFTSize(padded.height));
+
+    int outCn = weights.num(), inpGroupCn = weights.channels();
+    int kerH = weights.rows(), kerW = weights.cols();
+    const float *wgt = (const float*)data;
+
+    //new spectra are allocated because the previous ones may be shared with copies
+    kerSpectra.assign((size_t)outCn * inpGroupCn, Mat());
+    Mat ker = Mat::zeros(dftSize, CV_32F);
+    for (size_t i = 0; i < kerSpectra.size(); i++)
+    {
+        Mat(kerH, kerW, CV_32F, (void*)(wgt + i * kerH * kerW)).copyTo(ker(Rect(0, 0, kerW, kerH)));
+        dft(ker, kerSpectra[i]);
+    }
+}
+
+//computes spectra of the padded input planes
+class FFTInputInvoker : public ParallelLoopBody
+{
+public:
+    const float *inp;
+    int inpH, inpW, padH, padW;
+    Size dftSize;
+    Mat *spectra;
+
+    void operator()(const Range &range) const
+    {
+        Mat padded(dftSize, CV_32F);
+
+        for (int ic = range.start; ic < range.end; ic++)
+        {
+            padded.setTo(Scalar::all(0));
+            Mat(inpH, inpW, CV_32F, (void*)(inp + (size_t)ic * inpH * inpW)).copyTo(padded(Rect(padW, padH, inpW, inpH)));
+            dft(padded, spectra[ic]);
+        }
+    }
+};
+
+//accumulates correlations of the input planes with the kernels of each output channel
+class FFTOutputInvoker : public ParallelLoopBody
+{
+public:
+    const Mat *inpSpectra, *kerSpectra;
+    const float *bias;
+    float *out;
+    ActivationFunction *activ;
+    int inpGroupCn, outGroupCn, outCnOffset, outH, outW;
+
+    void operator()(const Range &range) const
+    {
+        Mat acc, prod, res;
+
+        for (int oc = range.start; oc < range.end; oc++)
+        {
+            acc = Mat::zeros(inpSpectra[0].size(), CV_32F);
+            for (int ic = 0; ic < inpGroupCn; ic++)
+            {
+                mulSpectrums(inpSpectra[ic], kerSpectra[(size_t)(outCnOffset + oc) * inpGroupCn + ic], prod, 0, true);
+                acc += prod;
+            }
+
+            idft(acc, res, DFT_SCALE | DFT_REAL_OUTPUT);
+
+            Mat dst(outH, outW, CV_32F, out + (size_t)oc * outH * outW);
+            double b = (bias) ? bias[outCnOffset + oc] : 0.;
+            res(Rect(0, 0, outW, outH)).convertTo(dst, CV_32F, 1, b);
+            if (activ)
+                activ->apply(dst.ptr<float>(), dst.total());
+        }
+    }
+};
+
+void FFTConvolution::run(Blob &inpBlob, Blob &outBlob, const float *bias, int padH, int padW, int group,
+                         ActivationFunction *activ) const
+{
+    int inpGroupCn = inpBlob.channels() / group, outGroupCn = outBlob.channels() / group;
+    CV_Assert(kerSpectra.size() == (size_t)outBlob.channels() * inpGroupCn);
+    CV_Assert(paddedSize == Size(inpBlob.cols() + 2 * padW, inpBlob.rows() + 2 * padH));
+
+    std::vector<Mat> inpSpectra(inpGroupCn);
+
+    for (int n = 0; n < inpBlob.num(); n++)
+    {
+        for (int g = 0; g < group; g++)
+        {
+            FFTInputInvoker inpInvoker;
+            inpInvoker.inp = inpBlob.ptrf(n, g * inpGroupCn);
+            inpInvoker.inpH = inpBlob.rows();
+            inpInvoker.inpW = inpBlob.cols();
+            inpInvoker.padH = padH;
+            inpInvoker.padW = padW;
+            inpInvoker.dftSize = dftSize;
+            inpInvoker.spectra = &inpSpectra[0];
+            parallel_for_(Range(0, inpGroupCn), inpInvoker);
+
+            FFTOutputInvoker outInvoker;
+            outInvoker.inpSpectra = &inpSpectra[0];
+            outInvoker.kerSpectra = &kerSpectra[0];
+            outInvoker.bias = bias;
+            outInvoker.activ = activ;
+            outInvoker.out = outBlob.ptrf(n, g * outGroupCn);
+            outInvoker.inpGroupCn = inpGroupCn;
+            outInvoker.outGroupCn = outGroupCn;
+            outInvoker.outCnOffset = g * outGroupCn;
+            outInvoker.outH = outBlob.rows();
+            outInvoker.outW = outBlob.cols();
+            parallel_for_(Range(0, outGroupCn), outInvoker);
+        }
+    }
+}
+
+}
+}
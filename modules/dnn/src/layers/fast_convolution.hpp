@@ -0,0 +1,98 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#ifndef __OPENCV_DNN_LAYERS_FAST_CONVOLUTION_HPP__
+#define __OPENCV_DNN_LAYERS_FAST_CONVOLUTION_HPP__
+#include "../precomp.hpp"
+#include "layers_common.hpp"
+
+namespace cv
+{
+namespace dnn
+{
+
+/** Winograd minimal filtering F(m x m, 3 x 3) for 3x3 convolutions with unit stride, m = 2 or m = 4.
+ *  Weights are transformed once by init(), each input tile of (m+2)x(m+2) pixels is transformed
+ *  and multiplied with the transformed weights, the result is transformed back into m x m output pixels.
+ *  Copies of the object share the transformed weights.
+ */
+class WinogradConvolution
+{
+public:
+    WinogradConvolution() : m(0), alpha(0), weightsData(NULL) {}
+
+    //transforms weights [outCn x inpCn/group x 3 x 3], if it wasn't done for them
+    void init(int tileSize, const Blob &weights, int group);
+
+    void run(const float *inp, int num, int inpCn, int inpH, int inpW,
+             float *out, int outCn, int outH, int outW,
+             const float *bias, int padH, int padW, int group, ActivationFunction *activ = NULL) const;
+
+private:
+    int m, alpha;
+    const uchar *weightsData;
+    Mat trWeights; //[group][alpha*alpha][outGroupCn][inpGroupCn]
+};
+
+/** Convolution with unit stride via products of spectra computed by DFT, suitable for large kernels.
+ *  Copies of the object share the spectra of the weights.
+ */
+class FFTConvolution
+{
+public:
+    FFTConvolution() : weightsData(NULL) {}
+
+    //computes spectra of the weights for the specified size of padded input, if it wasn't done for them
+    void init(const Blob &weights, int inpH, int inpW, int padH, int padW);
+
+    void run(Blob &inpBlob, Blob &outBlob, const float *bias, int padH, int padW, int group,
+             ActivationFunction *activ = NULL) const;
+
+private:
+    Size paddedSize, dftSize;
+    const uchar *weightsData;
+    std::vector<Mat> kerSpectra; //[outCn][inpCn/group]
+};
+
+}
+}
+
+#endif
@@ -56,6 +56,9 @@ namespace dnn
         CV_Assert(blobs.size() == (bias ? 2U : 1U));
         CV_Assert(blobs[0].dims() >= 2 && blobs[0].total() >= (size_t)numOutputs);
         CV_Assert(!bias || blobs[1].total() == (size_t)numOutputs);
+
+        wgtTotal = blobs[0].total();
+        inputScale = 0;
     }
 
     void FullyConnectedLayer::allocate(const std::vector<Blob*> &input, std::vector<Blob> &output)
@@ -65,8 +68,8 @@ namespace dnn
         axis = input[0]->canonicalAxis(axis_);
         innerSize = (int)input[0]->total(axis);
 
-        CV_Assert((size_t)innerSize * (size_t)numOutputs == blobs[0].total());
-        CV_Assert(blobs[0].size(-2) == numOutputs && blobs[0].size(-1) == innerSize);
+        CV_Assert((size_t)innerSize * (size_t)numOutputs == wgtTotal);
+        CV_Assert(!qWeights.empty() || (blobs[0].size(-2) == numOutputs && blobs[0].size(-1) == innerSize));
 
         output.resize(input.size());
         for (size_t i = 0; i < input.size(); i++)
@@ -96,11 +99,18 @@ namespace dnn
             int K = innerSize;
 
             Mat srcMat(M, K, input[i]->type(), input[i]->ptrf());
-            Mat weight(N, K, blobs[0].type(), blobs[0].ptrf());
             Mat dstMat(M, N, output[i].type(), output[i].ptrf());
 
-            //important: Caffe stores weights as transposed array
-            cv::gemm(srcMat, weight, 1, noArray(), 0, dstMat, GEMM_2_T);
+            if (!qWeights.empty())
+            {
+                multiplyQuantized(srcMat, dstMat);
+            }
+            else
+            {
+                //important: Caffe stores weights as transposed array
+                Mat weight(N, K, blobs[0].type(), blobs[0].ptrf());
+                cv::gemm(srcMat, weight, 1, noArray(), 0, dstMat, GEMM_2_T);
+            }
 
             if (bias)
             {
@@ -108,7 +118,112 @@ namespace dnn
                 Mat biasMat(1, N, CV_32F, blobs[1].ptrf());
                 cv::gemm(biasOnesMat, biasMat, 1, dstMat, 1, dstMat);
             }
+
+            if (activ)
+            {
+                for (int r = 0; r < M; r++)
+                    activ->apply(dstMat.ptr<float>(r), N);
+            }
+        }
+    }
+
+    int64 FullyConnectedLayer::getFLOPS(const std::vector<Blob*> &input, const std::vector<Blob>&) const
+    {
+        int64 flops = 0;
+        for (size_t i = 0; i < input.size(); i++)
+            flops += (int64)input[i]->total(0, axis) * numOutputs * (2 * innerSize + (bias ? 1 : 0));
+        return flops;
+    }
+
+    //Multiplies int8 inputs by int8 weights, each row of weights is loaded once for all input rows.
+    class FullyConnectedInt8Invoker : public ParallelLoopBody
+    {
+    public:
+        const QuantizedMatrix *wgt;
+        const schar *src;
+        const float *srcScales;
+        float *dst;
+        int M, N, K;
+
+        void operator()(const Range &range) const
+        {
+            for (int n = range.start; n < range.end; n++)
+            {
+                const schar *w = wgt->int8Row(n);
+                float scale = wgt->scales[n];
+                for (int m = 0; m < M; m++)
+                    dst[(size_t)m * N + n] = dotInt8(src + (size_t)m * K, w, K) * srcScales[m] * scale;
+            }
+        }
+    };
+
+    //number of fp16 weights rows converted to float at once
+    static const int FP16_BLOCK_ROWS = 64;
+
+    void FullyConnectedLayer::multiplyQuantized(const Mat &srcMat, Mat &dstMat)
+    {
+        int M = srcMat.rows, N = numOutputs, K = innerSize;
+
+        if (qWeights.precision == Net::PRECISION_FP16)
+        {
+            Mat weight(std::min(N, FP16_BLOCK_ROWS), K, CV_32F);
+            for (int r0 = 0; r0 < N; r0 += FP16_BLOCK_ROWS)
+            {
+                int r1 = std::min(N, r0 + FP16_BLOCK_ROWS);
+                qWeights.getRows(r0, r1, weight.ptr<float>());
+
+                Mat dstCols = dstMat.colRange(r0, r1);
+                cv::gemm(srcMat, weight.rowRange(0, r1 - r0), 1, noArray(), 0, dstCols, GEMM_2_T);
+            }
+            return;
         }
+
+        Mat srcInt8(M, K, CV_8S);
+        std::vector<float> srcScales(M);
+        for (int m = 0; m < M; m++)
+        {
+            srcScales[m] = (inputScale > 0) ? inputScale : int8Scale(norm(srcMat.row(m), NORM_INF));
+            quantizeInt8(srcMat.ptr<float>(m), K, srcScales[m], srcInt8.ptr<schar>(m));
+        }
+
+        FullyConnectedInt8Invoker invoker;
+        invoker.wgt = &qWeights;
+        invoker.src = srcInt8.ptr<schar>();
+        invoker.srcScales = &srcScales[0];
+        invoker.dst = dstMat.ptr<float>();
+        invoker.M = M;
+        invoker.N = N;
+        invoker.K = K;
+        parallel_for_(Range(0, N), invoker);
+    }
+
+    bool FullyConnectedLayer::quantize(int precision, float _inputScale)
+    {
+        if (precision == Net::PRECISION_FP32)
+            return qWeights.empty();
+        if (!qWeights.empty())
+            return qWeights.precision == precision;
+
+        qWeights.create(Mat(numOutputs, (int)(wgtTotal / numOutputs), CV_32F, blobs[0].ptrf()), precision);
+        inputScale = _inputScale;
+
+        //original weights aren't needed anymore, the parameter refers to the quantized ones
+        blobs[0].matRef() = qWeights.data;
+        return true;
+    }
+
+    bool FullyConnectedLayer::setActivation(const Ptr<ActivationFunction> &_activ)
+    {
+        activ = _activ;
+        return true;
+    }
+
+    Ptr<Layer> FullyConnectedLayer::createShared() const
+    {
+        //the layer has no buffers, so copies differ only by the fused activation
+        Ptr<FullyConnectedLayer> layer(new FullyConnectedLayer(*this));
+        layer->activ.release();
+        return layer;
     }
 }
 }
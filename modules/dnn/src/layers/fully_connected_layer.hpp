@@ -42,12 +42,14 @@
 #ifndef __OPENCV_DNN_LAYERS_FULLY_CONNECTED_LAYER_HPP__
 #define __OPENCV_DNN_LAYERS_FULLY_CONNECTED_LAYER_HPP__
 #include "../precomp.hpp"
+#include "layers_common.hpp"
+#include "quantization.hpp"
 
 namespace cv
 {
 namespace dnn
 {
-    class FullyConnectedLayer : public Layer
+    class FullyConnectedLayer : public Layer, public ActivationFusible, public Quantizable, public WeightsSharing
     {
         bool bias;
         int numOutputs;
@@ -55,12 +57,24 @@ namespace dnn
 
         int innerSize;
 
+        Ptr<ActivationFunction> activ; //fused activation applied to the outputs
+
+        QuantizedMatrix qWeights;   //weights with the reduced precision, replace blobs[0] if not empty
+        float inputScale;           //quantization step of the inputs for int8 weights, zero if it's computed for each row
+        size_t wgtTotal;
+
+        void multiplyQuantized(const Mat &srcMat, Mat &dstMat);
+
         void reshape(const Blob &inp, Blob &out);
 
     public:
         FullyConnectedLayer(LayerParams &params);
         void allocate(const std::vector<Blob*> &input, std::vector<Blob> &output);
         void forward(std::vector<Blob*> &inputs, std::vector<Blob> &outputs);
+        bool setActivation(const Ptr<ActivationFunction> &activ);
+        bool quantize(int precision, float inputScale);
+        Ptr<Layer> createShared() const;
+        int64 getFLOPS(const std::vector<Blob*> &inputs, const std::vector<Blob> &outputs) const;
     };
 }
 }
@@ -50,6 +50,44 @@ namespace dnn
 
 void getKernelParams(LayerParams &params, int &kernelH, int &kernelW, int &padH, int &padW, int &strideH, int &strideW);
 
+//Elementwise function which can be applied inplace by the preceding layer to its outputs.
+class ActivationFunction
+{
+public:
+    virtual ~ActivationFunction() {}
+    virtual void apply(float *data, size_t size) = 0;
+    virtual void apply(double *data, size_t size) = 0;
+};
+
+//Layer which can apply an activation to parts of its outputs while they are still in cache.
+class ActivationFusible
+{
+public:
+    virtual ~ActivationFusible() {}
+    //returns false if the activation can't be applied by the layer, empty pointer removes the fused activation
+    virtual bool setActivation(const Ptr<ActivationFunction> &activ) = 0;
+};
+
+//Layer which can store its weights and compute with the reduced precision, see Net::quantize().
+class Quantizable
+{
+public:
+    virtual ~Quantizable() {}
+    //inputScale is the quantization step of the inputs for int8 precision, zero means computing it for each input;
+    //returns false if the precision isn't supported by the layer
+    virtual bool quantize(int precision, float inputScale) = 0;
+};
+
+//Layer with data derived from its learned parameters (transformed or quantized weights),
+//which is shared by the execution contexts of the net, see Net::createContext().
+class WeightsSharing
+{
+public:
+    virtual ~WeightsSharing() {}
+    //returns the new instance of the layer sharing the weights and the derived data, but owning its buffers
+    virtual Ptr<Layer> createShared() const = 0;
+};
+
 }
 }
 
@@ -160,5 +160,15 @@ namespace dnn
         }
     }
 
+    int64 LRNLayer::getFLOPS(const std::vector<Blob*>&, const std::vector<Blob> &outputs) const
+    {
+        //squares summation over the window, scaling and power
+        int64 window = (type == CHANNEL_NRM) ? size : size * size;
+        int64 flops = 0;
+        for (size_t i = 0; i < outputs.size(); i++)
+            flops += (int64)outputs[i].total() * (2 * window + 4);
+        return flops;
+    }
+
 }
 }
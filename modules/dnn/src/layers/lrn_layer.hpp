@@ -69,6 +69,7 @@ namespace dnn
         LRNLayer(LayerParams &params);
         void allocate(const std::vector<Blob*> &inputs, std::vector<Blob> &outputs);
         void forward(std::vector<Blob*> &inputs, std::vector<Blob> &outputs);
+        int64 getFLOPS(const std::vector<Blob*> &inputs, const std::vector<Blob> &outputs) const;
     };
 }
 }
@@ -203,5 +203,13 @@ namespace dnn
             CV_Assert((outW - 1) * strideW < inW + padW);
         }
     }
+
+    int64 PoolingLayer::getFLOPS(const std::vector<Blob*>&, const std::vector<Blob> &outputs) const
+    {
+        int64 flops = 0;
+        for (size_t i = 0; i < outputs.size(); i++)
+            flops += (int64)outputs[i].total() * kernelH * kernelW;
+        return flops;
+    }
 }
 }
@@ -0,0 +1,200 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "../precomp.hpp"
+#include "quantization.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+
+namespace cv
+{
+namespace dnn
+{
+
+static ushort floatToHalf(float value)
+{
+    union { float f; unsigned u; } v;
+    v.f = value;
+
+    unsigned sign = (v.u >> 16) & 0x8000;
+    int exponent = (int)((v.u >> 23) & 0xff) - 127 + 15;
+    unsigned mantissa = v.u & 0x7fffff;
+
+    if (((v.u >> 23) & 0xff) == 0xff) //Inf and NaN
+        return (ushort)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    if (exponent >= 31) //overflow
+        return (ushort)(sign | 0x7c00);
+    if (exponent <= 0) //subnormal or zero
+    {
+        if (exponent < -10)
+            return (ushort)sign;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        unsigned half = mantissa >> shift;
+        unsigned rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return (ushort)(sign | half);
+    }
+
+    unsigned half = sign | ((unsigned)exponent << 10) | (mantissa >> 13);
+    unsigned rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++; //carry to the exponent is correct rounding
+    return (ushort)half;
+}
+
+static float halfToFloat(ushort value)
+{
+    union { float f; unsigned u; } v;
+    unsigned sign = (unsigned)(value & 0x8000) << 16;
+    int exponent = (value >> 10) & 0x1f;
+    unsigned mantissa = value & 0x3ff;
+
+    if (exponent == 0)
+    {
+        //zero or subnormal
+        v.f = mantissa * (1.f / (1 << 24));
+        v.u |= sign;
+        return v.f;
+    }
+
+    if (exponent == 31)
+        v.u = sign | 0x7f800000 | (mantissa << 13);
+    else
+        v.u = sign | ((unsigned)(exponent - 15 + 127) << 23) | (mantissa << 13);
+    return v.f;
+}
+
+void QuantizedMatrix::create(const Mat &src, int _precision)
+{
+    CV_Assert(src.dims == 2 && src.type() == CV_32F && src.isContinuous());
+    CV_Assert(_precision == Net::PRECISION_FP16 || _precision == Net::PRECISION_INT8);
+
+    precision = _precision;
+    rows = src.rows;
+    cols = src.cols;
+
+    if (precision == Net::PRECISION_FP16)
+    {
+        data.create(rows, cols, CV_16U);
+        scales.clear();
+        for (int r = 0; r < rows; r++)
+        {
+            const float *srcRow = src.ptr<float>(r);
+            ushort *dstRow = data.ptr<ushort>(r);
+            for (int c = 0; c < cols; c++)
+                dstRow[c] = floatToHalf(srcRow[c]);
+        }
+    }
+    else
+    {
+        data.create(rows, cols, CV_8S);
+        scales.resize(rows);
+        for (int r = 0; r < rows; r++)
+        {
+            scales[r] = int8Scale(norm(src.row(r), NORM_INF));
+            quantizeInt8(src.ptr<float>(r), cols, scales[r], data.ptr<schar>(r));
+        }
+    }
+}
+
+void QuantizedMatrix::getRows(int r0, int r1, float *dst) const
+{
+    CV_Assert(0 <= r0 && r0 <= r1 && r1 <= rows);
+
+    for (int r = r0; r < r1; r++, dst += cols)
+    {
+        if (precision == Net::PRECISION_FP16)
+        {
+            const ushort *srcRow = data.ptr<ushort>(r);
+            for (int c = 0; c < cols; c++)
+                dst[c] = halfToFloat(srcRow[c]);
+        }
+        else
+        {
+            const schar *srcRow = data.ptr<schar>(r);
+            float scale = scales[r];
+            for (int c = 0; c < cols; c++)
+                dst[c] = srcRow[c] * scale;
+        }
+    }
+}
+
+void quantizeInt8(const float *src, int size, float scale, schar *dst)
+{
+    float invScale = 1.f / scale;
+    for (int i = 0; i < size; i++)
+        dst[i] = saturate_cast<schar>(src[i] * invScale);
+}
+
+void quantizeInt8Transposed(const float *src, size_t srcStep, int rows, int cols, float scale, schar *dst, size_t dstStep)
+{
+    float invScale = 1.f / scale;
+    for (int r = 0; r < rows; r++)
+    {
+        const float *srcRow = src + r * srcStep;
+        for (int c = 0; c < cols; c++)
+            dst[c * dstStep + r] = saturate_cast<schar>(srcRow[c] * invScale);
+    }
+}
+
+int dotInt8(const schar *a, const schar *b, int size)
+{
+    int i = 0, sum = 0;
+#if CV_SIMD128
+    //products of values widened to 16 bits are pairwise summed into 32-bit lanes
+    v_int32x4 s0 = v_setzero_s32(), s1 = v_setzero_s32();
+    for (; i <= size - 16; i += 16)
+    {
+        s0 += v_dotprod(v_load_expand(a + i), v_load_expand(b + i));
+        s1 += v_dotprod(v_load_expand(a + i + 8), v_load_expand(b + i + 8));
+    }
+    for (; i <= size - 8; i += 8)
+        s0 += v_dotprod(v_load_expand(a + i), v_load_expand(b + i));
+    sum = v_reduce_sum(s0 + s1);
+#endif
+    for (; i < size; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+}
+}
@@ -0,0 +1,91 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#ifndef __OPENCV_DNN_LAYERS_QUANTIZATION_HPP__
+#define __OPENCV_DNN_LAYERS_QUANTIZATION_HPP__
+#include "../precomp.hpp"
+
+namespace cv
+{
+namespace dnn
+{
+
+/** Matrix of weights [rows x cols] stored with the reduced precision.
+ *  Int8 values are symmetrically quantized with the separate scale for each row (i. e. for each output channel),
+ *  fp16 values are stored as IEEE 754 half precision numbers.
+ */
+class QuantizedMatrix
+{
+public:
+    QuantizedMatrix() : precision(Net::PRECISION_FP32), rows(0), cols(0) {}
+
+    void create(const Mat &src, int precision);
+    bool empty() const { return data.empty(); }
+
+    //converts rows [r0, r1) to float, for int8 values are dequantized by the row scales
+    void getRows(int r0, int r1, float *dst) const;
+
+    const schar *int8Row(int r) const { return data.ptr<schar>(r); }
+
+    int precision, rows, cols;
+    Mat data;                   //CV_16U for fp16, CV_8S for int8
+    std::vector<float> scales;  //quantization step of each row for int8
+};
+
+//dst[i] = saturate(round(src[i] / scale))
+void quantizeInt8(const float *src, int size, float scale, schar *dst);
+
+//quantizes matrix [rows x cols] and stores it transposed: dst[c * dstStep + r] = quantized src[r * srcStep + c]
+void quantizeInt8Transposed(const float *src, size_t srcStep, int rows, int cols, float scale, schar *dst, size_t dstStep);
+
+//dot product of int8 vectors with 32-bit accumulation
+int dotInt8(const schar *a, const schar *b, int size);
+
+//quantization step which maps [-maxAbs, maxAbs] to [-127, 127]
+inline float int8Scale(double maxAbs)
+{
+    return (maxAbs > 0) ? (float)(maxAbs / 127) : 1.f;
+}
+
+}
+}
+
+#endif
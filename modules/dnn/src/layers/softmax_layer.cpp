@@ -140,5 +140,14 @@ namespace dnn
         }
     }
 
+    int64 SoftMaxLayer::getFLOPS(const std::vector<Blob*>&, const std::vector<Blob> &outputs) const
+    {
+        //max, subtraction, exponent, sum and division for each element
+        int64 flops = 0;
+        for (size_t i = 0; i < outputs.size(); i++)
+            flops += (int64)outputs[i].total() * 5;
+        return flops;
+    }
+
 }
 }
@@ -76,7 +76,11 @@ void SplitLayer::allocate(const std::vector<Blob*> &inputs, std::vector<Blob> &o
 void SplitLayer::forward(std::vector<Blob*> &inputs, std::vector<Blob> &outputs)
 {
     for (size_t i = 0; i < outputs.size(); i++)
-        inputs[0]->matRefConst().copyTo(outputs[i].matRef());
+    {
+        //output could share data with the input (see memory planning in Net)
+        if (outputs[i].matRefConst().data != inputs[0]->matRefConst().data)
+            inputs[0]->matRefConst().copyTo(outputs[i].matRef());
+    }
 }
 
 }
@@ -56,7 +56,7 @@ static String _tf(TString filename)
     return (getOpenCVExtraDir() + "/dnn/layers/") + filename;
 }
 
-static void testLayer(String basename, bool useCaffeModel = false, bool useCommonInputBlob = true)
+static void testLayer(String basename, bool useCaffeModel = false, bool useCommonInputBlob = true, bool mapCaffeModel = false)
 {
     String prototxt = _tf(basename + ".prototxt");
     String caffemodel = _tf(basename + ".caffemodel");
@@ -66,7 +66,7 @@ static void testLayer(String basename, bool useCaffeModel = false, bool useCommo
 
     Net net;
     {
-        Ptr<Importer> importer = createCaffeImporter(prototxt, (useCaffeModel) ? caffemodel : String());
+        Ptr<Importer> importer = createCaffeImporter(prototxt, (useCaffeModel) ? caffemodel : String(), mapCaffeModel);
         ASSERT_TRUE(importer != NULL);
         importer->populateNet(net);
     }
@@ -101,6 +101,11 @@ TEST(Layer_Test_Convolution, Accuracy)
      testLayer("layer_convolution", true);
 }
 
+TEST(Layer_Test_Convolution, MappedModel)
+{
+     testLayer("layer_convolution", true, true, true);
+}
+
 //TODO: move this test into separate file
 TEST(Layer_Test_Convolution, AccuracyOCL)
 {
@@ -112,11 +117,238 @@ TEST(Layer_Test_Convolution, AccuracyOCL)
     }
 }
 
+static void convolutionRef(Blob &inp, Blob &wgt, Blob &bias, int stride, int pad, int group, Blob &out)
+{
+    int outCn = wgt.num(), inpGroupCn = wgt.channels(), kernel = wgt.rows();
+    int outGroupCn = outCn / group;
+    int outH = (inp.rows() + 2 * pad - kernel) / stride + 1;
+    int outW = (inp.cols() + 2 * pad - kernel) / stride + 1;
+    out.create(BlobShape(inp.num(), outCn, outH, outW));
+
+    for (int n = 0; n < inp.num(); n++)
+    for (int oc = 0; oc < outCn; oc++)
+    for (int y = 0; y < outH; y++)
+    for (int x = 0; x < outW; x++)
+    {
+        int g = oc / outGroupCn;
+        float sum = bias.ptrf()[oc];
+
+        for (int ic = 0; ic < inpGroupCn; ic++)
+        for (int ky = 0; ky < kernel; ky++)
+        for (int kx = 0; kx < kernel; kx++)
+        {
+            int iy = y * stride - pad + ky, ix = x * stride - pad + kx;
+            if (iy >= 0 && iy < inp.rows() && ix >= 0 && ix < inp.cols())
+                sum += wgt.ptrf(oc, ic, ky, kx)[0] * inp.ptrf(n, g * inpGroupCn + ic, iy, ix)[0];
+        }
+
+        out.ptrf(n, oc, y, x)[0] = sum;
+    }
+}
+
+TEST(Layer_Test_Convolution, BatchedGroups)
+{
+    //batch, inpCn, size, outCn, kernel, stride, pad, group
+    const int configs[][8] =
+    {
+        {3, 4, 7, 6, 3, 1, 1, 2},
+        {2, 8, 5, 4, 1, 1, 0, 1},
+        {2, 8, 5, 4, 1, 2, 0, 2},
+        {2, 3, 9, 5, 5, 2, 2, 1},
+        {1, 6, 6, 70, 3, 1, 1, 1},
+    };
+    RNG rng(0);
+
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++)
+    {
+        const int *c = configs[i];
+
+        LayerParams params;
+        params.set("num_output", c[3]);
+        params.set("kernel_size", c[4]);
+        params.set("stride", c[5]);
+        params.set("pad", c[6]);
+        params.set("group", c[7]);
+
+        Blob wgt(BlobShape(c[3], c[1] / c[7], c[4], c[4])), bias(BlobShape(1, c[3], 1, 1));
+        rng.fill(wgt.matRef(), RNG::UNIFORM, -1, 1);
+        rng.fill(bias.matRef(), RNG::UNIFORM, -1, 1);
+        params.blobs.push_back(wgt);
+        params.blobs.push_back(bias);
+
+        Blob inp(BlobShape(c[0], c[1], c[2], c[2]));
+        rng.fill(inp.matRef(), RNG::UNIFORM, -1, 1);
+        std::vector<Blob*> inpVec(1, &inp);
+        std::vector<Blob> outVec;
+
+        Ptr<Layer> layer = LayerFactory::createLayerInstance("Convolution", params);
+        layer->allocate(inpVec, outVec);
+        layer->forward(inpVec, outVec);
+
+        Blob ref;
+        convolutionRef(inp, wgt, bias, c[5], c[6], c[7], ref);
+        normAssert(ref, outVec[0]);
+    }
+}
+
+TEST(Layer_Test_Convolution, DoublePrecision)
+{
+    //batch, inpCn, size, outCn, kernel, stride, pad, group
+    const int configs[][8] =
+    {
+        {2, 4, 7, 6, 3, 1, 1, 2},
+        {2, 8, 5, 4, 1, 1, 0, 1},
+    };
+    RNG rng(0);
+
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++)
+    {
+        const int *c = configs[i];
+
+        LayerParams params;
+        params.set("num_output", c[3]);
+        params.set("kernel_size", c[4]);
+        params.set("stride", c[5]);
+        params.set("pad", c[6]);
+        params.set("group", c[7]);
+
+        Blob wgt(BlobShape(c[3], c[1] / c[7], c[4], c[4])), bias(BlobShape(1, c[3], 1, 1));
+        rng.fill(wgt.matRef(), RNG::UNIFORM, -1, 1);
+        rng.fill(bias.matRef(), RNG::UNIFORM, -1, 1);
+        params.blobs.push_back(wgt);
+        params.blobs.push_back(bias);
+
+        Blob inp(BlobShape(c[0], c[1], c[2], c[2]));
+        rng.fill(inp.matRef(), RNG::UNIFORM, -1, 1);
+        Blob inp64(inp.shape(), CV_64F);
+        inp.matRefConst().convertTo(inp64.matRef(), CV_64F);
+        std::vector<Blob*> inpVec(1, &inp64);
+        std::vector<Blob> outVec;
+
+        Ptr<Layer> layer = LayerFactory::createLayerInstance("Convolution", params);
+        layer->allocate(inpVec, outVec);
+        layer->forward(inpVec, outVec);
+        ASSERT_EQ(CV_64F, outVec[0].type());
+
+        Blob ref, out(outVec[0].shape());
+        convolutionRef(inp, wgt, bias, c[5], c[6], c[7], ref);
+        outVec[0].matRefConst().convertTo(out.matRef(), CV_32F);
+        normAssert(ref, out);
+    }
+
+    //fused activations keep the double precision: data -> conv1 -> relu1 -> conv2 -> tanh2
+    Net nets[2];
+    for (int i = 0; i < 2; i++)
+    {
+        RNG wgtRng(1);
+        nets[i].setNetInputs(std::vector<String>(1, "data"));
+        const char *names[] = {"conv1", "conv2"}, *activs[] = {"ReLU", "TanH"}, *activNames[] = {"relu1", "tanh2"};
+        for (int l = 0; l < 2; l++)
+        {
+            LayerParams params;
+            params.set("num_output", 4);
+            params.set("kernel_size", 3);
+            params.set("pad", 1);
+            Blob wgt(BlobShape(4, 4, 3, 3)), bias(BlobShape(1, 4, 1, 1));
+            wgtRng.fill(wgt.matRef(), RNG::UNIFORM, -1, 1);
+            wgtRng.fill(bias.matRef(), RNG::UNIFORM, -1, 1);
+            params.blobs.push_back(wgt);
+            params.blobs.push_back(bias);
+
+            LayerParams activParams;
+            nets[i].addLayer(names[l], "Convolution", params);
+            nets[i].addLayer(activNames[l], activs[l], activParams);
+            nets[i].connect((l == 0) ? ".data" : "relu1", names[l]);
+            nets[i].connect(names[l], activNames[l]);
+        }
+        nets[i].setLayerFusion(i == 1);
+    }
+
+    Blob inp64(BlobShape(2, 4, 6, 6), CV_64F);
+    rng.fill(inp64.matRef(), RNG::UNIFORM, -1, 1);
+    for (int i = 0; i < 2; i++)
+    {
+        nets[i].setBlob(".data", inp64);
+        nets[i].forward();
+    }
+    Blob ref = nets[0].getBlob("tanh2"), out = nets[1].getBlob("tanh2");
+    ASSERT_EQ(CV_64F, out.type());
+    EXPECT_LE(cvtest::norm(ref.matRefConst(), out.matRefConst(), NORM_INF), 1e-12);
+}
+
+TEST(Layer_Test_Convolution, FastAlgorithms)
+{
+    struct Config
+    {
+        const char *algorithm;
+        int batch, inpCn, height, width, outCn, kernel, pad, group;
+    };
+    const Config configs[] =
+    {
+        {"winograd_2x2", 2, 8, 7, 9, 6, 3, 1, 1},
+        {"winograd_2x2", 1, 8, 6, 6, 8, 3, 0, 2},
+        {"winograd_4x4", 2, 8, 11, 13, 6, 3, 1, 1},
+        {"winograd_4x4", 1, 32, 20, 17, 40, 3, 1, 2},
+        {"winograd_4x4", 3, 4, 8, 8, 4, 3, 0, 1},
+        {"winograd",     1, 32, 24, 24, 32, 3, 1, 1},
+        {"fft",          2, 6, 15, 12, 4, 7, 3, 2},
+        {"fft",          1, 3, 20, 20, 5, 9, 0, 1},
+        {"auto",         1, 16, 12, 12, 16, 3, 1, 1},
+        {"auto",         1, 4, 16, 16, 4, 11, 5, 1},
+    };
+    RNG rng(0);
+
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++)
+    {
+        const Config &c = configs[i];
+
+        LayerParams params;
+        params.set("num_output", c.outCn);
+        params.set("kernel_size", c.kernel);
+        params.set("pad", c.pad);
+        params.set("group", c.group);
+        params.set("conv_algorithm", String(c.algorithm));
+
+        Blob wgt(BlobShape(c.outCn, c.inpCn / c.group, c.kernel, c.kernel)), bias(BlobShape(1, c.outCn, 1, 1));
+        rng.fill(wgt.matRef(), RNG::UNIFORM, -1, 1);
+        rng.fill(bias.matRef(), RNG::UNIFORM, -1, 1);
+        params.blobs.push_back(wgt);
+        params.blobs.push_back(bias);
+
+        Blob inp(BlobShape(c.batch, c.inpCn, c.height, c.width));
+        rng.fill(inp.matRef(), RNG::UNIFORM, -1, 1);
+        std::vector<Blob*> inpVec(1, &inp);
+        std::vector<Blob> outVec;
+
+        Ptr<Layer> layer = LayerFactory::createLayerInstance("Convolution", params);
+        layer->allocate(inpVec, outVec);
+        layer->forward(inpVec, outVec);
+
+        Blob ref;
+        convolutionRef(inp, wgt, bias, 1, c.pad, c.group, ref);
+        normAssert(ref, outVec[0], c.algorithm);
+
+        //transformed weights must follow the updated parameters
+        Blob newWgt(wgt.shape());
+        rng.fill(newWgt.matRef(), RNG::UNIFORM, -1, 1);
+        layer->blobs[0] = newWgt;
+        layer->forward(inpVec, outVec);
+
+        convolutionRef(inp, newWgt, bias, 1, c.pad, c.group, ref);
+        normAssert(ref, outVec[0], c.algorithm);
+    }
+}
+
 TEST(Layer_Test_InnerProduct, Accuracy)
 {
      testLayer("layer_inner_product", true);
 }
 
+TEST(Layer_Test_InnerProduct, MappedModel)
+{
+     testLayer("layer_inner_product", true, true, true);
+}
+
 TEST(Layer_Test_Pooling_max, Accuracy)
 {
      testLayer("layer_pooling_max");
@@ -132,6 +364,11 @@ TEST(Layer_Test_DeConvolution, Accuracy)
      testLayer("layer_deconvolution", true, false);
 }
 
+TEST(Layer_Test_DeConvolution, MappedModel)
+{
+     testLayer("layer_deconvolution", true, false, true);
+}
+
 TEST(Layer_Test_MVN, Accuracy)
 {
      testLayer("layer_mvn");
@@ -174,4 +411,24 @@ TEST(Layer_Test_Reshape_Split_Slice, Accuracy)
     normAssert(input, output);
 }
 
+TEST(Blob_Test_Fill, SharesMatData)
+{
+    int sizes[] = {2, 3, 4, 5};
+    Mat data(4, sizes, CV_32F);
+    RNG rng(0);
+    rng.fill(data, RNG::UNIFORM, -1, 1);
+
+    Blob blob;
+    blob.fill(data);
+    EXPECT_EQ(BlobShape(2, 3, 4, 5), blob.shape());
+    EXPECT_EQ(data.data, blob.matRefConst().data);
+
+    //the blob holds the reference to the data
+    Mat ref = data.clone();
+    data.release();
+    ASSERT_TRUE(blob.matRefConst().u != NULL);
+    EXPECT_EQ(1, blob.matRefConst().u->refcount);
+    EXPECT_EQ(0, cvtest::norm(ref, blob.matRefConst(), NORM_INF));
+}
+
 }
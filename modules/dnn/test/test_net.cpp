@@ -0,0 +1,630 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "test_precomp.hpp"
+#include <map>
+#include <fstream>
+#include <iterator>
+
+namespace cvtest
+{
+
+using namespace cv;
+using namespace cv::dnn;
+
+//sums up its inputs and the optional scalar param, counts forward calls of each layer instance
+class ForwardCounterLayer : public Layer
+{
+public:
+    static std::map<String, int> counters;
+
+    ForwardCounterLayer(LayerParams &params) : Layer(params) {}
+
+    void allocate(const std::vector<Blob*> &inputs, std::vector<Blob> &outputs)
+    {
+        CV_Assert(inputs.size() > 0);
+        outputs.resize(1);
+        outputs[0].create(inputs[0]->shape(), inputs[0]->type());
+    }
+
+    void forward(std::vector<Blob*> &inputs, std::vector<Blob> &outputs)
+    {
+        Mat &outMat = outputs[0].matRef();
+        outMat.setTo(Scalar::all(blobs.empty() ? 0.f : blobs[0].ptrf()[0]));
+
+        for (size_t i = 0; i < inputs.size(); i++)
+            cv::add(outMat, inputs[i]->matRefConst(), outMat);
+
+        counters[name]++;
+    }
+};
+
+std::map<String, int> ForwardCounterLayer::counters;
+
+static Blob constBlob(float value)
+{
+    Blob blob(BlobShape(1, 1, 2, 2));
+    blob.matRef().setTo(Scalar::all(value));
+    return blob;
+}
+
+TEST(Net_forwardOpt, RecomputesOnlyChangedLayers)
+{
+    REG_RUNTIME_LAYER_CLASS(ForwardCounter, ForwardCounterLayer)
+    ForwardCounterLayer::counters.clear();
+
+    Net net;
+    std::vector<String> inputNames;
+    inputNames.push_back("a");
+    inputNames.push_back("b");
+    net.setNetInputs(inputNames);
+
+    LayerParams params;
+    params.blobs.push_back(constBlob(0));
+    int idA = net.addLayer("branchA", "ForwardCounter", params);
+    net.addLayer("branchB", "ForwardCounter", params);
+    int idHead = net.addLayer("head", "ForwardCounter", params);
+    net.connect(".a", "branchA");
+    net.connect(".b", "branchB");
+    net.connect("branchA", "head.0");
+    net.connect("branchB", "head.1");
+
+    net.setBlob(".a", constBlob(1));
+    net.setBlob(".b", constBlob(2));
+    net.forward();
+
+    EXPECT_EQ(1, ForwardCounterLayer::counters["branchA"]);
+    EXPECT_EQ(1, ForwardCounterLayer::counters["branchB"]);
+    EXPECT_EQ(1, ForwardCounterLayer::counters["head"]);
+
+    //only the second branch depends on the updated input
+    net.setBlob(".b", constBlob(5));
+    net.forwardOpt(idHead);
+
+    EXPECT_EQ(1, ForwardCounterLayer::counters["branchA"]);
+    EXPECT_EQ(2, ForwardCounterLayer::counters["branchB"]);
+    EXPECT_EQ(2, ForwardCounterLayer::counters["head"]);
+    Blob head = net.getBlob("head"), ref = constBlob(6);
+    normAssert(ref, head);
+
+    //nothing was changed
+    net.forwardOpt(idHead);
+    EXPECT_EQ(1, ForwardCounterLayer::counters["branchA"]);
+    EXPECT_EQ(2, ForwardCounterLayer::counters["branchB"]);
+    EXPECT_EQ(2, ForwardCounterLayer::counters["head"]);
+
+    //updated param invalidates the layer itself and its consumers
+    net.setParam(idA, 0, constBlob(10));
+    std::vector<Net::LayerId> toLayers;
+    toLayers.push_back(idA);
+    toLayers.push_back(idHead);
+    net.forwardOpt(toLayers);
+
+    EXPECT_EQ(2, ForwardCounterLayer::counters["branchA"]);
+    EXPECT_EQ(2, ForwardCounterLayer::counters["branchB"]);
+    EXPECT_EQ(3, ForwardCounterLayer::counters["head"]);
+    head = net.getBlob("head");
+    ref = constBlob(16);
+    normAssert(ref, head);
+
+    LayerFactory::unregisterLayer("ForwardCounter");
+}
+
+//data -> mvn1 -> split -> [softmax, mvn -> tanh (inplace)] -> concat -> mvn2
+static void buildBranchingNet(Net &net)
+{
+    net.setNetInputs(std::vector<String>(1, "data"));
+
+    LayerParams mvnParams, splitParams, softmaxParams, tanhParams, concatParams;
+    net.addLayer("mvn1", "MVN", mvnParams);
+    net.addLayer("split", "Split", splitParams);
+    net.addLayer("softmaxA", "Softmax", softmaxParams);
+    net.addLayer("mvnB", "MVN", mvnParams);
+    net.addLayer("tanhB", "TanH", tanhParams);
+    concatParams.set("axis", 1);
+    net.addLayer("concat", "Concat", concatParams);
+    net.addLayer("mvn2", "MVN", mvnParams);
+
+    net.connect(".data", "mvn1");
+    net.connect("mvn1", "split");
+    net.connect("split.0", "softmaxA");
+    net.connect("split.1", "mvnB");
+    net.connect("mvnB", "tanhB");
+    net.connect("softmaxA", "concat.0");
+    net.connect("tanhB", "concat.1");
+    net.connect("concat", "mvn2");
+}
+
+TEST(Net_MemoryReuse, Accuracy)
+{
+    Blob input(BlobShape(1, 3, 4, 5));
+    RNG rng(0);
+    rng.fill(input.matRef(), RNG::UNIFORM, -1, 1);
+
+    Net refNet, net;
+    buildBranchingNet(refNet);
+    buildBranchingNet(net);
+    net.setMemoryReuse(true);
+
+    refNet.setBlob(".data", input);
+    refNet.forward();
+    Blob ref = refNet.getBlob("mvn2");
+
+    net.setBlob(".data", input);
+    net.forward();
+    Blob out = net.getBlob("mvn2");
+    normAssert(ref, out);
+
+    size_t blobsMemory, plannedMemory;
+    net.getMemoryConsumption(blobsMemory, plannedMemory);
+    EXPECT_LT(plannedMemory, blobsMemory);
+
+    size_t refBlobsMemory, refPlannedMemory;
+    refNet.getMemoryConsumption(refBlobsMemory, refPlannedMemory);
+    EXPECT_EQ(blobsMemory, refBlobsMemory);
+    EXPECT_EQ(plannedMemory, refPlannedMemory);
+
+    //the net is reallocated for the new input shape
+    Blob input2(BlobShape(1, 3, 6, 7));
+    rng.fill(input2.matRef(), RNG::UNIFORM, -1, 1);
+    refNet.setBlob(".data", input2);
+    refNet.forward();
+    ref = refNet.getBlob("mvn2");
+    net.setBlob(".data", input2);
+    net.forward();
+    out = net.getBlob("mvn2");
+    normAssert(ref, out);
+}
+
+static LayerParams convParams(RNG &rng, int inpCn, int outCn, int kernel)
+{
+    LayerParams params;
+    params.set("num_output", outCn);
+    params.set("kernel_size", kernel);
+    params.set("pad", kernel / 2);
+
+    Blob weights(BlobShape(outCn, inpCn, kernel, kernel)), bias(BlobShape(1, outCn, 1, 1));
+    rng.fill(weights.matRef(), RNG::UNIFORM, -0.2, 0.2);
+    rng.fill(bias.matRef(), RNG::UNIFORM, -0.2, 0.2);
+    params.blobs.push_back(weights);
+    params.blobs.push_back(bias);
+    return params;
+}
+
+//data -> conv1 (Winograd) -> relu1 -> conv2 (im2col) -> tanh2 -> conv3 (FFT) -> sigmoid3 -> fc -> relu4
+static void buildFusionNet(Net &net)
+{
+    RNG rng(0);
+    net.setNetInputs(std::vector<String>(1, "data"));
+
+    LayerParams conv1 = convParams(rng, 16, 16, 3), conv2 = convParams(rng, 16, 4, 3), conv3 = convParams(rng, 4, 4, 9);
+    LayerParams fc, reluParams, leakyReluParams, activParams;
+
+    fc.set("num_output", 10);
+    Blob fcWeights(BlobShape(Vec2i(10, 4 * 10 * 10))), fcBias(BlobShape(Vec2i(1, 10)));
+    rng.fill(fcWeights.matRef(), RNG::UNIFORM, -0.1, 0.1);
+    rng.fill(fcBias.matRef(), RNG::UNIFORM, -0.1, 0.1);
+    fc.blobs.push_back(fcWeights);
+    fc.blobs.push_back(fcBias);
+    leakyReluParams.set("negative_slope", 0.1f);
+
+    net.addLayer("conv1", "Convolution", conv1);
+    net.addLayer("relu1", "ReLU", reluParams);
+    net.addLayer("conv2", "Convolution", conv2);
+    net.addLayer("tanh2", "TanH", activParams);
+    net.addLayer("conv3", "Convolution", conv3);
+    net.addLayer("sigmoid3", "Sigmoid", activParams);
+    net.addLayer("fc", "InnerProduct", fc);
+    net.addLayer("relu4", "ReLU", leakyReluParams);
+
+    net.connect(".data", "conv1");
+    net.connect("conv1", "relu1");
+    net.connect("relu1", "conv2");
+    net.connect("conv2", "tanh2");
+    net.connect("tanh2", "conv3");
+    net.connect("conv3", "sigmoid3");
+    net.connect("sigmoid3", "fc");
+    net.connect("fc", "relu4");
+}
+
+TEST(Net_LayerFusion, Accuracy)
+{
+    Blob input(BlobShape(2, 16, 10, 10));
+    RNG rng(0);
+    rng.fill(input.matRef(), RNG::UNIFORM, -1, 1);
+
+    Net refNet, net;
+    buildFusionNet(refNet);
+    buildFusionNet(net);
+    refNet.setLayerFusion(false);
+
+    refNet.setBlob(".data", input);
+    refNet.forward();
+    net.setBlob(".data", input);
+    net.forward();
+
+    const char *names[] = {"relu1", "tanh2", "sigmoid3", "relu4"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        Blob ref = refNet.getBlob(names[i]), out = net.getBlob(names[i]);
+        normAssert(ref, out, names[i]);
+    }
+
+    //switching fusion off restores the original outputs
+    net.setLayerFusion(false);
+    net.forward();
+    Blob ref = refNet.getBlob("relu4"), out = net.getBlob("relu4");
+    normAssert(ref, out);
+}
+
+//data -> mvn1 -> [softmaxA, tanhB (inplace), mvnC] -> concat -> mvn2,
+//mvnC follows tanhB in the forward order, so it reads the data rewritten by tanhB
+static void buildInceptionNet(Net &net)
+{
+    net.setNetInputs(std::vector<String>(1, "data"));
+
+    LayerParams mvnParams, softmaxParams, tanhParams, concatParams;
+    net.addLayer("mvn1", "MVN", mvnParams);
+    net.addLayer("softmaxA", "Softmax", softmaxParams);
+    net.addLayer("tanhB", "TanH", tanhParams);
+    net.addLayer("mvnC", "MVN", mvnParams);
+    concatParams.set("axis", 1);
+    net.addLayer("concat", "Concat", concatParams);
+    net.addLayer("mvn2", "MVN", mvnParams);
+
+    net.connect(".data", "mvn1");
+    net.connect("mvn1", "softmaxA");
+    net.connect("mvn1", "tanhB");
+    net.connect("mvn1", "mvnC");
+    net.connect("softmaxA", "concat.0");
+    net.connect("tanhB", "concat.1");
+    net.connect("mvnC", "concat.2");
+    net.connect("concat", "mvn2");
+}
+
+TEST(Net_ParallelForward, Accuracy)
+{
+    int threads = getNumThreads();
+    setNumThreads(4);
+
+    Blob input(BlobShape(2, 3, 8, 9));
+    RNG rng(0);
+    rng.fill(input.matRef(), RNG::UNIFORM, -1, 1);
+
+    Net refNet, net;
+    buildInceptionNet(refNet);
+    buildInceptionNet(net);
+    net.setParallelForward(true);
+
+    refNet.setBlob(".data", input);
+    refNet.forward();
+    Blob ref = refNet.getBlob("mvn2");
+
+    for (int iter = 0; iter < 10; iter++)
+    {
+        net.setBlob(".data", input);
+        net.forward();
+        Blob out = net.getBlob("mvn2");
+        normAssert(ref, out);
+    }
+
+    std::vector<double> timings;
+    double total = net.getPerfProfile(timings);
+    ASSERT_EQ((size_t)net.getLayerId("mvn2") + 1, timings.size());
+    for (size_t i = 0; i < timings.size(); i++)
+        EXPECT_GE(timings[i], 0.);
+    EXPECT_GE(total, 0.);
+
+    setNumThreads(threads);
+}
+
+class ScaleShiftInvoker : public ParallelLoopBody
+{
+public:
+    const float *src;
+    float *dst;
+    float shift;
+
+    void operator()(const Range &range) const
+    {
+        for (int i = range.start; i < range.end; i++)
+            dst[i] = 2.f * src[i] + shift;
+    }
+};
+
+//computes 2 * input + param by its own parallel loop, as convolution and fully connected layers do
+class NestedLoopLayer : public Layer
+{
+public:
+    NestedLoopLayer(LayerParams &params) : Layer(params) {}
+
+    void allocate(const std::vector<Blob*> &inputs, std::vector<Blob> &outputs)
+    {
+        outputs.resize(1);
+        outputs[0].create(inputs[0]->shape(), inputs[0]->type());
+    }
+
+    void forward(std::vector<Blob*> &inputs, std::vector<Blob> &outputs)
+    {
+        ScaleShiftInvoker invoker;
+        invoker.src = inputs[0]->ptrf();
+        invoker.dst = outputs[0].ptrf();
+        invoker.shift = blobs[0].ptrf()[0];
+        parallel_for_(Range(0, (int)inputs[0]->total()), invoker, 16);
+    }
+};
+
+//layers of the parallel pass run inner parallel loops, with TBB the threads blocked in them execute pending workers
+TEST(Net_ParallelForward, NestedParallelLoops)
+{
+    REG_RUNTIME_LAYER_CLASS(NestedLoop, NestedLoopLayer)
+    REG_RUNTIME_LAYER_CLASS(ForwardCounter, ForwardCounterLayer)
+    int threads = getNumThreads();
+    setNumThreads(4);
+
+    const int branches = 8;
+    Net net;
+    net.setNetInputs(std::vector<String>(1, "data"));
+    for (int i = 0; i < branches; i++)
+    {
+        LayerParams params;
+        params.blobs.push_back(constBlob((float)i));
+        net.addLayer(format("branch%d", i), "NestedLoop", params);
+    }
+    LayerParams headParams;
+    net.addLayer("head", "ForwardCounter", headParams);
+    for (int i = 0; i < branches; i++)
+    {
+        net.connect(".data", format("branch%d", i));
+        net.connect(format("branch%d", i), format("head.%d", i));
+    }
+    net.setParallelForward(true);
+
+    Blob input(BlobShape(1, 4, 32, 32));
+    RNG rng(0);
+    rng.fill(input.matRef(), RNG::UNIFORM, -1, 1);
+    Blob ref(input.shape());
+    input.matRefConst().convertTo(ref.matRef(), CV_32F, 2 * branches, branches * (branches - 1) / 2);
+
+    for (int iter = 0; iter < 20; iter++)
+    {
+        net.setBlob(".data", input);
+        net.forward();
+        Blob out = net.getBlob("head");
+        normAssert(ref, out);
+    }
+
+    setNumThreads(threads);
+    LayerFactory::unregisterLayer("NestedLoop");
+    LayerFactory::unregisterLayer("ForwardCounter");
+}
+
+TEST(Net_Profile, Accuracy)
+{
+    Net net;
+    buildFusionNet(net);
+    net.setLayerFusion(false);
+
+    Blob input(BlobShape(2, 16, 10, 10));
+    net.setBlob(".data", input);
+    net.forward();
+
+    std::vector<LayerProfile> profile;
+    net.getProfile(profile);
+    ASSERT_EQ(8u, profile.size());
+
+    const LayerProfile &conv1 = profile[0];
+    EXPECT_EQ(net.getLayerId("conv1"), conv1.id);
+    EXPECT_EQ(String("conv1"), conv1.name);
+    EXPECT_EQ(String("Convolution"), conv1.type);
+    EXPECT_GE(conv1.time, 0.);
+    EXPECT_GE(conv1.start, 0.);
+    EXPECT_EQ((int64)2 * 16 * 10 * 10 * (2 * 16 * 3 * 3 + 1), conv1.flops);
+    EXPECT_EQ(2u * 16 * 10 * 10 * sizeof(float), conv1.memory);
+    ASSERT_EQ(1u, conv1.outputShapes.size());
+    EXPECT_EQ(BlobShape(2, 16, 10, 10), conv1.outputShapes[0]);
+
+    //ReLU is computed inplace
+    const LayerProfile &relu1 = profile[1];
+    EXPECT_EQ(String("relu1"), relu1.name);
+    EXPECT_EQ(0u, relu1.memory);
+    EXPECT_EQ((int64)2 * 16 * 10 * 10, relu1.flops);
+
+    const LayerProfile &fc = profile[6];
+    EXPECT_EQ(String("fc"), fc.name);
+    EXPECT_EQ((int64)2 * 10 * (2 * 400 + 1), fc.flops);
+
+    //only computed layers are reported
+    net.forward(net.getLayerId("tanh2"));
+    net.getProfile(profile);
+    ASSERT_EQ(4u, profile.size());
+    EXPECT_EQ(String("tanh2"), profile[3].name);
+
+    String jsonPath = tempfile(".json");
+    net.writeProfile(jsonPath, Net::PROFILE_JSON);
+    std::ifstream jsonFile(jsonPath.c_str());
+    std::string json((std::istreambuf_iterator<char>(jsonFile)), std::istreambuf_iterator<char>());
+    EXPECT_NE(std::string::npos, json.find("\"name\": \"conv2\""));
+    EXPECT_NE(std::string::npos, json.find("\"output_shapes\": [[2, 4, 10, 10]]"));
+    jsonFile.close();
+    remove(jsonPath.c_str());
+
+    String tracePath = tempfile(".json");
+    net.writeProfile(tracePath, Net::PROFILE_CHROME_TRACE);
+    std::ifstream traceFile(tracePath.c_str());
+    std::string trace((std::istreambuf_iterator<char>(traceFile)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(0u, trace.find("{\"traceEvents\": ["));
+    EXPECT_NE(std::string::npos, trace.find("\"ph\": \"X\""));
+    traceFile.close();
+    remove(tracePath.c_str());
+}
+
+static double relativeError(Blob &ref, Blob &out)
+{
+    return cvtest::norm(ref.matRefConst(), out.matRefConst(), NORM_L2) / cvtest::norm(ref.matRefConst(), NORM_L2);
+}
+
+TEST(Net_Quantization, Accuracy)
+{
+    RNG rng(0);
+    std::vector<Blob> calibration;
+    for (int i = 0; i < 4; i++)
+    {
+        Blob blob(BlobShape(2, 16, 10, 10));
+        rng.fill(blob.matRef(), RNG::UNIFORM, -1, 1);
+        calibration.push_back(blob);
+    }
+    Blob input(BlobShape(2, 16, 10, 10));
+    rng.fill(input.matRef(), RNG::UNIFORM, -1, 1);
+
+    Net refNet;
+    buildFusionNet(refNet);
+    refNet.setBlob(".data", input);
+    refNet.forward();
+    Blob ref = refNet.getBlob("relu4"), refConv = refNet.getBlob("relu1");
+
+    const int precisions[] = {Net::PRECISION_FP16, Net::PRECISION_INT8, Net::PRECISION_INT8};
+    const double maxErrors[] = {1e-3, 3e-2, 3e-2};
+    for (int i = 0; i < 3; i++)
+    {
+        Net net;
+        buildFusionNet(net);
+        //the last int8 net computes the quantization steps of inputs for each image
+        net.quantize(precisions[i], ".data", (i == 1) ? calibration : std::vector<Blob>());
+        const int qType = (precisions[i] == Net::PRECISION_FP16) ? CV_16U : CV_8S;
+        EXPECT_EQ(qType, net.getParam("conv1", 0).matRefConst().type());
+        EXPECT_EQ(qType, net.getParam("fc", 0).matRefConst().type());
+
+        net.setBlob(".data", input);
+        net.forward();
+        Blob out = net.getBlob("relu4"), outConv = net.getBlob("relu1");
+
+        double err = relativeError(ref, out), convErr = relativeError(refConv, outConv);
+        EXPECT_LE(err, maxErrors[i]) << "precision " << precisions[i];
+        EXPECT_LE(convErr, maxErrors[i]) << "precision " << precisions[i];
+    }
+}
+
+class ContextsForwardInvoker : public ParallelLoopBody
+{
+public:
+    std::vector<Net> *contexts;
+    const std::vector<Blob> *inputs;
+    std::vector<Blob> *outputs;
+
+    void operator()(const Range &range) const
+    {
+        for (int i = range.start; i < range.end; i++)
+        {
+            Net &context = (*contexts)[i];
+            context.setBlob(".data", (*inputs)[i]);
+            context.forward();
+            (*outputs)[i] = context.getBlob("relu4");
+        }
+    }
+};
+
+TEST(Net_Context, SharedWeights)
+{
+    const int numContexts = 4;
+    RNG rng(0);
+    std::vector<Blob> inputs;
+    for (int i = 0; i < numContexts; i++)
+    {
+        Blob blob(BlobShape(2, 16, 10, 10));
+        rng.fill(blob.matRef(), RNG::UNIFORM, -1, 1);
+        inputs.push_back(blob);
+    }
+
+    const int precisions[] = {Net::PRECISION_FP32, Net::PRECISION_FP16};
+    for (int p = 0; p < 2; p++)
+    {
+        Net net;
+        buildFusionNet(net);
+        net.quantize(precisions[p]);
+        //transformed weights of Winograd and FFT convolutions are computed by the first pass and shared by contexts
+        net.setBlob(".data", inputs[0]);
+        net.forward();
+
+        std::vector<Net> contexts;
+        for (int i = 0; i < numContexts; i++)
+        {
+            contexts.push_back(net.createContext());
+            const char *names[] = {"conv1", "conv3", "fc"};
+            for (int j = 0; j < 3; j++)
+            {
+                //for fp16 the first parameter is the quantized weights used by the forward pass
+                for (int k = 0; k < 2; k++)
+                {
+                    Blob param = net.getParam(names[j], k);
+                    ASSERT_FALSE(param.matRefConst().empty());
+                    EXPECT_EQ(param.matRefConst().data, contexts[i].getParam(names[j], k).matRefConst().data);
+                }
+                if (precisions[p] == Net::PRECISION_FP16)
+                    EXPECT_EQ(CV_16U, contexts[i].getParam(names[j], 0).matRefConst().type());
+            }
+        }
+
+        std::vector<Blob> refs(numContexts);
+        for (int i = 0; i < numContexts; i++)
+        {
+            net.setBlob(".data", inputs[i]);
+            net.forward();
+            //the output blob is overwritten by the next pass
+            Blob out = net.getBlob("relu4");
+            refs[i].fill(out.shape(), out.type(), out.ptr());
+        }
+
+        std::vector<Blob> outputs(numContexts);
+        ContextsForwardInvoker invoker;
+        invoker.contexts = &contexts;
+        invoker.inputs = &inputs;
+        invoker.outputs = &outputs;
+        for (int iter = 0; iter < 3; iter++)
+        {
+            parallel_for_(Range(0, numContexts), invoker, numContexts);
+            for (int i = 0; i < numContexts; i++)
+                normAssert(refs[i], outputs[i]);
+        }
+    }
+}
+
+}
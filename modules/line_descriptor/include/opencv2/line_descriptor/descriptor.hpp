@@ -1065,11 +1065,32 @@ void add( const std::vector<Mat>& descriptors );
 
 /** @brief Update dataset by inserting into it all descriptors that were stored locally by *add* function.
 
-@note Every time this function is invoked, current dataset is deleted and locally stored descriptors
-are inserted into dataset. The locally stored copy of just inserted descriptors is then removed.
+@note Every time this function is invoked, locally stored descriptors are appended to the dataset,
+the descriptors already indexed are kept and the index is not rebuilt. The locally stored copy of
+just inserted descriptors is then removed. Use *clear* to start a new dataset.
  */
 void train();
 
+/** @brief Store the dataset and its multi-index hashing tables to a binary file.
+
+@param filename path of the file to be written
+
+@note Descriptors stored locally by *add* are inserted into the dataset before saving. The file has
+a flat layout (hash tables, images' map and descriptors) and it is only readable on platforms with the
+same byte order.
+ */
+void saveIndex( const String& filename );
+
+/** @brief Load a dataset stored by *saveIndex*, replacing the current one.
+
+@param filename path of the file to be read
+
+@note The file is mapped into memory and the stored hash tables and descriptors are queried in place,
+so the dataset is ready without rebuilding its index. Descriptors inserted after loading are appended
+as usual, the tables they touch are then copied to memory.
+ */
+void loadIndex( const String& filename );
+
 /** @brief Create a BinaryDescriptorMatcher object and return a smart pointer to it.
  */
 static Ptr<BinaryDescriptorMatcher> createBinaryDescriptorMatcher();
@@ -1104,7 +1125,10 @@ BucketGroup();
 void insert( int subindex, UINT32 data );
 
 /** perform a query to the bucket */
-UINT32* query( int subindex, int *size );
+const UINT32* query( int subindex, int *size );
+
+/** perform a query to a bucket stored as a flat array (same layout of group) */
+static const UINT32* query( UINT32 empty, const UINT32* group, int subindex, int *size );
 
 /** utility functions */
 void insert_value( std::vector<uint32_t>& vec, int index, UINT32 data );
@@ -1143,7 +1167,16 @@ int init( int _b );
 void insert( UINT64 index, UINT32 data );
 
 /** query data */
-UINT32* query( UINT64 index, int* size );
+const UINT32* query( UINT64 index, int* size );
+
+/** use bucket groups stored in a flat pool, each one as { empty, count, group data } */
+void attach( const UINT32* pool, const UINT64* offsets );
+
+/** number of words needed to store the bucket groups in a flat pool */
+UINT64 flatSize() const;
+
+/** store the bucket groups in a flat pool, offsets of the groups are relative to base */
+void flatten( UINT32* pool, UINT64* offsets, UINT64 base ) const;
 
 /** Bits per index */
 int b;
@@ -1151,8 +1184,20 @@ int b;
 /**  Number of bins */
 UINT64 size;
 
+private:
+
+/** copy attached bucket groups to table, before inserting new data */
+void detach();
+
+/** attached bucket groups and their offsets in pool (table is NULL then) */
+const UINT32* pool;
+const UINT64* offsets;
+
 };
 
+/** read-only mapping of an index file into memory */
+class MappedFile;
+
 /** class defining a sequence of bits */
 class bitarray
 {
@@ -1238,29 +1283,26 @@ int D;
 /** Maximum hamming search radius per substring */
 int d;
 
-/** Maximum results to return */
-int K;
-
 /** Number of codes */
 UINT64 N;
 
 /** Table of original full-length codes */
 cv::Mat codes;
 
-/** Counter for eliminating duplicate results (it is not thread safe) */
-bitarray *counter;
-
 /** Array of m hashtables */
 SparseHashtable *H;
 
 /** Volume of a b-bit Hamming ball with radius s (for s = 0 to d) */
 UINT32 *xornum;
 
-/** Used within generation of binary codes at a certain Hamming distance */
-int power[100];
+/** file whose data are used by codes and H, if the index was loaded */
+Ptr<MappedFile> storage;
 
-/** constructor */
-Mihasher();
+/** per-thread buffers of the queries (duplicates counter, results grouped by distance) */
+struct QueryBuffers;
+
+/** parallel body of batchquery */
+class BatchQueryInvoker;
 
 /** desctructor */
 ~Mihasher();
@@ -1268,21 +1310,25 @@ Mihasher();
 /** constructor 2 */
 Mihasher( int B, int m );
 
-/** K setter */
-void setK( int K );
+/** append codes to the tables, the ones already inserted are kept */
+void insert( const cv::Mat & newCodes );
 
-/** populate tables */
-void populate( cv::Mat & codes, UINT32 N, int dim1codes );
+/** execute a batch query, queries are processed in parallel and
+ the K nearest neighbours of every query are returned */
+void batchquery( UINT32 * results, UINT32 *numres, const cv::Mat & q, int K ) const;
 
-/** execute a batch query */
-void batchquery( UINT32 * results, UINT32 *numres/*, qstat *stats*/, const cv::Mat & q, UINT32 numq, int dim1queries );
+/** execute a single query */
+void query( UINT32 * results, UINT32* numres, const UINT8 *q, int K, QueryBuffers& buffers ) const;
 
 private:
 
-/** execute a single query */
-void query( UINT32 * results, UINT32* numres/*, qstat *stats*/, UINT8 *q, UINT64 * chunks, UINT32 * res );
+Mihasher( const Mihasher& );
+Mihasher& operator=( const Mihasher& );
 };
 
+/** index of a train matrix, the cached one is returned while the matrix does not change */
+Ptr<Mihasher> getTrainIndex( const Mat& trainDescriptors ) const;
+
 /** retrieve Hamming distances */
 void checkKDistances( UINT32 * numres, int k, std::vector<int>& k_distances, int row, int string_length ) const;
 
@@ -1293,7 +1339,11 @@ Mat descriptorsMat;
 std::map<int, int> indexesMap;
 
 /** internal MiHaser representing dataset */
-Mihasher* dataset;
+Ptr<Mihasher> dataset;
+
+/** index of the last train matrix passed to const matching functions */
+mutable Ptr<Mihasher> trainIndex;
+mutable Mutex trainIndexMutex;
 
 /** index from which next added descriptors' bunch must begin */
 int nextAddedIndex;
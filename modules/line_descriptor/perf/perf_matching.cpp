@@ -185,3 +185,43 @@ PERF_TEST(radius_match, radius_match_distances_test)
 
 }
 
+
+typedef perf::TestBaseWithParam<std::tr1::tuple<int, bool> > large_dataset_matching;
+
+PERF_TEST_P(large_dataset_matching, knn_match, testing::Combine(testing::Values(10000, 100000, 1000000), testing::Bool()))
+{
+  int datasetSize = get<0>( GetParam() );
+  bool bruteForce = get<1>( GetParam() );
+
+  /* random dataset, queries are its codes with a few flipped bits */
+  RNG rng( 0x1234 );
+  Mat train( datasetSize, DIM, CV_8UC1 ), query( QUERY_DES_COUNT, DIM, CV_8UC1 );
+  rng.fill( train, RNG::UNIFORM, Scalar( 0 ), Scalar( 256 ) );
+  for ( int i = 0; i < query.rows; i++ )
+  {
+    train.row( rng.uniform( 0, train.rows ) ).copyTo( query.row( i ) );
+    for ( int f = rng.uniform( 0, 9 ); f > 0; f-- )
+      query.at<uchar>( i, rng.uniform( 0, DIM ) ) ^= (uchar) ( 1 << rng.uniform( 0, 8 ) );
+  }
+
+  /* the index is built once, out of the measured loop */
+  BFMatcher bf( NORM_HAMMING );
+  Ptr<BinaryDescriptorMatcher> bd = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+  if( !bruteForce )
+  {
+    bd->add( std::vector<Mat>( 1, train ) );
+    bd->train();
+  }
+
+  std::vector<std::vector<DMatch> > dm;
+  TEST_CYCLE()
+  {
+    dm.clear();
+    if( bruteForce )
+      bf.knnMatch( query, train, dm, 2 );
+    else
+      bd->knnMatch( query, dm, 2 );
+  }
+
+  SANITY_CHECK_NOTHING();
+}
@@ -40,6 +40,21 @@
  //M*/
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/hal.hpp"
+
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #define MAX_B 37
 double ARRAY_RESIZE_FACTOR = 1.1;    // minimum is 1.0
@@ -54,7 +69,7 @@ namespace line_descriptor
 /* constructor */
 BinaryDescriptorMatcher::BinaryDescriptorMatcher()
 {
-  dataset = new Mihasher( 256, 32 );
+  dataset = makePtr<Mihasher>( 256, 32 );
   nextAddedIndex = 0;
   numImages = 0;
   descrInDS = 0;
@@ -82,13 +97,14 @@ void BinaryDescriptorMatcher::add( const std::vector<Mat>& descriptors )
 /* store new descriptors into dataset */
 void BinaryDescriptorMatcher::train()
 {
-  if( !dataset )
-    dataset = new Mihasher( 256, 32 );
+  if( dataset.empty() )
+    dataset = makePtr<Mihasher>( 256, 32 );
 
+  /* new descriptors are appended to the tables, without rebuilding them */
   if( descriptorsMat.rows > 0 )
-    dataset->populate( descriptorsMat, descriptorsMat.rows, descriptorsMat.cols );
+    dataset->insert( descriptorsMat );
 
-  descrInDS = descriptorsMat.rows;
+  descrInDS = (int) dataset->N;
   descriptorsMat.release();
 }
 
@@ -97,12 +113,248 @@ void BinaryDescriptorMatcher::clear()
 {
   descriptorsMat.release();
   indexesMap.clear();
-  dataset = 0;
+  dataset.release();
   nextAddedIndex = 0;
   numImages = 0;
   descrInDS = 0;
 }
 
+/* index file mapped read-only into memory: the hash tables are queried in place and copied before any
+ insertion, the wrapped codes are reallocated when new ones are appended */
+class BinaryDescriptorMatcher::MappedFile
+{
+ public:
+  explicit MappedFile( const String& filename ) :
+      ptr( NULL ),
+      len( 0 )
+  {
+#ifdef _WIN32
+    HANDLE file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+    LARGE_INTEGER fileSize;
+    if( file != INVALID_HANDLE_VALUE && GetFileSizeEx( file, &fileSize ) && fileSize.QuadPart > 0 )
+    {
+      /* the view keeps the mapping object alive */
+      HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+      if( mapping )
+      {
+        ptr = (const uchar*) MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+        CloseHandle( mapping );
+      }
+      len = ptr ? (size_t) fileSize.QuadPart : 0;
+    }
+    if( file != INVALID_HANDLE_VALUE )
+      CloseHandle( file );
+#else
+    int fd = open( filename.c_str(), O_RDONLY );
+    struct stat st;
+    if( fd >= 0 && fstat( fd, &st ) == 0 && st.st_size > 0 )
+    {
+      void *addr = mmap( NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+      if( addr != MAP_FAILED )
+      {
+        ptr = (const uchar*) addr;
+        len = (size_t) st.st_size;
+      }
+    }
+    if( fd >= 0 )
+      close( fd );
+#endif
+
+    if( !ptr )
+      CV_Error( Error::StsError, "Can't load the index from \"" + filename + "\"" );
+  }
+
+  ~MappedFile()
+  {
+#ifdef _WIN32
+    UnmapViewOfFile( ptr );
+#else
+    munmap( (void*) ptr, len );
+#endif
+  }
+
+  const uchar* ptr;
+  size_t len;
+
+ private:
+  MappedFile( const MappedFile& );
+  MappedFile& operator=( const MappedFile& );
+};
+
+namespace
+{
+/* header of index files, followed by the offsets of the bucket groups (UINT64), the pool of bucket groups (UINT32),
+ the images' map (pairs of int) and the codes; every section is aligned to the size of its elements */
+struct IndexFileHeader
+{
+  char magic[8];
+  UINT32 version;
+  UINT32 byteOrder;
+  int B;
+  int m;
+  int numImages;
+  int nextAddedIndex;
+  UINT64 N;
+  UINT64 numEntries;
+  UINT64 numGroups;
+  UINT64 poolSize;
+};
+
+const char INDEX_FILE_MAGIC[8] = { 'L', 'D', 'M', 'I', 'H', 'I', 'D', 'X' };
+const UINT32 INDEX_FILE_VERSION = 1;
+const UINT32 INDEX_FILE_BYTE_ORDER = 0x01020304;
+}
+
+/* store dataset and its index to a file */
+void BinaryDescriptorMatcher::saveIndex( const String& filename )
+{
+  /* add new descriptors to dataset, if needed */
+  train();
+
+  IndexFileHeader header;
+  memset( &header, 0, sizeof ( header ) );
+  memcpy( header.magic, INDEX_FILE_MAGIC, sizeof ( header.magic ) );
+  header.version = INDEX_FILE_VERSION;
+  header.byteOrder = INDEX_FILE_BYTE_ORDER;
+  header.B = dataset->B;
+  header.m = dataset->m;
+  header.numImages = numImages;
+  header.nextAddedIndex = nextAddedIndex;
+  header.N = dataset->N;
+  header.numEntries = (UINT64) indexesMap.size();
+
+  for ( int k = 0; k < dataset->m; k++ )
+  {
+    header.numGroups += dataset->H[k].size;
+    header.poolSize += dataset->H[k].flatSize();
+  }
+
+  std::vector<UINT64> offsets( (size_t) header.numGroups );
+  std::vector<UINT32> pool( (size_t) header.poolSize );
+  UINT64 group = 0, base = 0;
+  for ( int k = 0; k < dataset->m; k++ )
+  {
+    dataset->H[k].flatten( &pool[0] + base, &offsets[0] + group, base );
+    group += dataset->H[k].size;
+    base += dataset->H[k].flatSize();
+  }
+
+  std::vector<int> entries;
+  entries.reserve( indexesMap.size() * 2 );
+  for ( std::map<int, int>::const_iterator it = indexesMap.begin(); it != indexesMap.end(); ++it )
+  {
+    entries.push_back( it->first );
+    entries.push_back( it->second );
+  }
+
+  std::ofstream out( filename.c_str(), std::ios::binary );
+  if( !out )
+    CV_Error( Error::StsError, "Can't open \"" + filename + "\" for writing" );
+
+  out.write( (const char*) &header, sizeof ( header ) );
+  if( !offsets.empty() )
+    out.write( (const char*) &offsets[0], offsets.size() * sizeof(UINT64) );
+  if( !pool.empty() )
+    out.write( (const char*) &pool[0], pool.size() * sizeof(UINT32) );
+  if( !entries.empty() )
+    out.write( (const char*) &entries[0], entries.size() * sizeof(int) );
+  for ( int i = 0; i < dataset->codes.rows; i++ )
+    out.write( (const char*) dataset->codes.ptr( i ), dataset->B_over_8 );
+
+  if( !out )
+    CV_Error( Error::StsError, "Can't write \"" + filename + "\"" );
+}
+
+/* load dataset and its index from a file */
+void BinaryDescriptorMatcher::loadIndex( const String& filename )
+{
+  Ptr<MappedFile> file = makePtr<MappedFile>( filename );
+
+  IndexFileHeader header;
+  if( file->len < sizeof ( header ) )
+    CV_Error( Error::StsParseError, "\"" + filename + "\" is not an index of BinaryDescriptorMatcher" );
+  memcpy( &header, file->ptr, sizeof ( header ) );
+
+  if( memcmp( header.magic, INDEX_FILE_MAGIC, sizeof ( header.magic ) ) != 0 || header.version != INDEX_FILE_VERSION )
+    CV_Error( Error::StsParseError, "\"" + filename + "\" is not an index of BinaryDescriptorMatcher" );
+  if( header.byteOrder != INDEX_FILE_BYTE_ORDER )
+    CV_Error( Error::StsUnsupportedFormat, "\"" + filename + "\" was saved on a platform with a different byte order" );
+  CV_Assert( header.B > 0 && header.B % 8 == 0 && header.m > 0 && header.m <= header.B );
+
+  Ptr<Mihasher> mh = makePtr<Mihasher>( header.B, header.m );
+
+  UINT64 numGroups = 0;
+  for ( int k = 0; k < mh->m; k++ )
+    numGroups += mh->H[k].size;
+
+  /* sizes are bounded by the file length before computing the sections' positions */
+  if( header.numGroups != numGroups || header.poolSize > file->len / sizeof(UINT32) || header.numEntries > file->len / ( 2 * sizeof(int) )
+      || header.N > (UINT64) std::min( file->len, (size_t) INT_MAX ) )
+    CV_Error( Error::StsParseError, "\"" + filename + "\" is corrupted" );
+
+  size_t offsetsPos = sizeof ( header );
+  size_t poolPos = offsetsPos + (size_t) header.numGroups * sizeof(UINT64);
+  size_t entriesPos = poolPos + (size_t) header.poolSize * sizeof(UINT32);
+  size_t codesPos = entriesPos + (size_t) header.numEntries * 2 * sizeof(int);
+  if( file->len != codesPos + (size_t) header.N * mh->B_over_8 )
+    CV_Error( Error::StsParseError, "\"" + filename + "\" is corrupted" );
+
+  const UINT64* offsets = (const UINT64*) ( file->ptr + offsetsPos );
+  const UINT32* pool = (const UINT32*) ( file->ptr + poolPos );
+  for ( UINT64 g = 0; g < numGroups; g++ )
+  {
+    if( offsets[g] + 2 > header.poolSize || offsets[g] + 2 + pool[offsets[g] + 1] > header.poolSize )
+      CV_Error( Error::StsParseError, "\"" + filename + "\" is corrupted" );
+  }
+
+  UINT64 group = 0;
+  for ( int k = 0; k < mh->m; k++ )
+  {
+    mh->H[k].attach( pool, offsets + group );
+    group += mh->H[k].size;
+  }
+
+  /* codes are wrapped, they are copied only if new ones are appended */
+  mh->N = header.N;
+  if( header.N > 0 )
+    mh->codes = Mat( (int) header.N, mh->B_over_8, CV_8UC1, (void*) ( file->ptr + codesPos ) );
+  mh->storage = file;
+
+  const int* entries = (const int*) ( file->ptr + entriesPos );
+  indexesMap.clear();
+  for ( UINT64 i = 0; i < header.numEntries; i++ )
+    indexesMap.insert( std::pair<int, int>( entries[2 * i], entries[2 * i + 1] ) );
+
+  dataset = mh;
+  descriptorsMat.release();
+  numImages = header.numImages;
+  nextAddedIndex = header.nextAddedIndex;
+  descrInDS = (int) header.N;
+}
+
+/* index of a train matrix: it is built only if the matrix differs from the one of the previous call */
+Ptr<BinaryDescriptorMatcher::Mihasher> BinaryDescriptorMatcher::getTrainIndex( const Mat& trainDescriptors ) const
+{
+  AutoLock lock( trainIndexMutex );
+
+  if( !trainIndex.empty() && trainIndex->codes.rows == trainDescriptors.rows && trainIndex->codes.cols == trainDescriptors.cols
+      && trainIndex->codes.type() == trainDescriptors.type() )
+  {
+    bool same = true;
+    for ( int i = 0; i < trainDescriptors.rows && same; i++ )
+      same = memcmp( trainIndex->codes.ptr( i ), trainDescriptors.ptr( i ), trainDescriptors.cols * trainDescriptors.elemSize() ) == 0;
+
+    if( same )
+      return trainIndex;
+  }
+
+  Ptr<Mihasher> mh = makePtr<Mihasher>( 256, 32 );
+  mh->insert( trainDescriptors );
+  trainIndex = mh;
+
+  return mh;
+}
+
 /* retrieve Hamming distances */
 void BinaryDescriptorMatcher::checkKDistances( UINT32 * numres, int k, std::vector<int> & k_distances, int row, int string_length ) const
 {
@@ -144,15 +396,12 @@ void BinaryDescriptorMatcher::match( const Mat& queryDescriptors, std::vector<DM
   /* add new descriptors to dataset, if needed */
   train();
 
-  /* set number of requested matches to return for each query */
-  dataset->setK( 1 );
-
   /* prepare structures for query */
   UINT32 *results = new UINT32[queryDescriptors.rows];
   UINT32 * numres = new UINT32[ ( 256 + 1 ) * ( queryDescriptors.rows )];
 
-  /* execute query */
-  dataset->batchquery( results, numres, queryDescriptors, queryDescriptors.rows, queryDescriptors.cols );
+  /* execute query, a single match is requested for each query */
+  dataset->batchquery( results, numres, queryDescriptors, 1 );
   /* compose matches */
   for ( int counter = 0; counter < queryDescriptors.rows; counter++ )
   {
@@ -211,20 +460,15 @@ void BinaryDescriptorMatcher::match( const Mat& queryDescriptors, const Mat& tra
     return;
   }
 
-  /* create a new mihasher object */
-  Mihasher *mh = new Mihasher( 256, 32 );
-
-  /* populate mihasher */
-  cv::Mat copy = trainDescriptors.clone();
-  mh->populate( copy, copy.rows, copy.cols );
-  mh->setK( 1 );
+  /* get the index of train descriptors, it is kept between the calls */
+  Ptr<Mihasher> mh = getTrainIndex( trainDescriptors );
 
   /* prepare structures for query */
   UINT32 *results = new UINT32[queryDescriptors.rows];
   UINT32 * numres = new UINT32[ ( 256 + 1 ) * ( queryDescriptors.rows )];
 
-  /* execute query */
-  mh->batchquery( results, numres, queryDescriptors, queryDescriptors.rows, queryDescriptors.cols );
+  /* execute query, a single match is requested for each query */
+  mh->batchquery( results, numres, queryDescriptors, 1 );
 
   /* compose matches */
   for ( int counter = 0; counter < queryDescriptors.rows; counter++ )
@@ -247,7 +491,6 @@ void BinaryDescriptorMatcher::match( const Mat& queryDescriptors, const Mat& tra
   }
 
   /* delete data */
-  delete mh;
   delete[] results;
   delete[] numres;
 
@@ -273,22 +516,15 @@ void BinaryDescriptorMatcher::knnMatch( const Mat& queryDescriptors, const Mat&
     return;
   }
 
-  /* create a new mihasher object */
-  Mihasher *mh = new Mihasher( 256, 32 );
-
-  /* populate mihasher */
-  cv::Mat copy = trainDescriptors.clone();
-  mh->populate( copy, copy.rows, copy.cols );
-
-  /* set K */
-  mh->setK( k );
+  /* get the index of train descriptors, it is kept between the calls */
+  Ptr<Mihasher> mh = getTrainIndex( trainDescriptors );
 
   /* prepare structures for query */
   UINT32 *results = new UINT32[k * queryDescriptors.rows];
   UINT32 * numres = new UINT32[ ( 256 + 1 ) * ( queryDescriptors.rows )];
 
   /* execute query */
-  mh->batchquery( results, numres, queryDescriptors, queryDescriptors.rows, queryDescriptors.cols );
+  mh->batchquery( results, numres, queryDescriptors, k );
 
   /* compose matches */
   int index = 0;
@@ -329,7 +565,6 @@ void BinaryDescriptorMatcher::knnMatch( const Mat& queryDescriptors, const Mat&
   }
 
   /* delete data */
-  delete mh;
   delete[] results;
   delete[] numres;
 }
@@ -358,15 +593,12 @@ void BinaryDescriptorMatcher::knnMatch( const Mat& queryDescriptors, std::vector
   /* add new descriptors to dataset, if needed */
   train();
 
-  /* set number of requested matches to return for each query */
-  dataset->setK( k );
-
   /* prepare structures for query */
   UINT32 *results = new UINT32[k * queryDescriptors.rows];
   UINT32 * numres = new UINT32[ ( 256 + 1 ) * ( queryDescriptors.rows )];
 
-  /* execute query */
-  dataset->batchquery( results, numres, queryDescriptors, queryDescriptors.rows, queryDescriptors.cols );
+  /* execute query, k matches are requested for each query */
+  dataset->batchquery( results, numres, queryDescriptors, k );
 
   /* compose matches */
   int index = 0;
@@ -444,23 +676,15 @@ void BinaryDescriptorMatcher::radiusMatch( const Mat& queryDescriptors, const Ma
     return;
   }
 
-  /* create a new Mihasher */
-  Mihasher* mh = new Mihasher( 256, 32 );
-
-  /* populate Mihasher */
-  //Mat copy = queryDescriptors.clone();
-  Mat copy = trainDescriptors.clone();
-  mh->populate( copy, copy.rows, copy.cols );
-
-  /* set K */
-  mh->setK( trainDescriptors.rows );
+  /* get the index of train descriptors, it is kept between the calls */
+  Ptr<Mihasher> mh = getTrainIndex( trainDescriptors );
 
   /* prepare structures for query */
   UINT32 *results = new UINT32[trainDescriptors.rows * queryDescriptors.rows];
   UINT32 * numres = new UINT32[ ( 256 + 1 ) * ( queryDescriptors.rows )];
 
-  /* execute query */
-  mh->batchquery( results, numres, queryDescriptors, queryDescriptors.rows, queryDescriptors.cols );
+  /* execute query, all the train descriptors are requested */
+  mh->batchquery( results, numres, queryDescriptors, trainDescriptors.rows );
 
   /* compose matches */
   int index = 0;
@@ -498,7 +722,6 @@ void BinaryDescriptorMatcher::radiusMatch( const Mat& queryDescriptors, const Ma
   }
 
   /* delete data */
-  delete mh;
   delete[] results;
   delete[] numres;
 }
@@ -527,15 +750,12 @@ void BinaryDescriptorMatcher::radiusMatch( const Mat& queryDescriptors, std::vec
   /* populate dataset */
   train();
 
-  /* set K */
-  dataset->setK( descrInDS );
-
   /* prepare structures for query */
   UINT32 *results = new UINT32[descrInDS * queryDescriptors.rows];
   UINT32 * numres = new UINT32[ ( 256 + 1 ) * ( queryDescriptors.rows )];
 
-  /* execute query */
-  dataset->batchquery( results, numres, queryDescriptors, queryDescriptors.rows, queryDescriptors.cols );
+  /* execute query, all the descriptors in dataset are requested */
+  dataset->batchquery( results, numres, queryDescriptors, descrInDS );
 
   /* compose matches */
   int index = 0;
@@ -592,47 +812,70 @@ void BinaryDescriptorMatcher::radiusMatch( const Mat& queryDescriptors, std::vec
 
 }
 
-/* execute a batch query */
-void BinaryDescriptorMatcher::Mihasher::batchquery( UINT32 * results, UINT32 *numres, const cv::Mat & queries, UINT32 numq, int dim1queries )
+/* buffers of the queries, each thread works on its own ones */
+struct BinaryDescriptorMatcher::Mihasher::QueryBuffers
 {
-  /* create and initialize a bitarray */
-  counter = new bitarray;
-  counter->init( N );
+  /* counter for eliminating duplicate results */
+  bitarray counter;
 
-  UINT32 *res = new UINT32[K * ( D + 1 )];
-  UINT64 *chunks = new UINT64[m];
-  UINT32 * presults = results;
-  UINT32 *pnumres = numres;
+  /* candidates marked in counter, they are unmarked at the end of the query */
+  std::vector<UINT32> visited;
 
-  /* make a copy of input queries */
-  cv::Mat queries_clone = queries.clone();
+  /* results grouped by their Hamming distance */
+  std::vector<std::vector<UINT32> > res;
 
-  /* set a pointer to first query (row) */
-  UINT8 *pq = queries_clone.ptr();
+  /* substrings of the query */
+  std::vector<UINT64> chunks;
 
-  /* loop over number of descriptors */
-  for ( size_t i = 0; i < numq; i++ )
+  QueryBuffers( UINT64 N, int D, int m ) :
+      counter( N ),
+      res( D + 1 ),
+      chunks( m )
   {
-    /* for every descriptor, query database */
-    query( presults, pnumres, pq, chunks, res );
+  }
+};
 
-    /* move pointer to write next K indeces */
-    presults += K;
-    pnumres += B + 1;
+/* run the queries of a range of rows */
+class BinaryDescriptorMatcher::Mihasher::BatchQueryInvoker : public ParallelLoopBody
+{
+ public:
+  BatchQueryInvoker( const Mihasher* _mh, UINT32* _results, UINT32* _numres, const Mat& _queries, int _K ) :
+      mh( _mh ),
+      results( _results ),
+      numres( _numres ),
+      queries( _queries ),
+      K( _K )
+  {
+  }
 
-    /* move forward pointer to current row in descriptors matrix */
-    pq += dim1queries;
+  virtual void operator()( const Range& range ) const
+  {
+    QueryBuffers buffers( mh->N, mh->D, mh->m );
 
+    for ( int i = range.start; i < range.end; i++ )
+      mh->query( results + (size_t) i * K, numres + (size_t) i * ( mh->B + 1 ), queries.ptr( i ), K, buffers );
   }
 
-  delete[] res;
-  delete[] chunks;
+ private:
+  const Mihasher* mh;
+  UINT32* results;
+  UINT32* numres;
+  const Mat& queries;
+  int K;
+};
+
+/* execute a batch query */
+void BinaryDescriptorMatcher::Mihasher::batchquery( UINT32 * results, UINT32 *numres, const cv::Mat & queries, int K ) const
+{
+  CV_Assert( queries.type() == CV_8UC1 && queries.cols == B_over_8 );
 
-  delete counter;
+  /* a few stripes per thread, so that the buffers are allocated once per stripe */
+  double nstripes = std::min( (double) queries.rows, std::max( getNumThreads(), 1 ) * 4.0 );
+  parallel_for_( Range( 0, queries.rows ), BatchQueryInvoker( this, results, numres, queries, K ), nstripes );
 }
 
 /* execute a single query */
-void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres, UINT8 * Query, UINT64 *chunks, UINT32 *res )
+void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres, const UINT8 * Query, int K, QueryBuffers& buffers ) const
 {
   /* if K == 0 that means we want everything to be processed.
    So maxres = N in that case. Otherwise K limits the results processed */
@@ -649,14 +892,19 @@ void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres,
   UINT32 nl = 0;
 
   UINT32 nd = 0;
-  UINT32 *arr;
+  const UINT32 *arr;
   int size = 0;
   UINT32 index;
   int hammd;
 
-  counter->erase();
+  /* used within generation of binary codes at a certain Hamming distance */
+  int power[100];
+
   memset( numres, 0, ( B + 1 ) * sizeof ( *numres ) );
+  for ( int i = 0; i <= D; i++ )
+    buffers.res[i].clear();
 
+  UINT64 *chunks = &buffers.chunks[0];
   split( chunks, Query, m, mplus, b );
 
   /* the growing search radius per substring */
@@ -712,14 +960,15 @@ void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres,
             for ( int c = 0; c < size; c++ )
             {
               index = arr[c];
-              if( !counter->get( index ) )
+              if( !buffers.counter.get( index ) )
               { /* if it is not a duplicate */
-                counter->set( index );
-                hammd = cv::line_descriptor::match( codes.ptr() + (UINT64) index * ( B_over_8 ), Query, B_over_8 );
+                buffers.counter.set( index );
+                buffers.visited.push_back( index );
+                hammd = cv::hal::normHamming( codes.ptr( (int) index ), Query, B_over_8 );
 
                 nc++;
                 if( hammd <= D && numres[hammd] < maxres )
-                  res[hammd * K + numres[hammd]] = index + 1;
+                  buffers.res[hammd].push_back( index + 1 );
 
                 numres[hammd]++;
               }
@@ -746,10 +995,14 @@ void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres,
   n = 0;
   for ( s = 0; s <= D && (int) n < K; s++ )
   {
-    for ( int c = 0; c < (int) numres[s] && (int) n < K; c++ )
-      results[n++] = res[s * K + c];
+    for ( int c = 0; c < (int) buffers.res[s].size() && (int) n < K; c++ )
+      results[n++] = buffers.res[s][c];
   }
 
+  /* unmark the verified candidates, cheaper than erasing the whole counter for large datasets */
+  for ( size_t i = 0; i < buffers.visited.size(); i++ )
+    buffers.counter.flip( buffers.visited[i] );
+  buffers.visited.clear();
 }
 
 /* constructor 2 */
@@ -769,6 +1022,8 @@ BinaryDescriptorMatcher::Mihasher::Mihasher( int B_val, int _m )
    (m-mplus) is the number of chunks with (b-1) bits */
   mplus = B - m * ( b - 1 );
 
+  N = 0;
+
   xornum = new UINT32[d + 2];
   xornum[0] = 0;
   for ( int i = 0; i <= d; i++ )
@@ -783,12 +1038,6 @@ BinaryDescriptorMatcher::Mihasher::Mihasher( int B_val, int _m )
     H[i].init( b - 1 );
 }
 
-/* K setter */
-void BinaryDescriptorMatcher::Mihasher::setK( int K_val )
-{
-  K = K_val;
-}
-
 /* desctructor */
 BinaryDescriptorMatcher::Mihasher::~Mihasher()
 {
@@ -796,32 +1045,36 @@ BinaryDescriptorMatcher::Mihasher::~Mihasher()
   delete[] H;
 }
 
-/* populate tables */
-void BinaryDescriptorMatcher::Mihasher::populate( cv::Mat & _codes, UINT32 N_val, int dim1codes )
+/* append codes to the tables */
+void BinaryDescriptorMatcher::Mihasher::insert( const cv::Mat & newCodes )
 {
-  N = N_val;
-  codes = _codes;
-  UINT64 * chunks = new UINT64[m];
+  if( newCodes.rows == 0 )
+    return;
 
-  UINT8 * pcodes = codes.ptr();
-  for ( UINT64 i = 0; i < N; i++, pcodes += dim1codes )
+  CV_Assert( newCodes.type() == CV_8UC1 && newCodes.cols == B_over_8 );
+
+  /* the new codes are indexed after the ones already in tables */
+  int first = codes.rows;
+  codes.push_back( newCodes );
+
+  std::vector<UINT64> chunks( m );
+  for ( int i = first; i < codes.rows; i++ )
   {
-    split( chunks, pcodes, m, mplus, b );
+    split( &chunks[0], codes.ptr( i ), m, mplus, b );
 
     for ( int k = 0; k < m; k++ )
       H[k].insert( chunks[k], (UINT32) i );
-
-    if( i % (int) ceil( N / 1000.0 ) == 0 )
-      fflush (stdout);
   }
 
-  delete[] chunks;
+  N = (UINT64) codes.rows;
 }
 
 /* constructor */
 BinaryDescriptorMatcher::SparseHashtable::SparseHashtable()
 {
   table = NULL;
+  pool = NULL;
+  offsets = NULL;
   size = 0;
   b = 0;
 }
@@ -835,7 +1088,7 @@ int BinaryDescriptorMatcher::SparseHashtable::init( int _b )
     return 1;
 
   size = UINT64_1 << ( b - 5 );  // size = 2 ^ b
-  table = (BucketGroup*) calloc( (size_t)size, sizeof(BucketGroup) );
+  table = new BucketGroup[(size_t) size];
 
   return 0;
 
@@ -844,26 +1097,108 @@ int BinaryDescriptorMatcher::SparseHashtable::init( int _b )
 /* destructor */
 BinaryDescriptorMatcher::SparseHashtable::~SparseHashtable()
 {
-  free (table);
+  delete[] table;
 }
 
 /* insert data */
 void BinaryDescriptorMatcher::SparseHashtable::insert( UINT64 index, UINT32 data )
 {
+  if( pool )
+    detach();
+
   table[index >> 5].insert( (int) ( index % 32 ), data );
 }
 
 /* query data */
-UINT32* BinaryDescriptorMatcher::SparseHashtable::query( UINT64 index, int *Size )
+const UINT32* BinaryDescriptorMatcher::SparseHashtable::query( UINT64 index, int *Size )
 {
+  if( pool )
+  {
+    const UINT32* group = pool + offsets[index >> 5];
+    return BucketGroup::query( group[0], group, (int) ( index % 32 ), Size );
+  }
+
   return table[index >> 5].query( (int) ( index % 32 ), Size );
 }
 
+/* use bucket groups stored in a flat pool */
+void BinaryDescriptorMatcher::SparseHashtable::attach( const UINT32* _pool, const UINT64* _offsets )
+{
+  delete[] table;
+  table = NULL;
+  pool = _pool;
+  offsets = _offsets;
+}
+
+/* copy attached bucket groups to table */
+void BinaryDescriptorMatcher::SparseHashtable::detach()
+{
+  table = new BucketGroup[(size_t) size];
+  for ( UINT64 i = 0; i < size; i++ )
+  {
+    const UINT32* group = pool + offsets[i];
+    table[i].empty = group[0];
+
+    /* the stored group has no free space, it is enlarged by next insertion */
+    if( group[1] > 0 )
+    {
+      table[i].group.assign( group, group + 2 + group[1] );
+      table[i].group[0] = table[i].group[1] = group[1];
+    }
+  }
+
+  pool = NULL;
+  offsets = NULL;
+}
+
+/* number of words needed to store the bucket groups in a flat pool */
+UINT64 BinaryDescriptorMatcher::SparseHashtable::flatSize() const
+{
+  if( pool )
+  {
+    UINT64 total = 0;
+    for ( UINT64 i = 0; i < size; i++ )
+      total += 2 + pool[offsets[i] + 1];
+    return total;
+  }
+
+  UINT64 total = 0;
+  for ( UINT64 i = 0; i < size; i++ )
+    total += 2 + ( table[i].group.empty() ? 0 : table[i].group[0] );
+  return total;
+}
+
+/* store the bucket groups in a flat pool: only the used part of each group is kept */
+void BinaryDescriptorMatcher::SparseHashtable::flatten( UINT32* dst, UINT64* dstOffsets, UINT64 base ) const
+{
+  UINT64 pos = 0;
+  for ( UINT64 i = 0; i < size; i++ )
+  {
+    dstOffsets[i] = base + pos;
+    if( pool )
+    {
+      const UINT32* group = pool + offsets[i];
+      memcpy( dst + pos, group, ( 2 + group[1] ) * sizeof(UINT32) );
+      pos += 2 + group[1];
+    }
+    else
+    {
+      const std::vector<uint32_t>& group = table[i].group;
+      UINT32 count = group.empty() ? 0 : group[0];
+      dst[pos] = table[i].empty;
+      dst[pos + 1] = count;
+      if( count > 0 )
+        memcpy( dst + pos + 2, &group[2], count * sizeof(UINT32) );
+      pos += 2 + count;
+    }
+  }
+}
+
 /* constructor */
 BinaryDescriptorMatcher::BucketGroup::BucketGroup()
 {
+  /* group is allocated by the first insertion */
   empty = 0;
-  group = std::vector < uint32_t > ( 2, 0 );
 }
 
 /* destructor */
@@ -947,16 +1282,22 @@ void BinaryDescriptorMatcher::BucketGroup::insert( int subindex, UINT32 data )
 }
 
 /* perform a query to the bucket */
-UINT32* BinaryDescriptorMatcher::BucketGroup::query( int subindex, int *size )
+const UINT32* BinaryDescriptorMatcher::BucketGroup::query( int subindex, int *size )
+{
+  return query( empty, group.empty() ? NULL : &group[0], subindex, size );
+}
+
+/* perform a query to a bucket stored as a flat array */
+const UINT32* BinaryDescriptorMatcher::BucketGroup::query( UINT32 _empty, const UINT32* _group, int subindex, int *size )
 {
-  if( empty & ( (UINT32) 1 << subindex ) )
+  if( _empty & ( (UINT32) 1 << subindex ) )
   {
     UINT32 lowerbits = ( (UINT32) 1 << subindex ) - 1;
-    int end = popcnt( empty & lowerbits );
-    int totones = popcnt( empty );
+    int end = popcnt( _empty & lowerbits );
+    int totones = popcnt( _empty );
 
-    *size = group[2 + end + 1] - group[2 + end];
-    return & ( * ( group.begin() + 2 + totones + 1 + (int) group[2 + end] ) );
+    *size = _group[2 + end + 1] - _group[2 + end];
+    return _group + 2 + totones + 1 + (int) _group[2 + end];
   }
 
   else
@@ -96,7 +96,7 @@ inline int match( UINT8*P, UINT8*Q, int codelb )
 }
 
 /* splitting function (b <= 64) */
-inline void split( UINT64 *chunks, UINT8 *code, int m, int mplus, int b )
+inline void split( UINT64 *chunks, const UINT8 *code, int m, int mplus, int b )
 {
   UINT64 temp = 0x0;
   int nbits = 0;
@@ -577,3 +577,122 @@ TEST( BinaryDescriptor_Matcher, regression)
   CV_BinaryDescriptorMatcherTest test( 0.01f );
   test.safe_run();
 }
+
+/* codes of the dataset with a few flipped bits */
+static void generatePerturbedQueries( const Mat& train, int count, int maxFlips, RNG& rng, Mat& query )
+{
+  query.create( count, train.cols, CV_8UC1 );
+  for ( int i = 0; i < count; i++ )
+  {
+    train.row( rng.uniform( 0, train.rows ) ).copyTo( query.row( i ) );
+    int flips = rng.uniform( 0, maxFlips + 1 );
+    for ( int f = 0; f < flips; f++ )
+      query.at<uchar>( i, rng.uniform( 0, train.cols ) ) ^= (uchar) ( 1 << rng.uniform( 0, 8 ) );
+  }
+}
+
+TEST( BinaryDescriptor_Matcher, knn_match_brute_force )
+{
+  RNG rng( 0x1234 );
+  Mat train( 20000, 32, CV_8UC1 ), query;
+  rng.fill( train, RNG::UNIFORM, Scalar( 0 ), Scalar( 256 ) );
+  generatePerturbedQueries( train, 500, 12, rng, query );
+
+  BFMatcher bf( NORM_HAMMING );
+  std::vector<std::vector<DMatch> > expected;
+  bf.knnMatch( query, train, expected, 2 );
+
+  /* the dataset is trained in two steps, the second one appends codes to the index */
+  Ptr<BinaryDescriptorMatcher> bdm = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+  int split = 12000;
+  bdm->add( std::vector<Mat>( 1, train.rowRange( 0, split ) ) );
+  bdm->train();
+  bdm->add( std::vector<Mat>( 1, train.rowRange( split, train.rows ) ) );
+
+  std::vector<std::vector<DMatch> > matches;
+  bdm->knnMatch( query, matches, 2 );
+  ASSERT_EQ( expected.size(), matches.size() );
+  for ( size_t i = 0; i < matches.size(); i++ )
+  {
+    ASSERT_EQ( 2u, matches[i].size() );
+    for ( size_t j = 0; j < matches[i].size(); j++ )
+    {
+      EXPECT_EQ( expected[i][j].distance, matches[i][j].distance ) << "query " << i;
+      EXPECT_EQ( matches[i][j].trainIdx < split ? 0 : 1, matches[i][j].imgIdx ) << "query " << i;
+    }
+  }
+
+  /* the index of the train matrix is reused by the second call */
+  for ( int call = 0; call < 2; call++ )
+  {
+    std::vector<std::vector<DMatch> > trainMatches;
+    bdm->knnMatch( query, train, trainMatches, 2 );
+    ASSERT_EQ( expected.size(), trainMatches.size() );
+    for ( size_t i = 0; i < trainMatches.size(); i++ )
+    {
+      ASSERT_EQ( 2u, trainMatches[i].size() );
+      for ( size_t j = 0; j < trainMatches[i].size(); j++ )
+        EXPECT_EQ( expected[i][j].distance, trainMatches[i][j].distance ) << "query " << i;
+    }
+  }
+}
+
+static void expectEqualMatches( const std::vector<std::vector<DMatch> >& expected, const std::vector<std::vector<DMatch> >& matches )
+{
+  ASSERT_EQ( expected.size(), matches.size() );
+  for ( size_t i = 0; i < matches.size(); i++ )
+  {
+    ASSERT_EQ( expected[i].size(), matches[i].size() ) << "query " << i;
+    for ( size_t j = 0; j < matches[i].size(); j++ )
+    {
+      EXPECT_EQ( expected[i][j].trainIdx, matches[i][j].trainIdx ) << "query " << i;
+      EXPECT_EQ( expected[i][j].imgIdx, matches[i][j].imgIdx ) << "query " << i;
+      EXPECT_EQ( expected[i][j].distance, matches[i][j].distance ) << "query " << i;
+    }
+  }
+}
+
+TEST( BinaryDescriptor_Matcher, save_load_index )
+{
+  RNG rng( 0x4321 );
+  Mat train( 6000, 32, CV_8UC1 ), query;
+  rng.fill( train, RNG::UNIFORM, Scalar( 0 ), Scalar( 256 ) );
+  generatePerturbedQueries( train, 300, 12, rng, query );
+
+  std::vector<Mat> images;
+  images.push_back( train.rowRange( 0, 2000 ) );
+  images.push_back( train.rowRange( 2000, 4500 ) );
+
+  Ptr<BinaryDescriptorMatcher> bdm = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+  bdm->add( images );
+
+  std::vector<std::vector<DMatch> > expected;
+  bdm->knnMatch( query, expected, 2 );
+
+  String filename = cv::tempfile( ".bin" );
+  bdm->saveIndex( filename );
+
+  Ptr<BinaryDescriptorMatcher> loaded = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+  loaded->loadIndex( filename );
+
+  std::vector<std::vector<DMatch> > matches;
+  loaded->knnMatch( query, matches, 2 );
+  expectEqualMatches( expected, matches );
+
+  /* descriptors appended to a loaded index give the same results of a dataset built at once */
+  std::vector<Mat> newImages( 1, train.rowRange( 4500, train.rows ) );
+  bdm->add( newImages );
+  bdm->knnMatch( query, expected, 2 );
+  loaded->add( newImages );
+  loaded->knnMatch( query, matches, 2 );
+  expectEqualMatches( expected, matches );
+
+  /* an extended loaded index is saved again */
+  loaded->saveIndex( filename );
+  Ptr<BinaryDescriptorMatcher> reloaded = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+  reloaded->loadIndex( filename );
+  reloaded->knnMatch( query, matches, 2 );
+  expectEqualMatches( expected, matches );
+
+  remove( filename.c_str() );
+}
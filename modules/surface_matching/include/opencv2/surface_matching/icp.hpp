@@ -135,6 +135,7 @@ public:
      *  \return On successful termination, the function returns 0.
      *
      *  \details It is assumed that the model is registered on the scene. Scene remains static, while the model transforms. The output poses transform the models onto the scene. Because of the point to plane minimization, the scene is expected to have the normals available. Expected to have the normals (Nx6).
+     *  The kd-tree of the scene is kept by the object, and it is reused by the next calls while the scene does not change.
      */
   int registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residual, double pose[16]);
 
@@ -148,6 +149,7 @@ public:
      *  \return On successful termination, the function returns 0.
      *
      *  \details It is assumed that the model is registered on the scene. Scene remains static, while the model transforms. The output poses transform the models onto the scene. Because of the point to plane minimization, the scene is expected to have the normals available. Expected to have the normals (Nx6).
+     *  The poses are registered in parallel, sharing the kd-tree of the scene.
      */
   int registerModelToScene(const Mat& srcPC, const Mat& dstPC, std::vector<Pose3DPtr>& poses);
 
@@ -159,6 +161,13 @@ private:
   int m_numLevels;
   int m_sampleType;
 
+  // kd-tree of the last scene, reused while the scene does not change
+  class SceneIndex;
+  Ptr<SceneIndex> m_sceneIndex;
+
+  Ptr<SceneIndex> getSceneIndex(const Mat& dstPC);
+  int registerModelToSceneIndex(const Mat& srcPC, const SceneIndex& scene, double& residual, double pose[16]) const;
+
 };
 
 //! @}
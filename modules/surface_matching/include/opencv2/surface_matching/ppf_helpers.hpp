@@ -56,19 +56,34 @@ namespace ppf_match_3d
 
 /**
  *  @brief Load a PLY file
- *  @param [in] fileName The PLY model to read
+ *  @param [in] fileName The PLY model to read. The ascii, binary_little_endian and binary_big_endian
+ *  formats are supported, and the vertices must be the first element of the file
  *  @param [in] withNormals Flag wheather the input PLY contains normal information,
  *  and whether it should be loaded or not
  *  @return Returns the matrix on successfull load
  */
 CV_EXPORTS Mat loadPLYSimple(const char* fileName, int withNormals);
 
+/**
+ *  @brief Load a PLY file and sample it on the fly, without holding the full point cloud in memory
+ *  @param [in] fileName The PLY model to read. It must contain the normals
+ *  @param [in] sampleStep The relative sampling step, as in samplePCByQuantization
+ *  @param [in] weightByCenter Enables/disables the weighting of the points by the distance to the cell centers
+ *  @return Returns the sampled point cloud with normals, the same as samplePCByQuantization applied
+ *  to the output of loadPLYSimple with the bounding box of computeBboxStd
+ *
+ *  The vertices are read in chunks in two passes over the file: the first one computes the bounding
+ *  box and the second one quantizes the points.
+ */
+CV_EXPORTS Mat loadPLYSampled(const char* fileName, float sampleStep, int weightByCenter=0);
+
 /**
  *  @brief Write a point cloud to PLY file
  *  @param [in] PC Input point cloud
  *  @param [in] fileName The PLY model file to write
+ *  @param [in] binary Write the vertices in the binary little endian format instead of ascii
 */
-CV_EXPORTS void writePLY(Mat PC, const char* fileName);
+CV_EXPORTS void writePLY(Mat PC, const char* fileName, bool binary=false);
 
 /**
 *  @brief Used for debbuging pruposes, writes a point cloud to a PLY file with the tip
@@ -140,6 +140,27 @@ public:
     */
   void match(const Mat& scene, std::vector<Pose3DPtr> &results, const double relativeSceneSampleStep=1.0/5.0, const double relativeSceneDistance=0.03);
 
+  /**
+    *  \brief Stores the trained model to a binary file.
+    *
+    *  @param [in] fileName Path of the file to be written
+    *
+    *  \details The file holds the parameters, the sampled model, the point pair features and the hashtable,
+    *  so that the model can be used after loading without training again. It is only readable on platforms
+    *  with the same byte order.
+    */
+  void saveModel(const String& fileName) const;
+
+  /**
+    *  \brief Loads a model stored by saveModel, replacing the current one.
+    *
+    *  @param [in] fileName Path of the file to be read
+    *
+    *  \details The file is mapped into memory and the model data are used in place, without copying them.
+    *  When the function returns, the instance is ready for calling "match".
+    */
+  void loadModel(const String& fileName);
+
   void read(const FileNode& fn);
   void write(FileStorage& fs) const;
 
@@ -149,8 +170,10 @@ protected:
   double sampling_step_relative, angle_step_relative, distance_step_relative;
   Mat sampled_pc, ppf;
   int num_ref_points, ppf_step;
-  hashtable_int* hash_table;
-  THash* hash_nodes;
+
+  // model point pairs (THash, 3 ints each) sorted by the bucket of their hashed PPF,
+  // pairs of bucket b lie in [hash_offsets[b], hash_offsets[b+1])
+  Mat hash_nodes, hash_offsets;
 
   double position_threshold, rotation_threshold;
   bool use_weighted_avg;
@@ -169,6 +192,10 @@ private:
   void clusterPoses(std::vector<Pose3DPtr> poseList, int numPoses, std::vector<Pose3DPtr> &finalPoses);
 
   bool trained;
+
+  // file mapped by loadModel, whose data are used by the model
+  class MappedFile;
+  Ptr<MappedFile> model_file;
 };
 
 //! @}
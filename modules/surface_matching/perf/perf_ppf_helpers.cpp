@@ -0,0 +1,91 @@
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                          License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2014, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+// Author: Tolga Birdal <tbirdal AT gmail.com>
+
+
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::ppf_match_3d;
+using namespace perf;
+
+// ascii or binary PLY files
+typedef perf::TestBaseWithParam<bool> PLY_Format;
+
+// writes a random cloud with unit normals
+static void writeCloud(const string& fileName, bool binary)
+{
+  Mat pc(500000, 6, CV_32F);
+  RNG rng(0);
+  rng.fill(pc.colRange(0, 3), RNG::UNIFORM, -100, 100);
+  rng.fill(pc.colRange(3, 6), RNG::UNIFORM, -1, 1);
+  for (int i = 0; i < pc.rows; i++)
+    normalize(pc.row(i).colRange(3, 6), pc.row(i).colRange(3, 6));
+
+  writePLY(pc, fileName.c_str(), binary);
+}
+
+PERF_TEST_P(PLY_Format, loadPLYSimple, testing::Bool())
+{
+  string fileName = cv::tempfile(".ply");
+  writeCloud(fileName, GetParam());
+
+  Mat pc;
+  TEST_CYCLE() pc = loadPLYSimple(fileName.c_str(), 1);
+
+  ASSERT_EQ(500000, pc.rows);
+
+  remove(fileName.c_str());
+  SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST_P(PLY_Format, loadPLYSampled, testing::Bool())
+{
+  string fileName = cv::tempfile(".ply");
+  writeCloud(fileName, GetParam());
+
+  Mat sampled;
+  TEST_CYCLE() sampled = loadPLYSampled(fileName.c_str(), 0.025f);
+
+  ASSERT_FALSE(sampled.empty());
+
+  remove(fileName.c_str());
+  SANITY_CHECK_NOTHING();
+}
@@ -0,0 +1,138 @@
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                          License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2014, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+// Author: Tolga Birdal <tbirdal AT gmail.com>
+
+
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::ppf_match_3d;
+using namespace perf;
+
+#define PPF_MODELS testing::Values(string("parasaurolophus_6700.ply"), string("parasaurolophus_low_normals2.ply"))
+
+typedef perf::TestBaseWithParam<string> PPF3DDetector_Model;
+
+static Mat loadModel(const string& name)
+{
+  Mat pc = loadPLYSimple((string(SURFACE_MATCHING_SAMPLES_DATA) + name).c_str(), 1);
+  CV_Assert(!pc.empty());
+  return pc;
+}
+
+// the scene is the model moved by a fixed pose (30 degrees around z and a shift)
+static Mat makeScene(const Mat& pc)
+{
+  const double c = cos(CV_PI/6), s = sin(CV_PI/6);
+  double pose[16] = { c, -s, 0, 10,
+                      s,  c, 0, -5,
+                      0,  0, 1, 20,
+                      0,  0, 0, 1 };
+  return transformPCPose(pc, pose);
+}
+
+PERF_TEST_P(PPF3DDetector_Model, trainModel, PPF_MODELS)
+{
+  Mat pc = loadModel(GetParam());
+
+  TEST_CYCLE()
+  {
+    PPF3DDetector detector(0.025, 0.05);
+    detector.trainModel(pc);
+  }
+
+  SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST_P(PPF3DDetector_Model, match, PPF_MODELS)
+{
+  Mat pc = loadModel(GetParam());
+  Mat scene = makeScene(pc);
+
+  PPF3DDetector detector(0.025, 0.05);
+  detector.trainModel(pc);
+
+  vector<Pose3DPtr> results;
+  TEST_CYCLE() detector.match(scene, results, 1.0/40.0, 0.05);
+
+  ASSERT_FALSE(results.empty());
+  SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST_P(PPF3DDetector_Model, loadModel, PPF_MODELS)
+{
+  Mat pc = loadModel(GetParam());
+
+  PPF3DDetector trained(0.025, 0.05);
+  trained.trainModel(pc);
+  string fileName = cv::tempfile(".ppf");
+  trained.saveModel(fileName);
+
+  PPF3DDetector detector;
+  TEST_CYCLE() detector.loadModel(fileName);
+
+  remove(fileName.c_str());
+  SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST_P(PPF3DDetector_Model, registerModelToScene, PPF_MODELS)
+{
+  Mat pc = loadModel(GetParam());
+  Mat scene = makeScene(pc);
+
+  PPF3DDetector detector(0.025, 0.05);
+  detector.trainModel(pc);
+  vector<Pose3DPtr> results;
+  detector.match(scene, results, 1.0/40.0, 0.05);
+  ASSERT_FALSE(results.empty());
+  results.resize(std::min(results.size(), (size_t)8));
+
+  // the kd-tree of the scene is built by the first registration and reused by the next ones
+  ICP icp(100, 0.005f, 2.5f, 8);
+  TEST_CYCLE()
+  {
+    vector<Pose3DPtr> poses(results.size());
+    for (size_t i = 0; i < results.size(); i++)
+      poses[i] = results[i]->clone();
+    icp.registerModelToScene(pc, scene, poses);
+  }
+
+  SANITY_CHECK_NOTHING();
+}
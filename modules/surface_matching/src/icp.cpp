@@ -107,6 +107,22 @@ static double computeDistToOrigin(Mat srcPC)
   return dist;
 }
 
+// compute the average distance to a center, without moving the point cloud
+static double computeDistToCenter(const Mat& srcPC, const double center[3])
+{
+  int height = srcPC.rows;
+  double dist = 0;
+
+  for (int i=0; i<height; i++)
+  {
+    const float *row = srcPC.ptr<float>(i);
+    const double d[3] = {row[0]-center[0], row[1]-center[1], row[2]-center[2]};
+    dist += sqrt(d[0]*d[0]+d[1]*d[1]+d[2]*d[2]);
+  }
+
+  return dist;
+}
+
 // From numerical receipes: Finds the median of an array
 static float medianF(float arr[], int n)
 {
@@ -192,36 +208,83 @@ static float getRejectionThreshold(float* r, int m, float outlierScale)
 }
 
 // Kok Lim Low's linearization
-static void minimizePointToPlaneMetric(Mat Src, Mat Dst, Mat& X)
+// The normal equations A'A X = A'b are accumulated over the correspondences, block by block and in parallel,
+// without forming A and b. The scene points are normalized on the fly as (pt-dstCenter)*dstScale, their normals
+// are kept. The squared distance between the corresponding points (all of their columns) is returned.
+static double minimizePointToPlaneMetric(const Mat& Src, const Mat& Dst, const int* indicesSrc, const int* indicesDst,
+                                         int numCorr, const double dstCenter[3], double dstScale, Mat& X)
 {
-  //Mat sub = Dst - Src;
-  Mat A = Mat(Src.rows, 6, CV_64F);
-  Mat b = Mat(Src.rows, 1, CV_64F);
+  // fixed block size, so that the sums do not depend on the number of threads
+  const int blockSize = 1024;
+  const int numBlocks = (numCorr + blockSize - 1) / blockSize;
+  const int numSums = 21 + 6 + 1;
+  const int cols = Src.cols;
+  std::vector<double> sums(numBlocks*numSums, 0.0);
 
 #if defined _OPENMP
 #pragma omp parallel for
 #endif
-  for (int i=0; i<Src.rows; i++)
+  for (int blk=0; blk<numBlocks; blk++)
   {
-    const double *srcPt = (double*)&Src.data[i*Src.step];
-    const double *dstPt = (double*)&Dst.data[i*Dst.step];
-    const double *normals = &dstPt[3];
-    double *bVal = (double*)&b.data[i*b.step];
-    double *aRow = (double*)&A.data[i*A.step];
+    double* AtA = &sums[blk*numSums];
+    double* Atb = AtA + 21;
+    double& sqDist = Atb[6];
+    const int end = std::min(numCorr, (blk+1)*blockSize);
+
+    for (int i=blk*blockSize; i<end; i++)
+    {
+      const float *srcRow = Src.ptr<float>(indicesSrc[i]);
+      const float *dstRow = Dst.ptr<float>(indicesDst[i]);
+      const double srcPt[3] = {srcRow[0], srcRow[1], srcRow[2]};
+      const double dstPt[3] = {(dstRow[0]-dstCenter[0])*dstScale, (dstRow[1]-dstCenter[1])*dstScale,
+                               (dstRow[2]-dstCenter[2])*dstScale};
+      const double normals[3] = {dstRow[3], dstRow[4], dstRow[5]};
+
+      const double sub[3]={dstPt[0]-srcPt[0], dstPt[1]-srcPt[1], dstPt[2]-srcPt[2]};
+
+      double aRow[6];
+      const double bVal = TDot3(sub, normals);
+      TCross(srcPt, normals, aRow);
 
-    const double sub[3]={dstPt[0]-srcPt[0], dstPt[1]-srcPt[1], dstPt[2]-srcPt[2]};
+      aRow[3] = normals[0];
+      aRow[4] = normals[1];
+      aRow[5] = normals[2];
 
-    *bVal = TDot3(sub, normals);
-    TCross(srcPt, normals, aRow);
+      // upper triangle of A'A, row by row
+      for (int r=0, k=0; r<6; r++)
+      {
+        for (int c=r; c<6; c++, k++)
+          AtA[k] += aRow[r]*aRow[c];
+        Atb[r] += aRow[r]*bVal;
+      }
 
-    aRow[3] = normals[0];
-    aRow[4] = normals[1];
-    aRow[5] = normals[2];
+      sqDist += sub[0]*sub[0] + sub[1]*sub[1] + sub[2]*sub[2];
+      for (int c=3; c<cols; c++)
+      {
+        const double d = (double)dstRow[c] - (double)srcRow[c];
+        sqDist += d*d;
+      }
+    }
   }
 
-  cv::solve(A, b, X, DECOMP_SVD);
-}
+  for (int blk=1; blk<numBlocks; blk++)
+  {
+    for (int k=0; k<numSums; k++)
+      sums[k] += sums[blk*numSums + k];
+  }
+
+  Mat AtA(6, 6, CV_64F), Atb(6, 1, CV_64F);
+  for (int r=0, k=0; r<6; r++)
+  {
+    for (int c=r; c<6; c++, k++)
+      AtA.at<double>(r, c) = AtA.at<double>(c, r) = sums[k];
+    Atb.at<double>(r) = sums[21 + r];
+  }
+
+  cv::solve(AtA, Atb, X, DECOMP_SVD);
 
+  return numBlocks ? sums[27] : 0;
+}
 
 static void getTransformMat(Mat X, double Pose[16])
 {
@@ -292,39 +355,113 @@ static hashtable_int* getHashtable(int* data, size_t length, int numMaxElement)
   return hashtable;
 }
 
+// kd-tree of a scene point cloud. It is built on the scene as it is, since the normalization
+// of the scene in the registration depends on the model
+class ICP::SceneIndex
+{
+public:
+  SceneIndex(const Mat& scene)
+  {
+    points = scene.clone();
+    computeMeanCols(points, mean);
+    flann = indexPCFlann(points);
+  }
+
+  ~SceneIndex()
+  {
+    destroyFlann(flann);
+  }
+
+  bool isSameScene(const Mat& scene) const
+  {
+    if (scene.rows != points.rows || scene.cols != points.cols || scene.type() != points.type())
+      return false;
+
+    for (int i=0; i<scene.rows; i++)
+    {
+      if (memcmp(scene.ptr(i), points.ptr(i), points.cols*points.elemSize()) != 0)
+        return false;
+    }
+
+    return true;
+  }
+
+  // nearest scene point of every row of pts (x, y, z of scene coordinates), the rows are searched in parallel blocks
+  void query(const Mat& pts, int* indices, float* distances) const
+  {
+    const int blockSize = 256;
+    const int numBlocks = (pts.rows + blockSize - 1) / blockSize;
+
+#if defined _OPENMP
+#pragma omp parallel for
+#endif
+    for (int blk=0; blk<numBlocks; blk++)
+    {
+      const int start = blk*blockSize, end = std::min(pts.rows, start + blockSize);
+      Mat blockPts = pts.rowRange(start, end);
+      Mat blockIndices(end-start, 1, CV_32S, indices + start);
+      Mat blockDistances(end-start, 1, CV_32F, distances + start);
+      queryPCFlann(flann, blockPts, blockIndices, blockDistances);
+    }
+  }
+
+  Mat points;
+  double mean[3];
+  void* flann;
+
+private:
+  SceneIndex(const SceneIndex&);
+  SceneIndex& operator=(const SceneIndex&);
+};
+
+Ptr<ICP::SceneIndex> ICP::getSceneIndex(const Mat& dstPC)
+{
+  CV_Assert(dstPC.type() == CV_32F || dstPC.type() == CV_32FC1);
+
+  if (m_sceneIndex.empty() || !m_sceneIndex->isSameScene(dstPC))
+    m_sceneIndex = makePtr<SceneIndex>(dstPC);
+
+  return m_sceneIndex;
+}
+
 // source point clouds are assumed to contain their normals
 int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residual, double pose[16])
+{
+  Ptr<SceneIndex> scene = getSceneIndex(dstPC);
+  return registerModelToSceneIndex(srcPC, *scene, residual, pose);
+}
+
+int ICP::registerModelToSceneIndex(const Mat& srcPC, const SceneIndex& scene, double& residual, double pose[16]) const
 {
   int n = srcPC.rows;
 
   const bool useRobustReject = m_rejectionScale>0;
 
+  // the scene is not moved: its points are normalized when they are used and the model points
+  // are brought back to the scene coordinates to query the kd-tree
+  const Mat& dstPC0 = scene.points;
   Mat srcTemp = srcPC.clone();
-  Mat dstTemp = dstPC.clone();
-  double meanSrc[3], meanDst[3];
+  double meanSrc[3];
+  const double* meanDst = scene.mean;
   computeMeanCols(srcTemp, meanSrc);
-  computeMeanCols(dstTemp, meanDst);
   double meanAvg[3]={0.5*(meanSrc[0]+meanDst[0]), 0.5*(meanSrc[1]+meanDst[1]), 0.5*(meanSrc[2]+meanDst[2])};
   subtractColumns(srcTemp, meanAvg);
-  subtractColumns(dstTemp, meanAvg);
 
   double distSrc = computeDistToOrigin(srcTemp);
-  double distDst = computeDistToOrigin(dstTemp);
+  double distDst = computeDistToCenter(dstPC0, meanAvg);
 
   double scale = (double)n / ((distSrc + distDst)*0.5);
 
   srcTemp(cv::Range(0, srcTemp.rows), cv::Range(0,3)) *= scale;
-  dstTemp(cv::Range(0, dstTemp.rows), cv::Range(0,3)) *= scale;
 
   Mat srcPC0 = srcTemp;
-  Mat dstPC0 = dstTemp;
+
+  // squared distances of the kd-tree are scaled as the ones between normalized point clouds
+  const float distScale = (float)(scale*scale);
 
   // initialize pose
   matrixIdentity(4, pose);
 
-  void* flann = indexPCFlann(dstPC0);
-  Mat M = Mat::eye(4,4,CV_64F);
-
   double tempResidual = 0;
 
 
@@ -369,6 +506,7 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
 
     Mat Indices(2, sizesResult, CV_32S, indices, 0);
     Mat Distances(2, sizesResult, CV_32F, distances, 0);
+    Mat queryPts((int)numElSrc, 3, CV_32F);
 
     // use robust weighting for outlier treatment
     int* indicesModel = new int[numElSrc];
@@ -384,7 +522,19 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
     {
       size_t di=0, selInd = 0;
 
-      queryPCFlann(flann, Src_Moved, Indices, Distances);
+      for (int r=0; r<queryPts.rows; r++)
+      {
+        const float *srcPt = Src_Moved.ptr<float>(r);
+        float *queryPt = queryPts.ptr<float>(r);
+        queryPt[0] = (float)(srcPt[0]/scale + meanAvg[0]);
+        queryPt[1] = (float)(srcPt[1]/scale + meanAvg[1]);
+        queryPt[2] = (float)(srcPt[2]/scale + meanAvg[2]);
+      }
+
+      scene.query(queryPts, indices, distances);
+
+      for (int r=0; r<queryPts.rows; r++)
+        distances[r] *= distScale;
 
       for (di=0; di<numElSrc; di++)
       {
@@ -454,34 +604,14 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
 
       if (selInd)
       {
-
-        Mat Src_Match = Mat((int)selInd, srcPCT.cols, CV_64F);
-        Mat Dst_Match = Mat((int)selInd, srcPCT.cols, CV_64F);
-
-        for (di=0; di<selInd; di++)
-        {
-          const int indModel = indicesModel[di];
-          const int indScene = indicesScene[di];
-          const float *srcPt = (float*)&srcPCT.data[indModel*srcPCT.step];
-          const float *dstPt = (float*)&dstPC0.data[indScene*dstPC0.step];
-          double *srcMatchPt = (double*)&Src_Match.data[di*Src_Match.step];
-          double *dstMatchPt = (double*)&Dst_Match.data[di*Dst_Match.step];
-          int ci=0;
-
-          for (ci=0; ci<srcPCT.cols; ci++)
-          {
-            srcMatchPt[ci] = (double)srcPt[ci];
-            dstMatchPt[ci] = (double)dstPt[ci];
-          }
-        }
-
         Mat X;
-        minimizePointToPlaneMetric(Src_Match, Dst_Match, X);
+        double sqDist = minimizePointToPlaneMetric(srcPCT, dstPC0, indicesModel, indicesScene, (int)selInd,
+                                                   meanAvg, scale, X);
 
         getTransformMat(X, PoseX);
         Src_Moved = transformPCPose(srcPCT, PoseX);
 
-        double fval = cv::norm(Src_Match, Dst_Match)/(double)(Src_Moved.rows);
+        double fval = sqrt(sqDist)/(double)(Src_Moved.rows);
 
         // Calculate change in error between iterations
         fval_perc=fval/fval_old;
@@ -533,18 +663,23 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
 
   residual = tempResidual;
 
-  destroyFlann(flann);
   return 0;
 }
 
 // source point clouds are assumed to contain their normals
 int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, std::vector<Pose3DPtr>& poses)
 {
-  for (size_t i=0; i<poses.size(); i++)
+  // the kd-tree of the scene is built once and shared by the registrations, which are independent
+  Ptr<SceneIndex> scene = getSceneIndex(dstPC);
+
+#if defined _OPENMP
+#pragma omp parallel for
+#endif
+  for (int i=0; i<(int)poses.size(); i++)
   {
     double poseICP[16]={0};
     Mat srcTemp = transformPCPose(srcPC, poses[i]->pose);
-    registerModelToScene(srcTemp, dstPC, poses[i]->residual, poseICP);
+    registerModelToSceneIndex(srcTemp, *scene, poses[i]->residual, poseICP);
     poses[i]->appendPose(poseICP);
   }
   return 0;
@@ -55,64 +55,338 @@ void getRandomRotation(double R[9]);
 void meanCovLocalPC(const float* pc, const int ws, const int point_count, double CovMat[3][3], double Mean[4]);
 void meanCovLocalPCInd(const float* pc, const int* Indices, const int ws, const int point_count, double CovMat[3][3], double Mean[4]);
 
-Mat loadPLYSimple(const char* fileName, int withNormals)
+// number of vertices processed at once by the streaming PLY functions
+static const int PLY_CHUNK_ROWS = 65536;
+
+static bool isLittleEndianHost()
 {
-  Mat cloud;
-  int numVertices=0;
+  const int one = 1;
+  return *(const char*)&one == 1;
+}
 
-  std::ifstream ifs(fileName);
+// Reader of the vertices of a PLY file (ascii, binary little or big endian). The vertices are read
+// in chunks, so that large point clouds can be processed without holding them in memory
+class PLYVertexReader
+{
+public:
+  PLYVertexReader(const char* fileName) : numVertices(0), verticesRead(0), rowSize(0), ascii(true), swapBytes(false)
+  {
+    ifs.open(fileName, std::ios::in | std::ios::binary);
+    if (ifs.is_open())
+      readHeader();
+  }
 
-  if (!ifs.is_open())
+  bool isOpen() const { return ifs.is_open(); }
+  int getNumVertices() const { return numVertices; }
+  bool hasNormals() const { return fields[3] >= 0 && fields[4] >= 0 && fields[5] >= 0; }
+
+  // read the next vertices into the rows of chunk (x, y, z and, for 6 columns, the normals),
+  // the number of vertices read is returned
+  int read(Mat& chunk)
   {
-    printf("Cannot open file...\n");
-    return Mat();
+    CV_Assert(chunk.type() == CV_32FC1 && (chunk.cols == 3 || chunk.cols == 6));
+    if (chunk.cols == 6 && !hasNormals())
+      CV_Error(Error::StsBadArg, "The PLY file does not contain the normals");
+
+    const int n = std::min(chunk.rows, numVertices - verticesRead);
+    if (ascii)
+    {
+      std::vector<double> values(properties.size());
+      std::string line;
+      for (int i = 0; i < n; i++)
+      {
+        do
+        {
+          if (!std::getline(ifs, line))
+            CV_Error(Error::StsParseError, "Unexpected end of the PLY file");
+        } while (line.find_first_not_of(" \t\r") == std::string::npos);
+
+        const char* ptr = line.c_str();
+        for (size_t k = 0; k < values.size(); k++)
+        {
+          char* next;
+          values[k] = strtod(ptr, &next);
+          if (next == ptr)
+            CV_Error(Error::StsParseError, "Invalid vertex in the PLY file");
+          ptr = next;
+        }
+
+        float* row = chunk.ptr<float>(i);
+        for (int c = 0; c < chunk.cols; c++)
+          row[c] = (float)values[fields[c]];
+      }
+    }
+    else
+    {
+      buffer.resize((size_t)std::max(n, 1)*rowSize);
+      ifs.read(&buffer[0], (std::streamsize)n*rowSize);
+      if (ifs.gcount() != (std::streamsize)n*rowSize)
+        CV_Error(Error::StsParseError, "Unexpected end of the PLY file");
+
+      for (int i = 0; i < n; i++)
+      {
+        const uchar* src = (const uchar*)&buffer[(size_t)i*rowSize];
+        float* row = chunk.ptr<float>(i);
+        for (int c = 0; c < chunk.cols; c++)
+        {
+          const Property& prop = properties[fields[c]];
+          row[c] = (float)readBinary(src + prop.offset, prop.type);
+        }
+      }
+    }
+
+    verticesRead += n;
+    return n;
   }
 
-  std::string str;
-  while (str.substr(0, 10) !="end_header")
+  // restart reading from the first vertex
+  void rewind()
+  {
+    ifs.clear();
+    ifs.seekg(dataStart);
+    verticesRead = 0;
+  }
+
+private:
+  enum { PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64 };
+
+  struct Property
+  {
+    std::string name;
+    int type, offset;
+  };
+
+  static int parseType(const std::string& name, int& size)
   {
-    std::string entry = str.substr(0, 14);
-    if (entry == "element vertex")
+    static const char* names[][2] = { {"char", "int8"}, {"uchar", "uint8"}, {"short", "int16"}, {"ushort", "uint16"},
+                                      {"int", "int32"}, {"uint", "uint32"}, {"float", "float32"}, {"double", "float64"} };
+    static const int sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+    for (int t = PLY_INT8; t <= PLY_FLOAT64; t++)
     {
-      numVertices = atoi(str.substr(15, str.size()-15).c_str());
+      if (name == names[t][0] || name == names[t][1])
+      {
+        size = sizes[t];
+        return t;
+      }
     }
-    std::getline(ifs, str);
+
+    CV_Error(Error::StsParseError, "Unknown property type \"" + name + "\" in the PLY file");
+    return -1;
   }
 
-  if (withNormals)
-    cloud=Mat(numVertices, 6, CV_32FC1);
-  else
-    cloud=Mat(numVertices, 3, CV_32FC1);
+  double readBinary(const uchar* src, int type) const
+  {
+    uchar buf[8];
+    int size = (type == PLY_FLOAT64) ? 8 : (type >= PLY_INT32) ? 4 : (type >= PLY_INT16) ? 2 : 1;
+    for (int b = 0; b < size; b++)
+      buf[b] = swapBytes ? src[size - 1 - b] : src[b];
+
+    switch (type)
+    {
+    case PLY_INT8: return *(const schar*)buf;
+    case PLY_UINT8: return *(const uchar*)buf;
+    case PLY_INT16: { short v; memcpy(&v, buf, 2); return v; }
+    case PLY_UINT16: { ushort v; memcpy(&v, buf, 2); return v; }
+    case PLY_INT32: { int v; memcpy(&v, buf, 4); return v; }
+    case PLY_UINT32: { unsigned v; memcpy(&v, buf, 4); return v; }
+    case PLY_FLOAT32: { float v; memcpy(&v, buf, 4); return v; }
+    default: { double v; memcpy(&v, buf, 8); return v; }
+    }
+  }
 
-  for (int i = 0; i < numVertices; i++)
+  void readHeader()
   {
-    float* data = (float*)(&cloud.data[i*cloud.step[0]]);
-    if (withNormals)
+    std::string line;
+    bool inVertex = false, vertexSeen = false;
+
+    std::getline(ifs, line);
+    if (line.substr(0, 3) != "ply")
+      CV_Error(Error::StsParseError, "Not a PLY file");
+
+    while (std::getline(ifs, line))
     {
-      ifs >> data[0] >> data[1] >> data[2] >> data[3] >> data[4] >> data[5];
+      std::istringstream iss(line);
+      std::string keyword;
+      iss >> keyword;
 
-      // normalize to unit norm
-      double norm = sqrt(data[3]*data[3] + data[4]*data[4] + data[5]*data[5]);
-      if (norm>0.00001)
+      if (keyword == "format")
       {
-        data[3]/=(float)norm;
-        data[4]/=(float)norm;
-        data[5]/=(float)norm;
+        std::string format;
+        iss >> format;
+        ascii = format == "ascii";
+        if (!ascii && format != "binary_little_endian" && format != "binary_big_endian")
+          CV_Error(Error::StsParseError, "Unknown PLY format \"" + format + "\"");
+        swapBytes = !ascii && (format == "binary_little_endian") != isLittleEndianHost();
       }
+      else if (keyword == "element")
+      {
+        std::string name;
+        iss >> name;
+        inVertex = name == "vertex";
+        if (inVertex)
+        {
+          iss >> numVertices;
+          vertexSeen = true;
+        }
+        else if (!vertexSeen)
+          CV_Error(Error::StsUnsupportedFormat, "The vertices must be the first element of the PLY file");
+      }
+      else if (keyword == "property" && inVertex)
+      {
+        std::string type;
+        Property prop;
+        iss >> type >> prop.name;
+        if (type == "list")
+          CV_Error(Error::StsUnsupportedFormat, "List properties of the vertices are not supported");
+
+        int size = 0;
+        prop.type = parseType(type, size);
+        prop.offset = rowSize;
+        rowSize += size;
+        properties.push_back(prop);
+      }
+      else if (keyword == "end_header")
+        break;
     }
-    else
+
+    dataStart = ifs.tellg();
+
+    // the coordinates and the normals are looked up by name, otherwise they are the first properties
+    static const char* names[] = { "x", "y", "z", "nx", "ny", "nz" };
+    for (int c = 0; c < 6; c++)
+    {
+      fields[c] = -1;
+      for (size_t k = 0; k < properties.size(); k++)
+      {
+        if (properties[k].name == names[c])
+          fields[c] = (int)k;
+      }
+    }
+
+    if (fields[0] < 0 || fields[1] < 0 || fields[2] < 0)
+    {
+      for (int c = 0; c < 3; c++)
+        fields[c] = c < (int)properties.size() ? c : -1;
+    }
+    if (!hasNormals())
+    {
+      for (int c = 3; c < 6; c++)
+        fields[c] = c < (int)properties.size() ? c : -1;
+    }
+
+    if (fields[0] < 0 || fields[1] < 0 || fields[2] < 0)
+      CV_Error(Error::StsParseError, "The PLY file does not contain vertices");
+  }
+
+  std::ifstream ifs;
+  std::streampos dataStart;
+  std::vector<Property> properties;
+  std::vector<char> buffer;
+  int fields[6];
+  int numVertices, verticesRead, rowSize;
+  bool ascii, swapBytes;
+};
+
+// normalize the normals of a point cloud to unit norm
+static void normalizeNormals(Mat pc)
+{
+  for (int i = 0; i < pc.rows; i++)
+  {
+    float* data = pc.ptr<float>(i);
+    double norm = sqrt(data[3]*data[3] + data[4]*data[4] + data[5]*data[5]);
+    if (norm>0.00001)
     {
-      ifs >> data[0] >> data[1] >> data[2];
+      data[3]/=(float)norm;
+      data[4]/=(float)norm;
+      data[5]/=(float)norm;
     }
   }
+}
+
+Mat loadPLYSimple(const char* fileName, int withNormals)
+{
+  PLYVertexReader reader(fileName);
+
+  if (!reader.isOpen())
+  {
+    printf("Cannot open file...\n");
+    return Mat();
+  }
+
+  Mat cloud(reader.getNumVertices(), withNormals ? 6 : 3, CV_32FC1);
+
+  // read in chunks, straight into the rows of the cloud
+  for (int i = 0; i < cloud.rows; i += PLY_CHUNK_ROWS)
+  {
+    Mat chunk = cloud.rowRange(i, std::min(cloud.rows, i + PLY_CHUNK_ROWS));
+    reader.read(chunk);
+  }
+
+  if (withNormals)
+    normalizeNormals(cloud);
 
   //cloud *= 5.0f;
   return cloud;
 }
 
-void writePLY(Mat PC, const char* FileName)
+Mat loadPLYSampled(const char* fileName, float sampleStep, int weightByCenter)
+{
+  PLYVertexReader reader(fileName);
+
+  if (!reader.isOpen())
+  {
+    printf("Cannot open file...\n");
+    return Mat();
+  }
+
+  const int numVertices = reader.getNumVertices();
+  if (numVertices == 0)
+    return Mat();
+
+  Mat chunk(std::min(numVertices, PLY_CHUNK_ROWS), 6, CV_32FC1);
+
+  // first pass: bounding box, as computeBboxStd
+  float xRange[2], yRange[2], zRange[2];
+  for (int i = 0; i < numVertices; )
+  {
+    int n = reader.read(chunk);
+    float xr[2], yr[2], zr[2];
+    computeBboxStd(chunk.rowRange(0, n), xr, yr, zr);
+
+    if (i == 0)
+    {
+      xRange[0] = xr[0]; xRange[1] = xr[1];
+      yRange[0] = yr[0]; yRange[1] = yr[1];
+      zRange[0] = zr[0]; zRange[1] = zr[1];
+    }
+    else
+    {
+      xRange[0] = std::min(xRange[0], xr[0]); xRange[1] = std::max(xRange[1], xr[1]);
+      yRange[0] = std::min(yRange[0], yr[0]); yRange[1] = std::max(yRange[1], yr[1]);
+      zRange[0] = std::min(zRange[0], zr[0]); zRange[1] = std::max(zRange[1], zr[1]);
+    }
+    i += n;
+  }
+
+  // second pass: quantization
+  PCQuantizer quantizer(xRange, yRange, zRange, sampleStep, weightByCenter);
+  reader.rewind();
+  for (int i = 0; i < numVertices; )
+  {
+    int n = reader.read(chunk);
+    Mat rows = chunk.rowRange(0, n);
+    normalizeNormals(rows);
+    quantizer.add(rows);
+    i += n;
+  }
+
+  return quantizer.getSampled(6);
+}
+
+void writePLY(Mat PC, const char* FileName, bool binary)
 {
-  std::ofstream outFile( FileName );
+  std::ofstream outFile( FileName, std::ios::out | std::ios::binary );
 
   if ( !outFile )
   {
@@ -127,37 +401,68 @@ void writePLY(Mat PC, const char* FileName)
 
   const int pointNum = ( int ) PC.rows;
   const int vertNum  = ( int ) PC.cols;
-
-  outFile << "ply" << std::endl;
-  outFile << "format ascii 1.0" << std::endl;
-  outFile << "element vertex " << pointNum << std::endl;
-  outFile << "property float x" << std::endl;
-  outFile << "property float y" << std::endl;
-  outFile << "property float z" << std::endl;
+  const int outNum = (vertNum==6) ? 6 : 3;
+
+  outFile << "ply\n";
+  outFile << (binary ? "format binary_little_endian 1.0\n" : "format ascii 1.0\n");
+  outFile << "element vertex " << pointNum << "\n";
+  outFile << "property float x\n";
+  outFile << "property float y\n";
+  outFile << "property float z\n";
   if (vertNum==6)
   {
-    outFile << "property float nx" << std::endl;
-    outFile << "property float ny" << std::endl;
-    outFile << "property float nz" << std::endl;
+    outFile << "property float nx\n";
+    outFile << "property float ny\n";
+    outFile << "property float nz\n";
   }
-  outFile << "end_header" << std::endl;
+  outFile << "end_header\n";
 
   ////
   // Points
   ////
 
-  for ( int pi = 0; pi < pointNum; ++pi )
+  if (binary)
   {
-    const float* point = (float*)(&PC.data[ pi*PC.step ]);
+    // the rows are written in chunks, swapping the bytes on big endian hosts
+    const bool swapBytes = !isLittleEndianHost();
+    std::vector<float> buffer((size_t)std::min(pointNum, PLY_CHUNK_ROWS)*outNum);
 
-    outFile << point[0] << " "<<point[1]<<" "<<point[2];
-
-    if (vertNum==6)
+    for (int start = 0; start < pointNum; start += PLY_CHUNK_ROWS)
     {
-      outFile<<" " << point[3] << " "<<point[4]<<" "<<point[5];
+      const int end = std::min(pointNum, start + PLY_CHUNK_ROWS);
+      float* dst = buffer.empty() ? 0 : &buffer[0];
+      for (int pi = start; pi < end; ++pi)
+      {
+        const float* point = (float*)(&PC.data[ pi*PC.step ]);
+        for (int c = 0; c < outNum; c++, dst++)
+        {
+          *dst = point[c];
+          if (swapBytes)
+          {
+            uchar* b = (uchar*)dst;
+            std::swap(b[0], b[3]);
+            std::swap(b[1], b[2]);
+          }
+        }
+      }
+      outFile.write((const char*)&buffer[0], (std::streamsize)(end - start)*outNum*sizeof(float));
     }
+  }
+  else
+  {
+    for ( int pi = 0; pi < pointNum; ++pi )
+    {
+      const float* point = (float*)(&PC.data[ pi*PC.step ]);
 
-    outFile << std::endl;
+      outFile << point[0] << " "<<point[1]<<" "<<point[2];
+
+      if (vertNum==6)
+      {
+        outFile<<" " << point[3] << " "<<point[4]<<" "<<point[5];
+      }
+
+      outFile << "\n";
+    }
   }
 
   return;
@@ -274,154 +579,138 @@ void queryPCFlann(void* flannIndex, Mat& pc, Mat& indices, Mat& distances, const
   ((FlannIndex*)flannIndex)->knnSearch(obj_32f, indices, distances, numNeighbors, cvflann::SearchParams(32));
 }
 
-// uses a volume instead of an octree
-// TODO: Right now normals are required.
-// This is much faster than sample_pc_octree
-Mat samplePCByQuantization(Mat pc, float xrange[2], float yrange[2], float zrange[2], float sampleStep, int weightByCenter)
+// Accumulates the points of a cloud into the cells of a regular grid over its bounding box. The points can be
+// added in chunks, and the sampled cloud has one point per occupied cell, in the order of the cells
+class PCQuantizer
 {
-  std::vector< std::vector<int> > map;
+public:
+  PCQuantizer(const float xRange[2], const float yRange[2], const float zRange[2], float sampleStep, int _weightByCenter)
+  {
+    numSamplesDim = (int)(1.0/sampleStep);
+    weightByCenter = _weightByCenter;
 
-  int numSamplesDim = (int)(1.0/sampleStep);
+    xrange[0] = xRange[0]; xrange[1] = xRange[1];
+    yrange[0] = yRange[0]; yrange[1] = yRange[1];
+    zrange[0] = zRange[0]; zrange[1] = zRange[1];
+    xr = xrange[1] - xrange[0];
+    yr = yrange[1] - yrange[0];
+    zr = zrange[1] - zrange[0];
 
-  float xr = xrange[1] - xrange[0];
-  float yr = yrange[1] - yrange[0];
-  float zr = zrange[1] - zrange[0];
+    cellSlots.assign((size_t)(numSamplesDim+1)*(numSamplesDim+1)*(numSamplesDim+1), -1);
+  }
 
-  int numPoints = 0;
+  void add(const Mat& pc)
+  {
+    const bool hasNormals = pc.cols >= 6;
 
-  map.resize((numSamplesDim+1)*(numSamplesDim+1)*(numSamplesDim+1));
+    // OpenMP might seem like a good idea, but it didn't speed this up for me
+    for (int i=0; i<pc.rows; i++)
+    {
+      const float* point = pc.ptr<float>(i);
 
-  // OpenMP might seem like a good idea, but it didn't speed this up for me
-  //#pragma omp parallel for
-  for (int i=0; i<pc.rows; i++)
-  {
-    const float* point = (float*)(&pc.data[i * pc.step]);
+      // quantize a point
+      const int xCell =(int) ((float)numSamplesDim*(point[0]-xrange[0])/xr);
+      const int yCell =(int) ((float)numSamplesDim*(point[1]-yrange[0])/yr);
+      const int zCell =(int) ((float)numSamplesDim*(point[2]-zrange[0])/zr);
+      const int index = xCell*numSamplesDim*numSamplesDim+yCell*numSamplesDim+zCell;
 
-    // quantize a point
-    const int xCell =(int) ((float)numSamplesDim*(point[0]-xrange[0])/xr);
-    const int yCell =(int) ((float)numSamplesDim*(point[1]-yrange[0])/yr);
-    const int zCell =(int) ((float)numSamplesDim*(point[2]-zrange[0])/zr);
-    const int index = xCell*numSamplesDim*numSamplesDim+yCell*numSamplesDim+zCell;
+      int& slot = cellSlots[index];
+      if (slot < 0)
+      {
+        slot = (int)(sums.size() / NUM_SUMS);
+        sums.resize(sums.size() + NUM_SUMS, 0.0);
+      }
+      double* cell = &sums[(size_t)slot*NUM_SUMS];
 
-    /*#pragma omp critical
-        {*/
-    map[index].push_back(i);
-    //  }
-  }
+      double w = 1;
+      if (weightByCenter)
+      {
+        int zc = index % numSamplesDim;
+        int yc = ((index-zc)/numSamplesDim) % numSamplesDim;
+        int xc = ((index-zc-yc*numSamplesDim)/(numSamplesDim*numSamplesDim));
+
+        const double dx = point[0] - (((double)xc+0.5) * (double)xr/numSamplesDim + (double)xrange[0]);
+        const double dy = point[1] - (((double)yc+0.5) * (double)yr/numSamplesDim + (double)yrange[0]);
+        const double dz = point[2] - (((double)zc+0.5) * (double)zr/numSamplesDim + (double)zrange[0]);
+        const double d = sqrt(dx*dx+dy*dy+dz*dz);
+
+        // it is possible to use different weighting schemes.
+        // inverse weigthing was just good for me
+        // exp( - (distance/h)**2 )
+        w = (d>EPS) ? 1.0/d : 0;
+      }
 
-  for (unsigned int i=0; i<map.size(); i++)
-  {
-    numPoints += (map[i].size()>0);
+      cell[0] += w*(double)point[0];
+      cell[1] += w*(double)point[1];
+      cell[2] += w*(double)point[2];
+      if (hasNormals)
+      {
+        cell[3] += w*(double)point[3];
+        cell[4] += w*(double)point[4];
+        cell[5] += w*(double)point[5];
+      }
+      cell[6] += w;
+    }
   }
 
-  Mat pcSampled = Mat(numPoints, pc.cols, CV_32F);
-  int c = 0;
-
-  for (unsigned int i=0; i<map.size(); i++)
+  Mat getSampled(int cols) const
   {
-    double px=0, py=0, pz=0;
-    double nx=0, ny=0, nz=0;
+    const int numPoints = (int)(sums.size() / NUM_SUMS);
+    Mat pcSampled = Mat::zeros(numPoints, cols, CV_32F);
+    int c = 0;
 
-    std::vector<int> curCell = map[i];
-    int cn = (int)curCell.size();
-    if (cn>0)
+    for (size_t i=0; i<cellSlots.size(); i++)
     {
-      if (weightByCenter)
-      {
-        int xCell, yCell, zCell;
-        double xc, yc, zc;
-        double weightSum = 0 ;
-        zCell = i % numSamplesDim;
-        yCell = ((i-zCell)/numSamplesDim) % numSamplesDim;
-        xCell = ((i-zCell-yCell*numSamplesDim)/(numSamplesDim*numSamplesDim));
-
-        xc = ((double)xCell+0.5) * (double)xr/numSamplesDim + (double)xrange[0];
-        yc = ((double)yCell+0.5) * (double)yr/numSamplesDim + (double)yrange[0];
-        zc = ((double)zCell+0.5) * (double)zr/numSamplesDim + (double)zrange[0];
-
-        for (int j=0; j<cn; j++)
-        {
-          const int ptInd = curCell[j];
-          float* point = (float*)(&pc.data[ptInd * pc.step]);
-          const double dx = point[0]-xc;
-          const double dy = point[1]-yc;
-          const double dz = point[2]-zc;
-          const double d = sqrt(dx*dx+dy*dy+dz*dz);
-          double w = 0;
-
-          if (d>EPS)
-          {
-            // it is possible to use different weighting schemes.
-            // inverse weigthing was just good for me
-            // exp( - (distance/h)**2 )
-            //const double w = exp(-d*d);
-            w = 1.0/d;
-          }
+      if (cellSlots[i] < 0)
+        continue;
 
-          //float weights[3]={1,1,1};
-          px += w*(double)point[0];
-          py += w*(double)point[1];
-          pz += w*(double)point[2];
-          nx += w*(double)point[3];
-          ny += w*(double)point[4];
-          nz += w*(double)point[5];
+      const double* cell = &sums[(size_t)cellSlots[i]*NUM_SUMS];
+      const double weightSum = cell[6];
+      float *pcData = pcSampled.ptr<float>(c++);
+      pcData[0]=(float)(cell[0]/weightSum);
+      pcData[1]=(float)(cell[1]/weightSum);
+      pcData[2]=(float)(cell[2]/weightSum);
 
-          weightSum+=w;
-        }
-        px/=(double)weightSum;
-        py/=(double)weightSum;
-        pz/=(double)weightSum;
-        nx/=(double)weightSum;
-        ny/=(double)weightSum;
-        nz/=(double)weightSum;
-      }
-      else
+      if (cols >= 6)
       {
-        for (int j=0; j<cn; j++)
-        {
-          const int ptInd = curCell[j];
-          float* point = (float*)(&pc.data[ptInd * pc.step]);
-
-          px += (double)point[0];
-          py += (double)point[1];
-          pz += (double)point[2];
-          nx += (double)point[3];
-          ny += (double)point[4];
-          nz += (double)point[5];
-        }
+        const double nx = cell[3]/weightSum, ny = cell[4]/weightSum, nz = cell[5]/weightSum;
 
-        px/=(double)cn;
-        py/=(double)cn;
-        pz/=(double)cn;
-        nx/=(double)cn;
-        ny/=(double)cn;
-        nz/=(double)cn;
+        // normalize the normals
+        double norm = sqrt(nx*nx+ny*ny+nz*nz);
 
+        if (norm>EPS)
+        {
+          pcData[3]=(float)(nx/norm);
+          pcData[4]=(float)(ny/norm);
+          pcData[5]=(float)(nz/norm);
+        }
       }
+    }
 
-      float *pcData = (float*)(&pcSampled.data[c*pcSampled.step[0]]);
-      pcData[0]=(float)px;
-      pcData[1]=(float)py;
-      pcData[2]=(float)pz;
+    return pcSampled;
+  }
 
-      // normalize the normals
-      double norm = sqrt(nx*nx+ny*ny+nz*nz);
+private:
+  // per occupied cell: weighted sums of the coordinates, of the normals and of the weights
+  enum { NUM_SUMS = 7 };
 
-      if (norm>EPS)
-      {
-        pcData[3]=(float)(nx/norm);
-        pcData[4]=(float)(ny/norm);
-        pcData[5]=(float)(nz/norm);
-      }
-      //#pragma omp atomic
-      c++;
+  int numSamplesDim, weightByCenter;
+  float xrange[2], yrange[2], zrange[2];
+  float xr, yr, zr;
 
-      curCell.clear();
-    }
-  }
+  // slot of the sums of every cell, -1 for empty cells
+  std::vector<int> cellSlots;
+  std::vector<double> sums;
+};
 
-  map.clear();
-  return pcSampled;
+// uses a volume instead of an octree
+// TODO: Right now normals are required.
+// This is much faster than sample_pc_octree
+Mat samplePCByQuantization(Mat pc, float xrange[2], float yrange[2], float zrange[2], float sampleStep, int weightByCenter)
+{
+  PCQuantizer quantizer(xrange, yrange, zrange, sampleStep, weightByCenter);
+  quantizer.add(pc);
+  return quantizer.getSampled(pc.cols);
 }
 
 void shuffle(int *array, size_t n)
@@ -41,6 +41,18 @@
 #include "precomp.hpp"
 #include "hash_murmur.hpp"
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace cv 
 {
 namespace ppf_match_3d
@@ -48,6 +60,13 @@ namespace ppf_match_3d
 
 static const size_t PPF_LENGTH = 5;
 
+// votes of a scene reference point, and the cells of the accumulator which received them
+struct VotingBuffer
+{
+  std::vector<unsigned int> accumulator;
+  std::vector<unsigned int> voted;
+};
+
 // routines for assisting sort
 static bool pose3DPtrCompare(const Pose3DPtr& a, const Pose3DPtr& b)
 {
@@ -209,17 +228,8 @@ void PPF3DDetector::computePPFFeatures(const double p1[4], const double n1[4],
 
 void PPF3DDetector::clearTrainingModels()
 {
-  if (this->hash_nodes)
-  {
-    free(this->hash_nodes);
-    this->hash_nodes=0;
-  }
-
-  if (this->hash_table)
-  {
-    hashtableDestroy(this->hash_table);
-    this->hash_table=0;
-  }
+  hash_nodes.release();
+  hash_offsets.release();
 }
 
 PPF3DDetector::~PPF3DDetector()
@@ -246,10 +256,6 @@ void PPF3DDetector::trainModel(const Mat &PC)
 
   Mat sampled = samplePCByQuantization(PC, xRange, yRange, zRange, (float)sampling_step_relative,0);
 
-  int size = sampled.rows*sampled.rows;
-
-  hashtable_int* hashTable = hashtableCreate(size, NULL);
-
   int numPPF = sampled.rows*sampled.rows;
   ppf = Mat(numPPF, PPF_LENGTH, CV_32FC1);
   int ppfStep = (int)ppf.step;
@@ -258,14 +264,13 @@ void PPF3DDetector::trainModel(const Mat &PC)
   // TODO: Maybe I could sample 1/5th of them here. Check the performance later.
   int numRefPoints = sampled.rows;
 
-  // pre-allocate the hash nodes
-  hash_nodes = (THash*)calloc(numRefPoints*numRefPoints, sizeof(THash));
+  // the hashtable is built from all the pairs once they are computed, so that this loop
+  // writes independent entries and runs in parallel
+  std::vector<THash> pairs(numPPF);
 
-  // TODO : This can easily be parallelized. But we have to lock hashtable_insert.
-  // I realized that performance drops when this loop is parallelized (unordered
-  // inserts into the hashtable
-  // But it is still there to be investigated. For now, I leave this unparallelized
-  // since this is just a training part.
+#if defined _OPENMP
+#pragma omp parallel for
+#endif
   for (int i=0; i<numRefPoints; i++)
   {
     float* f1 = (float*)(&sampled.data[i * sampledStep]);
@@ -289,13 +294,11 @@ void PPF3DDetector::trainModel(const Mat &PC)
         unsigned int corrInd = i*numRefPoints+j;
         unsigned int ppfInd = corrInd*ppfStep;
 
-        THash* hashNode = &hash_nodes[i*numRefPoints+j];
-        hashNode->id = hashValue;
+        THash* hashNode = &pairs[corrInd];
+        hashNode->id = (int)hashValue;
         hashNode->i = i;
         hashNode->ppfInd = ppfInd;
 
-        hashtableInsertHashed(hashTable, hashValue, (void*)hashNode);
-
         float* ppfRow = (float*)(&(ppf.data[ ppfInd ]));
         ppfRow[0] = (float)f[0];
         ppfRow[1] = (float)f[1];
@@ -306,12 +309,254 @@ void PPF3DDetector::trainModel(const Mat &PC)
     }
   }
 
+  // counting sort of the pairs by bucket: the pairs of a bucket are contiguous and keep the order
+  // of the reference points
+  int numPairs = numRefPoints*(numRefPoints-1);
+  unsigned int numBuckets = next_power_of_two((unsigned int)std::max(numPairs, 16));
+  Mat offsets = Mat::zeros(numBuckets+1, 1, CV_32S);
+  Mat nodes(std::max(numPairs, 1), 1, CV_32SC3);
+  int* offsetsPtr = offsets.ptr<int>();
+  THash* nodesPtr = nodes.ptr<THash>();
+
+  for (int k=0; k<numPPF; k++)
+  {
+    if (k / numRefPoints != k % numRefPoints)
+      offsetsPtr[((unsigned int)pairs[k].id & (numBuckets-1)) + 1]++;
+  }
+
+  for (unsigned int b=0; b<numBuckets; b++)
+    offsetsPtr[b+1] += offsetsPtr[b];
+
+  std::vector<int> bucketEnd(offsetsPtr, offsetsPtr + numBuckets);
+  for (int k=0; k<numPPF; k++)
+  {
+    if (k / numRefPoints != k % numRefPoints)
+      nodesPtr[bucketEnd[(unsigned int)pairs[k].id & (numBuckets-1)]++] = pairs[k];
+  }
+
+  hash_nodes = nodes;
+  hash_offsets = offsets;
   angle_step = angle_step_radians;
   distance_step = distanceStep;
-  hash_table = hashTable;
   ppf_step = ppfStep;
   num_ref_points = numRefPoints;
   sampled_pc = sampled;
+  model_file.release();
+  trained = true;
+}
+
+///////////////////////// SERIALIZATION ////////////////////////////////////////
+
+// model file mapped into memory. The matching only reads the model, so the pages are mapped
+// read-only and shared with the page cache
+class PPF3DDetector::MappedFile
+{
+public:
+  explicit MappedFile(const String& fileName) : ptr(NULL), len(0)
+  {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+      LARGE_INTEGER fileSize;
+      if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+      {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping)
+        {
+          // the view holds a reference to the mapping object
+          ptr = (const uchar*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+          CloseHandle(mapping);
+        }
+        if (ptr)
+          len = (size_t)fileSize.QuadPart;
+      }
+      CloseHandle(file);
+    }
+#else
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+      struct stat st;
+      if (fstat(fd, &st) == 0 && st.st_size > 0)
+      {
+        void* addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+          ptr = (const uchar*)addr;
+          len = (size_t)st.st_size;
+        }
+      }
+      close(fd);
+    }
+#endif
+
+    if (!ptr)
+      CV_Error(Error::StsError, "Can't read the PPF model from \"" + fileName + "\"");
+  }
+
+  ~MappedFile()
+  {
+#ifdef _WIN32
+    UnmapViewOfFile(ptr);
+#else
+    munmap((void*)ptr, len);
+#endif
+  }
+
+  // matrices wrapping the model data
+  Mat wrap(size_t pos, int rows, int cols, int type) const
+  {
+    return Mat(rows, cols, type, (void*)(ptr + pos));
+  }
+
+  const uchar* ptr;
+  size_t len;
+
+private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+};
+
+// header of model files. It is followed by the sampled model, the point pair features (floats),
+// the offsets of the hashtable buckets and the hashtable nodes (ints)
+struct PPFModelHeader
+{
+  char magic[8];
+  unsigned int version;
+  unsigned int byteOrder;
+  double angleStep, angleStepRadians, distanceStep;
+  double samplingStepRelative, angleStepRelative, distanceStepRelative;
+  double positionThreshold, rotationThreshold;
+  int numRefPoints, ppfStep, useWeightedAvg, sceneSampleStep;
+  int sampledRows, sampledCols, ppfRows, ppfCols;
+  int numNodes, numOffsets;
+};
+
+static const char PPF_MODEL_MAGIC[8] = {'P', 'P', 'F', '3', 'D', 'M', 'D', 'L'};
+static const unsigned int PPF_MODEL_VERSION = 1;
+static const unsigned int PPF_MODEL_BYTE_ORDER = 0x01020304;
+
+static void writeRows(std::ofstream& out, const Mat& m)
+{
+  for (int i = 0; i < m.rows; i++)
+    out.write((const char*)m.ptr(i), m.cols*m.elemSize());
+}
+
+void PPF3DDetector::saveModel(const String& fileName) const
+{
+  if (!trained)
+  {
+    CV_Error(Error::StsError, "The model is not trained. Cannot save it");
+  }
+
+  CV_Assert(sampled_pc.type() == CV_32FC1 && ppf.type() == CV_32FC1 && ppf.isContinuous());
+  CV_Assert(hash_nodes.type() == CV_32SC3 && hash_offsets.type() == CV_32SC1);
+
+  PPFModelHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PPF_MODEL_MAGIC, sizeof(header.magic));
+  header.version = PPF_MODEL_VERSION;
+  header.byteOrder = PPF_MODEL_BYTE_ORDER;
+  header.angleStep = angle_step;
+  header.angleStepRadians = angle_step_radians;
+  header.distanceStep = distance_step;
+  header.samplingStepRelative = sampling_step_relative;
+  header.angleStepRelative = angle_step_relative;
+  header.distanceStepRelative = distance_step_relative;
+  header.positionThreshold = position_threshold;
+  header.rotationThreshold = rotation_threshold;
+  header.numRefPoints = num_ref_points;
+  header.ppfStep = ppf_step;
+  header.useWeightedAvg = use_weighted_avg ? 1 : 0;
+  header.sceneSampleStep = scene_sample_step;
+  header.sampledRows = sampled_pc.rows;
+  header.sampledCols = sampled_pc.cols;
+  header.ppfRows = ppf.rows;
+  header.ppfCols = ppf.cols;
+  header.numNodes = hash_nodes.rows;
+  header.numOffsets = hash_offsets.rows;
+
+  std::ofstream out(fileName.c_str(), std::ios::binary);
+  if (!out)
+    CV_Error(Error::StsError, "Can't open \"" + fileName + "\" for writing");
+
+  out.write((const char*)&header, sizeof(header));
+  writeRows(out, sampled_pc);
+  writeRows(out, ppf);
+  writeRows(out, hash_offsets);
+  writeRows(out, hash_nodes);
+
+  if (!out)
+    CV_Error(Error::StsError, "Can't write \"" + fileName + "\"");
+}
+
+void PPF3DDetector::loadModel(const String& fileName)
+{
+  Ptr<MappedFile> file = makePtr<MappedFile>(fileName);
+
+  PPFModelHeader header;
+  if (file->len < sizeof(header))
+    CV_Error(Error::StsParseError, "\"" + fileName + "\" is not a PPF model");
+  memcpy(&header, file->ptr, sizeof(header));
+
+  if (memcmp(header.magic, PPF_MODEL_MAGIC, sizeof(header.magic)) != 0 || header.version != PPF_MODEL_VERSION)
+    CV_Error(Error::StsParseError, "\"" + fileName + "\" is not a PPF model");
+  if (header.byteOrder != PPF_MODEL_BYTE_ORDER)
+    CV_Error(Error::StsUnsupportedFormat, "\"" + fileName + "\" was saved on a platform with a different byte order");
+
+  // the sizes must agree with the ones of trainModel and match the length of the file
+  const int n = header.numRefPoints;
+  if (n <= 0 || header.sampledRows != n || header.sampledCols < 6 || header.ppfCols != (int)PPF_LENGTH ||
+      (double)header.ppfRows != (double)n*n || header.ppfStep != (int)(PPF_LENGTH*sizeof(float)) ||
+      header.numOffsets < 2 || ((header.numOffsets - 1) & (header.numOffsets - 2)) != 0 || header.numNodes < 1)
+    CV_Error(Error::StsParseError, "\"" + fileName + "\" is corrupted");
+
+  const size_t sampledPos = sizeof(header);
+  const size_t ppfPos = sampledPos + (size_t)header.sampledRows*header.sampledCols*sizeof(float);
+  const size_t offsetsPos = ppfPos + (size_t)header.ppfRows*header.ppfCols*sizeof(float);
+  const size_t nodesPos = offsetsPos + (size_t)header.numOffsets*sizeof(int);
+  if (file->len != nodesPos + (size_t)header.numNodes*sizeof(THash))
+    CV_Error(Error::StsParseError, "\"" + fileName + "\" is corrupted");
+
+  Mat offsets = file->wrap(offsetsPos, header.numOffsets, 1, CV_32S);
+  const int* offsetsPtr = offsets.ptr<int>();
+  for (int b = 0; b + 1 < header.numOffsets; b++)
+  {
+    if (offsetsPtr[b] < 0 || offsetsPtr[b] > offsetsPtr[b+1] || offsetsPtr[b+1] > header.numNodes)
+      CV_Error(Error::StsParseError, "\"" + fileName + "\" is corrupted");
+  }
+
+  Mat nodes = file->wrap(nodesPos, header.numNodes, 1, CV_32SC3);
+  const THash* nodesPtr = nodes.ptr<THash>();
+  for (int k = 0; k < header.numNodes; k++)
+  {
+    if (nodesPtr[k].i < 0 || nodesPtr[k].i >= n || nodesPtr[k].ppfInd < 0 ||
+        nodesPtr[k].ppfInd / header.ppfStep >= header.ppfRows || nodesPtr[k].ppfInd % header.ppfStep != 0)
+      CV_Error(Error::StsParseError, "\"" + fileName + "\" is corrupted");
+  }
+
+  clearTrainingModels();
+
+  angle_step = header.angleStep;
+  angle_step_radians = header.angleStepRadians;
+  distance_step = header.distanceStep;
+  sampling_step_relative = header.samplingStepRelative;
+  angle_step_relative = header.angleStepRelative;
+  distance_step_relative = header.distanceStepRelative;
+  position_threshold = header.positionThreshold;
+  rotation_threshold = header.rotationThreshold;
+  use_weighted_avg = header.useWeightedAvg != 0;
+  scene_sample_step = header.sceneSampleStep;
+  num_ref_points = n;
+  ppf_step = header.ppfStep;
+
+  sampled_pc = file->wrap(sampledPos, header.sampledRows, header.sampledCols, CV_32FC1);
+  ppf = file->wrap(ppfPos, header.ppfRows, header.ppfCols, CV_32FC1);
+  hash_offsets = offsets;
+  hash_nodes = nodes;
+  model_file = file;
   trained = true;
 }
 
@@ -484,6 +729,9 @@ void PPF3DDetector::match(const Mat& pc, std::vector<Pose3DPtr>& results, const
   float distanceStep = (float)distance_step;
   unsigned int n = num_ref_points;
   std::vector<Pose3DPtr> poseList;
+  const int* hashOffsets = hash_offsets.ptr<int>();
+  const THash* hashNodes = hash_nodes.ptr<THash>();
+  const unsigned int hashMask = (unsigned int)(hash_offsets.rows - 2);
   int sceneSamplingStep = scene_sample_step;
 
   // compute bbox
@@ -498,12 +746,15 @@ void PPF3DDetector::match(const Mat& pc, std::vector<Pose3DPtr>& results, const
   float distanceSampleStep = diameter * RelativeSceneDistance;*/
   Mat sampled = samplePCByQuantization(pc, xRange, yRange, zRange, (float)relativeSceneDistance, 0);
 
-  // allocate the accumulator : Moved this to the inside of the loop
-  /*#if !defined (_OPENMP)
-     unsigned int* accumulator = (unsigned int*)calloc(numAngles*n, sizeof(unsigned int));
-  #endif*/
+  // one pose per scene reference point, each iteration writes its own slot
+  poseList.resize((sampled.rows + sceneSamplingStep - 1)/sceneSamplingStep);
 
-  poseList.reserve((sampled.rows/sceneSamplingStep)+4);
+  // voting buffers of the threads, allocated at their first reference point and then reused
+  int numThreads = 1;
+#if defined _OPENMP
+  numThreads = omp_get_max_threads();
+#endif
+  std::vector<VotingBuffer> buffers(numThreads);
 
 #if defined _OPENMP
 #pragma omp parallel for
@@ -513,12 +764,21 @@ void PPF3DDetector::match(const Mat& pc, std::vector<Pose3DPtr>& results, const
     unsigned int refIndMax = 0, alphaIndMax = 0;
     unsigned int maxVotes = 0;
 
+#if defined _OPENMP
+    VotingBuffer& buffer = buffers[omp_get_thread_num()];
+#else
+    VotingBuffer& buffer = buffers[0];
+#endif
+    if (buffer.accumulator.empty())
+      buffer.accumulator.resize(numAngles*n, 0);
+
     float* f1 = (float*)(&sampled.data[i * sampled.step]);
     const double p1[4] = {f1[0], f1[1], f1[2], 0};
     const double n1[4] = {f1[3], f1[4], f1[5], 0};
     double *row2, *row3, tsg[3]={0}, Rsg[9]={0}, RInv[9]={0};
 
-    unsigned int* accumulator = (unsigned int*)calloc(numAngles*n, sizeof(unsigned int));
+    unsigned int* accumulator = &buffer.accumulator[0];
+    std::vector<unsigned int>& voted = buffer.voted;
     computeTransformRT(p1, n1, Rsg, tsg);
     row2=&Rsg[3];
     row3=&Rsg[6];
@@ -558,11 +818,16 @@ void PPF3DDetector::match(const Mat& pc, std::vector<Pose3DPtr>& results, const
 
         alpha_scene=-alpha_scene;
 
-        hashnode_i* node = hashtableGetBucketHashed(hash_table, (hashValue));
+        const unsigned int bucket = hashValue & hashMask;
 
-        while (node)
+        for (int k = hashOffsets[bucket]; k < hashOffsets[bucket+1]; k++)
         {
-          THash* tData = (THash*) node->data;
+          const THash* tData = &hashNodes[k];
+
+          // the bucket may hold pairs of other PPFs
+          if (tData->id != (int)hashValue)
+            continue;
+
           int corrI = (int)tData->i;
           int ppfInd = (int)tData->ppfInd;
           float* ppfCorrScene = (float*)(&ppf.data[ppfInd]);
@@ -581,31 +846,31 @@ void PPF3DDetector::match(const Mat& pc, std::vector<Pose3DPtr>& results, const
 
           unsigned int accIndex = corrI * numAngles + alpha_index;
 
-          accumulator[accIndex]++;
-          node = node->next;
+          if (accumulator[accIndex]++ == 0)
+            voted.push_back(accIndex);
         }
       }
     }
 
-    // Maximize the accumulator
-    for (unsigned int k = 0; k < n; k++)
+    // Maximize the accumulator, only the voted cells are visited and cleared.
+    // On ties, the lowest cell is taken as in a scan of the whole accumulator
+    unsigned int accIndMax = 0;
+    for (size_t k = 0; k < voted.size(); k++)
     {
-      for (int j = 0; j < numAngles; j++)
+      const unsigned int accInd = voted[k];
+      const unsigned int accVal = accumulator[ accInd ];
+      if (accVal > maxVotes || (accVal == maxVotes && accInd < accIndMax))
       {
-        const unsigned int accInd = k*numAngles + j;
-        const unsigned int accVal = accumulator[ accInd ];
-        if (accVal > maxVotes)
-        {
-          maxVotes = accVal;
-          refIndMax = k;
-          alphaIndMax = j;
-        }
-
-#if !defined (_OPENMP)
-        accumulator[accInd ] = 0;
-#endif
+        maxVotes = accVal;
+        accIndMax = accInd;
       }
+
+      accumulator[accInd ] = 0;
     }
+    voted.clear();
+
+    refIndMax = accIndMax / numAngles;
+    alphaIndMax = accIndMax % numAngles;
 
     // invert Tsg : Luckily rotation is orthogonal: Inverse = Transpose.
     // We are not required to invert.
@@ -649,11 +914,7 @@ void PPF3DDetector::match(const Mat& pc, std::vector<Pose3DPtr>& results, const
 
     Pose3DPtr pose(new Pose3D(alpha, refIndMax, maxVotes));
     pose->updatePose(rawPose);
-    poseList.push_back(pose);
-
-#if defined (_OPENMP)
-    free(accumulator);
-#endif
+    poseList[i/sceneSamplingStep] = pose;
   }
 
   // TODO : Make the parameters relative if not arguments.
@@ -0,0 +1,228 @@
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                          License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2014, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+
+#include "test_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::ppf_match_3d;
+
+// a random cloud with unit normals
+static Mat makeCloud(int rows)
+{
+  Mat pc(rows, 6, CV_32F);
+  RNG rng(0);
+  rng.fill(pc.colRange(0, 3), RNG::UNIFORM, -1, 1);
+  rng.fill(pc.colRange(3, 6), RNG::UNIFORM, -1, 1);
+  for (int i = 0; i < pc.rows; i++)
+    normalize(pc.row(i).colRange(3, 6), pc.row(i).colRange(3, 6));
+  return pc;
+}
+
+static bool isLittleEndianHost()
+{
+  const int one = 1;
+  return *(const char*)&one == 1;
+}
+
+static void swapBytes(char* data, size_t size)
+{
+  for (size_t i = 0; i < size / 2; i++)
+    std::swap(data[i], data[size - 1 - i]);
+}
+
+// rewrites a binary little endian PLY file of float properties in the big endian format
+static void convertToBigEndian(const string& fileName)
+{
+  ifstream ifs(fileName.c_str(), ios::in | ios::binary);
+  string contents((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+  ifs.close();
+
+  const string little = "format binary_little_endian 1.0\n", big = "format binary_big_endian 1.0\n";
+  size_t formatPos = contents.find(little);
+  ASSERT_NE(string::npos, formatPos);
+  contents.replace(formatPos, little.size(), big);
+
+  const string endHeader = "end_header\n";
+  size_t dataPos = contents.find(endHeader);
+  ASSERT_NE(string::npos, dataPos);
+  dataPos += endHeader.size();
+  for (size_t i = dataPos; i + sizeof(float) <= contents.size(); i += sizeof(float))
+    swapBytes(&contents[i], sizeof(float));
+
+  ofstream ofs(fileName.c_str(), ios::out | ios::binary | ios::trunc);
+  ofs.write(contents.data(), contents.size());
+}
+
+enum PLYFormat { PLY_ASCII, PLY_LITTLE_ENDIAN, PLY_BIG_ENDIAN };
+
+typedef testing::TestWithParam<int> PLY_RoundTrip;
+
+TEST_P(PLY_RoundTrip, loadPLYSimple)
+{
+  const int format = GetParam();
+  Mat pc = makeCloud(1000);
+  string fileName = cv::tempfile(".ply");
+
+  writePLY(pc, fileName.c_str(), format != PLY_ASCII);
+  if (format == PLY_BIG_ENDIAN)
+    convertToBigEndian(fileName);
+
+  Mat loaded = loadPLYSimple(fileName.c_str(), 1);
+  ASSERT_EQ(pc.rows, loaded.rows);
+  ASSERT_EQ(6, loaded.cols);
+
+  // the ascii format keeps six significant digits, the normals are normalized again
+  if (format == PLY_ASCII)
+    EXPECT_LE(cv::norm(pc, loaded, NORM_INF), 1e-5);
+  else
+  {
+    EXPECT_EQ(0, cv::norm(pc.colRange(0, 3), loaded.colRange(0, 3), NORM_INF));
+    EXPECT_LE(cv::norm(pc.colRange(3, 6), loaded.colRange(3, 6), NORM_INF), 1e-6);
+  }
+
+  // without the normals
+  Mat points = loadPLYSimple(fileName.c_str(), 0);
+  ASSERT_EQ(pc.rows, points.rows);
+  ASSERT_EQ(3, points.cols);
+  EXPECT_EQ(0, cv::norm(loaded.colRange(0, 3), points, NORM_INF));
+
+  remove(fileName.c_str());
+}
+
+INSTANTIATE_TEST_CASE_P(PPF_Helpers, PLY_RoundTrip, testing::Values((int)PLY_ASCII, (int)PLY_LITTLE_ENDIAN, (int)PLY_BIG_ENDIAN));
+
+// double coordinates and normals interleaved with uchar colors, in the ascii or the native binary format
+static void writeMixedPLY(const Mat& pc, const string& fileName, bool binary)
+{
+  ofstream ofs(fileName.c_str(), ios::out | ios::binary | ios::trunc);
+  ofs << "ply\n";
+  if (binary)
+    ofs << (isLittleEndianHost() ? "format binary_little_endian 1.0\n" : "format binary_big_endian 1.0\n");
+  else
+    ofs << "format ascii 1.0\n";
+  ofs << "comment properties of mixed types\n";
+  ofs << "element vertex " << pc.rows << "\n";
+  ofs << "property double x\nproperty double y\nproperty double z\n";
+  ofs << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+  ofs << "property double nx\nproperty double ny\nproperty double nz\n";
+  ofs << "property uchar alpha\n";
+  ofs << "end_header\n";
+  ofs.precision(17);
+
+  for (int i = 0; i < pc.rows; i++)
+  {
+    const float* p = pc.ptr<float>(i);
+    const uchar color[4] = { (uchar)i, (uchar)(2*i), (uchar)(3*i), 255 };
+    if (binary)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        double v = p[c];
+        ofs.write((const char*)&v, sizeof(v));
+      }
+      ofs.write((const char*)color, 3);
+      for (int c = 3; c < 6; c++)
+      {
+        double v = p[c];
+        ofs.write((const char*)&v, sizeof(v));
+      }
+      ofs.write((const char*)&color[3], 1);
+    }
+    else
+    {
+      ofs << (double)p[0] << " " << (double)p[1] << " " << (double)p[2] << " "
+          << (int)color[0] << " " << (int)color[1] << " " << (int)color[2] << " "
+          << (double)p[3] << " " << (double)p[4] << " " << (double)p[5] << " "
+          << (int)color[3] << "\n";
+    }
+  }
+}
+
+typedef testing::TestWithParam<bool> PLY_MixedProperties;
+
+TEST_P(PLY_MixedProperties, loadPLYSimple)
+{
+  Mat pc = makeCloud(300);
+  string fileName = cv::tempfile(".ply");
+  writeMixedPLY(pc, fileName, GetParam());
+
+  Mat loaded = loadPLYSimple(fileName.c_str(), 1);
+  ASSERT_EQ(pc.rows, loaded.rows);
+  ASSERT_EQ(6, loaded.cols);
+  EXPECT_EQ(0, cv::norm(pc.colRange(0, 3), loaded.colRange(0, 3), NORM_INF));
+  EXPECT_LE(cv::norm(pc.colRange(3, 6), loaded.colRange(3, 6), NORM_INF), 1e-6);
+
+  remove(fileName.c_str());
+}
+
+INSTANTIATE_TEST_CASE_P(PPF_Helpers, PLY_MixedProperties, testing::Bool());
+
+typedef testing::TestWithParam<bool> PLY_Sampled;
+
+TEST_P(PLY_Sampled, equalsSamplePCByQuantization)
+{
+  // more vertices than one chunk of the reader
+  Mat pc = makeCloud(100000);
+  string fileName = cv::tempfile(".ply");
+  writePLY(pc, fileName.c_str(), true);
+
+  const int weightByCenter = GetParam() ? 1 : 0;
+  Mat sampled = loadPLYSampled(fileName.c_str(), 0.05f, weightByCenter);
+
+  Mat loaded = loadPLYSimple(fileName.c_str(), 1);
+  float xRange[2], yRange[2], zRange[2];
+  float* ranges[3] = { xRange, yRange, zRange };
+  for (int c = 0; c < 3; c++)
+  {
+    double minVal, maxVal;
+    minMaxIdx(loaded.col(c), &minVal, &maxVal);
+    ranges[c][0] = (float)minVal;
+    ranges[c][1] = (float)maxVal;
+  }
+  Mat expected = samplePCByQuantization(loaded, xRange, yRange, zRange, 0.05f, weightByCenter);
+
+  ASSERT_FALSE(expected.empty());
+  ASSERT_EQ(expected.rows, sampled.rows);
+  ASSERT_EQ(expected.cols, sampled.cols);
+  EXPECT_EQ(0, cv::norm(expected, sampled, NORM_INF));
+
+  remove(fileName.c_str());
+}
+
+INSTANTIATE_TEST_CASE_P(PPF_Helpers, PLY_Sampled, testing::Bool());
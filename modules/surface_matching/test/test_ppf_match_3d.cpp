@@ -0,0 +1,188 @@
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                          License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2014, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+
+#include "test_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::ppf_match_3d;
+
+// points of an ellipsoid with their unit normals
+static Mat makeEllipsoid()
+{
+  const int rings = 30, sectors = 60;
+  const float a = 1.0f, b = 0.6f, c = 0.3f;
+  Mat pc(rings*sectors, 6, CV_32F);
+  for (int i = 0; i < rings; i++)
+  {
+    const float v = (float)(CV_PI*(i + 0.5)/rings - CV_PI/2);
+    for (int j = 0; j < sectors; j++)
+    {
+      const float u = (float)(2*CV_PI*j/sectors);
+      float* p = pc.ptr<float>(i*sectors + j);
+      p[0] = a*cos(u)*cos(v);
+      p[1] = b*sin(u)*cos(v);
+      p[2] = c*sin(v);
+      Mat n(1, 3, CV_32F, p + 3);
+      n.at<float>(0) = p[0]/(a*a);
+      n.at<float>(1) = p[1]/(b*b);
+      n.at<float>(2) = p[2]/(c*c);
+      normalize(n, n);
+    }
+  }
+  return pc;
+}
+
+static Mat makeScene(const Mat& pc)
+{
+  const double c = cos(CV_PI/6), s = sin(CV_PI/6);
+  double pose[16] = { c, -s, 0, 0.5,
+                      s,  c, 0, -0.2,
+                      0,  0, 1, 0.1,
+                      0,  0, 0, 1 };
+  return transformPCPose(pc, pose);
+}
+
+static vector<char> readFile(const string& fileName)
+{
+  ifstream ifs(fileName.c_str(), ios::in | ios::binary);
+  return vector<char>((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+}
+
+static void writeFile(const string& fileName, const vector<char>& data, size_t size)
+{
+  ofstream ofs(fileName.c_str(), ios::out | ios::binary | ios::trunc);
+  ofs.write(&data[0], size);
+}
+
+// stores a model trained on the ellipsoid, whose contents are returned
+static vector<char> saveEllipsoidModel(const string& fileName)
+{
+  PPF3DDetector detector(0.05, 0.05);
+  detector.trainModel(makeEllipsoid());
+  detector.saveModel(fileName);
+  return readFile(fileName);
+}
+
+TEST(PPF3DDetector, saveLoadMatch)
+{
+  Mat pc = makeEllipsoid();
+  Mat scene = makeScene(pc);
+  string fileName = cv::tempfile(".ppf");
+
+  PPF3DDetector trained(0.05, 0.05);
+  trained.trainModel(pc);
+  trained.saveModel(fileName);
+
+  PPF3DDetector loaded;
+  loaded.loadModel(fileName);
+
+  // the loaded model finds the same poses of the trained one
+  vector<Pose3DPtr> expected, results;
+  trained.match(scene, expected, 1.0/10.0, 0.05);
+  loaded.match(scene, results, 1.0/10.0, 0.05);
+  ASSERT_FALSE(expected.empty());
+  ASSERT_EQ(expected.size(), results.size());
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    EXPECT_EQ(expected[i]->numVotes, results[i]->numVotes);
+    EXPECT_EQ(expected[i]->modelIndex, results[i]->modelIndex);
+    for (int k = 0; k < 16; k++)
+      EXPECT_EQ(expected[i]->pose[k], results[i]->pose[k]);
+  }
+
+  remove(fileName.c_str());
+}
+
+TEST(PPF3DDetector, loadCorruptHeader)
+{
+  string fileName = cv::tempfile(".ppf");
+  vector<char> data = saveEllipsoidModel(fileName);
+  ASSERT_FALSE(data.empty());
+
+  PPF3DDetector detector;
+
+  // wrong magic
+  data[0] ^= 0x20;
+  writeFile(fileName, data, data.size());
+  EXPECT_THROW(detector.loadModel(fileName), cv::Exception);
+  data[0] ^= 0x20;
+
+  // unknown version, which follows the magic
+  data[8] ^= 0x7f;
+  writeFile(fileName, data, data.size());
+  EXPECT_THROW(detector.loadModel(fileName), cv::Exception);
+  data[8] ^= 0x7f;
+
+  // different byte order
+  std::swap(data[12], data[15]);
+  writeFile(fileName, data, data.size());
+  EXPECT_THROW(detector.loadModel(fileName), cv::Exception);
+  std::swap(data[12], data[15]);
+
+  // negative number of reference points, which follows the eight parameters of the detector
+  const size_t numRefPointsPos = 16 + 8*sizeof(double);
+  for (size_t i = numRefPointsPos; i < numRefPointsPos + sizeof(int); i++)
+    data[i] = (char)0xff;
+  writeFile(fileName, data, data.size());
+  EXPECT_THROW(detector.loadModel(fileName), cv::Exception);
+
+  remove(fileName.c_str());
+}
+
+TEST(PPF3DDetector, loadTruncatedFile)
+{
+  string fileName = cv::tempfile(".ppf");
+  vector<char> data = saveEllipsoidModel(fileName);
+  ASSERT_GT(data.size(), (size_t)64);
+
+  PPF3DDetector detector;
+
+  // shorter than the header
+  writeFile(fileName, data, 8);
+  EXPECT_THROW(detector.loadModel(fileName), cv::Exception);
+
+  // complete header, missing data
+  writeFile(fileName, data, data.size() / 2);
+  EXPECT_THROW(detector.loadModel(fileName), cv::Exception);
+
+  writeFile(fileName, data, data.size() - 1);
+  EXPECT_THROW(detector.loadModel(fileName), cv::Exception);
+
+  remove(fileName.c_str());
+}
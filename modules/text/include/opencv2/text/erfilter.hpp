@@ -267,6 +267,50 @@ magnitude (Grad).
 CV_EXPORTS void computeNMChannels(InputArray _src, OutputArrayOfArrays _channels, int _mode = ERFILTER_NM_RGBLGrad);
 
 
+/** @brief Time spent (in seconds) in the stages of detectRegions.
+
+The times of the 1st and 2nd stages are summed over all the channels, so they can exceed the total time when
+the channels are processed in parallel.
+ */
+struct CV_EXPORTS ERStageTimes
+{
+    double channels; //!< computation of the channels
+    double stage1;   //!< extraction of the component trees and 1st stage classification
+    double stage2;   //!< 2nd stage classification
+    double total;    //!< the whole detection
+};
+
+/** @brief Extracts the channels of an image and runs the 1st and 2nd stage filters of the N&M algorithm
+[Neumann12] on all of them concurrently.
+
+@param image Source image. Must be RGB CV_8UC3.
+
+@param er_filter1 The 1st stage filter, created with createERFilterNM1.
+
+@param er_filter2 The 2nd stage filter, created with createERFilterNM2.
+
+@param channels Output vector\<Mat\> where the processed channels are stored, as computed by computeNMChannels
+followed by the negated channels (but the gradient magnitude) when bothPolarities is set.
+
+@param regions Output with the ER's selected in each channel, ready to be passed to erGrouping.
+
+@param mode Mode of computeNMChannels, **ERFILTER_NM_RGBLGrad** or **ERFILTER_NM_IHSGrad**.
+
+@param bothPolarities Whenever the negated channels are processed too, to detect ER- (bright regions over dark
+background).
+
+@param times Optional output with the time spent in each stage.
+
+The result is the same of running er_filter1 and er_filter2 on every channel, but each thread works with its own
+copies of the filters (so the classifier callbacks must be thread safe) and the 2nd stage filters the component
+tree of the 1st stage directly, without the intermediate vectors of regions.
+ */
+CV_EXPORTS void detectRegions(InputArray image, const Ptr<ERFilter>& er_filter1, const Ptr<ERFilter>& er_filter2,
+                              std::vector<Mat>& channels, std::vector<std::vector<ERStat> >& regions,
+                              int mode = ERFILTER_NM_RGBLGrad, bool bothPolarities = true,
+                              ERStageTimes* times = 0);
+
+
 
 //! text::erGrouping operation modes
 enum erGrouping_Modes {
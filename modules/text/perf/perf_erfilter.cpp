@@ -0,0 +1,108 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::text;
+using namespace perf;
+
+#define TEXT_IMAGES testing::Values(string("scenetext01.jpg"), string("scenetext02.jpg"), string("scenetext03.jpg"), \
+                                    string("scenetext04.jpg"), string("scenetext05.jpg"), string("scenetext06.jpg"))
+
+typedef perf::TestBaseWithParam<string> ERFilter_Image;
+
+static string getTextDataPath(const string& name)
+{
+    return string(TEXT_SAMPLES_DATA) + name;
+}
+
+PERF_TEST_P(ERFilter_Image, extractNM1, TEXT_IMAGES)
+{
+    Mat src = imread(getTextDataPath(GetParam()));
+    ASSERT_FALSE(src.empty());
+
+    vector<Mat> channels;
+    computeNMChannels(src, channels);
+
+    // the same filter processes all the channels, so the nodes of the component tree are reused
+    Ptr<ERFilter> filter = createERFilterNM1(loadClassifierNM1(getTextDataPath("trained_classifierNM1.xml")),
+                                             16, 0.00015f, 0.13f, 0.2f, true, 0.1f);
+    vector< vector<ERStat> > regions(channels.size());
+
+    TEST_CYCLE()
+    {
+        for (size_t c = 0; c < channels.size(); c++)
+        {
+            regions[c].clear();
+            filter->run(channels[c], regions[c]);
+        }
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST_P(ERFilter_Image, detectRegions, TEXT_IMAGES)
+{
+    Mat src = imread(getTextDataPath(GetParam()));
+    ASSERT_FALSE(src.empty());
+
+    Ptr<ERFilter> filter1 = createERFilterNM1(loadClassifierNM1(getTextDataPath("trained_classifierNM1.xml")),
+                                              16, 0.00015f, 0.13f, 0.2f, true, 0.1f);
+    Ptr<ERFilter> filter2 = createERFilterNM2(loadClassifierNM2(getTextDataPath("trained_classifierNM2.xml")), 0.5);
+
+    vector<Mat> channels;
+    vector< vector<ERStat> > regions;
+    ERStageTimes times;
+    TEST_CYCLE() detectRegions(src, filter1, filter2, channels, regions, ERFILTER_NM_RGBLGrad, true, &times);
+
+    // split of the last detection between the stages, in milliseconds
+    RecordProperty("channels_ms", cvRound(1000 * times.channels));
+    RecordProperty("stage1_ms", cvRound(1000 * times.stage1));
+    RecordProperty("stage2_ms", cvRound(1000 * times.stage2));
+    RecordProperty("total_ms", cvRound(1000 * times.total));
+
+    ASSERT_EQ(channels.size(), regions.size());
+
+    SANITY_CHECK_NOTHING();
+}
@@ -35,28 +35,22 @@ int main(int argc, const char * argv[])
     namedWindow("grouping",WINDOW_NORMAL);
     Mat src = imread(argv[1]);
 
-    // Extract channels to be processed individually
-    vector<Mat> channels;
-    computeNMChannels(src, channels);
-
-    int cn = (int)channels.size();
-    // Append negative channels to detect ER- (bright regions over dark background)
-    for (int c = 0; c < cn-1; c++)
-        channels.push_back(255-channels[c]);
-
     // Create ERFilter objects with the 1st and 2nd stage default classifiers
     Ptr<ERFilter> er_filter1 = createERFilterNM1(loadClassifierNM1("trained_classifierNM1.xml"),16,0.00015f,0.13f,0.2f,true,0.1f);
     Ptr<ERFilter> er_filter2 = createERFilterNM2(loadClassifierNM2("trained_classifierNM2.xml"),0.5);
 
-    vector<vector<ERStat> > regions(channels.size());
-    // Apply the default cascade classifier to each independent channel (could be done in parallel)
-    cout << "Extracting Class Specific Extremal Regions from " << (int)channels.size() << " channels ..." << endl;
+    // Extract the channels (and their negatives, to detect ER- as bright regions over dark background)
+    // and apply the default cascade classifier to each independent channel in parallel
+    cout << "Extracting Class Specific Extremal Regions ..." << endl;
     cout << "    (...) this may take a while (...)" << endl << endl;
-    for (int c=0; c<(int)channels.size(); c++)
-    {
-        er_filter1->run(channels[c], regions[c]);
-        er_filter2->run(channels[c], regions[c]);
-    }
+    vector<Mat> channels;
+    vector<vector<ERStat> > regions;
+    ERStageTimes times;
+    detectRegions(src, er_filter1, er_filter2, channels, regions, ERFILTER_NM_RGBLGrad, true, &times);
+
+    cout << "Processed " << (int)channels.size() << " channels in " << fixed << setprecision(3) << times.total << " s" << endl;
+    cout << "    channels " << times.channels << " s, 1st stage " << times.stage1 << " s, 2nd stage "
+         << times.stage2 << " s (summed over the channels)" << endl << endl;
 
     // Detect character groups
     cout << "Grouping extracted ERs ... ";
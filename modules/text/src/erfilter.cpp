@@ -45,7 +45,6 @@
 #include "opencv2/ml.hpp"
 #include <limits>
 #include <fstream>
-#include <queue>
 
 #if defined _MSC_VER && _MSC_VER == 1500
     typedef int int_fast32_t;
@@ -65,27 +64,6 @@ using namespace cv::ml;
 using namespace std;
 using namespace cv::ml;
 
-// Deletes a tree of ERStat regions starting at root. Used only
-// internally to this implementation.
-static void deleteERStatTree(ERStat* root) {
-    queue<ERStat*> to_delete;
-    to_delete.push(root);
-    while (!to_delete.empty()) {
-        ERStat* n = to_delete.front();
-        to_delete.pop();
-        ERStat* c = n->child;
-        if (c != NULL) {
-            to_delete.push(c);
-            ERStat* sibling = c->next;
-            while (sibling != NULL) {
-                to_delete.push(sibling);
-                sibling = sibling->next;
-            }
-        }
-        delete n;
-    }
-}
-
 ERStat::ERStat(int init_level, int init_pixel, int init_x, int init_y) : pixel(init_pixel),
                level(init_level), area(0), perimeter(0), euler(0), probability(1.0),
                parent(0), child(0), next(0), prev(0), local_maxima(0),
@@ -102,6 +80,64 @@ ERStat::ERStat(int init_level, int init_pixel, int init_x, int init_y) : pixel(i
 }
 
 
+// pool of the ERStat nodes (and their crossings) of the component tree. The nodes are never released
+// individually, the whole tree is freed at once by reset() and its memory is reused by the next run
+class ERStatArena
+{
+public:
+    ERStatArena() : used(0)
+    {
+        // the template of the new nodes does not own any crossings
+        delete blank.crossings;
+        blank.crossings = NULL;
+    }
+
+    // the nodes are only meaningful during a run, so copies (e.g. the filters of each thread) start empty
+    ERStatArena(const ERStatArena&) : used(0)
+    {
+        delete blank.crossings;
+        blank.crossings = NULL;
+    }
+
+    ERStatArena& operator=(const ERStatArena&)
+    {
+        reset();
+        return *this;
+    }
+
+    // same initial state of ERStat(level, pixel, x, y)
+    ERStat* alloc(int level = 256, int pixel = 0, int x = 0, int y = 0)
+    {
+        // std::deque does not move its elements when growing, so the nodes handed out stay valid
+        if (used == nodes.size())
+        {
+            nodes.push_back(blank);
+            crossings.push_back(deque<int>());
+        }
+
+        ERStat *er = &nodes[used];
+        *er = blank;
+        er->level = level;
+        er->pixel = pixel;
+        er->rect = Rect(x,y,1,1);
+        er->crossings = &crossings[used];
+        er->crossings->clear();
+        er->crossings->push_back(0);
+
+        used++;
+        return er;
+    }
+
+    void reset() { used = 0; }
+
+private:
+    ERStat blank;
+    deque<ERStat> nodes;
+    deque< deque<int> > crossings;
+    size_t used;
+};
+
+
 // derivative classes
 
 
@@ -122,6 +158,12 @@ public:
     // input/output - for the second one.
     void run( InputArray image, vector<ERStat>& regions );
 
+    // runs this 1st stage filter followed by the given 2nd stage filter. The 2nd stage walks the extracted
+    // component tree (stored in tree) directly, doing the non-maximum suppression of the 1st stage on the
+    // fly, so the regions are not copied in between. The ticks spent in each stage are added to stageTicks
+    void runCascade( InputArray image, ERFilterNM& stage2, vector<ERStat>& tree, vector<ERStat>& regions,
+                     int64 stageTicks[2] );
+
 protected:
     int thresholdDelta;
     float maxArea;
@@ -150,6 +192,8 @@ private:
     vector<ERStat> *regions;
     // image mask used for feature calculations
     Mat region_mask;
+    // nodes of the component tree, reused across runs
+    ERStatArena er_arena;
 
     // extract the component tree and store all the ER regions
     void er_tree_extract( InputArray image );
@@ -161,8 +205,10 @@ private:
     void er_merge( ERStat *parent, ERStat *child );
     // copy extracted regions into the output vector
     ERStat* er_save( ERStat *er, ERStat *parent, ERStat *prev );
-    // recursively walk the tree and filter (remove) regions using the callback classifier
-    ERStat* er_tree_filter( InputArray image, ERStat *stat, ERStat *parent, ERStat *prev );
+    // recursively walk the tree and filter (remove) regions using the callback classifier,
+    // optionally skipping the regions which are not local maxima of the 1st stage probability
+    ERStat* er_tree_filter( InputArray image, ERStat *stat, ERStat *parent, ERStat *prev,
+                            bool local_maxima_only = false );
     // recursively walk the tree selecting only regions with local maxima probability
     ERStat* er_tree_nonmax_suppression( ERStat *er, ERStat *parent, ERStat *prev );
 };
@@ -254,6 +300,33 @@ void ERFilterNM::run( InputArray image, vector<ERStat>& _regions )
     }
 }
 
+// runs this 1st stage filter followed by the given 2nd stage filter, without the intermediate vectors of run()
+void ERFilterNM::runCascade( InputArray image, ERFilterNM& stage2, vector<ERStat>& tree, vector<ERStat>& _regions,
+                             int64 stageTicks[2] )
+{
+    // assert correct image type
+    CV_Assert( image.getMat().type() == CV_8UC1 );
+
+    int64 start = getTickCount();
+
+    tree.clear();
+    regions = &tree;
+    region_mask = Mat::zeros(image.getMat().rows+2, image.getMat().cols+2, CV_8UC1);
+    er_tree_extract( image );
+
+    int64 extracted = getTickCount();
+
+    // the 2nd stage keeps pointers to its output regions, so they must not be reallocated
+    _regions.clear();
+    _regions.reserve(tree.size());
+    stage2.regions = &_regions;
+    stage2.region_mask = region_mask;
+    stage2.er_tree_filter( image, &tree.front(), NULL, NULL, nonMaxSuppression );
+
+    stageTicks[0] += extracted - start;
+    stageTicks[1] += getTickCount() - extracted;
+}
+
 // extract the component tree and store all the ER regions
 // uses the algorithm described in
 // Linear time maximally stable extremal regions, D Nistér, H Stewénius – ECCV 2008
@@ -272,8 +345,9 @@ void ERFilterNM::er_tree_extract( InputArray image )
     const unsigned char * image_data = src.data;
     int width = src.cols, height = src.rows;
 
-    // the component stack
+    // the component stack, its nodes come from the arena and the nodes of the previous run are recycled
     vector<ERStat*> er_stack;
+    er_arena.reset();
 
     //the quads for euler number calculation
     unsigned char quads[3][4];
@@ -303,7 +377,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
     vector<int> boundary_edges[256];
 
     // add a dummy-component before start
-    er_stack.push_back(new ERStat);
+    er_stack.push_back(er_arena.alloc());
 
     // we'll look initially for all pixels with grey-level lower than a grey-level higher than any allowed in the image
     int threshold_level = (255/thresholdDelta)+1;
@@ -323,7 +397,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
 
         // push a component with current level in the component stack
         if (push_new_component)
-            er_stack.push_back(new ERStat(current_level, current_pixel, x, y));
+            er_stack.push_back(er_arena.alloc(current_level, current_pixel, x, y));
         push_new_component = false;
 
         // explore the (remaining) edges to the neighbors to the current pixel
@@ -520,18 +594,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
             regions->reserve(num_accepted_regions+1);
             er_save(er_stack.back(), NULL, NULL);
 
-            // clean memory
-            for (size_t r=0; r<er_stack.size(); r++)
-            {
-                ERStat *stat = er_stack.at(r);
-                if (stat->crossings)
-                {
-                    stat->crossings->clear();
-                    delete(stat->crossings);
-                    stat->crossings = NULL;
-                }
-                deleteERStatTree(stat);
-            }
+            // the tree is freed at once by the next run
             er_stack.clear();
 
             return;
@@ -563,7 +626,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
 
                 if (new_level < er_stack.back()->level)
                 {
-                    er_stack.push_back(new ERStat(new_level, current_pixel, current_pixel%width, current_pixel/width));
+                    er_stack.push_back(er_arena.alloc(new_level, current_pixel, current_pixel%width, current_pixel/width));
                     er_merge(er_stack.back(), er);
                     break;
                 }
@@ -664,9 +727,7 @@ void ERFilterNM::er_merge(ERStat *parent, ERStat *child)
     sort(m_crossings.begin(), m_crossings.end());
     child->med_crossings = (float)m_crossings.at(1);
 
-    // free unnecessary mem
-    child->crossings->clear();
-    delete(child->crossings);
+    // the crossings are not needed anymore (their memory belongs to the arena)
     child->crossings = NULL;
 
     // recover the original grey-level
@@ -710,15 +771,6 @@ void ERFilterNM::er_merge(ERStat *parent, ERStat *child)
             parent->child   = child->child;
             child->child->parent = parent;
         }
-
-        // free mem
-        if(child->crossings)
-        {
-            child->crossings->clear();
-            delete(child->crossings);
-            child->crossings = NULL;
-        }
-        delete(child);
     }
 
 }
@@ -788,8 +840,23 @@ ERStat* ERFilterNM::er_save( ERStat *er, ERStat *parent, ERStat *prev )
 }
 
 // recursively walk the tree and filter (remove) regions using the callback classifier
-ERStat* ERFilterNM::er_tree_filter ( InputArray image, ERStat * stat, ERStat *parent, ERStat *prev )
+ERStat* ERFilterNM::er_tree_filter ( InputArray image, ERStat * stat, ERStat *parent, ERStat *prev,
+                                     bool local_maxima_only )
 {
+    // regions discarded by the non-maximum suppression of the 1st stage, their children go up to the parent
+    // (as in er_tree_nonmax_suppression)
+    if ( local_maxima_only && !stat->local_maxima && (stat->parent != NULL) )
+    {
+        ERStat *old_prev = prev;
+
+        for (ERStat * child = stat->child; child; child = child->next)
+        {
+            old_prev = er_tree_filter(image, child, parent, old_prev, local_maxima_only);
+        }
+
+        return old_prev;
+    }
+
     Mat src = image.getMat();
     // assert correct image type
     CV_Assert( src.type() == CV_8UC1 );
@@ -897,7 +964,7 @@ ERStat* ERFilterNM::er_tree_filter ( InputArray image, ERStat * stat, ERStat *pa
 
         for (ERStat * child = stat->child; child; child = child->next)
         {
-            old_prev = er_tree_filter(image, child, this_er, old_prev);
+            old_prev = er_tree_filter(image, child, this_er, old_prev, local_maxima_only);
         }
 
         return this_er;
@@ -910,7 +977,7 @@ ERStat* ERFilterNM::er_tree_filter ( InputArray image, ERStat * stat, ERStat *pa
 
         for (ERStat * child = stat->child; child; child = child->next)
         {
-            old_prev = er_tree_filter(image, child, parent, old_prev);
+            old_prev = er_tree_filter(image, child, parent, old_prev, local_maxima_only);
         }
 
         return old_prev;
@@ -1312,6 +1379,94 @@ void computeNMChannels(InputArray _src, OutputArrayOfArrays _channels, int _mode
 }
 
 
+// the cascade of the 1st and 2nd stages is run on different channels in parallel,
+// every range with its own copies of the filters
+class Parallel_detectRegions : public ParallelLoopBody
+{
+private:
+    const vector<Mat> &channels;
+    vector< vector<ERStat> > &regions;
+    const ERFilterNM &er_filter1;
+    const ERFilterNM &er_filter2;
+    vector<int64> &stage_ticks;
+
+public:
+    Parallel_detectRegions(const vector<Mat> &_channels, vector< vector<ERStat> > &_regions,
+                           const ERFilterNM &_er_filter1, const ERFilterNM &_er_filter2, vector<int64> &_stage_ticks)
+        : channels(_channels), regions(_regions), er_filter1(_er_filter1), er_filter2(_er_filter2),
+          stage_ticks(_stage_ticks) {}
+
+    virtual void operator()( const Range &r ) const
+    {
+        // the component tree buffer and the nodes of the filters are reused by all the channels of the range
+        ERFilterNM filter1(er_filter1), filter2(er_filter2);
+        vector<ERStat> tree;
+
+        for (int c = r.start; c < r.end; c++)
+            filter1.runCascade(channels[c], filter2, tree, regions[c], &stage_ticks[2*c]);
+    }
+    Parallel_detectRegions & operator=(const Parallel_detectRegions &a);
+};
+
+/*!
+    Extracts the channels of an image and runs the 1st and 2nd stage filters on all of them concurrently.
+
+    \param  image          Source image. Must be RGB CV_8UC3.
+    \param  er_filter1     The 1st stage filter (created with createERFilterNM1).
+    \param  er_filter2     The 2nd stage filter (created with createERFilterNM2).
+    \param  channels       Output vector<Mat> where the processed channels are stored.
+    \param  regions        Output vector with the regions selected in every channel.
+    \param  mode           Channels mode of computeNMChannels.
+    \param  bothPolarities Whenever the negated channels are processed too.
+    \param  times          Optional output with the time spent in every stage.
+*/
+void detectRegions(InputArray image, const Ptr<ERFilter>& er_filter1, const Ptr<ERFilter>& er_filter2,
+                   vector<Mat>& channels, vector< vector<ERStat> >& regions, int mode, bool bothPolarities,
+                   ERStageTimes* times)
+{
+    // every thread works with copies of the filters, which is only possible with the N&M implementation
+    ERFilterNM *filter1 = dynamic_cast<ERFilterNM*>(er_filter1.get());
+    ERFilterNM *filter2 = dynamic_cast<ERFilterNM*>(er_filter2.get());
+    CV_Assert( (filter1 != NULL) && (filter2 != NULL) );
+
+    int64 start = getTickCount();
+
+    computeNMChannels(image, channels, mode);
+
+    // append negative channels to detect ER- (bright regions over dark background),
+    // all but the gradient magnitude
+    if (bothPolarities)
+    {
+        int cn = (int)channels.size();
+        for (int c = 0; c < cn-1; c++)
+            channels.push_back(255-channels[c]);
+    }
+
+    int64 computed = getTickCount();
+
+    regions.clear();
+    regions.resize(channels.size());
+    vector<int64> stage_ticks(2*channels.size(), 0);
+    parallel_for_(Range(0, (int)channels.size()),
+                  Parallel_detectRegions(channels, regions, *filter1, *filter2, stage_ticks));
+
+    if (times != NULL)
+    {
+        int64 stage1 = 0, stage2 = 0;
+        for (size_t c = 0; c < channels.size(); c++)
+        {
+            stage1 += stage_ticks[2*c];
+            stage2 += stage_ticks[2*c+1];
+        }
+
+        times->channels = (computed - start) / getTickFrequency();
+        times->stage1   = stage1 / getTickFrequency();
+        times->stage2   = stage2 / getTickFrequency();
+        times->total    = (getTickCount() - start) / getTickFrequency();
+    }
+}
+
+
 
 /* ------------------------------------------------------------------------------------*/
 /* -------------------------------- ER Grouping Algorithm -----------------------------*/
@@ -0,0 +1,111 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "test_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::text;
+
+static string getTextDataPath(const string& name)
+{
+    return string(TEXT_SAMPLES_DATA) + name;
+}
+
+// index of a region in its vector, -1 for none
+static int regionIndex(const vector<ERStat>& regions, const ERStat* stat)
+{
+    return stat == NULL ? -1 : (int)(stat - &regions[0]);
+}
+
+typedef testing::TestWithParam<tr1::tuple<string, bool> > ERFilter_DetectRegions;
+
+TEST_P(ERFilter_DetectRegions, equalsSequentialFilters)
+{
+    const string imageName = tr1::get<0>(GetParam());
+    const bool nonMaxSuppression = tr1::get<1>(GetParam());
+
+    Mat src = imread(getTextDataPath(imageName));
+    ASSERT_FALSE(src.empty());
+
+    Ptr<ERFilter> filter1 = createERFilterNM1(loadClassifierNM1(getTextDataPath("trained_classifierNM1.xml")),
+                                              16, 0.00015f, 0.13f, 0.2f, nonMaxSuppression, 0.1f);
+    Ptr<ERFilter> filter2 = createERFilterNM2(loadClassifierNM2(getTextDataPath("trained_classifierNM2.xml")), 0.5);
+
+    vector<Mat> channels;
+    vector< vector<ERStat> > regions;
+    detectRegions(src, filter1, filter2, channels, regions, ERFILTER_NM_RGBLGrad, true);
+
+    vector<Mat> expectedChannels;
+    computeNMChannels(src, expectedChannels, ERFILTER_NM_RGBLGrad);
+    int cn = (int)expectedChannels.size();
+    for (int c = 0; c < cn-1; c++)
+        expectedChannels.push_back(255-expectedChannels[c]);
+    ASSERT_EQ(expectedChannels.size(), channels.size());
+    ASSERT_EQ(channels.size(), regions.size());
+
+    for (size_t c = 0; c < channels.size(); c++)
+    {
+        EXPECT_EQ(0, cvtest::norm(expectedChannels[c], channels[c], NORM_INF));
+
+        vector<ERStat> expected;
+        filter1->run(channels[c], expected);
+        filter2->run(channels[c], expected);
+
+        const vector<ERStat>& actual = regions[c];
+        ASSERT_EQ(expected.size(), actual.size()) << "channel " << c;
+        for (size_t r = 0; r < expected.size(); r++)
+        {
+            EXPECT_EQ(expected[r].pixel, actual[r].pixel);
+            EXPECT_EQ(expected[r].level, actual[r].level);
+            EXPECT_EQ(expected[r].area, actual[r].area);
+            EXPECT_EQ(regionIndex(expected, expected[r].parent), regionIndex(actual, actual[r].parent));
+            EXPECT_EQ(regionIndex(expected, expected[r].child), regionIndex(actual, actual[r].child));
+            EXPECT_EQ(regionIndex(expected, expected[r].next), regionIndex(actual, actual[r].next));
+            EXPECT_EQ(regionIndex(expected, expected[r].prev), regionIndex(actual, actual[r].prev));
+        }
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(Text, ERFilter_DetectRegions,
+                        testing::Combine(testing::Values(string("scenetext01.jpg"), string("scenetext04.jpg")),
+                                         testing::Bool()));
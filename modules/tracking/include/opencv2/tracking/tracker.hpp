@@ -1247,6 +1247,8 @@ public:
 		int compressed_size;          //!<  feature size after compression
 		unsigned int desc_pca;        //!<  compressed descriptors of TrackerKCF::MODE
 		unsigned int desc_npca;       //!<  non-compressed descriptors of TrackerKCF::MODE
+		int scale_count;              //!<  number of scales of the search window evaluated at each frame, 1 disables the scale estimation
+		double scale_step;            //!<  ratio between two consecutive scales of the search window
 	};
 
 	virtual void setFeatureExtractor(void(*)(const Mat, const Rect, Mat&), bool pca_func = false);
@@ -1449,6 +1451,47 @@ public:
 	bool update_opt(const Mat& image);
 };
 
+/** @brief Multi Object Tracker for KCF, see cv::TrackerKCF.
+
+The optimized update shares the feature extraction between the targets: the grayscale and color-names maps
+are computed once per frame over the area covered by the search windows of all the targets, then the targets
+are localized and their models are updated in parallel. The scale pyramid of each target (see
+TrackerKCF::Params::scale_count) is evaluated in the same pass.
+
+@sa Tracker, MultiTracker, TrackerKCF
+*/
+struct TrackerKCFFeatureMaps;
+class CV_EXPORTS MultiTrackerKCF : public MultiTracker_Alt
+{
+public:
+	using MultiTracker_Alt::addTarget;
+
+	/** @brief Add a new target to a tracking-list and initialize a KCF tracker with the given parameters
+	@param image The initial frame
+	@param boundingBox The initial boundig box of target
+	@param parameters KCF parameters TrackerKCF::Params
+
+	@return True if new target initialization went succesfully, false otherwise
+	*/
+	bool addTarget(const Mat& image, const Rect2d& boundingBox, const TrackerKCF::Params& parameters);
+
+	/** @brief Update all trackers from the tracking-list, find a new most likely bounding boxes for the targets by
+	optimized update method sharing the features of the frame between the KCF trackers. The trackers of other
+	algorithms are updated one by one.
+
+	@param image The current frame.
+
+	@return True means that all targets were located and false means that tracker couldn't locate one of the targets in
+	current frame. Note, that latter *does not* imply that tracker has failed, maybe target is indeed
+	missing from the frame (say, out of sight)
+	*/
+	bool update_opt(const Mat& image);
+
+protected:
+	//!<  feature maps of the frame shared by the KCF trackers, the storage is reused by the next frames
+	Ptr<TrackerKCFFeatureMaps> kcfMaps;
+};
+
 //! @}
 
 } /* namespace cv */
@@ -343,3 +343,114 @@ PERF_TEST_P(tracking, tld, testing::Combine(TESTSET_NAMES, SEGMENTS))
   SANITY_CHECK( bbs_mat, 15, ERROR_RELATIVE );
 
 }
+
+PERF_TEST_P(tracking, kcf, testing::Combine(TESTSET_NAMES, SEGMENTS))
+{
+  string video = get<0>( GetParam() );
+  int segmentId = get<1>( GetParam() );
+
+  int startFrame;
+  string prefix;
+  string suffix;
+  string datasetMeta = getDataPath( TRACKING_DIR + "/" + video + "/" + video + ".yml" );
+  checkData( datasetMeta, startFrame, prefix, suffix );
+  int gtStartFrame = startFrame;
+
+  vector<Rect> gtBBs;
+  string gtFile = getDataPath( TRACKING_DIR + "/" + video + "/gt.txt" );
+  if( !getGroundTruth( gtFile, gtBBs ) )
+    FAIL()<< "Ground truth file " << gtFile << " can not be read" << endl;
+  int bbCounter = (int)gtBBs.size();
+
+  int numSegments = ( sizeof ( SEGMENTS)/sizeof(int) );
+  int endFrame = 0;
+  getSegment( segmentId, numSegments, bbCounter, startFrame, endFrame );
+
+  Rect currentBBi = gtBBs[startFrame - gtStartFrame];
+  Rect2d currentBB(currentBBi);
+
+  //decode the segment in advance, so that only the tracker is measured
+  vector<Mat> frames;
+  VideoCapture c;
+  c.open( getDataPath( TRACKING_DIR + "/" + video + "/" + FOLDER_IMG + "/" + video + ".webm" ) );
+  c.set( CAP_PROP_POS_FRAMES, startFrame );
+  for ( int frameCounter = startFrame; frameCounter < endFrame; frameCounter++ )
+  {
+    Mat frame;
+    c >> frame;
+    if( frame.empty() )
+    {
+      break;
+    }
+    frames.push_back( frame );
+  }
+  if( frames.empty() )
+    FAIL()<< "No frames can be read from " << video << endl;
+
+  vector<Rect2d> bbs;
+  Ptr<Tracker> tracker;
+
+  TEST_CYCLE_N(1)
+  {
+    Rect2d bb = currentBB;
+    tracker = Tracker::create( "KCF" );
+    bbs.clear();
+    if( !tracker->init( frames[0], bb ) )
+    {
+      FAIL()<< "Could not initialize tracker" << endl;
+      return;
+    }
+    bbs.push_back( bb );
+    for ( size_t i = 1; i < frames.size(); i++ )
+    {
+      tracker->update( frames[i], bb );
+      bbs.push_back( bb );
+    }
+  }
+
+  SANITY_CHECK_NOTHING();
+}
+
+typedef perf::TestBaseWithParam<tr1::tuple<int, bool> > trackingMultiKCF;
+
+PERF_TEST_P(trackingMultiKCF, update, testing::Combine(testing::Values(1, 16, 64), testing::Bool()))
+{
+  int numTargets = get<0>( GetParam() );
+  bool batched = get<1>( GetParam() );
+
+  //textured frame translated by a few pixels at each step
+  RNG rng( 0x1234 );
+  Mat background( 720, 1280, CV_8UC3 );
+  rng.fill( background, RNG::UNIFORM, 0, 256 );
+  GaussianBlur( background, background, Size( 5, 5 ), 0 );
+  vector<Mat> frames( 10 );
+  for ( int f = 0; f < (int)frames.size(); f++ )
+  {
+    Mat shift = ( Mat_<double>( 2, 3 ) << 1, 0, 2 * f, 0, 1, f );
+    warpAffine( background, frames[f], shift, background.size(), INTER_LINEAR, BORDER_REFLECT );
+  }
+
+  //targets on a grid, with overlapping search windows
+  int gridCols = (int)ceil( sqrt( (double)numTargets ) );
+  vector<Rect2d> targets;
+  for ( int i = 0; i < numTargets; i++ )
+    targets.push_back( Rect2d( 100 + 60 * ( i % gridCols ), 100 + 60 * ( i / gridCols ), 48, 48 ) );
+
+  //the targets are added out of the measured cycle, which runs once
+  MultiTrackerKCF mt;
+  for ( int i = 0; i < numTargets; i++ )
+    mt.addTarget( frames[0], targets[i], TrackerKCF::Params() );
+
+  TEST_CYCLE_N(1)
+  {
+    for ( size_t f = 1; f < frames.size(); f++ )
+    {
+      if( batched )
+        mt.update_opt( frames[f] );
+      else
+        mt.update( frames[f] );
+    }
+  }
+
+  SANITY_CHECK_NOTHING();
+}
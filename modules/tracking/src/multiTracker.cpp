@@ -246,6 +246,80 @@ namespace cv
 		return true;
 	}
 
+	//Multitracker KCF
+	bool MultiTrackerKCF::addTarget(const Mat& image, const Rect2d& boundingBox, const TrackerKCF::Params& parameters)
+	{
+		Ptr<Tracker> tracker = TrackerKCF::createTracker(parameters);
+		if (tracker == NULL)
+			return false;
+
+		if (!tracker->init(image, boundingBox))
+			return false;
+
+		//Add BB of target
+		boundingBoxes.push_back(boundingBox);
+
+		//Add Tracker to stack
+		trackers.push_back(tracker);
+
+		//Assign a random color to target
+		if (targetNum == 1)
+			colors.push_back(Scalar(0, 0, 255));
+		else
+			colors.push_back(Scalar(rand() % 256, rand() % 256, rand() % 256));
+
+		//Target counter
+		targetNum++;
+
+		return true;
+	}
+
+	/*Optimized update method for KCF Multitracker */
+	bool MultiTrackerKCF::update_opt(const Mat& image)
+	{
+		bool result = true;
+
+		//Collect the KCF trackers, the others are updated one by one
+		std::vector<TrackerKCFImpl*> kcfTrackers;
+		std::vector<Rect2d> kcfBoundingBoxes;
+		std::vector<int> kcfIndices;
+		for (int i = 0; i < (int)trackers.size(); i++)
+		{
+			TrackerKCFImpl* tracker = dynamic_cast<TrackerKCFImpl*>(trackers[i].get());
+			if (tracker == NULL)
+			{
+				if (!trackers[i]->update(image, boundingBoxes[i]))
+					result = false;
+			}
+			else if (!tracker->isInitialized())
+				result = false;
+			else
+			{
+				kcfTrackers.push_back(tracker);
+				kcfBoundingBoxes.push_back(boundingBoxes[i]);
+				kcfIndices.push_back(i);
+			}
+		}
+		if (kcfTrackers.empty())
+			return result;
+
+		//Shared features, parallel detection and learning
+		if (kcfMaps.empty())
+			kcfMaps = makePtr<TrackerKCFFeatureMaps>();
+		std::vector<uchar> success;
+		updateTrackersKCF(image, kcfTrackers, kcfBoundingBoxes, success, *kcfMaps);
+
+		for (size_t k = 0; k < kcfIndices.size(); k++)
+		{
+			boundingBoxes[kcfIndices[k]] = kcfBoundingBoxes[k];
+			if (!success[k])
+				result = false;
+		}
+
+		return result;
+	}
+
+
 	void detect_all(const Mat& img, const Mat& imgBlurred, std::vector<Rect2d>& res, std::vector < std::vector < tld::TLDDetector::LabeledPatch > > &patches, std::vector<bool> &detect_flgs,
 		std::vector<Ptr<Tracker> > &trackers)
 	{
@@ -45,6 +45,7 @@
 #include "precomp.hpp"
 #include "tldTracker.hpp"
 #include "tldUtils.hpp"
+#include "trackerKCF.hpp"
 #include <math.h>
 
 namespace cv
@@ -40,7 +40,9 @@
  //M*/
 
 #include "precomp.hpp"
+#include "trackerKCF.hpp"
 #include <complex>
+#include <algorithm>
 
 /*---------------------------
 |  TrackerKCFModel
@@ -65,98 +67,80 @@ namespace cv{
 |---------------------------*/
 namespace cv{
 
+  /*-------------------------------------
+  |  feature maps shared by the trackers
+  |-------------------------------------*/
+
   /*
- * Prototype
- */
-  class TrackerKCFImpl : public TrackerKCF {
+   * Convert BGR to ColorNames, the rows of the map are processed in parallel
+   */
+  class ColorNamesParallel : public ParallelLoopBody {
   public:
-    TrackerKCFImpl( const TrackerKCF::Params &parameters = TrackerKCF::Params() );
-    void read( const FileNode& /*fn*/ );
-    void write( FileStorage& /*fs*/ ) const;
-    void setFeatureExtractor(void (*f)(const Mat, const Rect, Mat&), bool pca_func = false);
-
-  protected:
-     /*
-    * basic functions and vars
-    */
-    bool initImpl( const Mat& /*image*/, const Rect2d& boundingBox );
-    bool updateImpl( const Mat& image, Rect2d& boundingBox );
-
-    TrackerKCF::Params params;
-
-    /*
-    * KCF functions and vars
-    */
-    void createHanningWindow(OutputArray dest, const cv::Size winSize, const int type) const;
-    void inline fft2(const Mat src, std::vector<Mat> & dest, std::vector<Mat> & layers_data) const;
-    void inline fft2(const Mat src, Mat & dest) const;
-    void inline ifft2(const Mat src, Mat & dest) const;
-    void inline pixelWiseMult(const std::vector<Mat> src1, const std::vector<Mat>  src2, std::vector<Mat>  & dest, const int flags, const bool conjB=false) const;
-    void inline sumChannels(std::vector<Mat> src, Mat & dest) const;
-    void inline updateProjectionMatrix(const Mat src, Mat & old_cov,Mat &  proj_matrix,double pca_rate, int compressed_sz,
-                                       std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat pca_data, Mat new_cov, Mat w, Mat u, Mat v) const;
-    void inline compress(const Mat proj_matrix, const Mat src, Mat & dest, Mat & data, Mat & compressed) const;
-    bool getSubWindow(const Mat img, const Rect roi, Mat& feat, Mat& patch, TrackerKCF::MODE desc = GRAY) const;
-    bool getSubWindow(const Mat img, const Rect roi, Mat& feat, void (*f)(const Mat, const Rect, Mat& )) const;
-    void extractCN(Mat patch_data, Mat & cnFeatures) const;
-    void denseGaussKernel(const double sigma, const Mat , const Mat y_data, Mat & k_data,
-                          std::vector<Mat> & layers_data,std::vector<Mat> & xf_data,std::vector<Mat> & yf_data, std::vector<Mat> xyf_v, Mat xy, Mat xyf ) const;
-    void calcResponse(const Mat alphaf_data, const Mat kf_data, Mat & response_data, Mat & spec_data) const;
-    void calcResponse(const Mat alphaf_data, const Mat alphaf_den_data, const Mat kf_data, Mat & response_data, Mat & spec_data, Mat & spec2_data) const;
-
-    void shiftRows(Mat& mat) const;
-    void shiftRows(Mat& mat, int n) const;
-    void shiftCols(Mat& mat, int n) const;
+    ColorNamesParallel(const Mat &_src, Mat &_dst) : src(_src), dst(_dst) {}
+
+    virtual void operator()( const Range &r ) const {
+      for(int i=r.start;i<r.end;i++){
+        const Vec3b *pixel = src.ptr<Vec3b>(i);
+        float *cn = dst.ptr<float>(i);
+        for(int j=0;j<src.cols;j++,cn+=10){
+          unsigned index=(unsigned)((pixel[j][2]>>3)+32*(pixel[j][1]>>3)+32*32*(pixel[j][0]>>3));
+
+          //copy the values
+          for(int _k=0;_k<10;_k++){
+            cn[_k]=(float)ColorNames[index][_k];
+          }
+        }
+      }
+    }
 
   private:
-    double output_sigma;
-    Rect2d roi;
-    Mat hann; 	//hann window filter
-    Mat hann_cn; //10 dimensional hann-window filter for CN features,
-
-    Mat y,yf; 	// training response and its FFT
-    Mat x; 	// observation and its FFT
-    Mat k,kf;	// dense gaussian kernel and its FFT
-    Mat kf_lambda; // kf+lambda
-    Mat new_alphaf, alphaf;	// training coefficients
-    Mat new_alphaf_den, alphaf_den; // for splitted training coefficients
-    Mat z; // model
-    Mat response; // detection result
-    Mat old_cov_mtx, proj_mtx; // for feature compression
-
-    // pre-defined Mat variables for optimization of private functions
-    Mat spec, spec2;
-    std::vector<Mat> layers;
-    std::vector<Mat> vxf,vyf,vxyf;
-    Mat xy_data,xyf_data;
-    Mat data_temp, compress_data;
-    std::vector<Mat> layers_pca_data;
-    std::vector<Scalar> average_data;
-    Mat img_Patch;
-
-    // storage for the extracted features, KRLS model, KRLS compressed model
-    Mat X[2],Z[2],Zc[2];
-
-    // storage of the extracted features
-    std::vector<Mat> features_pca;
-    std::vector<Mat> features_npca;
-    std::vector<MODE> descriptors_pca;
-    std::vector<MODE> descriptors_npca;
-
-    // optimization variables for updateProjectionMatrix
-    Mat data_pca, new_covar,w_data,u_data,vt_data;
-
-    // custom feature extractor
-    bool use_custom_extractor_pca;
-    bool use_custom_extractor_npca;
-    std::vector<void(*)(const Mat img, const Rect roi, Mat& output)> extractor_pca;
-    std::vector<void(*)(const Mat img, const Rect roi, Mat& output)> extractor_npca;
-
-    bool resizeImage; // resize the image whenever needed and the patch size is large
-
-    int frame;
+    const Mat &src;
+    Mat &dst;
   };
 
+  void TrackerKCFFeatureMaps::setImage(const Mat& img, bool needResized){
+    image[0]=img;
+    if(needResized)
+      resize(img,image[1],Size(img.cols/2,img.rows/2));
+    else
+      image[1].release();
+    modes[0]=modes[1]=0;
+  }
+
+  void TrackerKCFFeatureMaps::compute(int level, const Rect& region, unsigned desc){
+    CV_Assert(level==0 || level==1);
+    const Mat &img=image[level];
+    Rect r=region & Rect(0,0,img.cols,img.rows);
+    if(r.area()==0 || desc==0)return;
+
+    // the maps computed before are enough
+    if((modes[level] & desc)==desc && (area[level] & r)==r)return;
+
+    // otherwise the maps are extended to cover both the old and the new region
+    if(modes[level]!=0){
+      r|=area[level];
+      desc|=modes[level];
+    }
+    area[level]=r;
+    modes[level]=desc;
+
+    Mat patch=img(r);
+    if((desc & TrackerKCF::GRAY) == TrackerKCF::GRAY){
+      // normalize to range -0.5 .. 0.5
+      if(img.channels()>1){
+        cvtColor(patch,gray_u8[level],CV_BGR2GRAY);
+        gray_u8[level].convertTo(gray[level],CV_32F,1.0/255.0,-0.5);
+      }else{
+        patch.convertTo(gray[level],CV_32F,1.0/255.0,-0.5);
+      }
+    }
+    if((desc & TrackerKCF::CN) == TrackerKCF::CN){
+      CV_Assert(img.channels() == 3);
+      cn[level].create(r.height,r.width,CV_32FC(10));
+      parallel_for_(Range(0,r.height),ColorNamesParallel(patch,cn[level]));
+    }
+  }
+
   /*
  * Constructor
  */
@@ -170,7 +154,8 @@ namespace cv{
     resizeImage = false;
     use_custom_extractor_pca = false;
     use_custom_extractor_npca = false;
-
+    current_scale = 1.0;
+    frame = 0;
   }
 
   void TrackerKCFImpl::read( const cv::FileNode& fn ){
@@ -211,18 +196,22 @@ namespace cv{
     roi.width*=2;
     roi.height*=2;
 
+    // the model keeps the size of the initial search window
+    roi_size=roi.size();
+    current_scale=1.0;
+
     // initialize the hann window filter
-    createHanningWindow(hann, roi.size(), CV_64F);
+    createHanningWindow(hann, roi.size(), CV_32F);
 
     // hann window filter for CN feature
     Mat _layer[] = {hann, hann, hann, hann, hann, hann, hann, hann, hann, hann};
     merge(_layer, 10, hann_cn);
 
     // create gaussian response
-    y=Mat::zeros((int)roi.height,(int)roi.width,CV_64F);
+    y=Mat::zeros((int)roi.height,(int)roi.width,CV_32F);
     for(unsigned i=0;i<roi.height;i++){
       for(unsigned j=0;j<roi.width;j++){
-        y.at<double>(i,j)=(i-roi.height/2+1)*(i-roi.height/2+1)+(j-roi.width/2+1)*(j-roi.width/2+1);
+        y.at<float>(i,j)=(float)((i-roi.height/2+1)*(i-roi.height/2+1)+(j-roi.width/2+1)*(j-roi.width/2+1));
       }
     }
 
@@ -264,67 +253,84 @@ namespace cv{
    * Main part of the KCF algorithm
    */
   bool TrackerKCFImpl::updateImpl( const Mat& image, Rect2d& boundingBox ){
-    double minVal, maxVal;	// min-max response
-    Point minLoc,maxLoc;	// min-max location
+    std::vector<TrackerKCFImpl*> trackers(1,this);
+    std::vector<Rect2d> boundingBoxes(1,boundingBox);
+    std::vector<uchar> success;
 
-    Mat img=image.clone();
-    // check the channels of the input image, grayscale is preferred
-    CV_Assert(img.channels() == 1 || img.channels() == 3);
+    updateTrackersKCF(image,trackers,boundingBoxes,success,maps_data);
 
-    // resize the image whenever needed
-    if(resizeImage)resize(img,img,Size(img.cols/2,img.rows/2));
+    boundingBox=boundingBoxes[0];
+    return success[0]!=0;
+  }
 
-    // detection part
-    if(frame>0){
+  /*
+   * search window scaled around the center of the current roi
+   */
+  Rect2d TrackerKCFImpl::getWindow(double scale) const {
+    if(scale==1.0)return roi;
+    return Rect2d(roi.x+roi.width*(1.0-scale)/2.0,roi.y+roi.height*(1.0-scale)/2.0,roi.width*scale,roi.height*scale);
+  }
 
-      // extract and pre-process the patch
-      // get non compressed descriptors
-      for(unsigned i=0;i<descriptors_npca.size()-extractor_npca.size();i++){
-        if(!getSubWindow(img,roi, features_npca[i], img_Patch, descriptors_npca[i]))return false;
-      }
-      //get non-compressed custom descriptors
-      for(unsigned i=0,j=(unsigned)(descriptors_npca.size()-extractor_npca.size());i<extractor_npca.size();i++,j++){
-        if(!getSubWindow(img,roi, features_npca[j], extractor_npca[i]))return false;
-      }
-      if(features_npca.size()>0)merge(features_npca,X[1]);
+  Rect TrackerKCFImpl::getSearchArea(bool detection) const {
+    Rect area=getWindow(1.0);
+    int nScales=std::max(params.scale_count,1);
+    if(!detection || nScales==1)return area;
 
-      // get compressed descriptors
-      for(unsigned i=0;i<descriptors_pca.size()-extractor_pca.size();i++){
-        if(!getSubWindow(img,roi, features_pca[i], img_Patch, descriptors_pca[i]))return false;
-      }
-      //get compressed custom descriptors
-      for(unsigned i=0,j=(unsigned)(descriptors_pca.size()-extractor_pca.size());i<extractor_pca.size();i++,j++){
-        if(!getSubWindow(img,roi, features_pca[j], extractor_pca[i]))return false;
-      }
-      if(features_pca.size()>0)merge(features_pca,X[0]);
+    // the windows of detect(), their rounding makes the extreme scales not cover the others
+    for(int s=0;s<nScales;s++)
+      area|=Rect(getWindow(std::pow(params.scale_step,s-(nScales-1)*0.5)));
+    return area;
+  }
 
-      //compress the features and the KRSL model
-      if(params.desc_pca !=0){
-        compress(proj_mtx,X[0],X[0],data_temp,compress_data);
-        compress(proj_mtx,Z[0],Zc[0],data_temp,compress_data);
-      }
+  /*
+   * detection part: the scale pyramid of the search window is evaluated against the model
+   */
+  bool TrackerKCFImpl::detect(const TrackerKCFFeatureMaps& maps, Rect2d& boundingBox){
+    double maxVal, bestVal=0.0;	// max response
+    Point maxLoc, bestLoc;	// max location
+    double bestScale=1.0;
+    bool found=false;
+
+    //compress the KRSL model, it is shared by all the scales
+    bool compressed=(params.desc_pca !=0 || use_custom_extractor_pca);
+    if(compressed)compress(proj_mtx,Z[0],Zc[0]);
+    Zc[1] = Z[1];
+    if(features_npca.size()==0)
+      z = Zc[0];
+    else if(features_pca.size()==0)
+      z = Z[1];
+    else
+      merge(Zc,2,z);
 
-      // copy the compressed KRLS model
-      Zc[1] = Z[1];
+    int nScales=std::max(params.scale_count,1);
+    for(int s=0;s<nScales;s++){
+      double scale=(nScales>1)?std::pow(params.scale_step,s-(nScales-1)*0.5):1.0;
+      Rect2d window=getWindow(scale);
+      if(window.width<1.0 || window.height<1.0)continue;
+
+      // extract and pre-process the patch
+      if(!getFeatures(maps,window))continue;
+
+      //compress the features
+      if(compressed)
+        compress(proj_mtx,X[0],Xc[0]);
+      else
+        Xc[0] = X[0];
+      Xc[1] = X[1];
 
       // merge all features
-      if(features_npca.size()==0){
-        x = X[0];
-        z = Zc[0];
-      }else if(features_pca.size()==0){
+      if(features_npca.size()==0)
+        x = Xc[0];
+      else if(features_pca.size()==0)
         x = X[1];
-        z = Z[1];
-      }else{
-        merge(X,2,x);
-        merge(Zc,2,z);
-      }
+      else
+        merge(Xc,2,x);
 
-      //compute the gaussian kernel
-      denseGaussKernel(params.sigma,x,z,k,layers,vxf,vyf,vxyf,xy_data,xyf_data);
+      //compute the gaussian kernel, the spectrum of the model is computed by the first scale only
+      denseGaussKernel(params.sigma,x,z,k,layers,vxf,vyf,vxyf,xy_data,xyf_data,found);
 
       // compute the fourier transform of the kernel
       fft2(k,kf);
-      if(frame==1)spec2=Mat_<Vec2d >(kf.rows, kf.cols);
 
       // calculate filter response
       if(params.split_coeff)
@@ -333,43 +339,47 @@ namespace cv{
         calcResponse(alphaf,kf,response, spec);
 
       // extract the maximum response
-      minMaxLoc( response, &minVal, &maxVal, &minLoc, &maxLoc );
-      roi.x+=(maxLoc.x-roi.width/2+1);
-      roi.y+=(maxLoc.y-roi.height/2+1);
-
-      // update the bounding box
-      boundingBox.x=(resizeImage?roi.x*2:roi.x)+boundingBox.width/2;
-      boundingBox.y=(resizeImage?roi.y*2:roi.y)+boundingBox.height/2;
+      minMaxLoc( response, NULL, &maxVal, NULL, &maxLoc );
+      if(!found || maxVal>bestVal){
+        bestVal=maxVal;
+        bestLoc=maxLoc;
+        bestScale=scale;
+        found=true;
+      }
     }
+    if(!found)return false;
+
+    // move the window of the best scale, the shift is measured in the model pixels
+    Rect2d window=getWindow(bestScale);
+    current_scale*=bestScale;
+    roi.x=window.x+(bestLoc.x-roi_size.width/2+1)*current_scale;
+    roi.y=window.y+(bestLoc.y-roi_size.height/2+1)*current_scale;
+    roi.width=window.width;
+    roi.height=window.height;
+
+    // update the bounding box
+    boundingBox.width=(resizeImage?roi.width:roi.width/2);
+    boundingBox.height=(resizeImage?roi.height:roi.height/2);
+    boundingBox.x=(resizeImage?roi.x*2:roi.x)+boundingBox.width/2;
+    boundingBox.y=(resizeImage?roi.y*2:roi.y)+boundingBox.height/2;
 
-    // extract the patch for learning purpose
-    // get non compressed descriptors
-    for(unsigned i=0;i<descriptors_npca.size()-extractor_npca.size();i++){
-      if(!getSubWindow(img,roi, features_npca[i], img_Patch, descriptors_npca[i]))return false;
-    }
-    //get non-compressed custom descriptors
-    for(unsigned i=0,j=(unsigned)(descriptors_npca.size()-extractor_npca.size());i<extractor_npca.size();i++,j++){
-      if(!getSubWindow(img,roi, features_npca[j], extractor_npca[i]))return false;
-    }
-    if(features_npca.size()>0)merge(features_npca,X[1]);
+    return true;
+  }
 
-    // get compressed descriptors
-    for(unsigned i=0;i<descriptors_pca.size()-extractor_pca.size();i++){
-      if(!getSubWindow(img,roi, features_pca[i], img_Patch, descriptors_pca[i]))return false;
-    }
-    //get compressed custom descriptors
-    for(unsigned i=0,j=(unsigned)(descriptors_pca.size()-extractor_pca.size());i<extractor_pca.size();i++,j++){
-      if(!getSubWindow(img,roi, features_pca[j], extractor_pca[i]))return false;
-    }
-    if(features_pca.size()>0)merge(features_pca,X[0]);
+  /*
+   * learning part: the model is updated with the patch at the current roi
+   */
+  bool TrackerKCFImpl::train(const TrackerKCFFeatureMaps& maps){
+    // extract the patch for learning purpose
+    if(!getFeatures(maps,roi))return false;
 
     //update the training data
     if(frame==0){
       Z[0] = X[0].clone();
       Z[1] = X[1].clone();
     }else{
-      Z[0]=(1.0-params.interp_factor)*Z[0]+params.interp_factor*X[0];
-      Z[1]=(1.0-params.interp_factor)*Z[1]+params.interp_factor*X[1];
+      if(!X[0].empty())addWeighted(Z[0],1.0-params.interp_factor,X[0],params.interp_factor,0.0,Z[0]);
+      if(!X[1].empty())addWeighted(Z[1],1.0-params.interp_factor,X[1],params.interp_factor,0.0,Z[1]);
     }
 
     if(params.desc_pca !=0 || use_custom_extractor_pca){
@@ -381,16 +391,19 @@ namespace cv{
 
       // feature compression
       updateProjectionMatrix(Z[0],old_cov_mtx,proj_mtx,params.pca_learning_rate,params.compressed_size,layers_pca_data,average_data,data_pca, new_covar,w_data,u_data,vt_data);
-      compress(proj_mtx,X[0],X[0],data_temp,compress_data);
+      compress(proj_mtx,X[0],Xc[0]);
+    }else{
+      Xc[0] = X[0];
     }
+    Xc[1] = X[1];
 
     // merge all features
     if(features_npca.size()==0)
-      x = X[0];
+      x = Xc[0];
     else if(features_pca.size()==0)
       x = X[1];
     else
-      merge(X,2,x);
+      merge(Xc,2,x);
 
     // initialize some required Mat variables
     if(frame==0){
@@ -398,7 +411,7 @@ namespace cv{
       vxf.resize(x.channels());
       vyf.resize(x.channels());
       vxyf.resize(vyf.size());
-      new_alphaf=Mat_<Vec2d >(yf.rows, yf.cols);
+      new_alphaf.create(yf.rows, yf.cols, CV_32FC2);
     }
 
     // Kernel Regularized Least-Squares, calculate alphas
@@ -406,38 +419,126 @@ namespace cv{
 
     // compute the fourier transform of the kernel and add a small value
     fft2(k,kf);
-    kf_lambda=kf+params.lambda;
+    add(kf,Scalar(params.lambda),kf_lambda);
 
-    double den;
     if(params.split_coeff){
       mulSpectrums(yf,kf,new_alphaf,0);
       mulSpectrums(kf,kf_lambda,new_alphaf_den,0);
     }else{
       for(int i=0;i<yf.rows;i++){
+        const Vec2f *yf_row = yf.ptr<Vec2f>(i), *kf_row = kf_lambda.ptr<Vec2f>(i);
+        Vec2f *alphaf_row = new_alphaf.ptr<Vec2f>(i);
         for(int j=0;j<yf.cols;j++){
-          den = 1.0/(kf_lambda.at<Vec2d>(i,j)[0]*kf_lambda.at<Vec2d>(i,j)[0]+kf_lambda.at<Vec2d>(i,j)[1]*kf_lambda.at<Vec2d>(i,j)[1]);
+          float den = 1.f/(kf_row[j][0]*kf_row[j][0]+kf_row[j][1]*kf_row[j][1]);
 
-          new_alphaf.at<Vec2d>(i,j)[0]=
-          (yf.at<Vec2d>(i,j)[0]*kf_lambda.at<Vec2d>(i,j)[0]+yf.at<Vec2d>(i,j)[1]*kf_lambda.at<Vec2d>(i,j)[1])*den;
-          new_alphaf.at<Vec2d>(i,j)[1]=
-          (yf.at<Vec2d>(i,j)[1]*kf_lambda.at<Vec2d>(i,j)[0]-yf.at<Vec2d>(i,j)[0]*kf_lambda.at<Vec2d>(i,j)[1])*den;
+          alphaf_row[j][0]=(yf_row[j][0]*kf_row[j][0]+yf_row[j][1]*kf_row[j][1])*den;
+          alphaf_row[j][1]=(yf_row[j][1]*kf_row[j][0]-yf_row[j][0]*kf_row[j][1])*den;
         }
       }
     }
 
     // update the RLS model
     if(frame==0){
-      alphaf=new_alphaf.clone();
-      if(params.split_coeff)alphaf_den=new_alphaf_den.clone();
+      new_alphaf.copyTo(alphaf);
+      if(params.split_coeff)new_alphaf_den.copyTo(alphaf_den);
     }else{
-      alphaf=(1.0-params.interp_factor)*alphaf+params.interp_factor*new_alphaf;
-      if(params.split_coeff)alphaf_den=(1.0-params.interp_factor)*alphaf_den+params.interp_factor*new_alphaf_den;
+      addWeighted(alphaf,1.0-params.interp_factor,new_alphaf,params.interp_factor,0.0,alphaf);
+      if(params.split_coeff)addWeighted(alphaf_den,1.0-params.interp_factor,new_alphaf_den,params.interp_factor,0.0,alphaf_den);
     }
 
     frame++;
     return true;
   }
 
+  /*
+   * parallel steps of the batched update
+   */
+  class DetectKCFParallel : public ParallelLoopBody {
+  public:
+    DetectKCFParallel(const TrackerKCFFeatureMaps &_maps, const std::vector<TrackerKCFImpl*> &_trackers,
+                      std::vector<Rect2d> &_boundingBoxes, std::vector<uchar> &_success)
+      : maps(_maps), trackers(_trackers), boundingBoxes(_boundingBoxes), success(_success) {}
+
+    virtual void operator()( const Range &r ) const {
+      for(int i=r.start;i<r.end;i++){
+        if(success[i] && trackers[i]->isTrained())
+          success[i]=(uchar)trackers[i]->detect(maps,boundingBoxes[i]);
+      }
+    }
+
+  private:
+    const TrackerKCFFeatureMaps &maps;
+    const std::vector<TrackerKCFImpl*> &trackers;
+    std::vector<Rect2d> &boundingBoxes;
+    std::vector<uchar> &success;
+  };
+
+  class TrainKCFParallel : public ParallelLoopBody {
+  public:
+    TrainKCFParallel(const TrackerKCFFeatureMaps &_maps, const std::vector<TrackerKCFImpl*> &_trackers,
+                     std::vector<uchar> &_success)
+      : maps(_maps), trackers(_trackers), success(_success) {}
+
+    virtual void operator()( const Range &r ) const {
+      for(int i=r.start;i<r.end;i++){
+        if(success[i])
+          success[i]=(uchar)trackers[i]->train(maps);
+      }
+    }
+
+  private:
+    const TrackerKCFFeatureMaps &maps;
+    const std::vector<TrackerKCFImpl*> &trackers;
+    std::vector<uchar> &success;
+  };
+
+  /*
+   * compute the feature maps covering the windows of all the active trackers
+   */
+  static void computeFeatureMaps(TrackerKCFFeatureMaps& maps, const std::vector<TrackerKCFImpl*>& trackers,
+                                 const std::vector<uchar>& success, bool detection){
+    Rect area[2];
+    unsigned modes[2]={0,0};
+
+    for(size_t i=0;i<trackers.size();i++){
+      if(!success[i] || (detection && !trackers[i]->isTrained()))continue;
+
+      int level=trackers[i]->getLevel();
+      Rect window=trackers[i]->getSearchArea(detection);
+      area[level]=(modes[level]==0)?window:(area[level] | window);
+      modes[level]|=trackers[i]->getModes();
+    }
+
+    for(int level=0;level<2;level++){
+      if(modes[level]!=0)maps.compute(level,area[level],modes[level]);
+    }
+  }
+
+  void updateTrackersKCF(const Mat& image, const std::vector<TrackerKCFImpl*>& trackers,
+                         std::vector<Rect2d>& boundingBoxes, std::vector<uchar>& success, TrackerKCFFeatureMaps& maps){
+    // check the channels of the input image, grayscale is preferred
+    CV_Assert(image.channels() == 1 || image.channels() == 3);
+    CV_Assert(trackers.size() == boundingBoxes.size());
+
+    int n=(int)trackers.size();
+    success.assign(n,(uchar)1);
+
+    // the half size frame is shared by all the trackers working on resized patches
+    bool needResized=false;
+    for(int i=0;i<n;i++){
+      if(trackers[i]->getLevel()==1)needResized=true;
+    }
+    maps.setImage(image,needResized);
+
+    // localize the targets
+    computeFeatureMaps(maps,trackers,success,true);
+    parallel_for_(Range(0,n),DetectKCFParallel(maps,trackers,boundingBoxes,success));
+
+    // update the models at the new locations, the maps are extended only when needed
+    computeFeatureMaps(maps,trackers,success,false);
+    parallel_for_(Range(0,n),TrainKCFParallel(maps,trackers,success));
+  }
+
 
   /*-------------------------------------
   |  implementation of the KCF functions
@@ -484,11 +585,11 @@ namespace cv{
   /*
    * simplification of fourier transform function in opencv
    */
-  void inline TrackerKCFImpl::fft2(const Mat src, Mat & dest) const {
+  void inline TrackerKCFImpl::fft2(const Mat &src, Mat & dest) const {
     dft(src,dest,DFT_COMPLEX_OUTPUT);
   }
 
-  void inline TrackerKCFImpl::fft2(const Mat src, std::vector<Mat> & dest, std::vector<Mat> & layers_data) const {
+  void inline TrackerKCFImpl::fft2(const Mat &src, std::vector<Mat> & dest, std::vector<Mat> & layers_data) const {
     split(src, layers_data);
 
     for(int i=0;i<src.channels();i++){
@@ -499,14 +600,14 @@ namespace cv{
   /*
    * simplification of inverse fourier transform function in opencv
    */
-  void inline TrackerKCFImpl::ifft2(const Mat src, Mat & dest) const {
+  void inline TrackerKCFImpl::ifft2(const Mat &src, Mat & dest) const {
     idft(src,dest,DFT_SCALE+DFT_REAL_OUTPUT);
   }
 
   /*
    * Point-wise multiplication of two Multichannel Mat data
    */
-  void inline TrackerKCFImpl::pixelWiseMult(const std::vector<Mat> src1, const std::vector<Mat>  src2, std::vector<Mat>  & dest, const int flags, const bool conjB) const {
+  void inline TrackerKCFImpl::pixelWiseMult(const std::vector<Mat> &src1, const std::vector<Mat> &src2, std::vector<Mat>  & dest, const int flags, const bool conjB) const {
     for(unsigned i=0;i<src1.size();i++){
       mulSpectrums(src1[i], src2[i], dest[i],flags,conjB);
     }
@@ -515,42 +616,41 @@ namespace cv{
   /*
    * Combines all channels in a multi-channels Mat data into a single channel
    */
-  void inline TrackerKCFImpl::sumChannels(std::vector<Mat> src, Mat & dest) const {
-    dest=src[0].clone();
+  void inline TrackerKCFImpl::sumChannels(const std::vector<Mat> &src, Mat & dest) const {
+    src[0].copyTo(dest);
     for(unsigned i=1;i<src.size();i++){
-      dest+=src[i];
+      add(dest,src[i],dest);
     }
   }
 
   /*
    * obtains the projection matrix using PCA
    */
-  void inline TrackerKCFImpl::updateProjectionMatrix(const Mat src, Mat & old_cov,Mat &  proj_matrix, double pca_rate, int compressed_sz,
-                                                     std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat pca_data, Mat new_cov, Mat w, Mat u, Mat vt) const {
+  void inline TrackerKCFImpl::updateProjectionMatrix(const Mat &src, Mat & old_cov,Mat &  proj_matrix, double pca_rate, int compressed_sz,
+                                                     std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat &pca_data, Mat &new_cov, Mat &w, Mat &u, Mat &vt) const {
     CV_Assert(compressed_sz<=src.channels());
 
     split(src,layers_pca);
 
     for (int i=0;i<src.channels();i++){
       average[i]=mean(layers_pca[i]);
-      layers_pca[i]-=average[i];
+      subtract(layers_pca[i],average[i],layers_pca[i]);
     }
 
     // calc covariance matrix
     merge(layers_pca,pca_data);
-    pca_data=pca_data.reshape(1,src.rows*src.cols);
-
-    new_cov=1.0/(double)(src.rows*src.cols-1)*(pca_data.t()*pca_data);
+    mulTransposed(pca_data.reshape(1,src.rows*src.cols),new_cov,true,noArray(),1.0/(double)(src.rows*src.cols-1));
     if(old_cov.rows==0)old_cov=new_cov.clone();
 
     // calc PCA
-    SVD::compute((1.0-pca_rate)*old_cov+pca_rate*new_cov, w, u, vt);
+    addWeighted(old_cov,1.0-pca_rate,new_cov,pca_rate,0.0,new_cov);
+    SVD::compute(new_cov, w, u, vt);
 
     // extract the projection matrix
-    proj_matrix=u(Rect(0,0,compressed_sz,src.channels())).clone();
+    u(Rect(0,0,compressed_sz,src.channels())).copyTo(proj_matrix);
     Mat proj_vars=Mat::eye(compressed_sz,compressed_sz,proj_matrix.type());
     for(int i=0;i<compressed_sz;i++){
-      proj_vars.at<double>(i,i)=w.at<double>(i);
+      proj_vars.at<float>(i,i)=w.at<float>(i);
     }
 
     // update the covariance matrix
@@ -558,19 +658,51 @@ namespace cv{
   }
 
   /*
-   * compress the features
+   * compress the features, the product is written directly to the destination buffer
    */
-  void inline TrackerKCFImpl::compress(const Mat proj_matrix, const Mat src, Mat & dest, Mat & data, Mat & compressed) const {
-    data=src.reshape(1,src.rows*src.cols);
-    compressed=data*proj_matrix;
-    dest=compressed.reshape(proj_matrix.cols,src.rows).clone();
+  void inline TrackerKCFImpl::compress(const Mat &proj_matrix, const Mat &src, Mat & dest) const {
+    if(dest.data == src.data)dest.release();
+    dest.create(src.rows, src.cols, CV_MAKETYPE(proj_matrix.depth(), proj_matrix.cols));
+    Mat compressed=dest.reshape(1,src.rows*src.cols);
+    gemm(src.reshape(1,src.rows*src.cols), proj_matrix, 1.0, noArray(), 0.0, compressed);
   }
 
   /*
-   * obtain the patch and apply hann window filter to it
+   * extract all the compressed and non-compressed features of the window
    */
-  bool TrackerKCFImpl::getSubWindow(const Mat img, const Rect _roi, Mat& feat, Mat& patch, TrackerKCF::MODE desc) const {
+  bool TrackerKCFImpl::getFeatures(const TrackerKCFFeatureMaps& maps, const Rect2d& window){
+    const Mat &img=maps.image[getLevel()];
 
+    // get non compressed descriptors
+    for(unsigned i=0;i<descriptors_npca.size()-extractor_npca.size();i++){
+      if(!getSubWindow(maps,window, features_npca[i], descriptors_npca[i]))return false;
+    }
+    //get non-compressed custom descriptors
+    for(unsigned i=0,j=(unsigned)(descriptors_npca.size()-extractor_npca.size());i<extractor_npca.size();i++,j++){
+      if(!getSubWindow(img,window, features_npca[j], extractor_npca[i]))return false;
+    }
+    if(features_npca.size()>0)merge(features_npca,X[1]);
+
+    // get compressed descriptors
+    for(unsigned i=0;i<descriptors_pca.size()-extractor_pca.size();i++){
+      if(!getSubWindow(maps,window, features_pca[i], descriptors_pca[i]))return false;
+    }
+    //get compressed custom descriptors
+    for(unsigned i=0,j=(unsigned)(descriptors_pca.size()-extractor_pca.size());i<extractor_pca.size();i++,j++){
+      if(!getSubWindow(img,window, features_pca[j], extractor_pca[i]))return false;
+    }
+    if(features_pca.size()>0)merge(features_pca,X[0]);
+
+    return true;
+  }
+
+  /*
+   * crop the patch from the feature maps, resize it to the size of the model and apply hann window filter to it
+   */
+  bool TrackerKCFImpl::getSubWindow(const TrackerKCFFeatureMaps& maps, const Rect _roi, Mat& feat, TrackerKCF::MODE desc) {
+
+    const int level=getLevel();
+    const Mat &img=maps.image[level];
     Rect region=_roi;
 
     // return false if roi is outside the image
@@ -588,8 +720,6 @@ namespace cv{
     if(region.width>img.cols)region.width=img.cols;
     if(region.height>img.rows)region.height=img.rows;
 
-    patch=img(region).clone();
-
     // add some padding to compensate when the patch is outside image border
     int addTop,addBottom, addLeft, addRight;
     addTop=region.y-_roi.y;
@@ -597,26 +727,19 @@ namespace cv{
     addLeft=region.x-_roi.x;
     addRight=(_roi.width+_roi.x>img.cols?_roi.width+_roi.x-img.cols:0);
 
-    copyMakeBorder(patch,patch,addTop,addBottom,addLeft,addRight,BORDER_REPLICATE);
+    // the descriptors are pixel-wise, so the padded patch of the map equals the map of the padded patch
+    const Mat &map=(desc==CN)?maps.cn[level]:maps.gray[level];
+    CV_Assert(!map.empty() && (maps.area[level] & region) == region);
+
+    // the patches of the other scales are brought to the size of the model
+    bool scaled=(_roi.width!=hann.cols || _roi.height!=hann.rows);
+    Mat &patch=scaled?img_Patch:feat;
+    copyMakeBorder(map(region-maps.area[level].tl()),patch,addTop,addBottom,addLeft,addRight,BORDER_REPLICATE|BORDER_ISOLATED);
     if(patch.rows==0 || patch.cols==0)return false;
+    if(scaled)resize(patch,feat,hann.size());
 
-    // extract the desired descriptors
-    switch(desc){
-      case CN:
-        CV_Assert(img.channels() == 3);
-        extractCN(patch,feat);
-        feat=feat.mul(hann_cn); // hann window filter
-        break;
-      default: // GRAY
-        if(img.channels()>1)
-          cvtColor(patch,feat, CV_BGR2GRAY);
-        else
-          feat=patch;
-        feat.convertTo(feat,CV_64F);
-        feat=feat/255.0-0.5; // normalize to range -0.5 .. 0.5
-        feat=feat.mul(hann); // hann window filter
-        break;
-    }
+    // hann window filter
+    multiply(feat,(desc==CN)?hann_cn:hann,feat);
 
     return true;
 
@@ -625,7 +748,7 @@ namespace cv{
   /*
    * get feature using external function
    */
-  bool TrackerKCFImpl::getSubWindow(const Mat img, const Rect _roi, Mat& feat, void (*f)(const Mat, const Rect, Mat& )) const{
+  bool TrackerKCFImpl::getSubWindow(const Mat &img, const Rect _roi, Mat& feat, void (*f)(const Mat, const Rect, Mat& )){
 
     // return false if roi is outside the image
     if((_roi.x+_roi.width<0)
@@ -641,79 +764,67 @@ namespace cv{
       printf("Rules: roi.width==feat.cols && roi.height = feat.rows \n");
     }
 
-    Mat hann_win;
-    std::vector<Mat> _layers;
+    // the tracker works in single precision
+    if(feat.depth() != CV_32F)
+      feat.convertTo(feat, CV_32F);
 
-    for(int i=0;i<feat.channels();i++)
-      _layers.push_back(hann);
+    // the patches of the other scales are brought to the size of the model
+    if(feat.cols != hann.cols || feat.rows != hann.rows)
+      resize(feat, feat, hann.size());
 
-    merge(_layers, hann_win);
+    if(hann_custom.channels() != feat.channels()){
+      std::vector<Mat> _layers;
+      for(int i=0;i<feat.channels();i++)
+        _layers.push_back(hann);
+      merge(_layers, hann_custom);
+    }
 
-    feat=feat.mul(hann_win); // hann window filter
+    multiply(feat,hann_custom,feat); // hann window filter
 
     return true;
   }
 
-  /* Convert BGR to ColorNames
-   */
-  void TrackerKCFImpl::extractCN(Mat patch_data, Mat & cnFeatures) const {
-    Vec3b & pixel = patch_data.at<Vec3b>(0,0);
-    unsigned index;
-
-    if(cnFeatures.type() != CV_64FC(10))
-      cnFeatures = Mat::zeros(patch_data.rows,patch_data.cols,CV_64FC(10));
-
-    for(int i=0;i<patch_data.rows;i++){
-      for(int j=0;j<patch_data.cols;j++){
-        pixel=patch_data.at<Vec3b>(i,j);
-        index=(unsigned)(floor(pixel[2]/8)+32*floor(pixel[1]/8)+32*32*floor(pixel[0]/8));
-
-        //copy the values
-        for(int _k=0;_k<10;_k++){
-          cnFeatures.at<Vec<double,10> >(i,j)[_k]=ColorNames[index][_k];
-        }
-      }
-    }
-
-  }
-
   /*
    *  dense gauss kernel function
    */
-  void TrackerKCFImpl::denseGaussKernel(const double sigma, const Mat x_data, const Mat y_data, Mat & k_data,
-                                        std::vector<Mat> & layers_data,std::vector<Mat> & xf_data,std::vector<Mat> & yf_data, std::vector<Mat> xyf_v, Mat xy, Mat xyf ) const {
+  void TrackerKCFImpl::denseGaussKernel(const double sigma, const Mat &x_data, const Mat &y_data, Mat & k_data,
+                                        std::vector<Mat> & layers_data,std::vector<Mat> & xf_data,std::vector<Mat> & yf_data, std::vector<Mat> &xyf_v, Mat &xy, Mat &xyf,
+                                        const bool reuse_yf ) const {
     double normX, normY;
 
+    // the spectrum of the data is computed only once for the auto-correlation,
+    // the spectrum of y is kept from the previous call when requested
+    bool autoCorrelation = x_data.data == y_data.data;
     fft2(x_data,xf_data,layers_data);
-    fft2(y_data,yf_data,layers_data);
+    if(!autoCorrelation && !reuse_yf)fft2(y_data,yf_data,layers_data);
 
     normX=norm(x_data);
     normX*=normX;
-    normY=norm(y_data);
-    normY*=normY;
+    if(autoCorrelation){
+      normY=normX;
+    }else{
+      normY=norm(y_data);
+      normY*=normY;
+    }
 
-    pixelWiseMult(xf_data,yf_data,xyf_v,0,true);
+    pixelWiseMult(xf_data,autoCorrelation?xf_data:yf_data,xyf_v,0,true);
     sumChannels(xyf_v,xyf);
-    ifft2(xyf,xyf);
+    ifft2(xyf,xy);
 
     if(params.wrap_kernel){
-      shiftRows(xyf, x_data.rows/2);
-      shiftCols(xyf, x_data.cols/2);
+      shiftRows(xy, x_data.rows/2);
+      shiftCols(xy, x_data.cols/2);
     }
 
-    //(xx + yy - 2 * xy) / numel(x)
-    xy=(normX+normY-2*xyf)/(x_data.rows*x_data.cols*x_data.channels());
+    //(xx + yy - 2 * xy) / numel(x), scaled by -1/sigma^2 in the same pass
+    double numel=(double)(x_data.rows*x_data.cols*x_data.channels());
+    double sig=-1.0/(sigma*sigma);
+    xy.convertTo(xy,-1,-2.0*sig/numel,(normX+normY)*sig/numel);
 
     // TODO: check wether we really need thresholding or not
-    //threshold(xy,xy,0.0,0.0,THRESH_TOZERO);//max(0, (xx + yy - 2 * xy) / numel(x))
-    for(int i=0;i<xy.rows;i++){
-      for(int j=0;j<xy.cols;j++){
-        if(xy.at<double>(i,j)<0.0)xy.at<double>(i,j)=0.0;
-      }
-    }
+    //max(0, (xx + yy - 2 * xy) / numel(x)), i.e. min(0, .) after the negative scaling
+    min(xy,0.0,xy);
 
-    double sig=-1.0/(sigma*sigma);
-    xy=sig*xy;
     exp(xy,k_data);
 
   }
@@ -772,7 +883,7 @@ namespace cv{
   /*
    * calculate the detection response
    */
-  void TrackerKCFImpl::calcResponse(const Mat alphaf_data, const Mat kf_data, Mat & response_data, Mat & spec_data) const {
+  void TrackerKCFImpl::calcResponse(const Mat &alphaf_data, const Mat &kf_data, Mat & response_data, Mat & spec_data) const {
     //alpha f--> 2channels ; k --> 1 channel;
     mulSpectrums(alphaf_data,kf_data,spec_data,0,false);
     ifft2(spec_data,response_data);
@@ -781,19 +892,19 @@ namespace cv{
   /*
    * calculate the detection response for splitted form
    */
-  void TrackerKCFImpl::calcResponse(const Mat alphaf_data, const Mat _alphaf_den, const Mat kf_data, Mat & response_data, Mat & spec_data, Mat & spec2_data) const {
+  void TrackerKCFImpl::calcResponse(const Mat &alphaf_data, const Mat &_alphaf_den, const Mat &kf_data, Mat & response_data, Mat & spec_data, Mat & spec2_data) const {
 
     mulSpectrums(alphaf_data,kf_data,spec_data,0,false);
+    spec2_data.create(kf_data.rows, kf_data.cols, CV_32FC2);
 
     //z=(a+bi)/(c+di)=[(ac+bd)+i(bc-ad)]/(c^2+d^2)
-    double den;
     for(int i=0;i<kf_data.rows;i++){
+      const Vec2f *spec_row = spec_data.ptr<Vec2f>(i), *den_row = _alphaf_den.ptr<Vec2f>(i);
+      Vec2f *spec2_row = spec2_data.ptr<Vec2f>(i);
       for(int j=0;j<kf_data.cols;j++){
-        den=1.0/(_alphaf_den.at<Vec2d>(i,j)[0]*_alphaf_den.at<Vec2d>(i,j)[0]+_alphaf_den.at<Vec2d>(i,j)[1]*_alphaf_den.at<Vec2d>(i,j)[1]);
-        spec2_data.at<Vec2d>(i,j)[0]=
-          (spec_data.at<Vec2d>(i,j)[0]*_alphaf_den.at<Vec2d>(i,j)[0]+spec_data.at<Vec2d>(i,j)[1]*_alphaf_den.at<Vec2d>(i,j)[1])*den;
-        spec2_data.at<Vec2d>(i,j)[1]=
-          (spec_data.at<Vec2d>(i,j)[1]*_alphaf_den.at<Vec2d>(i,j)[0]-spec_data.at<Vec2d>(i,j)[0]*_alphaf_den.at<Vec2d>(i,j)[1])*den;
+        float den=1.f/(den_row[j][0]*den_row[j][0]+den_row[j][1]*den_row[j][1]);
+        spec2_row[j][0]=(spec_row[j][0]*den_row[j][0]+spec_row[j][1]*den_row[j][1])*den;
+        spec2_row[j][1]=(spec_row[j][1]*den_row[j][0]-spec_row[j][0]*den_row[j][1])*den;
       }
     }
 
@@ -830,6 +941,10 @@ namespace cv{
       compress_feature=true;
       compressed_size=2;
       pca_learning_rate=0.15;
+
+      //scale estimation
+      scale_count=1;
+      scale_step=1.05;
   }
 
   void TrackerKCF::Params::read( const cv::FileNode& /*fn*/ ){}
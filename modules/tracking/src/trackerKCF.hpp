@@ -0,0 +1,196 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+ //
+ //  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+ //
+ //  By downloading, copying, installing or using the software you agree to this license.
+ //  If you do not agree to this license, do not download, install,
+ //  copy or use the software.
+ //
+ //
+ //                           License Agreement
+ //                For Open Source Computer Vision Library
+ //
+ // Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+ // Third party copyrights are property of their respective owners.
+ //
+ // Redistribution and use in source and binary forms, with or without modification,
+ // are permitted provided that the following conditions are met:
+ //
+ //   * Redistribution's of source code must retain the above copyright notice,
+ //     this list of conditions and the following disclaimer.
+ //
+ //   * Redistribution's in binary form must reproduce the above copyright notice,
+ //     this list of conditions and the following disclaimer in the documentation
+ //     and/or other materials provided with the distribution.
+ //
+ //   * The name of the copyright holders may not be used to endorse or promote products
+ //     derived from this software without specific prior written permission.
+ //
+ // This software is provided by the copyright holders and contributors "as is" and
+ // any express or implied warranties, including, but not limited to, the implied
+ // warranties of merchantability and fitness for a particular purpose are disclaimed.
+ // In no event shall the Intel Corporation or contributors be liable for any direct,
+ // indirect, incidental, special, exemplary, or consequential damages
+ // (including, but not limited to, procurement of substitute goods or services;
+ // loss of use, data, or profits; or business interruption) however caused
+ // and on any theory of liability, whether in contract, strict liability,
+ // or tort (including negligence or otherwise) arising in any way out of
+ // the use of this software, even if advised of the possibility of such damage.
+ //
+ //M*/
+
+#ifndef OPENCV_KCF_TRACKER
+#define OPENCV_KCF_TRACKER
+
+#include "precomp.hpp"
+
+namespace cv{
+
+  /*
+   * Feature maps of a frame, computed once and shared by all the KCF trackers
+   * working on the frame. Level 0 holds the input frame, level 1 its half size version
+   * used by the trackers with resized patches.
+   */
+  struct TrackerKCFFeatureMaps {
+    Mat image[2];   // the frame of each level
+    Rect area[2];   // part of the frame covered by the maps of each level
+    Mat gray[2];    // normalized grayscale map
+    Mat cn[2];      // color-names map
+    Mat gray_u8[2]; // buffer for the grayscale conversion
+    unsigned modes[2]; // TrackerKCF::MODE of the computed maps
+
+    TrackerKCFFeatureMaps(){modes[0]=modes[1]=0;}
+
+    // set the frame, the half size level is computed only when requested
+    void setImage(const Mat& img, bool needResized);
+
+    // make sure that the maps of the given modes cover the region of the frame
+    void compute(int level, const Rect& region, unsigned desc);
+  };
+
+  /*
+   * Prototype
+   */
+  class TrackerKCFImpl : public TrackerKCF {
+  public:
+    TrackerKCFImpl( const TrackerKCF::Params &parameters = TrackerKCF::Params() );
+    void read( const FileNode& /*fn*/ );
+    void write( FileStorage& /*fs*/ ) const;
+    void setFeatureExtractor(void (*f)(const Mat, const Rect, Mat&), bool pca_func = false);
+
+    /*
+    * the steps of the update, used by the batched update of several trackers
+    */
+    // level of the feature maps and descriptors used by the tracker
+    bool isInitialized() const { return isInit; }
+    int getLevel() const { return resizeImage ? 1 : 0; }
+    unsigned getModes() const { return (params.desc_pca | params.desc_npca) & (GRAY | CN); }
+    // part of the frame read by the next call of detect() or train()
+    Rect getSearchArea(bool detection) const;
+    bool isTrained() const { return frame > 0; }
+    // localize the target in the frame, the roi and the scale are updated
+    bool detect(const TrackerKCFFeatureMaps& maps, Rect2d& boundingBox);
+    // update the model at the current roi
+    bool train(const TrackerKCFFeatureMaps& maps);
+
+  protected:
+     /*
+    * basic functions and vars
+    */
+    bool initImpl( const Mat& /*image*/, const Rect2d& boundingBox );
+    bool updateImpl( const Mat& image, Rect2d& boundingBox );
+
+    TrackerKCF::Params params;
+
+    /*
+    * KCF functions and vars
+    */
+    void createHanningWindow(OutputArray dest, const cv::Size winSize, const int type) const;
+    void inline fft2(const Mat &src, std::vector<Mat> & dest, std::vector<Mat> & layers_data) const;
+    void inline fft2(const Mat &src, Mat & dest) const;
+    void inline ifft2(const Mat &src, Mat & dest) const;
+    void inline pixelWiseMult(const std::vector<Mat> &src1, const std::vector<Mat> &src2, std::vector<Mat> & dest, const int flags, const bool conjB=false) const;
+    void inline sumChannels(const std::vector<Mat> &src, Mat & dest) const;
+    void inline updateProjectionMatrix(const Mat &src, Mat & old_cov,Mat &  proj_matrix,double pca_rate, int compressed_sz,
+                                       std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat &pca_data, Mat &new_cov, Mat &w, Mat &u, Mat &v) const;
+    void inline compress(const Mat &proj_matrix, const Mat &src, Mat & dest) const;
+    Rect2d getWindow(double scale) const;
+    bool getFeatures(const TrackerKCFFeatureMaps& maps, const Rect2d& window);
+    bool getSubWindow(const TrackerKCFFeatureMaps& maps, const Rect window, Mat& feat, TrackerKCF::MODE desc = GRAY);
+    bool getSubWindow(const Mat &img, const Rect window, Mat& feat, void (*f)(const Mat, const Rect, Mat& ));
+    void denseGaussKernel(const double sigma, const Mat &x_data, const Mat &y_data, Mat & k_data,
+                          std::vector<Mat> & layers_data,std::vector<Mat> & xf_data,std::vector<Mat> & yf_data, std::vector<Mat> &xyf_v, Mat &xy, Mat &xyf,
+                          const bool reuse_yf=false ) const;
+    void calcResponse(const Mat &alphaf_data, const Mat &kf_data, Mat & response_data, Mat & spec_data) const;
+    void calcResponse(const Mat &alphaf_data, const Mat &alphaf_den_data, const Mat &kf_data, Mat & response_data, Mat & spec_data, Mat & spec2_data) const;
+
+    void shiftRows(Mat& mat) const;
+    void shiftRows(Mat& mat, int n) const;
+    void shiftCols(Mat& mat, int n) const;
+
+  private:
+    double output_sigma;
+    Rect2d roi; // search window at the current scale
+    Size2d roi_size; // search window at the initial scale, i.e. the size of the model
+    double current_scale; // scale of the target relative to the initial bounding box
+    Mat hann; 	//hann window filter
+    Mat hann_cn; //10 dimensional hann-window filter for CN features,
+    Mat hann_custom; //hann-window filter for the channels of the custom features
+
+    Mat y,yf; 	// training response and its FFT
+    Mat x; 	// observation and its FFT
+    Mat k,kf;	// dense gaussian kernel and its FFT
+    Mat kf_lambda; // kf+lambda
+    Mat new_alphaf, alphaf;	// training coefficients
+    Mat new_alphaf_den, alphaf_den; // for splitted training coefficients
+    Mat z; // model
+    Mat response; // detection result
+    Mat old_cov_mtx, proj_mtx; // for feature compression
+
+    // pre-defined Mat variables for optimization of private functions,
+    // all of them are allocated in the first frames and reused by the following ones
+    Mat spec, spec2;
+    std::vector<Mat> layers;
+    std::vector<Mat> vxf,vyf,vxyf;
+    Mat xy_data,xyf_data;
+    std::vector<Mat> layers_pca_data;
+    std::vector<Scalar> average_data;
+    Mat img_Patch;
+
+    // storage for the extracted features, compressed features, KRLS model, KRLS compressed model
+    Mat X[2],Xc[2],Z[2],Zc[2];
+
+    // storage of the extracted features
+    std::vector<Mat> features_pca;
+    std::vector<Mat> features_npca;
+    std::vector<MODE> descriptors_pca;
+    std::vector<MODE> descriptors_npca;
+
+    // optimization variables for updateProjectionMatrix
+    Mat data_pca, new_covar,w_data,u_data,vt_data;
+
+    // custom feature extractor
+    bool use_custom_extractor_pca;
+    bool use_custom_extractor_npca;
+    std::vector<void(*)(const Mat img, const Rect roi, Mat& output)> extractor_pca;
+    std::vector<void(*)(const Mat img, const Rect roi, Mat& output)> extractor_npca;
+
+    bool resizeImage; // resize the image whenever needed and the patch size is large
+
+    int frame;
+
+    // the maps of the single tracker update
+    TrackerKCFFeatureMaps maps_data;
+  };
+
+  /*
+   * Update a set of KCF trackers on the same frame: the feature maps are computed once
+   * for all of them and the trackers are processed in parallel.
+   * success[i] is set to 0 when the i-th target is lost, maps is the reused storage of the feature maps.
+   */
+  void updateTrackersKCF(const Mat& image, const std::vector<TrackerKCFImpl*>& trackers,
+                         std::vector<Rect2d>& boundingBoxes, std::vector<uchar>& success, TrackerKCFFeatureMaps& maps);
+
+} /* namespace cv */
+
+#endif
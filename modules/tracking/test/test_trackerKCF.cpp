@@ -0,0 +1,196 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+ //
+ //  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+ //
+ //  By downloading, copying, installing or using the software you agree to this license.
+ //  If you do not agree to this license, do not download, install,
+ //  copy or use the software.
+ //
+ //
+ //                           License Agreement
+ //                For Open Source Computer Vision Library
+ //
+ // Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+ // Third party copyrights are property of their respective owners.
+ //
+ // Redistribution and use in source and binary forms, with or without modification,
+ // are permitted provided that the following conditions are met:
+ //
+ //   * Redistribution's of source code must retain the above copyright notice,
+ //     this list of conditions and the following disclaimer.
+ //
+ //   * Redistribution's in binary form must reproduce the above copyright notice,
+ //     this list of conditions and the following disclaimer in the documentation
+ //     and/or other materials provided with the distribution.
+ //
+ //   * The name of the copyright holders may not be used to endorse or promote products
+ //     derived from this software without specific prior written permission.
+ //
+ // This software is provided by the copyright holders and contributors "as is" and
+ // any express or implied warranties, including, but not limited to, the implied
+ // warranties of merchantability and fitness for a particular purpose are disclaimed.
+ // In no event shall the Intel Corporation or contributors be liable for any direct,
+ // indirect, incidental, special, exemplary, or consequential damages
+ // (including, but not limited to, procurement of substitute goods or services;
+ // loss of use, data, or profits; or business interruption) however caused
+ // and on any theory of liability, whether in contract, strict liability,
+ // or tort (including negligence or otherwise) arising in any way out of
+ // the use of this software, even if advised of the possibility of such damage.
+ //
+ //M*/
+
+#include "test_precomp.hpp"
+
+using namespace cv;
+using namespace std;
+
+/*
+ * Synthetic sequence: textured targets moving (and optionally growing) over a noisy background
+ */
+static void createKCFSequence(int nFrames, const vector<Rect2d>& start, const Point2d& shift, double growth,
+                              vector<Mat>& frames, vector<vector<Rect2d> >& truth)
+{
+  RNG rng(0x1234);
+  Mat background(480, 640, CV_8UC3);
+  rng.fill(background, RNG::UNIFORM, 0, 256);
+  GaussianBlur(background, background, Size(5, 5), 0);
+
+  vector<Mat> textures;
+  for (size_t t = 0; t < start.size(); t++)
+  {
+    Mat texture(64, 64, CV_8UC3);
+    rng.fill(texture, RNG::UNIFORM, 0, 256);
+    GaussianBlur(texture, texture, Size(3, 3), 0);
+    rectangle(texture, Rect(8, 8, 48, 48), Scalar(255, 0, 0), 4);
+    circle(texture, Point(32, 32), 12, Scalar(0, 0, 255), -1);
+    textures.push_back(texture);
+  }
+
+  frames.clear();
+  truth.assign(nFrames, vector<Rect2d>());
+  for (int f = 0; f < nFrames; f++)
+  {
+    Mat frame = background.clone();
+    double scale = pow(growth, f);
+    for (size_t t = 0; t < start.size(); t++)
+    {
+      Point2d center(start[t].x + start[t].width / 2 + shift.x * f, start[t].y + start[t].height / 2 + shift.y * f);
+      Size size(cvRound(start[t].width * scale), cvRound(start[t].height * scale));
+      Rect r(cvRound(center.x - size.width / 2.0), cvRound(center.y - size.height / 2.0), size.width, size.height);
+      resize(textures[t], frame(r), size);
+      truth[f].push_back(r);
+    }
+    frames.push_back(frame);
+  }
+}
+
+TEST(KCF, multitracker_matches_single_trackers)
+{
+  vector<Rect2d> start;
+  start.push_back(Rect2d(100, 100, 40, 40));
+  start.push_back(Rect2d(150, 110, 40, 40)); // overlapping search windows
+  start.push_back(Rect2d(400, 300, 100, 100)); // resized patches
+  vector<Mat> frames;
+  vector<vector<Rect2d> > truth;
+  createKCFSequence(15, start, Point2d(2, 1), 1.0, frames, truth);
+
+  TrackerKCF::Params params;
+  params.scale_count = 3;
+
+  MultiTrackerKCF multi;
+  vector<Ptr<Tracker> > singles;
+  vector<Rect2d> boxes = start;
+  for (size_t t = 0; t < start.size(); t++)
+  {
+    ASSERT_TRUE(multi.addTarget(frames[0], start[t], params));
+    singles.push_back(TrackerKCF::createTracker(params));
+    ASSERT_TRUE(singles[t]->init(frames[0], start[t]));
+  }
+
+  for (size_t f = 1; f < frames.size(); f++)
+  {
+    bool multiResult = multi.update_opt(frames[f]);
+    bool singleResult = true;
+    for (size_t t = 0; t < singles.size(); t++)
+      singleResult = singles[t]->update(frames[f], boxes[t]) && singleResult;
+
+    ASSERT_EQ(singleResult, multiResult) << "frame " << f;
+    for (size_t t = 0; t < singles.size(); t++)
+    {
+      EXPECT_DOUBLE_EQ(boxes[t].x, multi.boundingBoxes[t].x) << "frame " << f << " target " << t;
+      EXPECT_DOUBLE_EQ(boxes[t].y, multi.boundingBoxes[t].y) << "frame " << f << " target " << t;
+      EXPECT_DOUBLE_EQ(boxes[t].width, multi.boundingBoxes[t].width) << "frame " << f << " target " << t;
+      EXPECT_DOUBLE_EQ(boxes[t].height, multi.boundingBoxes[t].height) << "frame " << f << " target " << t;
+    }
+  }
+
+  // the targets are followed
+  for (size_t t = 0; t < start.size(); t++)
+  {
+    Rect2d last = truth.back()[t];
+    EXPECT_LT(norm(Point2d(boxes[t].x - last.x, boxes[t].y - last.y)), 10.0) << "target " << t;
+  }
+}
+
+TEST(KCF, scale_estimation)
+{
+  vector<Rect2d> start(1, Rect2d(260, 180, 50, 50));
+  vector<Mat> frames;
+  vector<vector<Rect2d> > truth;
+  createKCFSequence(20, start, Point2d(1, 0), 1.02, frames, truth);
+
+  TrackerKCF::Params params;
+  params.scale_count = 3;
+  Ptr<Tracker> tracker = TrackerKCF::createTracker(params);
+  Rect2d box = start[0];
+  ASSERT_TRUE(tracker->init(frames[0], box));
+  for (size_t f = 1; f < frames.size(); f++)
+    ASSERT_TRUE(tracker->update(frames[f], box)) << "frame " << f;
+
+  // the bounding box follows the growth of the target, the single scale tracker keeps the initial size
+  Rect2d last = truth.back()[0];
+  EXPECT_GT(box.width, start[0].width * 1.1);
+  EXPECT_LT(fabs(box.width - last.width), last.width * 0.2);
+  EXPECT_LT(norm(Point2d(box.x + box.width / 2 - last.x - last.width / 2, box.y + box.height / 2 - last.y - last.height / 2)), 10.0);
+}
+
+static double overlap(const Rect2d& a, const Rect2d& b)
+{
+  double inter = (a & b).area();
+  return inter / (a.area() + b.area() - inter);
+}
+
+TEST(KCF, single_precision_accuracy)
+{
+  vector<Rect2d> start(1, Rect2d(200, 150, 60, 60));
+  vector<Mat> frames;
+  vector<vector<Rect2d> > truth;
+  createKCFSequence(30, start, Point2d(3, 2), 1.0, frames, truth);
+
+  // compressed color names with gray values, gray values only and the resized patch
+  const int nConfigs = 3;
+  for (int c = 0; c < nConfigs; c++)
+  {
+    TrackerKCF::Params params;
+    if (c == 1)
+    {
+      params.desc_pca = 0;
+      params.desc_npca = TrackerKCF::GRAY;
+      params.compress_feature = false;
+    }
+    else if (c == 2)
+    {
+      params.resize = true;
+      params.max_patch_size = 40 * 40;
+    }
+
+    Ptr<Tracker> tracker = TrackerKCF::createTracker(params);
+    Rect2d box = start[0];
+    ASSERT_TRUE(tracker->init(frames[0], box)) << "config " << c;
+    for (size_t f = 1; f < frames.size(); f++)
+    {
+      ASSERT_TRUE(tracker->update(frames[f], box)) << "config " << c << " frame " << f;
+      EXPECT_GT(overlap(box, truth[f][0]), 0.7) << "config " << c << " frame " << f;
+    }
+  }
+}